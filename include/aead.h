@@ -0,0 +1,110 @@
+#ifndef AEAD_H
+#define AEAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Authenticated encryption stage of the transmitter pipeline
+ * (getMessage -> compress -> encrypt -> sendMessage).
+ *
+ * Two backends behind the same interface, picked at build time:
+ *
+ *   AES-256-GCM        (NIST SP 800-38D) through mbedtls, which in ESP-IDF
+ *                      runs the AES rounds on the ESP32 AES accelerator
+ *                      (CONFIG_MBEDTLS_HARDWARE_AES). Default on the ESP32.
+ *   ChaCha20-Poly1305  (RFC 8439) in plain C. Used on the host, and on the
+ *                      ESP32 when built with -DAEAD_FORCE_SOFTWARE.
+ *
+ * Both use a 32 byte key, a 12 byte nonce and a 16 byte tag, so the frame
+ * layout does not depend on the backend, but both ends must be built with
+ * the same one.
+ *
+ * Data is encrypted/decrypted in place: the transmitter passes a pointer
+ * into the frame buffer and no copy is made. The streaming calls accept
+ * any chunk size, so a long message can be processed as it is produced;
+ * aeadSeal/aeadOpen wrap them for the usual one-shot case.
+ *
+ * A (key, nonce) pair must never be used twice. The transmitter builds
+ * nonces from transmitter id + sequence number (see aeadBuildNonce).
+ */
+
+#define AEAD_KEY_SIZE   32
+#define AEAD_NONCE_SIZE 12
+#define AEAD_TAG_SIZE   16
+
+#if defined(ESP_PLATFORM) && !defined(AEAD_FORCE_SOFTWARE)
+#define AEAD_USE_AES_GCM 1
+#include "mbedtls/gcm.h"
+#endif
+
+//errors 600 -> Message could not be encrypted/decrypted
+
+enum aead_error{
+
+    AEAD_OK = 0,
+    AEAD_ERROR_BACKEND = 601,        // accelerator/mbedtls call failed
+    AEAD_ERROR_AUTHENTICATION = 602, // tag does not match: forged or corrupted frame
+    AEAD_ERROR_STATE = 603,          // calls made in the wrong order
+
+};
+
+typedef struct{
+
+    bool encrypting;
+    bool aad_done;          // additional data is closed once text starts
+    uint64_t aad_length;
+    uint64_t text_length;
+
+#ifdef AEAD_USE_AES_GCM
+    mbedtls_gcm_context gcm;
+#else
+    uint32_t chacha_state[16];
+    uint8_t keystream[64];
+    size_t keystream_used;  // bytes of keystream already consumed (64 = empty)
+
+    uint32_t poly_r[5];     // Poly1305 key and accumulator in 26-bit limbs
+    uint32_t poly_h[5];
+    uint32_t poly_pad[4];
+    uint8_t poly_buffer[16];
+    size_t poly_buffered;
+#endif
+
+} aead_context;
+
+// Name of the compiled backend, for logs and benchmarks
+const char *aeadBackendName(void);
+
+/*
+ * Nonce for a frame: transmitter id and sequence, little-endian, plus a
+ * 4 byte domain value so other packet types never collide with messages.
+ */
+void aeadBuildNonce(uint8_t nonce[AEAD_NONCE_SIZE], uint32_t transmitter_id, uint32_t sequence, uint32_t domain);
+
+/*
+ * Streaming interface. Order: aeadStart, any aeadAddAad calls, any
+ * aeadUpdate calls, then aeadFinishEncrypt or aeadFinishDecrypt.
+ *
+ * When decrypting, aeadUpdate hands back plaintext before the tag is
+ * checked: the caller must throw it away if aeadFinishDecrypt fails.
+ */
+int aeadStart(aead_context *context, const uint8_t key[AEAD_KEY_SIZE],
+              const uint8_t nonce[AEAD_NONCE_SIZE], bool encrypting);
+int aeadAddAad(aead_context *context, const uint8_t *aad, size_t aad_length);
+int aeadUpdate(aead_context *context, uint8_t *data, size_t length);
+int aeadFinishEncrypt(aead_context *context, uint8_t tag[AEAD_TAG_SIZE]);
+int aeadFinishDecrypt(aead_context *context, const uint8_t tag[AEAD_TAG_SIZE]);
+
+/*
+ * One-shot helpers. aeadOpen wipes data if the tag does not match, so a
+ * forged frame never leaves plaintext behind.
+ */
+int aeadSeal(const uint8_t key[AEAD_KEY_SIZE], const uint8_t nonce[AEAD_NONCE_SIZE],
+             const uint8_t *aad, size_t aad_length,
+             uint8_t *data, size_t length, uint8_t tag[AEAD_TAG_SIZE]);
+int aeadOpen(const uint8_t key[AEAD_KEY_SIZE], const uint8_t nonce[AEAD_NONCE_SIZE],
+             const uint8_t *aad, size_t aad_length,
+             uint8_t *data, size_t length, const uint8_t tag[AEAD_TAG_SIZE]);
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * Botones direccionales por interrupción
+ * --------------------------------------
+ *
+ * Cada botón tiene una interrupción GPIO que salta cuando cambia. La
+ * interrupción publica el evento al momento, con la marca de tiempo del
+ * cambio, y después deja el pin "sordo" durante BUTTONS_DEBOUNCE_US
+ * mientras rebota el contacto. Un temporizador esp_timer de un disparo
+ * cierra esa ventana: vuelve a leer el pin, publica el cambio si el botón
+ * se soltó (o se volvió a pulsar) durante el rebote, y reactiva la
+ * interrupción.
+ *
+ * Así la latencia de una pulsación es la de la propia interrupción (unos
+ * microsegundos), no se pierden pulsaciones rápidas, y mientras no se
+ * toca nada la CPU no hace ningún trabajo para leer los botones. Las
+ * mismas interrupciones despiertan al chip si está en light sleep.
+ *
+ * Los eventos se publican como APP_EVENT_BUTTON en el bucle de eventos
+ * (event_loop.h), que debe inicializarse antes que los botones.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+// Identificador de cada botón (mismo orden que Direction en game_ui.h)
+typedef enum {
+    BUTTON_UP = 0,
+    BUTTON_DOWN,
+    BUTTON_LEFT,
+    BUTTON_RIGHT,
+    BUTTON_COUNT
+} button_id_t;
+
+typedef enum {
+    BUTTON_EVENT_PRESS = 0,
+    BUTTON_EVENT_RELEASE,
+} button_event_type_t;
+
+typedef struct {
+    uint8_t  button;    // button_id_t
+    uint8_t  type;      // button_event_type_t
+    int64_t  time_us;   // esp_timer_get_time() en el cambio que lo provocó
+} button_event_t;
+
+// Ventana de rebote tras cada cambio (10 ms)
+#define BUTTONS_DEBOUNCE_US  10000
+
+/**
+ * Configura los GPIO de los botones (entrada con PULLUP), instala sus
+ * interrupciones y los activa como fuente de despertar de light sleep.
+ * Devuelve false si algo falla.
+ */
+bool buttons_init(void);
+
+/**
+ * Estado actual (ya sin rebotes) de un botón.
+ */
+bool buttons_is_pressed(button_id_t button);
+
@@ -0,0 +1,60 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compression stage of the transmitter pipeline
+ * (getMessage -> compress -> sendMessage).
+ *
+ * A codec is a pair of functions behind a compression_codec struct, so the
+ * transmitter does not care which one is in use. Both ends must use the
+ * same codec: the packet only carries PACKET_FLAG_COMPRESSED, not which
+ * model produced the payload.
+ *
+ * huffman_codec is a static (pre-trained) canonical Huffman model for
+ * short English/Spanish chat messages, built by
+ * testplayground/huffman_train.c from testplayground/chat_corpus.txt.
+ * Compressed payload layout:
+ *
+ *   varint      original length in bytes (see packetWriteVarint)
+ *   bitstream   one canonical code per byte, MSB first, zero padded
+ *
+ * Encoding is a single pass over the input with a 32-bit bit buffer and
+ * no heap or work tables: all tables are const and live in flash.
+ */
+
+// Longest Huffman code (codes fit in a uint16_t)
+#define HUFFMAN_MAX_BITS 15
+
+//errors 500 -> Message could not be compressed/decompressed
+
+enum compress_error{
+
+    COMPRESS_OK = 0,
+    COMPRESS_ERROR_BUFFER_TOO_SMALL = 501,
+    COMPRESS_ERROR_CORRUPTED = 502,
+
+};
+
+typedef struct{
+
+    const char *name;
+
+    // Both return COMPRESS_OK or a 5xx error; *output_length is set on success
+    int (*compress)(const uint8_t *input, size_t input_length,
+                    uint8_t *output, size_t output_size, size_t *output_length);
+    int (*decompress)(const uint8_t *input, size_t input_length,
+                      uint8_t *output, size_t output_size, size_t *output_length);
+
+} compression_codec;
+
+extern const compression_codec huffman_codec;
+
+int huffmanCompress(const uint8_t *input, size_t input_length,
+                    uint8_t *output, size_t output_size, size_t *output_length);
+int huffmanDecompress(const uint8_t *input, size_t input_length,
+                      uint8_t *output, size_t output_size, size_t *output_length);
+
+#endif
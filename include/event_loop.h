@@ -0,0 +1,108 @@
+/**
+ * Bucle de eventos de la aplicación
+ * ---------------------------------
+ *
+ * La tarea principal no sondea nada: duerme en event_loop_wait hasta que
+ * llega un evento (botón, radio...) o vence uno de sus temporizadores, lo
+ * procesa y vuelve a dormir. Mientras duerme, FreeRTOS (tickless idle)
+ * para el tick y el gestor de energía mete al chip en light sleep hasta
+ * el siguiente evento; las pulsaciones lo despiertan por GPIO y los
+ * temporizadores por el RTC.
+ *
+ * Los temporizadores son de un disparo y viven dentro del propio bucle:
+ * no crean tareas ni interrupciones, solo acortan la espera de la cola.
+ *
+ * event_loop_report muestra cuántas veces se despertó el bucle y cuánto
+ * tiempo pasó dormido, para comprobar el ahorro.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "buttons.h"
+
+// Eventos que caben en la cola antes de empezar a perder los nuevos
+#define EVENT_LOOP_QUEUE_LEN   16
+
+// Temporizadores disponibles (sus ids van de 0 a EVENT_LOOP_MAX_TIMERS - 1)
+#define EVENT_LOOP_MAX_TIMERS  8
+
+// Frecuencias para el gestor de energía: máxima mientras hay trabajo y la
+// del cristal cuando no (el driver SPI pide la máxima mientras transmite)
+#define EVENT_LOOP_MAX_FREQ_MHZ  CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define EVENT_LOOP_MIN_FREQ_MHZ  CONFIG_XTAL_FREQ
+
+typedef enum {
+    APP_EVENT_BUTTON = 0,
+    APP_EVENT_TIMER,
+    APP_EVENT_RADIO,
+} app_event_type_t;
+
+typedef struct {
+    uint8_t type;               // app_event_type_t
+    int64_t time_us;            // cuándo ocurrió (esp_timer_get_time)
+    union {
+        button_event_t button;  // APP_EVENT_BUTTON
+        uint8_t timer_id;       // APP_EVENT_TIMER
+        uint32_t radio_flags;   // APP_EVENT_RADIO (los define el driver de radio)
+    };
+} app_event_t;
+
+/**
+ * Contadores del bucle.
+ */
+typedef struct {
+    uint32_t wakeups;           // veces que el bucle se despertó
+    uint32_t button_events;
+    uint32_t timer_events;
+    uint32_t radio_events;
+    uint32_t dropped;           // eventos perdidos por cola llena
+    int64_t  idle_us;           // tiempo dormido esperando eventos
+    int64_t  busy_us;           // tiempo procesando eventos
+} event_loop_stats_t;
+
+/**
+ * Crea la cola de eventos y configura el gestor de energía (light sleep
+ * automático) si CONFIG_PM_ENABLE está activo. Devuelve false si falla.
+ */
+bool event_loop_init(void);
+
+/**
+ * Publica un evento desde una tarea o desde una interrupción. No espera
+ * nunca: si la cola está llena el evento se pierde (y se cuenta).
+ * En la versión ISR, 'woken' indica si hay que ceder la CPU al salir.
+ */
+bool event_loop_post(const app_event_t *event);
+bool event_loop_post_from_isr(const app_event_t *event, BaseType_t *woken);
+
+/**
+ * Programa el temporizador 'timer_id' para dentro de 'delay_ms'. Si ya
+ * estaba en marcha, se reprograma.
+ */
+void event_loop_start_timer(uint8_t timer_id, uint32_t delay_ms);
+
+/**
+ * Cancela el temporizador 'timer_id' (no pasa nada si no estaba activo).
+ */
+void event_loop_stop_timer(uint8_t timer_id);
+
+/**
+ * Duerme hasta el siguiente evento o vencimiento de temporizador y lo
+ * devuelve en 'event'. Solo debe llamarla una tarea.
+ */
+void event_loop_wait(app_event_t *event);
+
+/**
+ * Copia los contadores del bucle.
+ */
+void event_loop_get_stats(event_loop_stats_t *stats);
+
+/**
+ * Escribe en el log los contadores y, con CONFIG_PM_PROFILING, el tiempo
+ * real que el chip pasó en cada modo de energía (incluido light sleep).
+ */
+void event_loop_report(void);
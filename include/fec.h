@@ -0,0 +1,56 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Erasure code for fragmented messages (fragment.h): systematic
+ * Reed-Solomon over GF(2^8) with a Cauchy matrix.
+ *
+ * A message is cut into k data shards of shard_size bytes (the last one
+ * padded with zeros) and m parity shards are added, k + m <= FEC_MAX_SHARDS:
+ *
+ *   parity p = sum over data shards i of C[p][i] * data i
+ *   C[p][i]  = 1 / ((FEC_MAX_SHARDS + p) xor i)
+ *
+ * Every square submatrix of a Cauchy matrix is invertible, so any k of
+ * the k + m shards give the message back, whichever they are. Data shards
+ * travel as they are: with nothing lost there is nothing to decode.
+ *
+ * Multiplying is table-driven: each coefficient gets two 16-entry tables,
+ * its products with the low and with the high nibble of a byte (built from
+ * its eight doublings), so the inner loop is two lookups and two XORs per
+ * byte with no branches. Log/exp tables of the field (768 bytes, built on
+ * first use) only serve the coefficients and the decoding matrix. Nothing
+ * allocates.
+ */
+
+#define FEC_MAX_SHARDS   16     // data + parity (the fragment index is 4 bits)
+
+// GF(2^8) coefficient of data shard data_index in parity shard parity_index
+uint8_t fecCoefficient(size_t parity_index, size_t data_index);
+
+// dst ^= coefficient * src, byte by byte in GF(2^8)
+void fecMulAdd(uint8_t *dst, const uint8_t *src, uint8_t coefficient, size_t length);
+
+// dst = coefficient * dst
+void fecScale(uint8_t *dst, uint8_t coefficient, size_t length);
+
+/*
+ * Parity shard parity_index of the data_length bytes at data, cut into
+ * shards of shard_size bytes, written to parity (shard_size bytes).
+ */
+void fecEncode(const uint8_t *data, size_t data_length, size_t shard_size, size_t parity_index, uint8_t *parity);
+
+/*
+ * Rebuilds the data shards in place. shards holds data_count slots of
+ * shard_size bytes; slot i holds the shard numbered held[i]: data shard i
+ * itself (held[i] == i) or a parity shard (data_count + parity index) in
+ * place of the missing one. Afterwards every slot holds its data shard.
+ * Returns false if held names a shard twice or out of range.
+ */
+bool fecRecover(uint8_t *shards, size_t shard_size, size_t data_count, const uint8_t *held);
+
+#endif
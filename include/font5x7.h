@@ -0,0 +1,61 @@
+/**
+ * Fuente bitmap 5x7 para el driver ILI9341
+ * ----------------------------------------
+ *
+ * Tabla densa con TODO el ASCII imprimible (0x20 ' ' .. 0x7E '~'),
+ * indexada directamente por el código del carácter: buscar un glifo es
+ * una resta y un acceso a array (O(1)), sin recorrer ninguna tabla.
+ *
+ * Todas las tablas son const, así que el enlazador las deja en flash.
+ *
+ * Cada glifo se guarda en varias formas, todas calculadas en tiempo de
+ * compilación a partir de sus 5 columnas:
+ *   - columns[]: formato clásico, columna a columna (bit 0 = fila superior).
+ *   - rows[]:    fila a fila (bit 0 = columna izquierda), para rasterizar
+ *                líneas de píxeles sin transponer en tiempo de ejecución.
+ *   - rows_x2[] / rows_x3[]: filas ya ensanchadas para escala 2 y 3
+ *                (cada bit repetido 2 o 3 veces). Opcionales, ver
+ *                FONT5X7_PRESCALED.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define FONT5X7_CHAR_W      5
+#define FONT5X7_CHAR_H      7
+#define FONT5X7_ADVANCE     6     // 5 columnas + 1 de separación
+
+#define FONT5X7_FIRST_CHAR  0x20  // ' '
+#define FONT5X7_LAST_CHAR   0x7E  // '~'
+#define FONT5X7_NUM_GLYPHS  (FONT5X7_LAST_CHAR - FONT5X7_FIRST_CHAR + 1)
+
+// Pon a 0 para ahorrar ~2 KB de flash a cambio de ensanchar en tiempo de
+// ejecución los glifos de escala 2 y 3.
+#ifndef FONT5X7_PRESCALED
+#define FONT5X7_PRESCALED   1
+#endif
+
+typedef struct {
+    uint8_t  columns[FONT5X7_CHAR_W];  // 5 columnas, 7 bits útiles cada una
+    uint8_t  rows[FONT5X7_CHAR_H];     // 7 filas, 5 bits útiles cada una
+#if FONT5X7_PRESCALED
+    uint16_t rows_x2[FONT5X7_CHAR_H];  // filas a escala 2 (10 bits)
+    uint16_t rows_x3[FONT5X7_CHAR_H];  // filas a escala 3 (15 bits)
+#endif
+} font5x7_glyph_t;
+
+extern const font5x7_glyph_t font5x7_glyphs[FONT5X7_NUM_GLYPHS];
+
+/**
+ * Devuelve el glifo del carácter indicado.
+ * Los caracteres fuera del ASCII imprimible se dibujan como espacio.
+ */
+static inline const font5x7_glyph_t *font5x7_glyph(char ch)
+{
+    uint8_t code = (uint8_t)ch;
+    if (code < FONT5X7_FIRST_CHAR || code > FONT5X7_LAST_CHAR) {
+        code = ' ';
+    }
+    return &font5x7_glyphs[code - FONT5X7_FIRST_CHAR];
+}
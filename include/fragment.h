@@ -0,0 +1,232 @@
+#ifndef FRAGMENT_H
+#define FRAGMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fec.h"
+#include "packet.h"
+
+/*
+ * Fragmentation, reassembly and selective acknowledgements.
+ *
+ * The message frame built by encodeMessage (header | payload | tag | CRC,
+ * up to PACKET_MAX_MESSAGE_SIZE bytes) is cut into at most
+ * FRAGMENT_MAX_COUNT chunks, each sent in its own frame:
+ *
+ *   PACKET_TYPE_FRAGMENT   sender -> receiver
+ *     header   ids and sequence of the message frame
+ *     byte 0   fragment index (high nibble) | fragment count - 1 (low nibble)
+ *     byte 1   chunk size: bytes carried by every fragment but the last
+ *     [byte 2] only with PACKET_FLAG_FEC: data fragments, the rest are parity
+ *     [byte 3] only with PACKET_FLAG_FEC: bytes in the last data fragment
+ *     rest     the chunk
+ *
+ *   PACKET_TYPE_ACK        receiver -> sender
+ *     header   ids swapped, sequence of the message frame
+ *     2 bytes  bitmap of the fragments held, bit i = fragment i (little-endian)
+ *     8 bytes  MAC: HMAC-SHA256 under the ACK key, first 8 bytes, of a
+ *              label, the two ids, the sequence and the bitmap
+ *
+ * The sender sends a round (every fragment not acknowledged yet) and
+ * flags the last fragment of the round with PACKET_FLAG_ACK_REQUEST. The
+ * receiver answers that flag, and every fragment once the message is
+ * complete, with an ACK; the next round carries only the fragments whose
+ * bit is still clear. When no ACK arrives in time (fragmentSenderTimeout)
+ * only the last missing fragment goes again, as a probe: the ACK it
+ * triggers tells which others are missing. After FRAGMENT_MAX_ROUNDS
+ * rounds the message is given up.
+ *
+ * Forward error correction (optional, parity_count in fragmentSenderStart):
+ * a message of two or more fragments gets parity fragments after its data
+ * fragments (fec.h), all of them chunk size, and the chunk is evened out
+ * so the data fragments hardly need padding. The receiver rebuilds the
+ * message from any data-count fragments, so the first round usually
+ * delivers it despite a few losses. ACKs still list the fragments that
+ * really arrived (the link quality sees every loss); the sender is done
+ * once they are as many as the data fragments, and a later round carries
+ * only as many missing fragments as are still short. The rest of a round
+ * usually follows a rebuilt message, so only the flagged fragment is
+ * answered.
+ *
+ * Fragments carry only the CRC: the message frame inside is already
+ * sealed as a whole (one AEAD tag per message, not per fragment). ACKs
+ * carry a MAC instead, or a forged one would make the sender stop
+ * retransmitting a message that never arrived. The ACK key is the shared
+ * key or the network key (session.h), the one both ends already hold
+ * before any session: ack_key in the sender and in the reassembler,
+ * NULL on links without encryption (the MAC is then zeros and not
+ * checked). A replayed ACK only repeats fragments already acknowledged:
+ * sequences are not reused (transmitter.h).
+ *
+ * The receiver keeps one reassembly buffer per peer, FRAGMENT_MAX_PEERS
+ * of them. A new message from a peer replaces its previous one; a peer
+ * without a buffer takes the least recently used one only if it has been
+ * idle for FRAGMENT_REASSEMBLY_TIMEOUT_US.
+ */
+
+#define FRAGMENT_MAX_COUNT           16   // fits the 4-bit index and the 16-bit ACK bitmap
+#define FRAGMENT_HEADER_SIZE         2
+#define FRAGMENT_FEC_HEADER_SIZE     4
+#define FRAGMENT_ACK_PAYLOAD_SIZE    (PACKET_ACK_BITMAP_SIZE + PACKET_ACK_MAC_SIZE)
+#define FRAGMENT_ACK_KEY_SIZE        32   // AEAD_KEY_SIZE (aead.h)
+#define FRAGMENT_MAX_PEERS           4
+#define FRAGMENT_MAX_ROUNDS          8
+#define FRAGMENT_REASSEMBLY_TIMEOUT_US (30LL * 1000 * 1000)
+#define FRAGMENT_REASSEMBLY_SIZE     (PACKET_MAX_MESSAGE_SIZE + FRAGMENT_MAX_COUNT) // FEC pads each data chunk
+
+//errors 800 -> Message could not be fragmented/reassembled
+
+enum fragment_error{
+
+    FRAGMENT_OK = 0,
+    FRAGMENT_ERROR_TOO_LARGE = 801,     // needs more than FRAGMENT_MAX_COUNT fragments at this frame size
+    FRAGMENT_ERROR_WRONG_TYPE = 802,    // not a fragment (or not an ACK)
+    FRAGMENT_ERROR_MALFORMED = 803,     // index, count or lengths do not add up
+    FRAGMENT_ERROR_NO_BUFFER = 804,     // every reassembly buffer busy with another peer
+    FRAGMENT_ERROR_NOT_OURS = 805,      // other destination, or ACK for another message
+    FRAGMENT_ERROR_BUSY = 806,          // previous message still in flight
+    FRAGMENT_ERROR_GAVE_UP = 807,       // FRAGMENT_MAX_ROUNDS without a complete ACK
+    FRAGMENT_ERROR_FORGED = 808,        // ACK whose MAC does not match
+
+};
+
+typedef enum{
+
+    FRAGMENT_IDLE = 0,
+    FRAGMENT_SENDING,           // fragments of the current round left to send
+    FRAGMENT_WAITING_ACK,       // round sent, ACK or timeout next
+    FRAGMENT_DELIVERED,
+    FRAGMENT_FAILED,
+
+} fragment_state;
+
+typedef struct{
+
+    uint32_t messages_delivered;
+    uint32_t messages_failed;
+    uint32_t fragments_sent;
+    uint32_t retransmissions;   // fragments sent more than once
+    uint32_t acks_received;
+    uint32_t acks_forged;       // FRAGMENT_ERROR_FORGED
+    uint32_t timeouts;
+
+} fragment_sender_stats;
+
+// A zeroed fragment_sender is idle and ready for fragmentSenderStart
+typedef struct{
+
+    fragment_state state;
+    packet_header header;       // of the fragment frames
+    uint8_t message[PACKET_MAX_MESSAGE_SIZE];
+    size_t message_length;
+    uint8_t chunk_size;
+    uint8_t count;
+    uint8_t data_count;         // fragments carrying the message; the rest of count are parity
+    uint16_t acknowledged;      // union of every ACK bitmap received
+    uint16_t sent;              // fragments sent at least once
+    uint16_t round_pending;     // still to send in this round
+    uint16_t round_sent;        // sent in this round so far (link quality, link.h)
+    uint8_t rounds;
+    int64_t ack_deadline_us;    // set by the caller once the round is on air
+    const uint8_t *ack_key;     // FRAGMENT_ACK_KEY_SIZE bytes, NULL = ACKs are not checked
+    fragment_sender_stats stats;
+
+} fragment_sender;
+
+typedef struct{
+
+    uint32_t messages_reassembled;
+    uint32_t recovered;         // of those, rebuilt with parity fragments
+    uint32_t fragments_received;
+    uint32_t duplicates;
+    uint32_t acks_sent;
+    uint32_t evictions;         // idle buffers taken by another peer
+    uint32_t dropped;           // FRAGMENT_ERROR_NO_BUFFER
+
+} fragment_receiver_stats;
+
+typedef struct{
+
+    bool in_use;
+    bool complete;
+    uint32_t peer_id;
+    uint32_t sequence;
+    uint8_t count;
+    uint8_t data_count;         // count without parity fragments
+    uint8_t chunk_size;
+    uint16_t received;
+    uint16_t slots;             // FEC: chunks of data held, each its own or a parity in its place
+    uint8_t held[FRAGMENT_MAX_COUNT]; // FEC: fragment in each chunk of data (fecRecover)
+    size_t last_length;         // bytes in the last data fragment, once known
+    int64_t last_us;
+    uint8_t data[FRAGMENT_REASSEMBLY_SIZE];
+
+} fragment_entry;
+
+typedef struct{
+
+    uint32_t local_id;
+    const uint8_t *ack_key;     // FRAGMENT_ACK_KEY_SIZE bytes, NULL = ACKs go without a MAC
+    fragment_entry entries[FRAGMENT_MAX_PEERS];
+    fragment_receiver_stats stats;
+
+} fragment_reassembler;
+
+/*
+ * Fragment payload that fits in a frame of max_frame_size bytes for this
+ * message frame (0 if not even one byte fits).
+ */
+size_t fragmentChunkSize(const uint8_t *message_frame, size_t message_length, size_t max_frame_size);
+
+/*
+ * Starts sending message_frame (a frame from encodeMessage) in fragments
+ * of at most max_frame_size bytes, plus up to parity_count parity
+ * fragments if it takes two or more (fewer if FRAGMENT_MAX_COUNT leaves
+ * no room; 0 = no FEC). Statistics carry over from earlier messages.
+ * Fails with FRAGMENT_ERROR_BUSY while a message is in flight.
+ */
+int fragmentSenderStart(fragment_sender *sender, const uint8_t *message_frame, size_t message_length,
+                        size_t max_frame_size, size_t parity_count);
+
+/*
+ * Writes the next fragment of the current round into frame. Returns false
+ * when the round is out (the sender then waits for the ACK).
+ */
+bool fragmentSenderNext(fragment_sender *sender, uint8_t *frame, size_t frame_size, size_t *frame_length);
+
+/*
+ * Handles an ACK frame: marks the acknowledged fragments and, if some are
+ * still missing, starts the next round with only those. With an ack_key
+ * an ACK whose MAC does not match changes nothing (FRAGMENT_ERROR_FORGED).
+ */
+int fragmentSenderHandleAck(fragment_sender *sender, const uint8_t *frame, size_t frame_length);
+
+/*
+ * Same for an ACK that arrived some other way (attached to a frame of the
+ * peer, see packetAttachAck): from is the header of the frame it came in.
+ */
+int fragmentSenderApplyAck(fragment_sender *sender, const packet_header *from, uint32_t sequence, uint16_t bitmap,
+                           const uint8_t mac[PACKET_ACK_MAC_SIZE]);
+
+/*
+ * No ACK by the deadline: queues the last missing fragment as a probe.
+ * Returns FRAGMENT_ERROR_GAVE_UP after FRAGMENT_MAX_ROUNDS rounds.
+ */
+int fragmentSenderTimeout(fragment_sender *sender);
+
+// Clears the reassembler; set ack_key afterwards on encrypted links
+void fragmentReassemblerInit(fragment_reassembler *reassembler, uint32_t local_id);
+
+/*
+ * Handles a received fragment. When it completes a message the message
+ * frame is copied to message (*message_length > 0, ready for
+ * receiveMessage). When the sender must be answered the ACK frame is
+ * written to ack (*ack_length > 0). now_us is the caller's monotonic clock.
+ */
+int fragmentReceive(fragment_reassembler *reassembler, const uint8_t *frame, size_t frame_length, int64_t now_us,
+                    uint8_t *message, size_t message_size, size_t *message_length,
+                    uint8_t *ack, size_t ack_size, size_t *ack_length);
+
+#endif
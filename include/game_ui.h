@@ -0,0 +1,63 @@
+/**
+ * Pantallas de Stratagem Hero sobre el driver ILI9341
+ * ---------------------------------------------------
+ *
+ * Todo el dibujo del minijuego vive aquí, separado de la máquina de
+ * estados y de los botones (main.c). Así las mismas pantallas se pueden
+ * dibujar en el ESP32 o en el emulador de host (ili9341_sim) para medir
+ * cuánto cuesta cada una sin placa.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ili9341.h"
+
+// Direcciones posibles (coinciden con el enunciado)
+typedef enum {
+    DIR_UP = 0,
+    DIR_DOWN,
+    DIR_LEFT,
+    DIR_RIGHT
+} Direction;
+
+// para UI (layout muy simple)
+#define COLOR_BG      ILI9341_COLOR_BLACK
+#define COLOR_TEXT    ILI9341_COLOR_WHITE
+#define COLOR_GOOD    ILI9341_COLOR_GREEN
+#define COLOR_BAD     ILI9341_COLOR_RED
+#define COLOR_INFO    ILI9341_COLOR_YELLOW
+
+// Área de texto principal
+#define TEXT_LINE_HEIGHT   16  // depende del tamaño de fuente 8x8 escalada x2
+
+/**
+ * Pantalla de menú inicial: título e instrucciones mínimas.
+ */
+void game_draw_menu_screen(void);
+
+/**
+ * Pantalla con la secuencia que el jugador debe memorizar.
+ */
+void game_draw_show_sequence_screen(Direction *seq, int length);
+
+/**
+ * Pantalla de introducción de la secuencia ("TU INPUT:").
+ */
+void game_draw_input_screen(void);
+
+/**
+ * Dibuja el progreso del jugador en la línea "TU INPUT:".
+ */
+void game_draw_input_progress(Direction *seq, int length, int current_index);
+
+/**
+ * Dibuja el temporizador en la parte inferior de la pantalla.
+ */
+void game_draw_timer(uint32_t remaining_ms);
+
+/**
+ * Muestra el resultado del intento (ÉXITO o FALLO).
+ */
+void game_draw_result(int success);
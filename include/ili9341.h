@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 // Dimensiones típicas del ILI9341 en orientación vertical (portrait)
@@ -56,6 +57,109 @@
  */
 void ili9341_init(void);
 
+/**
+ * Contadores del tráfico SPI hacia el panel.
+ *
+ * "Bytes de comando" incluye el byte de comando y sus parámetros (por
+ * ejemplo, CASET + 4 bytes); los píxeles se cuentan aparte.
+ */
+typedef struct {
+    uint32_t transactions;     // transacciones SPI encoladas
+    uint32_t cmd_bytes;        // bytes de comando + parámetros enviados
+    uint32_t pixel_bytes;      // bytes de píxeles enviados
+    uint32_t cmd_bytes_saved;  // bytes de comando + parámetros evitados
+    uint32_t caset_skipped;    // CASET omitidos (mismo rango de columnas)
+    uint32_t raset_skipped;    // RASET omitidos (mismo rango de filas)
+    uint32_t ramwr_reused;     // escrituras que continuaron el RAMWR abierto
+    uint32_t dc_writes_saved;  // cambios de la línea D/C evitados
+} ili9341_stats_t;
+
+/**
+ * Copia los contadores de tráfico en 'stats'.
+ */
+void ili9341_get_stats(ili9341_stats_t *stats);
+
+/**
+ * Pone a cero los contadores de tráfico.
+ */
+void ili9341_reset_stats(void);
+
+/**
+ * Activa o desactiva el modo de transferencia no bloqueante.
+ *
+ *  - false (por defecto): cada primitiva espera a que sus datos hayan
+ *    salido por el bus antes de volver.
+ *  - true: las primitivas solo encolan transacciones DMA y vuelven en
+ *    cuanto el último bloque está en la cola. La CPU queda libre mientras
+ *    el bus trabaja; usa ili9341_flush() cuando necesites esperar.
+ *
+ * Al desactivarlo se esperan las transferencias pendientes.
+ */
+void ili9341_set_async(bool enable);
+
+/**
+ * Espera a que terminen todas las transferencias SPI encoladas.
+ */
+void ili9341_flush(void);
+
+/**
+ * Devuelve true si todavía quedan transferencias en curso (no bloquea).
+ */
+bool ili9341_is_busy(void);
+
+/**
+ * Formatos de framebuffer disponibles.
+ *
+ *  - ILI9341_FB_RGB565:   2 bytes por píxel (150 KB).
+ *  - ILI9341_FB_INDEXED8: 1 byte por píxel (75 KB), paleta de 256 colores.
+ *  - ILI9341_FB_INDEXED4: 4 bits por píxel (37,5 KB), paleta de 16 colores.
+ *
+ * Los formatos indexados empiezan con la paleta ILI9341_COLOR_* (índices
+ * 0..7 en el orden en que están definidos arriba). Los colores nuevos se
+ * añaden a la paleta al usarlos por primera vez; si ya está llena se usa
+ * el color más parecido.
+ */
+typedef enum {
+    ILI9341_FB_RGB565 = 0,
+    ILI9341_FB_INDEXED8,
+    ILI9341_FB_INDEXED4,
+} ili9341_fb_format_t;
+
+/**
+ * Activa el modo framebuffer (opcional) con el formato indicado.
+ *
+ * Reserva una copia de la pantalla en RAM. A partir de ahí las
+ * primitivas de dibujo escriben en esa RAM y anotan los rectángulos
+ * modificados; nada llega al panel hasta ili9341_present().
+ *
+ * Devuelve false si no hay memoria: el driver sigue en dibujo directo.
+ */
+bool ili9341_framebuffer_enable(ili9341_fb_format_t format);
+
+/**
+ * Envía los cambios pendientes y libera el framebuffer (vuelve a dibujo directo).
+ */
+void ili9341_framebuffer_disable(void);
+
+/**
+ * Devuelve true si el modo framebuffer está activo.
+ */
+bool ili9341_framebuffer_active(void);
+
+/**
+ * Cambia una entrada de la paleta de un framebuffer indexado.
+ * Toda la pantalla se marca como modificada.
+ * Devuelve 0 si todo va bien, -1 si no hay framebuffer indexado o el
+ * índice no existe en su paleta.
+ */
+int ili9341_palette_set(uint8_t index, uint16_t color);
+
+/**
+ * Envía al panel solo las zonas que han cambiado desde el último present
+ * (los rectángulos sucios, ya fusionados). Sin framebuffer no hace nada.
+ */
+void ili9341_present(void);
+
 /**
  * Rellena toda la pantalla con un único color.
  */
@@ -79,7 +183,8 @@ void ili9341_fill_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t
  * Dibuja un carácter ASCII sencillo (fuente 5x7) escalado.
  *
  *  - x, y: posición de la esquina superior izquierda del carácter.
- *  - ch:   carácter ASCII (solo se soporta un subconjunto básico).
+ *  - ch:   carácter ASCII imprimible (0x20..0x7E); el resto se dibuja
+ *          como espacio.
  *  - color: color de primer plano.
  *  - bg:    color de fondo (se repinta el bloque completo).
  *  - scale: factor de escala entero (1 = 5x7, 2 = 10x14, etc.).
@@ -90,7 +195,72 @@ void ili9341_draw_char(uint16_t x, uint16_t y, char ch,
 /**
  * Dibuja una cadena de texto usando la fuente 5x7.
  *
- * Cada carácter se dibuja con ili9341_draw_char, avanzando en x.
+ * Cada línea del texto (separadas por '\n') se rasteriza completa y se
+ * envía con una única ventana de dirección; los huecos entre caracteres
+ * se pintan con el color de fondo.
  */
 void ili9341_draw_string(uint16_t x, uint16_t y, const char *text,
                          uint16_t color, uint16_t bg, uint8_t scale);
+
+/**
+ * Dibuja un bitmap RGB565 (w x h píxeles, fila a fila).
+ *
+ *  - x, y:   esquina superior izquierda; puede quedar fuera de la pantalla
+ *            (valores negativos o más allá del borde): se recorta.
+ *  - pixels: w*h colores RGB565 en el orden nativo de un uint16_t (como
+ *            los genera ILI9341_RGB565). Puede estar en flash o en RAM.
+ *
+ * Las filas se pasan a orden de bus dos píxeles por palabra directamente
+ * en los bloques DMA, sin una llamada por píxel.
+ */
+void ili9341_draw_bitmap(int16_t x, int16_t y, uint16_t w, uint16_t h,
+                         const uint16_t *pixels);
+
+/**
+ * Igual que ili9341_draw_bitmap, pero solo se dibuja la parte del bitmap
+ * que cae dentro del rectángulo (clip_x, clip_y, clip_w, clip_h).
+ */
+void ili9341_draw_bitmap_clipped(int16_t x, int16_t y, uint16_t w, uint16_t h,
+                                 const uint16_t *pixels,
+                                 uint16_t clip_x, uint16_t clip_y,
+                                 uint16_t clip_w, uint16_t clip_h);
+
+/**
+ * Igual que ili9341_draw_bitmap, pero los píxeles del color 'transparent'
+ * no se dibujan (se ve lo que hubiera debajo).
+ */
+void ili9341_draw_bitmap_transparent(int16_t x, int16_t y, uint16_t w, uint16_t h,
+                                     const uint16_t *pixels, uint16_t transparent);
+
+/**
+ * Dibuja una imagen comprimida (formato de ili9341_image.h, generada con
+ * testplayground/img2ili9341.c) con su esquina superior izquierda en
+ * (x, y). Se recorta contra la pantalla igual que ili9341_draw_bitmap.
+ *
+ * La imagen se descomprime fila a fila directamente en los bloques DMA
+ * (o en el framebuffer): nunca se reconstruye entera en RAM.
+ *
+ *  - image: bytes de la imagen, normalmente un array const en flash.
+ *  - size:  tamaño de 'image' en bytes.
+ *
+ * Devuelve ILI9341_IMAGE_OK, o un ILI9341_IMAGE_ERR_* si la imagen no es
+ * válida o está truncada (en ese caso puede haberse dibujado una parte).
+ */
+int ili9341_draw_image(int16_t x, int16_t y, const uint8_t *image, uint32_t size);
+
+/**
+ * Define la zona de scroll vertical por hardware: las 'top_fixed' filas de
+ * arriba y las 'bottom_fixed' de abajo no se mueven; el resto de la
+ * pantalla se desplaza con ili9341_scroll_to. Deja el scroll a 0.
+ */
+void ili9341_scroll_define(uint16_t top_fixed, uint16_t bottom_fixed);
+
+/**
+ * Desplaza la zona de scroll 'offset' filas hacia arriba (módulo su alto).
+ *
+ * La fila de pantalla top_fixed + r muestra entonces lo que se dibujó en
+ * la fila top_fixed + (offset + r) % alto_zona: el contenido no se mueve
+ * en memoria, solo cambia qué parte se ve en cada línea. Cuesta un
+ * comando y 2 bytes.
+ */
+void ili9341_scroll_to(uint16_t offset);
@@ -0,0 +1,83 @@
+/**
+ * Formato de imagen comprimida para el ILI9341
+ * --------------------------------------------
+ *
+ * Las imágenes se guardan como un array de bytes const (queda en flash)
+ * que genera testplayground/img2ili9341.c a partir de un PPM. El driver
+ * las descomprime directamente en los bloques DMA, fila a fila, sin
+ * reconstruir nunca la imagen completa en RAM (ver ili9341_draw_image).
+ *
+ * Cabecera (campos de 16 bits en little-endian):
+ *
+ *   byte 0-1  magia 'I' 'M'
+ *   byte 2    versión (ILI9341_IMAGE_VERSION)
+ *   byte 3    codificación (ili9341_image_encoding_t)
+ *   byte 4-5  ancho en píxeles
+ *   byte 6-7  alto en píxeles
+ *
+ * Solo en ILI9341_IMAGE_RLE8:
+ *   byte 8    número de colores de la paleta - 1
+ *   byte 9..  paleta: un color RGB565 (2 bytes) por entrada
+ *
+ * Los colores (paleta y píxeles RLE16) van con el byte alto primero, en
+ * el mismo orden que espera el panel: los literales RLE16 se copian tal
+ * cual a los bloques DMA.
+ *
+ * Después vienen los píxeles, fila a fila y de izquierda a derecha, como
+ * una secuencia de paquetes RLE que pueden cruzar el final de una fila:
+ *
+ *   byte de control c, n = (c & 0x7F) + 1 píxeles
+ *     c & 0x80 -> repetición: sigue UN valor que se repite n veces
+ *     si no    -> literal: siguen n valores distintos
+ *
+ * Un "valor" es un índice de paleta (1 byte) en RLE8, o un color RGB565
+ * (2 bytes) en RLE16.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define ILI9341_IMAGE_MAGIC0        'I'
+#define ILI9341_IMAGE_MAGIC1        'M'
+#define ILI9341_IMAGE_VERSION       1
+
+#define ILI9341_IMAGE_HEADER_SIZE   8
+#define ILI9341_IMAGE_RUN_FLAG      0x80
+#define ILI9341_IMAGE_MAX_PACKET    128   // píxeles por paquete (7 bits + 1)
+
+typedef enum {
+    ILI9341_IMAGE_RLE8 = 0,   // paleta de hasta 256 colores + índices RLE
+    ILI9341_IMAGE_RLE16,      // colores RGB565 en RLE (más de 256 colores)
+} ili9341_image_encoding_t;
+
+// Códigos de error de ili9341_draw_image
+#define ILI9341_IMAGE_OK            0
+#define ILI9341_IMAGE_ERR_HEADER   -1   // magia, versión o codificación inválidas
+#define ILI9341_IMAGE_ERR_TRUNCATED -2  // los datos acaban antes que la imagen
+
+/**
+ * Lee un campo de 16 bits little-endian de la cabecera.
+ */
+static inline uint16_t ili9341_image_read16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * Lee un color RGB565 guardado con el byte alto primero.
+ */
+static inline uint16_t ili9341_image_read_color(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint16_t ili9341_image_width(const uint8_t *image)
+{
+    return ili9341_image_read16(image + 4);
+}
+
+static inline uint16_t ili9341_image_height(const uint8_t *image)
+{
+    return ili9341_image_read16(image + 6);
+}
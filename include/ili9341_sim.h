@@ -0,0 +1,177 @@
+/**
+ * Backend de host (Linux) para el driver ILI9341
+ * ----------------------------------------------
+ *
+ * Permite compilar src/ili9341.c en un PC, sin ESP-IDF ni placa. Las
+ * llamadas SPI/GPIO que usa el driver se sustituyen por un modelo del
+ * ILI9341 dentro del propio proceso que:
+ *
+ *   - Interpreta CASET, RASET, RAMWR y MADCTL (más los comandos de
+ *     arranque, que simplemente se cuentan).
+ *   - Mantiene una GRAM de 240x320 píxeles RGB565.
+ *   - Guarda capturas de la pantalla en formato PPM.
+ *   - Cuenta transacciones, bytes de comando, de parámetros y de píxeles,
+ *     y estima el tiempo de bus con un reloj SPI configurable.
+ *
+ * Cuándo se usa:
+ *   ESP-IDF siempre define ESP_PLATFORM. Si no está definido, ili9341.c
+ *   incluye esta cabecera en lugar de las de FreeRTOS/driver.
+ *
+ * Ejemplo de compilación (ver testplayground/ili9341_bench.c):
+ *   gcc -Iinclude src/ili9341.c src/ili9341_sim.c src/font5x7.c ...
+ */
+
+#pragma once
+
+#ifndef ESP_PLATFORM
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// -----------------------------------------------------------------------------
+//  SUSTITUTOS MÍNIMOS DE LA API DE ESP-IDF USADA POR EL DRIVER
+// -----------------------------------------------------------------------------
+
+typedef int esp_err_t;
+#define ESP_OK    0
+#define ESP_FAIL  -1
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY        ((TickType_t)0xFFFFFFFF)
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(ms))
+
+#define IRAM_ATTR
+#define DMA_ATTR
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "I (%s) " fmt "\n", tag, ##__VA_ARGS__)
+
+// Memoria: en el host cualquier bloque vale para "DMA"
+#define MALLOC_CAP_DMA   (1 << 3)
+#define MALLOC_CAP_8BIT  (1 << 2)
+#define heap_caps_malloc(size, caps)  ((void)(caps), malloc(size))
+#define heap_caps_free(ptr)           free(ptr)
+
+// GPIO
+#define GPIO_MODE_OUTPUT   2
+#define GPIO_INTR_DISABLE  0
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    int mode;
+    int pull_up_en;
+    int pull_down_en;
+    int intr_type;
+} gpio_config_t;
+
+esp_err_t gpio_config(const gpio_config_t *config);
+esp_err_t gpio_set_level(int gpio_num, uint32_t level);
+
+// SPI maestro
+#define HSPI_HOST               1
+#define VSPI_HOST               2
+#define SPI_DMA_CH_AUTO         3
+#define SPI_DEVICE_HALFDUPLEX   (1 << 4)
+#define SPI_TRANS_USE_TXDATA    (1 << 3)
+
+typedef struct spi_transaction_t spi_transaction_t;
+typedef void (*transaction_cb_t)(spi_transaction_t *trans);
+
+struct spi_transaction_t {
+    uint32_t flags;
+    size_t length;          // en bits
+    void *user;
+    union {
+        const void *tx_buffer;
+        uint8_t tx_data[4];
+    };
+};
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+} spi_bus_config_t;
+
+typedef struct {
+    int clock_speed_hz;
+    int mode;
+    int spics_io_num;
+    int queue_size;
+    uint32_t flags;
+    transaction_cb_t pre_cb;
+} spi_device_interface_config_t;
+
+typedef struct ili9341_sim_device *spi_device_handle_t;
+
+esp_err_t spi_bus_initialize(int host, const spi_bus_config_t *config, int dma_chan);
+esp_err_t spi_bus_add_device(int host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans,
+                                 TickType_t timeout);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans,
+                                      TickType_t timeout);
+
+// FreeRTOS: los retardos no esperan de verdad, solo avanzan el reloj simulado
+void vTaskDelay(TickType_t ticks);
+
+// -----------------------------------------------------------------------------
+//  API DEL EMULADOR
+// -----------------------------------------------------------------------------
+
+/**
+ * Contadores del bus simulado.
+ */
+typedef struct {
+    uint32_t transactions;    // transacciones SPI completas
+    uint32_t cmd_bytes;       // bytes con D/C = 0 (comandos)
+    uint32_t param_bytes;     // bytes con D/C = 1 que no son píxeles
+    uint32_t pixel_bytes;     // bytes escritos en GRAM tras RAMWR
+    uint64_t bus_time_ns;     // tiempo estimado de bus (bits + sobrecoste)
+} ili9341_sim_stats_t;
+
+/**
+ * Configura la estimación de tiempo de bus.
+ *  - spi_clock_hz:      reloj SPI (por defecto 40 MHz, como el driver).
+ *  - trans_overhead_ns: coste fijo por transacción (cola, interrupción,
+ *                       CS...). Por defecto 5 us.
+ */
+void ili9341_sim_configure(uint32_t spi_clock_hz, uint32_t trans_overhead_ns);
+
+/**
+ * Modo tiempo real: cada transacción tarda en completarse su tiempo de
+ * bus estimado (las encoladas seguidas se ponen en fila), así que
+ * ili9341_flush espera lo mismo que esperaría con el DMA real. Por
+ * defecto está desactivado y todo termina al instante.
+ */
+void ili9341_sim_set_realtime(bool enable);
+
+/**
+ * Devuelve los contadores acumulados desde el último reset.
+ */
+void ili9341_sim_get_stats(ili9341_sim_stats_t *stats);
+
+/**
+ * Pone a cero los contadores (la GRAM se conserva).
+ */
+void ili9341_sim_reset_stats(void);
+
+/**
+ * Color RGB565 visible en la posición (x, y) de la pantalla, ya aplicada
+ * la orientación de MADCTL y el scroll vertical (VSCRDEF/VSCRSADD).
+ */
+uint16_t ili9341_sim_get_pixel(uint16_t x, uint16_t y);
+
+/**
+ * Guarda la pantalla como PPM binario (P6). Devuelve 0 si todo va bien.
+ */
+int ili9341_sim_dump_ppm(const char *path);
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,105 @@
+/**
+ * Latencia de la entrada a la pantalla
+ * ------------------------------------
+ *
+ * Mide cuánto tarda una pulsación en verse en el panel, en cuatro
+ * instantes de una "traza":
+ *
+ *   INPUT      la interrupción GPIO del botón (button_event_t.time_us)
+ *   HANDLED    la máquina de estados empieza a procesar el evento
+ *   ISSUED     el juego termina de encolar los comandos de dibujo
+ *   DISPLAYED  el ILI9341 ha recibido el último byte por SPI (lo apunta
+ *              la tarea de render, ver render_latency)
+ *
+ * Cada traza completa suma una muestra a un histograma por etapa (y otro
+ * del total). latency_report los escribe por el monitor serie con p50,
+ * p99 y máximo, y avisa de las etapas que superan su presupuesto.
+ *
+ * Los histogramas tienen 4 cubos por potencia de 2 (error < 25 %) hasta
+ * unos 30 s. Se pueden escribir desde una tarea y leer desde otra.
+ *
+ * En el host el reloj es CLOCK_MONOTONIC; con el emulador en tiempo real
+ * (ili9341_sim_set_realtime) el bus SPI tarda lo mismo que en la placa.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+    LATENCY_POINT_INPUT = 0,
+    LATENCY_POINT_HANDLED,
+    LATENCY_POINT_ISSUED,
+    LATENCY_POINT_DISPLAYED,
+    LATENCY_POINT_COUNT
+} latency_point_t;
+
+typedef enum {
+    LATENCY_STAGE_DISPATCH = 0, // INPUT -> HANDLED (cola de eventos, despertar)
+    LATENCY_STAGE_LOGIC,        // HANDLED -> ISSUED (juego y cola de render)
+    LATENCY_STAGE_DRAW,         // ISSUED -> DISPLAYED (render y bus SPI)
+    LATENCY_STAGE_TOTAL,        // INPUT -> DISPLAYED
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+// Cubos de cada histograma
+#define LATENCY_BUCKETS  96
+
+typedef struct {
+    int64_t time_us[LATENCY_POINT_COUNT];
+} latency_trace_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;        // cota superior del cubo (error < 25 %)
+    uint32_t p99_us;
+    uint32_t max_us;        // exacto
+} latency_summary_t;
+
+/**
+ * Reloj de las trazas, en microsegundos (esp_timer_get_time en el ESP32).
+ */
+int64_t latency_now_us(void);
+
+/**
+ * Empieza una traza de un evento que ocurrió en 'input_us'; HANDLED es
+ * ahora.
+ */
+void latency_trace_begin(latency_trace_t *trace, int64_t input_us);
+
+/**
+ * Apunta ahora como el instante 'point' de la traza.
+ */
+void latency_trace_mark(latency_trace_t *trace, latency_point_t point);
+
+/**
+ * Suma la traza (ya con DISPLAYED) a los histogramas.
+ */
+void latency_trace_finish(const latency_trace_t *trace);
+
+/**
+ * Suma una muestra suelta a una etapa.
+ */
+void latency_record(latency_stage_t stage, int64_t elapsed_us);
+
+/**
+ * Fija el presupuesto de una etapa: latency_report avisa si su p99 lo
+ * supera. 0 = sin presupuesto.
+ */
+void latency_set_budget(latency_stage_t stage, uint32_t budget_us);
+
+/**
+ * Resumen de una etapa.
+ */
+void latency_get_summary(latency_stage_t stage, latency_summary_t *summary);
+
+/**
+ * Escribe el resumen de todas las etapas por la salida estándar (el
+ * monitor serie en el ESP32).
+ */
+void latency_report(void);
+
+/**
+ * Vacía los histogramas (los presupuestos se conservan).
+ */
+void latency_reset(void);
@@ -0,0 +1,195 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packet.h"
+#include "sx1278.h"
+
+/*
+ * Link quality and data rate per peer (adaptive data rate).
+ *
+ * For every peer (by id, the receiver_id of the frames sent to it) the
+ * node keeps the RSSI and SNR of the frames it hears from it and the share
+ * of fragments that reach it (from the ACKs), and picks from them the
+ * fastest rate that still gets through:
+ *
+ *   - Spreading factor: the fastest one whose demodulation floor (-7.5 dB
+ *     at SF7 ... -20 dB at SF12) stays snr_margin_db below the average SNR
+ *     of the peer. The link is taken as symmetric: what we hear from the
+ *     peer is what it hears from us. Slowing down waits until the SNR is
+ *     snr_hysteresis_db worse than that, so a link on the edge does not
+ *     flap. A loss above loss_high with the coding rate already at 4/8
+ *     (interference, a weaker transmitter at the other end) slows it down
+ *     one step whatever the SNR says, for holddown_ms.
+ *   - Coding rate: ours alone to choose, the receiver reads it from the
+ *     LoRa header. One step more redundancy while the loss is above
+ *     loss_low, one step less while it is below loss_low / 2.
+ *
+ * Both ends must use the same spreading factor, so it is agreed in band
+ * (PACKET_FLAG_RATE_ATTACHED, one byte: spreading factor in the high
+ * nibble, coding rate in the low one). The sender offers it on the
+ * fragments of a round; the receiver switches and answers on its ACK,
+ * which still goes at the old rate; the sender switches when the answer
+ * arrives. Without an agreement, or once it lapses, frames go at the base
+ * rate, which every node listens at:
+ *
+ *   - After fallback_failures rounds in a row without an ACK the sender
+ *     goes back to base and offers nothing that fast again for
+ *     holddown_ms. With an offer still unanswered, the first try is the
+ *     offered rate instead: the receiver may have switched and its answer
+ *     been lost. If base fails as many times, the receiver is probably
+ *     still at the agreed rate (it cannot know the sender gave up on
+ *     it), so the sender alternates between the two until an ACK comes
+ *     back or the agreement lapses.
+ *   - An agreement lapses hold_ms after the last frame heard from the
+ *     peer. The side that accepted it waits LINK_ACCEPTOR_GUARD_MS more,
+ *     so by the time it listens at base again the other side sends there.
+ *
+ * The base rate is the radio configuration (sx1278_init) unless
+ * link_config says otherwise. It sets the range of the network: choose
+ * one that reaches every peer (SF10 or more), the faster rates are for
+ * the peers that can take them.
+ *
+ * The radio listens at one rate at a time: the one agreed with the peer
+ * heard last, base if none. Other peers are heard again when that
+ * agreement lapses, so adaptive rates suit one conversation at a time.
+ * Mesh frames (mesh.h) always go at base and carry no offers; what is
+ * heard from them counts for the relay that sent the copy.
+ *
+ * Frames addressed to other nodes (overheard) only refresh the RSSI and
+ * SNR of a peer already known: they neither keep its agreement alive nor
+ * carry offers or answers for us, so set the id of the node first
+ * (linkSetLocalId).
+ *
+ * Call linkObserveFrame for every frame received, the linkReport*
+ * functions for every round of fragments and linkService before building
+ * frames. Time is the caller's monotonic clock, in microseconds. Not
+ * thread safe: use it from one task.
+ */
+
+#define LINK_MAX_PEERS           8
+#define LINK_ACCEPTOR_GUARD_MS   3000
+#define LINK_AVERAGE_WEIGHT      0.25f  // of each new sample in the RSSI, SNR and loss averages
+
+typedef struct{
+
+    sx1278_rate_t base;             // every node listens here; spreading_factor 0 = the radio configuration
+    uint8_t min_spreading_factor;   // fastest allowed
+    uint8_t max_spreading_factor;   // slowest allowed
+    float snr_margin_db;            // above the demodulation floor
+    float snr_hysteresis_db;
+    float loss_low;
+    float loss_high;
+    uint8_t fallback_failures;
+    uint32_t hold_ms;
+    uint32_t holddown_ms;
+
+} link_config;
+
+#define LINK_CONFIG_DEFAULT {               \
+    .base = { 0, 0 },                       \
+    .min_spreading_factor = 7,              \
+    .max_spreading_factor = 12,             \
+    .snr_margin_db = 5.0f,                  \
+    .snr_hysteresis_db = 2.0f,              \
+    .loss_low = 0.05f,                      \
+    .loss_high = 0.25f,                     \
+    .fallback_failures = 3,                 \
+    .hold_ms = 15 * 1000,                   \
+    .holddown_ms = 60 * 1000,               \
+}
+
+typedef struct{
+
+    uint32_t frames_heard;
+    float rssi_dbm;             // averages of the frames heard from the peer
+    float snr_db;
+    float loss;                 // average share of fragments lost per round
+    uint32_t fragments_sent;
+    uint32_t fragments_lost;
+    uint32_t rate_changes;      // agreements reached, either side
+    uint32_t fallbacks;         // back to base after failures
+
+} link_peer_stats;
+
+typedef struct{
+
+    bool in_use;
+    uint32_t peer;
+    link_peer_stats stats;
+    uint8_t failures;           // rounds in a row without an ACK
+    uint8_t spreading_factor;   // agreed with the peer (base without agreement)
+    uint8_t coding_rate;        // for frames to the peer
+    uint8_t offered;            // spreading factor offered and not answered yet, 0 = none
+    uint8_t previous;           // accepted an offer: the answer still goes at this one
+    bool answering;             // accepted an offer the sender may not know about yet
+    bool answer_sent;
+    bool accepted;              // the peer proposed the current agreement
+    uint8_t fallback_from;      // agreed before falling back: tried again while base fails too
+    uint8_t blocked;            // nothing this fast or faster is offered until blocked_until_us
+    int64_t blocked_until_us;
+    int64_t last_heard_us;
+
+} link_peer;
+
+/*
+ * Forgets every peer and starts over with config (NULL for the defaults).
+ * Using the link before any init uses the defaults.
+ */
+void linkInit(const link_config *config);
+
+/*
+ * Id of this node (the receiver_id of the frames sent to it). Kept across
+ * linkInit; 0 until set.
+ */
+void linkSetLocalId(uint32_t local_id);
+
+/*
+ * Lets agreements lapse and holddowns expire. Call it before building
+ * frames and on every radio event.
+ */
+void linkService(int64_t now_us);
+
+/*
+ * Takes the RSSI and SNR of a frame received from a peer (any frame with
+ * a valid CRC) and handles the rate offer or answer it may carry.
+ */
+void linkObserveFrame(const uint8_t *frame, size_t frame_length, int16_t rssi_dbm, float snr_db, int64_t now_us);
+
+/*
+ * The ACK of a round of sent fragments to peer arrived: delivered of them
+ * are now acknowledged.
+ */
+void linkReportAck(uint32_t peer, unsigned sent, unsigned delivered, int64_t now_us);
+
+/*
+ * The round went unanswered.
+ */
+void linkReportTimeout(uint32_t peer, unsigned sent, int64_t now_us);
+
+/*
+ * Attaches a rate offer to a FRAGMENT frame if its peer would go faster
+ * or slower, or an answer to an ACK frame for a peer whose offer was
+ * accepted (packetAttachRate). *packet_length = length when there is
+ * nothing to attach.
+ */
+int linkAttachRate(uint8_t *frame, size_t length, size_t frame_size, size_t *packet_length);
+
+/*
+ * Rate for a finished frame: the one agreed with its receiver (or base),
+ * the old one for the answer to an offer.
+ */
+void linkFrameRate(const uint8_t *frame, size_t frame_length, sx1278_rate_t *rate);
+uint32_t linkAirtimeUs(const uint8_t *frame, size_t frame_length);
+
+// Rate frames to peer go at now, and the one to listen at
+void linkPeerRate(uint32_t peer, sx1278_rate_t *rate);
+void linkListenRate(sx1278_rate_t *rate);
+
+// Copy of what is known about peer; false if nothing
+bool linkGetPeer(uint32_t peer, link_peer *out);
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packet.h"
+
+/*
+ * Store-and-forward relaying by flooding, for peers out of direct range.
+ *
+ * A frame sent in mesh mode carries a mesh trailer (PACKET_FLAG_MESH,
+ * packet.h): a flood id, the id of the node that put this copy on air
+ * and the relays it may still take. Origin and destination stay in the
+ * header (transmitter_id, receiver_id), which is authenticated; the
+ * trailer is not, so relays can rewrite it. The origin numbers every
+ * frame it floods, retransmissions too, so a relay never mistakes a
+ * retry for a copy it already relayed.
+ *
+ * A node that hears a mesh frame for the first time:
+ *
+ *   - delivers it if it is addressed to it or to MESH_BROADCAST_ID;
+ *   - otherwise (and for broadcasts) relays it if hops are left: after a
+ *     random delay of 0 .. relay_slots - 1 slots (one slot = the airtime
+ *     of the frame + slot_guard_ms), so the neighbours that heard the
+ *     same copy do not all answer at once, with itself as hop and one
+ *     hop less;
+ *   - cancels that relay if it hears suppress_count more copies while it
+ *     waits: its neighbours already have it.
+ *
+ * "First time" is the duplicate cache, keyed by (origin, flood id): a
+ * rotating Bloom filter of two generations of MESH_CACHE_BITS bits and
+ * MESH_CACHE_HASHES hashes. Inserts go to the current generation; after
+ * MESH_CACHE_GENERATION of them the older one is cleared and becomes the
+ * current. The last MESH_CACHE_GENERATION floods are always remembered
+ * (up to twice that), insert and lookup are O(1), and the cache takes
+ * 2 * MESH_CACHE_BITS / 8 bytes whatever the traffic. A false positive
+ * (about 1% with both generations full) only skips one relay, which
+ * other nodes usually cover.
+ *
+ * Relays wait in MESH_RELAY_SLOTS frame buffers. With all of them taken
+ * new relays are dropped: a busy node neither floods the channel nor
+ * grows its memory. Relays still go through the TX scheduler (duty
+ * cycle, LBT).
+ *
+ * Mesh frames always go at the base rate (link.h), which every node
+ * listens at. Time is the caller's monotonic clock, in microseconds.
+ */
+
+#define MESH_BROADCAST_ID        0
+#define MESH_CACHE_BITS          4096   // per generation (power of two)
+#define MESH_CACHE_HASHES        3
+#define MESH_CACHE_GENERATION    256    // inserts before the older generation is cleared
+#define MESH_RELAY_SLOTS         4
+
+typedef struct{
+
+    uint8_t hops;               // relays a frame flooded here may take
+    uint8_t relay_slots;        // random delay before relaying, in slots
+    uint16_t slot_guard_ms;     // added to the frame airtime in each slot
+    uint8_t suppress_count;     // copies heard that cancel a waiting relay, 0 = never
+    bool relay;                 // false: delivers and floods its own frames, relays nothing
+
+} mesh_config;
+
+#define MESH_CONFIG_DEFAULT {               \
+    .hops = 3,                              \
+    .relay_slots = 8,                       \
+    .slot_guard_ms = 20,                    \
+    .suppress_count = 2,                    \
+    .relay = true,                          \
+}
+
+typedef struct{
+
+    uint32_t floods;            // frames of this node sent in mesh mode
+    uint32_t delivered;
+    uint32_t duplicates;
+    uint32_t relayed;
+    uint32_t suppressed;        // relays cancelled by copies heard
+    uint32_t expired;           // no hops left
+    uint32_t relays_dropped;    // every relay slot busy
+
+} mesh_stats;
+
+typedef struct{
+
+    bool in_use;
+    uint32_t origin;
+    uint32_t flood_id;
+    uint8_t copies;             // heard while waiting
+    int64_t due_us;
+    size_t length;
+    uint8_t frame[PACKET_MAX_SIZE];
+
+} mesh_relay;
+
+typedef struct{
+
+    uint32_t local_id;
+    mesh_config config;
+    uint32_t next_flood_id;
+    uint32_t random_state;
+    uint8_t cache[2][MESH_CACHE_BITS / 8];
+    uint8_t current;            // generation inserts go to
+    uint16_t generation_inserts;
+    mesh_relay relays[MESH_RELAY_SLOTS];
+    mesh_stats stats;
+
+} mesh_node;
+
+/*
+ * Empties cache and relays and starts over with config (NULL for the
+ * defaults). Relay delays are drawn from a generator seeded with the id,
+ * so neighbours draw different ones. Flood ids start at a random value
+ * (esp_random), so after a reboot the floods of the node are not taken
+ * for those of its last boot still in the neighbours' caches.
+ */
+void meshInit(mesh_node *node, uint32_t local_id, const mesh_config *config);
+
+/*
+ * Floods a finished frame of this node: attaches a new flood id, itself
+ * as hop and config.hops (packetSetMesh). Leave PACKET_MESH_MAX_SIZE
+ * bytes of room under PACKET_MAX_SIZE for it.
+ */
+int meshAttach(mesh_node *node, uint8_t *frame, size_t length, size_t frame_size, size_t *packet_length);
+
+/*
+ * Handles a received frame (any frame with a valid CRC). Returns true if
+ * it is for this node: a direct frame addressed to it, or the first copy
+ * of a flood addressed to it or to MESH_BROADCAST_ID. Floods for others
+ * are queued for relaying.
+ */
+bool meshReceive(mesh_node *node, const uint8_t *frame, size_t frame_length, int64_t now_us);
+
+/*
+ * Copies the next relay due by now_us into frame, ready to submit.
+ * Returns false if none is due.
+ */
+bool meshNextRelay(mesh_node *node, int64_t now_us, uint8_t *frame, size_t frame_size, size_t *frame_length);
+
+// Microseconds until the next relay is due (0 = now, -1 = none waiting)
+int64_t meshRelayWaitUs(const mesh_node *node, int64_t now_us);
+
+/*
+ * Worst delay the relays add to a frame of airtime_us on its way to a
+ * peer config.hops relays away (for ACK deadlines).
+ */
+int64_t meshPathDelayUs(const mesh_node *node, uint32_t airtime_us);
+
+#endif
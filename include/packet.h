@@ -0,0 +1,221 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * On-air packet layout (all multi-byte fields are little-endian varints
+ * except the CRC):
+ *
+ *   byte 0        version (high nibble) | packet type (low nibble)
+ *   byte 1        flags
+ *   varint        transmitter_id
+ *   varint        receiver_id
+ *   varint        sequence
+ *   varint        payload_length
+ *   payload       payload_length bytes
+ *   [mesh]        only with PACKET_FLAG_MESH: varint flood id, varint hop
+ *                 id, one byte of hops left (mesh.h), see packetSetMesh
+ *   [rate]        only with PACKET_FLAG_RATE_ATTACHED: one byte, a data
+ *                 rate offer or answer (link.h), see packetAttachRate
+ *   [ack]         only with PACKET_FLAG_ACK_ATTACHED: varint sequence +
+ *                 2 byte bitmap (little-endian) + 8 byte MAC, see
+ *                 packetAttachAck
+ *   2 bytes       CRC-16/CCITT-FALSE over everything above, big-endian
+ *
+ * Varints are unsigned LEB128 (same encoding as protobuf): 7 bits per byte,
+ * high bit set on every byte except the last. Small ids and short messages
+ * cost one byte each, so a 10 character text between nodes 1 and 2 is
+ * 18 bytes on air instead of the 288 bytes of the device struct.
+ *
+ * Encoder and decoder never allocate: the encoder writes into a buffer
+ * given by the caller and the decoder returns a view whose payload
+ * points inside the received buffer.
+ */
+
+#define PACKET_VERSION          1
+
+// Largest frame the SX1278 FIFO can send in one go
+#define PACKET_MAX_SIZE         255
+
+// Largest message frame before fragmentation (fragment.h): a full text
+// (MESSAGE_SIZE - 1 bytes) uncompressed, AEAD tag, worst case header and CRC
+#define PACKET_MAX_MESSAGE_SIZE 320
+
+#define PACKET_FIXED_SIZE       2   // version/type + flags
+#define PACKET_CRC_SIZE         2
+#define PACKET_VARINT_MAX_SIZE  5   // a uint32_t needs at most 5 varint bytes
+
+// Worst case header: fixed bytes + 4 varints
+#define PACKET_HEADER_MAX_SIZE  (PACKET_FIXED_SIZE + 4 * PACKET_VARINT_MAX_SIZE)
+
+// Attached ACK: sequence varint + bitmap + MAC (fragment.h)
+#define PACKET_ACK_BITMAP_SIZE  2
+#define PACKET_ACK_MAC_SIZE     8
+#define PACKET_ACK_MAX_SIZE     (PACKET_VARINT_MAX_SIZE + PACKET_ACK_BITMAP_SIZE + PACKET_ACK_MAC_SIZE)
+
+enum packet_type{
+
+    PACKET_TYPE_DATA = 0,
+    PACKET_TYPE_HANDSHAKE_INIT = 1,  // session key exchange (session.h)
+    PACKET_TYPE_HANDSHAKE_REPLY = 2,
+    PACKET_TYPE_FRAGMENT = 3,        // piece of a message frame (fragment.h)
+    PACKET_TYPE_ACK = 4,             // selective acknowledgement of fragments
+
+};
+
+enum packet_flags{
+
+    PACKET_FLAG_NONE = 0x00,
+    PACKET_FLAG_COMPRESSED = 0x01, // payload went through the compression stage (compress.h)
+    PACKET_FLAG_ENCRYPTED = 0x02,  // payload is ciphertext + AEAD tag, header is the AAD (aead.h)
+    PACKET_FLAG_KEY_PHASE = 0x04,  // which of the two latest session keys sealed it (session.h)
+    PACKET_FLAG_ACK_REQUEST = 0x08, // last fragment of a round: answer with an ACK (fragment.h)
+    PACKET_FLAG_ACK_ATTACHED = 0x10, // an ACK for the opposite direction rides after the payload;
+                                     // left out of the AAD, it carries its own MAC like a standalone ACK
+    PACKET_FLAG_RATE_ATTACHED = 0x20, // a data rate byte rides after the payload (link.h); left out of
+                                      // the AAD and not authenticated
+    PACKET_FLAG_MESH = 0x40,        // flooded through relays (mesh.h); every hop rewrites the trailer,
+                                    // so it is left out of the AAD too
+    PACKET_FLAG_FEC = 0x80,         // fragment of a message sent with parity fragments (fragment.h)
+
+
+};
+
+// Trailers added after sealing: clear them before using a header as AAD
+#define PACKET_TRAILER_FLAGS    (PACKET_FLAG_ACK_ATTACHED | PACKET_FLAG_RATE_ATTACHED | PACKET_FLAG_MESH)
+
+// Mesh trailer: two varints + hops left
+#define PACKET_MESH_MAX_SIZE    (2 * PACKET_VARINT_MAX_SIZE + 1)
+
+//errors 400 -> Packet could not be encoded/decoded
+
+enum packet_error{
+
+    PACKET_OK = 0,
+    PACKET_ERROR_BUFFER_TOO_SMALL = 401,
+    PACKET_ERROR_PAYLOAD_TOO_LARGE = 402,
+    PACKET_ERROR_BAD_VERSION = 403,
+    PACKET_ERROR_TRUNCATED = 404,
+    PACKET_ERROR_BAD_CRC = 405,
+    PACKET_ERROR_BAD_VARINT = 406,
+
+};
+
+typedef struct{
+
+    uint8_t version;
+    uint8_t packet_type;
+    uint8_t flags;
+    uint32_t transmitter_id;
+    uint32_t receiver_id;
+    uint32_t sequence;
+
+} packet_header;
+
+typedef struct{
+
+    uint32_t flood_id;          // numbers the frames an origin floods
+    uint32_t hop_id;            // node that put this copy on air
+    uint8_t hops_left;          // relays it may still take
+
+} packet_mesh;
+
+typedef struct{
+
+    packet_header header;
+    const uint8_t *payload;     // points inside the decoded buffer
+    size_t payload_length;
+    bool has_ack;               // PACKET_FLAG_ACK_ATTACHED: the three fields below are set
+    uint32_t ack_sequence;
+    uint16_t ack_bitmap;
+    const uint8_t *ack_mac;     // PACKET_ACK_MAC_SIZE bytes inside the decoded buffer
+    bool has_rate;              // PACKET_FLAG_RATE_ATTACHED: rate is set
+    uint8_t rate;
+    bool has_mesh;              // PACKET_FLAG_MESH: mesh is set
+    packet_mesh mesh;
+
+} packet_view;
+
+
+/*
+ * Bytes taken by the header (without the CRC) for a given header and
+ * payload length. The payload starts at buffer + packetHeaderSize(...),
+ * so a caller can build it there directly and skip the copy in
+ * packetEncode.
+ */
+size_t packetHeaderSize(const packet_header *header, size_t payload_length);
+
+/*
+ * Total frame size for a given header and payload length.
+ */
+size_t packetEncodedSize(const packet_header *header, size_t payload_length);
+
+/*
+ * Writes a full frame into buffer (at most PACKET_MAX_MESSAGE_SIZE bytes;
+ * only frames up to PACKET_MAX_SIZE go on air whole). If payload already sits at
+ * buffer + packetHeaderSize(header, payload_length) it is not copied.
+ * On success *packet_length holds the frame size.
+ */
+int packetEncode(const packet_header *header, const uint8_t *payload, size_t payload_length,
+                 uint8_t *buffer, size_t buffer_size, size_t *packet_length);
+
+/*
+ * packetEncode in two steps, for stages that must see the finished header
+ * before the payload is final (the AEAD stage authenticates the header):
+ * packetWriteHeader writes the header for payload_length bytes and sets
+ * *header_length; the caller fills buffer[*header_length ...] and then
+ * packetWriteCrc appends the CRC after the first length bytes and returns
+ * the frame size.
+ */
+int packetWriteHeader(const packet_header *header, size_t payload_length,
+                      uint8_t *buffer, size_t buffer_size, size_t *header_length);
+size_t packetWriteCrc(uint8_t *buffer, size_t length);
+
+/*
+ * Checks CRC and layout of a received frame and fills view. view->payload
+ * points inside buffer, which must stay alive while the view is used.
+ */
+int packetDecode(const uint8_t *buffer, size_t buffer_length, packet_view *view);
+
+/*
+ * Attaches an ACK (sequence, bitmap and MAC, as in a PACKET_TYPE_ACK
+ * frame) to a finished frame of length bytes going the other way to the same
+ * peer: the ACK is inserted before the CRC, PACKET_FLAG_ACK_ATTACHED is
+ * set and the CRC rewritten. The frame must still fit in PACKET_MAX_SIZE.
+ * Payload and header length are untouched, so a sealed payload stays
+ * valid as long as the receiver clears the flag before using the header
+ * as AAD.
+ */
+int packetAttachAck(uint8_t *buffer, size_t length, size_t buffer_size,
+                    uint32_t ack_sequence, uint16_t ack_bitmap, const uint8_t ack_mac[PACKET_ACK_MAC_SIZE],
+                    size_t *packet_length);
+
+/*
+ * Same for the data rate byte (link.h), which goes before an attached
+ * ACK: attach it first.
+ */
+int packetAttachRate(uint8_t *buffer, size_t length, size_t buffer_size, uint8_t rate, size_t *packet_length);
+
+/*
+ * Writes the mesh trailer (mesh.h) of a finished frame, or replaces the
+ * one it has: a relay rewrites hop and hops left on every copy. An
+ * attached rate or ACK after it moves along.
+ */
+int packetSetMesh(uint8_t *buffer, size_t length, size_t buffer_size, const packet_mesh *mesh, size_t *packet_length);
+
+/*
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, no reflection, no final xor).
+ */
+uint16_t packetCrc16(const uint8_t *data, size_t length);
+
+/*
+ * Unsigned LEB128 helpers. Return the number of bytes written/read,
+ * or 0 if the buffer is too short (or the varint is malformed).
+ */
+size_t packetWriteVarint(uint8_t *buffer, size_t buffer_size, uint32_t value);
+size_t packetReadVarint(const uint8_t *buffer, size_t buffer_length, uint32_t *value);
+
+#endif
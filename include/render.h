@@ -0,0 +1,155 @@
+/**
+ * Tarea de render con cola de comandos de dibujo
+ * ----------------------------------------------
+ *
+ * Todo el dibujo en el ILI9341 lo hace una tarea dedicada, fijada al
+ * núcleo RENDER_CORE del ESP32. El resto del programa (juego, botones,
+ * radio) solo encola comandos (rellenar, texto, bitmap, present...) y
+ * sigue trabajando en el otro núcleo sin esperar nunca al bus SPI.
+ *
+ * La cola es un buffer circular de un productor y un consumidor (SPSC)
+ * sin cerrojos: el productor solo escribe 'head' y el consumidor solo
+ * escribe 'tail', con órdenes de memoria acquire/release. Los semáforos
+ * solo se usan para dormir cuando la cola está vacía (consumidor) o llena
+ * (productor), nunca para proteger los datos.
+ *
+ * Reglas:
+ *   - Solo UNA tarea puede encolar comandos (el productor).
+ *   - Tras render_start, solo la tarea de render puede llamar al driver
+ *     ILI9341. Para dibujar algo más complejo, usa render_call.
+ *   - Los punteros de bitmaps e imágenes deben seguir siendo válidos hasta
+ *     que se dibujen (lo normal es que estén en flash). El texto y los
+ *     argumentos de render_call se copian dentro del comando.
+ *
+ * En el host (sin ESP_PLATFORM) la tarea de render es un hilo POSIX, así
+ * que la misma cola se puede someter a pruebas de estrés en el PC (ver
+ * testplayground/render_stress.c).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "latency.h"
+
+// Comandos en la cola (debe ser potencia de 2)
+#define RENDER_QUEUE_LEN      32
+
+// Caracteres máximos de un comando de texto (el resto se recorta)
+#define RENDER_TEXT_MAX       40
+
+// Bytes máximos de argumentos que se copian en un render_call
+#define RENDER_CALL_ARG_MAX   32
+
+// Núcleo, prioridad y pila de la tarea de render en el ESP32. app_main
+// corre en el núcleo 0 (CONFIG_ESP_MAIN_TASK_AFFINITY_CPU0).
+#define RENDER_CORE           1
+#define RENDER_TASK_PRIORITY  5
+#define RENDER_STACK_SIZE     4096
+
+typedef enum {
+    RENDER_CMD_FILL_SCREEN = 0,
+    RENDER_CMD_FILL_RECT,
+    RENDER_CMD_TEXT,
+    RENDER_CMD_BITMAP,
+    RENDER_CMD_IMAGE,
+    RENDER_CMD_PRESENT,
+    RENDER_CMD_CALL,
+    RENDER_CMD_LATENCY,
+    RENDER_CMD_STOP,
+} render_cmd_type_t;
+
+// Función que ejecuta la tarea de render; recibe su copia de los argumentos
+typedef void (*render_call_fn_t)(const void *arg);
+
+typedef struct {
+    uint8_t  type;          // render_cmd_type_t
+    uint8_t  scale;         // texto
+    int16_t  x, y;
+    uint16_t w, h;
+    uint16_t color, bg;
+    union {
+        char text[RENDER_TEXT_MAX + 1];
+        const uint16_t *pixels;         // RENDER_CMD_BITMAP
+        struct {
+            const uint8_t *data;        // RENDER_CMD_IMAGE
+            uint32_t size;
+        } image;
+        struct {
+            render_call_fn_t fn;        // RENDER_CMD_CALL
+            uint8_t arg[RENDER_CALL_ARG_MAX];
+        } call;
+        latency_trace_t latency;        // RENDER_CMD_LATENCY
+    };
+} render_cmd_t;
+
+/**
+ * Contadores de la cola.
+ */
+typedef struct {
+    uint32_t submitted;     // comandos encolados
+    uint32_t executed;      // comandos ejecutados por la tarea de render
+    uint32_t full_waits;    // veces que el productor esperó por cola llena
+    uint32_t max_depth;     // máximo de comandos pendientes a la vez
+} render_stats_t;
+
+/**
+ * Arranca la tarea (o el hilo, en el host) de render. El driver ya debe
+ * estar inicializado (ili9341_init y su configuración). Devuelve false si
+ * no se pudo crear.
+ */
+bool render_start(void);
+
+/**
+ * Pide a la tarea de render que termine tras ejecutar lo pendiente y
+ * espera a que lo haga. El driver vuelve a poder usarse directamente.
+ */
+void render_stop(void);
+
+/**
+ * Encola un comando sin esperar nunca. Devuelve false si la cola está
+ * llena (el comando se descarta).
+ */
+bool render_try_submit(const render_cmd_t *cmd);
+
+/**
+ * Encola un comando; si la cola está llena, espera a que haya hueco.
+ */
+void render_submit(const render_cmd_t *cmd);
+
+/**
+ * Atajos que construyen y encolan cada comando (esperan si está llena).
+ */
+void render_fill_screen(uint16_t color);
+void render_fill_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
+void render_text(uint16_t x, uint16_t y, const char *text,
+                 uint16_t color, uint16_t bg, uint8_t scale);
+void render_bitmap(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint16_t *pixels);
+void render_image(int16_t x, int16_t y, const uint8_t *image, uint32_t size);
+void render_present(void);
+
+/**
+ * Ejecuta fn(arg) en la tarea de render. Los 'size' bytes de 'arg' (como
+ * mucho RENDER_CALL_ARG_MAX) se copian en el comando.
+ */
+void render_call(render_call_fn_t fn, const void *arg, size_t size);
+
+/**
+ * Cierra una traza de latencia (latency.h) cuando todo lo encolado antes
+ * ha llegado al panel: la tarea de render espera a que termine el DMA,
+ * apunta DISPLAYED y suma la traza a los histogramas. Esa espera solo
+ * ocurre en los frames que llevan traza.
+ */
+void render_latency(const latency_trace_t *trace);
+
+/**
+ * Espera a que la tarea de render haya ejecutado todo lo encolado.
+ */
+void render_sync(void);
+
+/**
+ * Copia los contadores de la cola.
+ */
+void render_get_stats(render_stats_t *stats);
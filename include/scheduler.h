@@ -0,0 +1,178 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packet.h"
+
+/*
+ * Transmit scheduler between the protocol (sendMessage, ACKs, handshakes)
+ * and the radio. Everything that goes on air is submitted here; the
+ * scheduler hands the radio one frame at a time, so a frame that just
+ * arrived can still overtake what is waiting.
+ *
+ *   - Three queues by packet type: ACKs first, then control frames
+ *     (handshakes), then messages and their fragments. FIFO within a queue.
+ *   - Duty cycle: airtime (at the rate of each frame, link.h) is added up in
+ *     SCHEDULER_DUTY_SLOTS slots of duty_window_ms. A frame waits until the
+ *     slots that may still overlap the last window, plus its own airtime,
+ *     fit in duty_cycle_permille of the window. Whole slots are counted, so
+ *     no window of that length ever goes over; the price is waiting up to
+ *     one slot longer than strictly needed.
+ *   - Listen-before-talk: the driver checks the channel right before each
+ *     transmission and hands busy frames back (SX1278_EVENT_TX_BUSY). The
+ *     frame goes back to the head of its queue after a random backoff of
+ *     1..2^n slots, n growing with each busy attempt; it is dropped after
+ *     lbt_max_attempts.
+ *   - ACK piggybacking: an ACK about to go out that has a DATA or FRAGMENT
+ *     frame queued for the same peer travels inside it (packetAttachAck)
+ *     instead of in its own frame, saving a preamble and a header (not a
+ *     flooded ACK, mesh.h). An ACK for a message that already has one
+ *     waiting replaces it.
+ *
+ * Each submitted frame gets a ticket (never 0). Ticket state and the
+ * expected wait are available at any time; so are the queue depths and
+ * the wait a new frame of each priority would face. The expected wait
+ * assumes a free channel and nothing new of higher priority.
+ *
+ * Nothing runs on its own: call schedulerService on every radio event
+ * (TX done, TX busy) and again after the delay it returns. Time is the
+ * caller's monotonic clock, in microseconds. Not thread safe: use it from
+ * one task.
+ */
+
+#define SCHEDULER_QUEUE_LEN      8    // frames per priority
+#define SCHEDULER_HISTORY_LEN    16   // finished tickets remembered for schedulerTicketInfo
+#define SCHEDULER_DUTY_SLOTS     60   // resolution of the duty cycle window
+#define SCHEDULER_RETRY_US       (10 * 1000) // radio refused the frame (not started, queue full)
+
+//errors 900 -> Frame could not be scheduled
+
+enum scheduler_error{
+
+    SCHEDULER_OK = 0,
+    SCHEDULER_ERROR_QUEUE_FULL = 901,
+    SCHEDULER_ERROR_TOO_LARGE = 902,        // does not fit in one frame, or alone exceeds the duty cycle budget
+    SCHEDULER_ERROR_UNKNOWN_TICKET = 903,   // never issued, or finished too long ago
+
+};
+
+typedef enum{
+
+    SCHEDULER_PRIORITY_ACK = 0,
+    SCHEDULER_PRIORITY_CONTROL,
+    SCHEDULER_PRIORITY_MESSAGE,
+    SCHEDULER_PRIORITY_COUNT,
+
+} scheduler_priority;
+
+typedef enum{
+
+    SCHEDULER_TICKET_QUEUED = 0,
+    SCHEDULER_TICKET_ON_AIR,
+    SCHEDULER_TICKET_SENT,
+    SCHEDULER_TICKET_DROPPED,   // channel busy lbt_max_attempts times
+
+} scheduler_ticket_state;
+
+typedef uint32_t scheduler_ticket;
+
+typedef struct{
+
+    scheduler_ticket_state state;
+    scheduler_priority priority;
+    uint8_t position;           // frames ahead in the queues (QUEUED only)
+    int64_t expected_wait_us;   // until it starts on air (QUEUED only)
+    bool piggybacked;           // an ACK that travelled inside another frame
+
+} scheduler_ticket_info;
+
+typedef struct{
+
+    uint8_t depth[SCHEDULER_PRIORITY_COUNT];
+    uint32_t queued_airtime_us;
+    int64_t expected_wait_us[SCHEDULER_PRIORITY_COUNT]; // for a frame submitted now (without its own airtime)
+    uint32_t duty_credit_us;    // airtime left in the current window
+    bool on_air;
+
+} scheduler_status;
+
+typedef struct{
+
+    uint32_t submitted;
+    uint32_t sent;
+    uint32_t rejected;          // SCHEDULER_ERROR_QUEUE_FULL
+    uint32_t dropped;           // gave up on a busy channel
+    uint32_t channel_busy;      // frames handed back by LBT
+    uint32_t duty_waits;        // times a frame had to wait for the budget
+    uint32_t acks_piggybacked;
+    uint32_t acks_replaced;
+    uint64_t airtime_us;
+
+} scheduler_stats;
+
+typedef struct{
+
+    uint16_t duty_cycle_permille;   // share of time on air (1000 = no limit)
+    uint32_t duty_window_ms;        // the share applies to every window this long
+    uint32_t lbt_slot_us;
+    uint8_t lbt_max_attempts;
+    uint8_t lbt_max_exponent;       // backoff up to 2^this slots
+    bool piggyback_acks;
+
+} scheduler_config;
+
+// 10%: the usual limit of the 433 MHz SRD band in Europe (check yours)
+#define SCHEDULER_CONFIG_DEFAULT {          \
+    .duty_cycle_permille = 100,             \
+    .duty_window_ms = 60 * 60 * 1000,       \
+    .lbt_slot_us = 20 * 1000,               \
+    .lbt_max_attempts = 8,                  \
+    .lbt_max_exponent = 5,                  \
+    .piggyback_acks = true,                 \
+}
+
+/*
+ * What the scheduler needs from the radio; NULL in schedulerInit means the
+ * SX1278 driver, sending every frame at the rate link.h agreed with its
+ * receiver. busy_count counts frames handed back by LBT so far.
+ */
+typedef struct{
+
+    bool (*send)(const uint8_t *frame, size_t length);
+    size_t (*pending)(void);
+    uint32_t (*busy_count)(void);
+    uint32_t (*airtime_us)(const uint8_t *frame, size_t length);
+
+} scheduler_radio;
+
+/*
+ * Empties the queues and starts over with config and radio (NULL for the
+ * defaults). Submitting before any init uses the defaults.
+ */
+void schedulerInit(const scheduler_config *config, const scheduler_radio *radio, int64_t now_us);
+
+/*
+ * Queues a finished frame by its packet type and returns at once. *ticket
+ * (if not NULL) identifies it later. A waiting ACK for the same message
+ * is replaced and keeps its ticket.
+ */
+int schedulerSubmit(const uint8_t *frame, size_t frame_length, int64_t now_us, scheduler_ticket *ticket);
+
+/*
+ * Hands the next frame to the radio if it is idle and the budget and the
+ * backoff allow it. Returns the microseconds until it should be called
+ * again (-1 with nothing queued).
+ */
+int64_t schedulerService(int64_t now_us);
+
+// Free slots in a priority queue
+size_t schedulerQueueRoom(scheduler_priority priority);
+
+int schedulerTicketInfo(scheduler_ticket ticket, int64_t now_us, scheduler_ticket_info *info);
+void schedulerGetStatus(int64_t now_us, scheduler_status *status);
+void schedulerGetStats(scheduler_stats *stats);
+
+#endif
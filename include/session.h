@@ -0,0 +1,170 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aead.h"
+#include "x25519.h"
+
+/*
+ * Per-peer session keys for the encryption stage (aead.h).
+ *
+ * Each pair of nodes runs one X25519 handshake and then only symmetric
+ * crypto per message. Two frames:
+ *
+ *   HANDSHAKE_INIT   initiator -> responder   ephemeral public key | auth
+ *   HANDSHAKE_REPLY  responder -> initiator   ephemeral public key | auth
+ *
+ * auth = first SESSION_AUTH_SIZE bytes of HMAC-SHA256(network key,
+ * header | public key): only nodes holding the network key can open a
+ * session. Both ends then derive, with HKDF-SHA256 (salt = network key,
+ * input = shared secret | initiator public | responder public), one key
+ * per direction. Ephemeral keys are wiped once used (forward secrecy).
+ *
+ * Sessions live in a fixed size cache, least recently used entry goes
+ * first when it is full. A session should be renewed after
+ * SESSION_REKEY_MESSAGES messages or SESSION_REKEY_SECONDS
+ * (sessionRekeyDue) and stops sending at twice those message limits.
+ * Data frames carry PACKET_FLAG_KEY_PHASE, which flips on every rekey,
+ * so frames sealed with the previous key just before a rekey still open.
+ *
+ * Either handshake frame may be lost:
+ *
+ *   - A handshake unanswered after SESSION_HANDSHAKE_TIMEOUT_MS counts as
+ *     lost: sessionRekeyDue asks for a new one (a late REPLY to the old
+ *     INIT is rejected, its auth covers the old ephemeral key), and an
+ *     INIT of the peer is no longer refused as a collision.
+ *   - The responder cannot tell whether its REPLY arrived, so on a rekey
+ *     it keeps sending under the previous key until a frame of the peer
+ *     opens under the new one (sessionConfirmKey). Until then the peer
+ *     can still read it, whether it got the REPLY or not.
+ *
+ * Not covered: replay of an old HANDSHAKE_INIT makes the responder derive
+ * keys nobody else has until the next handshake (no persistent counter to
+ * reject it yet); being unconfirmed, they are not sent under.
+ */
+
+#define SESSION_CACHE_SIZE       8
+#define SESSION_REKEY_MESSAGES   1000
+#define SESSION_REKEY_SECONDS    (60 * 60)
+#define SESSION_AUTH_SIZE        16
+#define SESSION_HANDSHAKE_PAYLOAD_SIZE (X25519_KEY_SIZE + SESSION_AUTH_SIZE)
+#define SESSION_HANDSHAKE_TIMEOUT_MS   (30 * 1000) // INIT + REPLY at the slowest rate, queues included
+
+//errors 700 -> Session could not be established/used
+
+enum session_error{
+
+    SESSION_OK = 0,
+    SESSION_ERROR_NO_SESSION = 701,     // no keys for that peer: run a handshake first
+    SESSION_ERROR_REJECTED = 702,       // bad auth, wrong destination or weak public key
+    SESSION_ERROR_UNEXPECTED = 703,     // reply without a handshake in progress
+    SESSION_ERROR_EXHAUSTED = 704,      // hard message limit reached without a rekey
+    SESSION_ERROR_COLLISION = 705,      // both sides started; ours wins (lower id initiates)
+    SESSION_ERROR_NOT_HANDSHAKE = 706,  // frame is not a handshake frame
+
+};
+
+// Replay check of the frames opened under one key (receiveMessage, transmitter.h)
+typedef struct{
+
+    uint32_t highest_sequence;  // newest frame received
+    uint32_t sequence_window;   // bit n: highest_sequence - n already received; 0 = none yet
+
+} session_replay;
+
+typedef struct{
+
+    uint32_t peer_id;
+    bool in_use;
+    bool established;           // keys below are valid
+    bool handshake_pending;     // our INIT is out, waiting for the REPLY
+    bool has_previous_key;
+    bool confirmed;             // the peer has used the current keys (or sent us the REPLY)
+
+    uint8_t key_phase;          // 0/1, sent as PACKET_FLAG_KEY_PHASE
+    uint8_t pending_key_phase;
+    uint8_t send_key[AEAD_KEY_SIZE];
+    uint8_t receive_key[AEAD_KEY_SIZE];
+    uint8_t previous_receive_key[AEAD_KEY_SIZE];
+    uint8_t previous_send_key[AEAD_KEY_SIZE];   // sent under until confirmed, if has_previous_key
+
+    session_replay replay;      // of receive_key, cleared with every new key
+    session_replay previous_replay; // of previous_receive_key
+
+    uint8_t ephemeral_secret[X25519_KEY_SIZE];
+    uint8_t ephemeral_public[X25519_KEY_SIZE];
+
+    int64_t established_us;
+    int64_t handshake_started_us;
+    uint32_t messages_sent;
+    uint32_t last_used;         // LRU stamp
+
+} session_entry;
+
+typedef struct{
+
+    uint32_t handshakes_started;
+    uint32_t handshakes_completed;  // first session with a peer
+    uint32_t rekeys;                // renewed session with a known peer
+    uint32_t handshakes_rejected;
+    uint32_t handshakes_retried;    // started again after SESSION_HANDSHAKE_TIMEOUT_MS
+    uint32_t evictions;
+
+} session_stats;
+
+typedef struct{
+
+    uint32_t local_id;
+    uint8_t network_key[AEAD_KEY_SIZE];
+    uint32_t handshake_sequence;
+    uint32_t use_clock;
+    session_entry entries[SESSION_CACHE_SIZE];
+    session_stats stats;
+
+} session_cache;
+
+void sessionCacheInit(session_cache *cache, uint32_t local_id, const uint8_t network_key[AEAD_KEY_SIZE]);
+
+/*
+ * Starts (or restarts) a handshake with peer_id and writes the
+ * HANDSHAKE_INIT frame to send. The current session, if any, keeps
+ * working until the reply arrives. now_us is the caller's monotonic
+ * clock, for the handshake timeout.
+ */
+int sessionStartHandshake(session_cache *cache, uint32_t peer_id, int64_t now_us,
+                          uint8_t *frame, size_t frame_size, size_t *frame_length);
+
+/*
+ * Handles a received handshake frame. For an INIT the REPLY to send back
+ * is written to reply (*reply_length = 0 when there is nothing to send).
+ * now_us is the caller's monotonic clock, used for the rekey timer.
+ */
+int sessionHandleHandshake(session_cache *cache, const uint8_t *frame, size_t frame_length, int64_t now_us,
+                           uint8_t *reply, size_t reply_size, size_t *reply_length);
+
+/*
+ * Key for the next message to peer_id. Counts the message; fails with
+ * SESSION_ERROR_EXHAUSTED at 2 * SESSION_REKEY_MESSAGES.
+ */
+int sessionGetSendKey(session_cache *cache, uint32_t peer_id, const uint8_t **key, uint8_t *key_phase);
+
+// Key for a frame from peer_id sealed under key_phase
+int sessionGetReceiveKey(session_cache *cache, uint32_t peer_id, uint8_t key_phase, const uint8_t **key);
+
+// Replay window of the key a frame from peer_id sealed under key_phase opens
+// with (NULL without one). Sequences start over when a peer reboots, so each
+// key gets its own window
+session_replay *sessionReplayWindow(session_cache *cache, uint32_t peer_id, uint8_t key_phase);
+
+// A frame from peer_id sealed under key_phase opened: if that is the current
+// phase, the peer has the current keys and the previous send key goes
+void sessionConfirmKey(session_cache *cache, uint32_t peer_id, uint8_t key_phase);
+
+// True when the session with peer_id is missing or past a soft limit, and
+// no handshake is on its way (or it timed out)
+bool sessionRekeyDue(const session_cache *cache, uint32_t peer_id, int64_t now_us);
+
+#endif
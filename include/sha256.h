@@ -0,0 +1,41 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * SHA-256 (FIPS 180-4), HMAC-SHA256 (RFC 2104) and HKDF-SHA256
+ * (RFC 5869) in plain C.
+ *
+ * Only the handshake uses them (session.h): key derivation and the
+ * authentication of handshake frames, a few hundred bytes per session.
+ */
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE  64
+
+typedef struct{
+
+    uint32_t state[8];
+    uint64_t total_length;
+    uint8_t buffer[SHA256_BLOCK_SIZE];
+    size_t buffered;
+
+} sha256_context;
+
+void sha256Start(sha256_context *context);
+void sha256Update(sha256_context *context, const uint8_t *data, size_t length);
+void sha256Finish(sha256_context *context, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+void hmacSha256(const uint8_t *key, size_t key_length, const uint8_t *data, size_t data_length,
+                uint8_t mac[SHA256_DIGEST_SIZE]);
+
+/*
+ * HKDF extract + expand. output_length is at most 255 * 32 bytes; salt
+ * and info may be NULL with length 0.
+ */
+void hkdfSha256(const uint8_t *salt, size_t salt_length, const uint8_t *input_key, size_t input_key_length,
+                const uint8_t *info, size_t info_length, uint8_t *output, size_t output_length);
+
+#endif
@@ -0,0 +1,203 @@
+/**
+ * Driver de la radio LoRa SX1278 (433 MHz) para ESP32
+ * ---------------------------------------------------
+ *
+ * El SX1278 cuelga del mismo bus SPI que la pantalla (HSPI, con su propio
+ * CS) y avisa de todo por su pin DIO0:
+ *
+ *   - En recepción DIO0 = RxDone: hay un paquete completo en la FIFO.
+ *   - En transmisión DIO0 = TxDone: el paquete ya salió por la antena.
+ *
+ * Nadie sondea los registros de estado. La interrupción de DIO0 solo
+ * despierta a la tarea de radio, que lee RegIrqFlags, vacía o llena la
+ * FIFO en UNA transacción SPI (ráfaga sobre RegFifo) y vuelve a dormir.
+ * Entre paquetes la radio se queda en recepción continua.
+ *
+ * Flujo:
+ *
+ *   sx1278_send ──> cola TX ──> tarea de radio ──> FIFO ──> aire
+ *                                    ^
+ *                              DIO0 (TxDone / RxDone)
+ *                                    |
+ *   sx1278_receive <── cola RX <─────┘  (+ RSSI, SNR y hora)
+ *
+ * sx1278_send solo copia el frame en la cola y vuelve: transmitir un
+ * paquete dura decenas o cientos de ms (ver sx1278_airtime_us). Cuando
+ * entra un paquete o termina un envío, la tarea publica APP_EVENT_RADIO
+ * en el bucle de eventos con los flags SX1278_EVENT_*.
+ *
+ * En el host (sin ESP_PLATFORM) la tarea es un hilo POSIX y el chip es un
+ * modelo por registros (ver sx1278_sim.h), así que el mismo driver se
+ * prueba en el PC (testplayground/radio_sim.c).
+ *
+ * ADÁPTALO A TU HARDWARE:
+ *   - Revisa los #define de pines en sx1278.c (CS, RST, DIO0).
+ *   - Llama a sx1278_init DESPUÉS de ili9341_init (la pantalla crea el
+ *     bus SPI) y de event_loop_init.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Mayor paquete que cabe en la FIFO del SX1278 (RegPayloadLength es de 8 bits)
+#define SX1278_MAX_PAYLOAD     255
+
+// Paquetes que esperan en cada cola antes de rechazar los nuevos
+#define SX1278_TX_QUEUE_LEN    4
+#define SX1278_RX_QUEUE_LEN    4
+
+// Núcleo, prioridad y pila de la tarea de radio (la de render va en el 1)
+#define SX1278_CORE            0
+#define SX1278_TASK_PRIORITY   6
+#define SX1278_STACK_SIZE      3072
+
+// Flags de APP_EVENT_RADIO (event->radio_flags)
+#define SX1278_EVENT_RX        (1u << 0)   // hay paquetes en la cola RX
+#define SX1278_EVENT_TX_DONE   (1u << 1)   // un paquete terminó de salir
+#define SX1278_EVENT_RX_ERROR  (1u << 2)   // paquete con CRC incorrecto descartado
+#define SX1278_EVENT_TX_BUSY   (1u << 3)   // canal ocupado: un frame se devolvió sin transmitir
+
+/**
+ * Parámetros de modulación. Los dos extremos deben usar los mismos
+ * (salvo la potencia).
+ */
+typedef struct {
+    uint32_t frequency_hz;      // 137-525 MHz
+    uint32_t bandwidth_hz;      // 7800 ... 500000 (se redondea al valor válido)
+    uint8_t spreading_factor;   // 7-12 (SF6 exige cabecera implícita)
+    uint8_t coding_rate;        // denominador de 4/x: 5-8
+    int8_t tx_power_dbm;        // 2-17 por PA_BOOST
+    uint8_t sync_word;          // 0x12 redes privadas, 0x34 LoRaWAN
+    uint16_t preamble_length;   // símbolos
+    int16_t lbt_threshold_dbm;  // listen-before-talk: no transmite con el canal por encima (0 = sin LBT)
+} sx1278_config_t;
+
+// 433 MHz, SF7, 125 kHz, 4/5: unos 5,5 kbit/s
+#define SX1278_CONFIG_DEFAULT {        \
+    .frequency_hz = 433000000,         \
+    .bandwidth_hz = 125000,            \
+    .spreading_factor = 7,             \
+    .coding_rate = 5,                  \
+    .tx_power_dbm = 17,                \
+    .sync_word = 0x12,                 \
+    .preamble_length = 8,              \
+    .lbt_threshold_dbm = -90,          \
+}
+
+/**
+ * Velocidad de un frame: lo que cambia de un paquete a otro (el resto de
+ * la modulación es fijo). El receptor tiene que escuchar con el mismo SF;
+ * el CR no, viaja en la cabecera explícita del paquete.
+ */
+typedef struct {
+    uint8_t spreading_factor;   // 7-12
+    uint8_t coding_rate;        // 5-8
+} sx1278_rate_t;
+
+/**
+ * Paquete recibido con sus datos de enlace.
+ */
+typedef struct {
+    uint8_t data[SX1278_MAX_PAYLOAD];
+    uint8_t length;
+    int16_t rssi_dbm;           // potencia del paquete
+    float snr_db;               // relación señal/ruido (negativa bajo el ruido)
+    int64_t time_us;            // cuándo saltó RxDone
+} sx1278_packet_t;
+
+/**
+ * Contadores del driver.
+ */
+typedef struct {
+    uint32_t tx_queued;         // frames aceptados por sx1278_send
+    uint32_t tx_rejected;       // rechazados por cola llena o tamaño
+    uint32_t tx_done;           // TxDone recibidos
+    uint32_t rx_packets;        // paquetes buenos entregados a la cola RX
+    uint32_t rx_crc_errors;     // descartados por CRC
+    uint32_t rx_dropped;        // buenos pero con la cola RX llena
+    uint32_t tx_busy;           // frames devueltos sin transmitir por canal ocupado (LBT)
+    uint32_t interrupts;        // disparos de DIO0
+    uint32_t spi_transactions;  // accesos a registros y a la FIFO
+} sx1278_stats_t;
+
+// ------------------------------------------------------------
+// API PÚBLICA DEL DRIVER
+// ------------------------------------------------------------
+
+/**
+ * Resetea el chip, comprueba RegVersion, lo configura en modo LoRa con
+ * 'config' (NULL = SX1278_CONFIG_DEFAULT), arranca la tarea de radio y
+ * deja la radio en recepción continua. Devuelve false si el chip no
+ * responde o algo falla.
+ */
+bool sx1278_init(const sx1278_config_t *config);
+
+/**
+ * Para la tarea de radio y deja el chip en sleep. Los paquetes pendientes
+ * se descartan.
+ */
+void sx1278_stop(void);
+
+/**
+ * Copia 'frame' en la cola de transmisión y vuelve sin esperar a que
+ * salga. Devuelve false si la cola está llena, el driver no está
+ * arrancado o el frame no cabe en la FIFO.
+ *
+ * Con LBT, justo antes de transmitir la tarea mira el canal (señal LoRa
+ * detectada o RSSI por encima del umbral). Si está ocupado, el frame se
+ * descarta sin salir, cuenta en tx_busy y se avisa con
+ * SX1278_EVENT_TX_BUSY: reintentarlo, y cuándo, es cosa de quien lo
+ * envió (ver scheduler.h).
+ */
+bool sx1278_send(const uint8_t *frame, size_t length);
+
+/**
+ * Como sx1278_send, pero el frame sale con 'rate' (NULL = el de la
+ * configuración). La tarea cambia RegModemConfig justo antes de
+ * transmitir y después vuelve a escuchar con el de sx1278_set_rx_rate.
+ */
+bool sx1278_send_rate(const uint8_t *frame, size_t length, const sx1278_rate_t *rate);
+
+/**
+ * Velocidad de la configuración: la de sx1278_send y la de escucha por
+ * defecto.
+ */
+sx1278_rate_t sx1278_config_rate(void);
+
+/**
+ * Velocidad a la que escucha la radio entre transmisiones (NULL = la de
+ * la configuración). Se aplica en cuanto la radio no está transmitiendo;
+ * un paquete que llegue durante el cambio se pierde.
+ */
+void sx1278_set_rx_rate(const sx1278_rate_t *rate);
+
+/**
+ * Saca el paquete más antiguo de la cola de recepción. Espera como mucho
+ * timeout_ms (0 = no esperar). Devuelve false si no llegó ninguno.
+ */
+bool sx1278_receive(sx1278_packet_t *packet, uint32_t timeout_ms);
+
+/**
+ * Frames en la cola TX más el que está en el aire.
+ */
+size_t sx1278_tx_pending(void);
+
+/**
+ * Tiempo en el aire de un paquete de 'length' bytes con la configuración
+ * actual (fórmula de la nota de aplicación AN1200.13 de Semtech, cabecera
+ * explícita y CRC activo).
+ */
+uint32_t sx1278_airtime_us(size_t length);
+
+/**
+ * Lo mismo con otra velocidad (NULL = la de la configuración).
+ */
+uint32_t sx1278_airtime_rate_us(size_t length, const sx1278_rate_t *rate);
+
+/**
+ * Devuelve los contadores acumulados.
+ */
+void sx1278_get_stats(sx1278_stats_t *stats);
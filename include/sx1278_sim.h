@@ -0,0 +1,98 @@
+/**
+ * Radio SX1278 simulada para el host (Linux)
+ * ------------------------------------------
+ *
+ * Permite compilar src/sx1278.c en un PC, sin ESP-IDF ni placa. En lugar
+ * del bus SPI y los GPIO, el driver habla con un modelo del chip dentro
+ * del propio proceso que:
+ *
+ *   - Guarda los 128 registros y la FIFO de 256 bytes, con el puntero
+ *     RegFifoAddrPtr y el autoincremento de las ráfagas SPI.
+ *   - Sigue los modos de RegOpMode: al pasar a TX toma el paquete de la
+ *     FIFO y, pasado su tiempo en el aire, marca TxDone y vuelve a standby.
+ *   - Solo recibe en recepción continua: los paquetes inyectados se
+ *     escriben en la FIFO con RegRxNbBytes, RegPktSnrValue y
+ *     RegPktRssiValue como lo haría el chip.
+ *   - Calcula el nivel de DIO0 según RegDioMapping1 y RegIrqFlags y llama
+ *     a la "interrupción" del driver mientras esté en alto y armada.
+ *
+ * El "aire" es el propio programa de prueba: cada paquete transmitido se
+ * entrega a un callback y los paquetes de otros nodos se inyectan con
+ * sx1278_sim_inject.
+ *
+ * Ejemplo de compilación (ver testplayground/radio_sim.c):
+ *   gcc -Iinclude src/sx1278.c src/sx1278_sim.c ... -pthread
+ */
+
+#pragma once
+
+#ifndef ESP_PLATFORM
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Recibe cada paquete que el chip simulado termina de transmitir. Se
+ * llama desde el hilo del simulador.
+ */
+typedef void (*sx1278_sim_tx_hook_t)(const uint8_t *frame, size_t length, void *context);
+
+/**
+ * Contadores del chip simulado.
+ */
+typedef struct {
+    uint32_t spi_transactions;  // accesos SPI (uno por ráfaga)
+    uint32_t register_reads;    // bytes leídos de registros
+    uint32_t register_writes;   // bytes escritos en registros
+    uint32_t fifo_bytes;        // bytes leídos o escritos en RegFifo
+    uint32_t packets_sent;      // TxDone producidos
+    uint32_t packets_received;  // inyecciones que llegaron a la FIFO
+    uint32_t packets_missed;    // inyecciones con la radio sin escuchar
+    uint64_t airtime_us;        // tiempo en el aire transmitido
+} sx1278_sim_stats_t;
+
+/**
+ * Modo tiempo real: cada transmisión tarda su tiempo en el aire antes de
+ * dar TxDone. Por defecto está desactivado y TxDone llega en cuanto el
+ * hilo del simulador lo procesa (pero siempre después de volver de la
+ * escritura de RegOpMode, como en el chip real).
+ */
+void sx1278_sim_set_realtime(bool enable);
+
+/**
+ * Instala el callback que recibe lo transmitido (NULL lo quita).
+ */
+void sx1278_sim_set_tx_hook(sx1278_sim_tx_hook_t hook, void *context);
+
+/**
+ * Un paquete de otro nodo termina de llegar ahora con esa potencia y SNR.
+ * crc_error simula un paquete dañado (marca PayloadCrcError). Devuelve
+ * false si la radio no estaba en recepción (el paquete se pierde).
+ */
+bool sx1278_sim_inject(const uint8_t *frame, size_t length, int16_t rssi_dbm, float snr_db,
+                       bool crc_error);
+
+/**
+ * Estado del canal que ve el chip en recepción: RegRssiValue y el bit de
+ * señal detectada de RegModemStat (lo que mira el LBT del driver). Tras
+ * el reset, canal libre con el ruido en -120 dBm.
+ */
+void sx1278_sim_set_channel(int16_t rssi_dbm, bool signal_detected);
+
+/**
+ * Valor actual de un registro (sin efectos sobre la FIFO).
+ */
+uint8_t sx1278_sim_get_register(uint8_t reg);
+
+/**
+ * Devuelve los contadores acumulados desde el último reset.
+ */
+void sx1278_sim_get_stats(sx1278_sim_stats_t *stats);
+
+/**
+ * Pone a cero los contadores (registros y FIFO se conservan).
+ */
+void sx1278_sim_reset_stats(void);
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,76 @@
+/**
+ * Consola de texto con scroll por hardware
+ * ----------------------------------------
+ *
+ * Muestra un historial de mensajes que crece hacia abajo (por ejemplo, una
+ * conversación de mensajes de hasta MESSAGE_SIZE caracteres) sin redibujar
+ * la pantalla: cuando el texto llega a la última línea, la consola mueve la
+ * zona de scroll del ILI9341 (ili9341_scroll_to) y solo dibuja la línea que
+ * queda al descubierto abajo.
+ *
+ * La consola ocupa todo el ancho de la pantalla entre dos zonas fijas
+ * (cabecera y pie) que se pueden dibujar aparte con la API normal.
+ *
+ * Solo puede haber una consola activa a la vez: la zona de scroll del
+ * panel es única.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ili9341.h"
+#include "font5x7.h"
+
+// Columnas máximas (escala 1: 240 / 6 píxeles por carácter)
+#define TEXT_CONSOLE_MAX_COLUMNS  (ILI9341_WIDTH / FONT5X7_ADVANCE)
+
+typedef struct {
+    uint16_t top;           // primera fila de la zona de scroll (pantalla)
+    uint16_t height;        // alto de la zona (múltiplo de line_height)
+    uint8_t  scale;         // escala de la fuente
+    uint8_t  line_height;   // filas de píxeles por línea de texto
+    uint8_t  columns;       // caracteres por línea
+    uint8_t  rows;          // líneas visibles
+    uint16_t fg, bg;        // colores (el fondo es fijo, ver text_console_set_color)
+    uint16_t scroll;        // desplazamiento actual de la zona, en filas de píxeles
+    uint8_t  row;           // línea del cursor (0 = la de arriba)
+    uint8_t  col;           // columna del cursor
+    bool     scroll_pending; // el cursor está en una línea aún no mostrada
+} text_console_t;
+
+/**
+ * Prepara la consola entre las zonas fijas 'top_fixed' (arriba) y
+ * 'bottom_fixed' (abajo), define la zona de scroll del panel y la borra.
+ *
+ * El alto de la zona se redondea a un número entero de líneas: las filas
+ * sobrantes se suman a la zona fija de abajo.
+ */
+void text_console_init(text_console_t *con, uint16_t top_fixed, uint16_t bottom_fixed,
+                       uint8_t scale, uint16_t fg, uint16_t bg);
+
+/**
+ * Escribe texto a partir del cursor. Parte las líneas por palabras (o a
+ * mitad de palabra si no cabe en una línea entera) y respeta '\n'.
+ */
+void text_console_write(text_console_t *con, const char *text);
+
+/**
+ * Pasa a la línea siguiente. Si el cursor está en la última, el scroll se
+ * hace al escribir el primer texto de la línea nueva (o en el siguiente
+ * salto, si la línea queda vacía).
+ */
+void text_console_newline(text_console_t *con);
+
+/**
+ * Cambia el color del texto que se escriba a partir de ahora (por
+ * ejemplo, para distinguir mensajes enviados y recibidos). El fondo no
+ * cambia: la consola cuenta con que las líneas viejas ya lo tienen.
+ */
+void text_console_set_color(text_console_t *con, uint16_t fg);
+
+/**
+ * Borra la consola y vuelve a dejar el cursor arriba, sin scroll.
+ */
+void text_console_clear(text_console_t *con);
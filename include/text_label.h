@@ -0,0 +1,80 @@
+/**
+ * Etiquetas de texto con redibujado incremental
+ * ---------------------------------------------
+ *
+ * Una etiqueta es una línea de texto en una posición fija que recuerda lo
+ * que dibujó la última vez (carácter y color de cada celda). Al cambiar el
+ * texto solo se repintan las celdas que cambian: un contador que pasa de
+ * "9.9" a "9.8" cuesta un único carácter, no borrar y reescribir la línea.
+ *
+ * Las celdas que cambian seguidas y con el mismo color se envían juntas
+ * con un solo ili9341_draw_string. Si el texto nuevo es más corto, las
+ * celdas que sobran se borran con el color de fondo.
+ *
+ * La etiqueta supone que nadie más dibuja encima: si se repinta su zona
+ * (por ejemplo con ili9341_fill_screen), hay que llamar a
+ * text_label_reset para que olvide lo que tenía.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ili9341.h"
+#include "font5x7.h"
+
+// Caracteres máximos de una etiqueta (una línea completa a escala 1)
+#define TEXT_LABEL_MAX_CHARS  (ILI9341_WIDTH / FONT5X7_ADVANCE)
+
+typedef struct {
+    uint16_t x, y;          // esquina superior izquierda
+    uint8_t  scale;         // escala de la fuente
+    uint8_t  capacity;      // celdas de la etiqueta (lo que cabe en pantalla)
+    uint8_t  length;        // celdas con algo distinto de espacio al final
+    uint16_t bg;            // color de fondo
+    char     text[TEXT_LABEL_MAX_CHARS];     // lo que se ve ahora
+    uint16_t colors[TEXT_LABEL_MAX_CHARS];   // color de cada celda
+    uint32_t glyphs_drawn;  // caracteres enviados desde text_label_init
+} text_label_t;
+
+/**
+ * Prepara una etiqueta de hasta 'capacity' caracteres en (x, y). No dibuja
+ * nada: supone que su zona ya está pintada con 'bg'.
+ */
+void text_label_init(text_label_t *label, uint16_t x, uint16_t y, uint8_t capacity,
+                     uint8_t scale, uint16_t bg);
+
+/**
+ * La zona de la etiqueta se repintó con el fondo desde fuera: olvida el
+ * contenido sin dibujar nada.
+ */
+void text_label_reset(text_label_t *label);
+
+/**
+ * Muestra 'text' en color 'fg', repintando solo las celdas que cambian.
+ */
+void text_label_print(text_label_t *label, const char *text, uint16_t fg);
+
+/**
+ * Igual que text_label_print, pero con un color por carácter ('colors'
+ * tiene al menos strlen(text) elementos).
+ */
+void text_label_print_colors(text_label_t *label, const char *text, const uint16_t *colors);
+
+/**
+ * Borra la etiqueta de la pantalla.
+ */
+void text_label_clear(text_label_t *label);
+
+/**
+ * Escribe 'value / 10^decimals' en decimal con 'decimals' cifras tras el
+ * punto, sin coma flotante. Se rellena con espacios por la izquierda
+ * hasta 'width' caracteres, para que las cifras no bailen cuando el
+ * número pierde un dígito (" 9.9" en vez de "9.9" tras "10.0").
+ *
+ * Devuelve los caracteres escritos (sin contar el '\0'), o 0 si no caben
+ * en 'size'.
+ */
+size_t text_label_format_fixed(char *out, size_t size, int32_t value,
+                               uint8_t decimals, uint8_t width);
@@ -2,8 +2,18 @@
 #define TRANSMITTER_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 
+#include "aead.h"
+#include "compress.h"
+#include "fragment.h"
+#include "link.h"
+#include "mesh.h"
+#include "packet.h"
+#include "scheduler.h"
+#include "session.h"
+
 #define MESSAGE_SIZE 280
 
 typedef int id;
@@ -12,18 +22,71 @@ typedef struct{ // change struct name to something more explicit
 
     id transmitter_id;
     id receiver_id;
+    uint32_t sequence; // next sequence number this device puts on air
     char message[MESSAGE_SIZE];
+    session_cache *sessions; // per-peer keys (session.h); NULL = shared key from setEncryptionKey
+    fragment_sender *transfer; // outgoing message with delivery confirmation (fragment.h); NULL = one frame, no ACK
+    fragment_reassembler *reassembly; // incoming fragments of this node (fragment.h)
+    session_replay replay; // replay check under the shared key; sessions keep one per key (session.h)
     
     //look for implemetntaion of enums in structures 
 }  device ;
 
 
-int sendMessage(int receiver_id, int emmisorID,char *message, device *debugSender, device *debugReceiver);
+// Validates the link, builds the frame and submits it to the TX scheduler (scheduler.h).
+// Returns as soon as the frame is queued, not when it is on air; *ticket (if not NULL)
+// follows it through schedulerTicketInfo. With a transfer the frame goes in fragments,
+// confirmed by ACKs (see serviceTransfer), and the ticket is the first fragment's
+int sendMessage(int receiver_id, int emmisorID,char *message, device *debugSender, device *debugReceiver,
+                scheduler_ticket *ticket);
 int getReceiver(int receiver_id);
 int validateConnection(int receiver_id, int emmisorID,char *message, device *debugSender, device *debugReceiver);
-int setMessage(char *message,device *debugReceiver );
+int setMessage(const char *message, size_t message_length, device *debugReceiver);
 char* getMessage(char *message);
 
+// Compression stage between getMessage and sendMessage (huffman_codec by default, NULL = raw text)
+void setCompressionCodec(const compression_codec *codec);
+// Encryption stage after compression: AEAD_KEY_SIZE byte shared key, NULL = plaintext frames
+void setEncryptionKey(const uint8_t *key);
+// Builds the on-air frame for message (see packet.h) into frame, compressed when that makes it smaller
+// and encrypted in place with the session key for receiver_id (or the shared key)
+int encodeMessage(const char *message, device *debugSender, uint8_t *frame, size_t frame_size, size_t *frame_length);
+// Decodes a received frame, checks it belongs to debugReceiver and stores the text.
+// Encrypted frames are decrypted in place, so frame is modified, and refused (306) if
+// their sequence was already received or is more than 32 behind the newest one under
+// the same key (a new session starts a new window: a rebooted peer starts over at 0)
+int receiveMessage(uint8_t *frame, size_t frame_length, device *debugReceiver);
+
+// Largest frame put on air (PACKET_MAX_SIZE by default); longer message frames go in
+// fragments. Smaller frames lose less airtime to each loss at high spreading factors
+void setMaxFrameSize(size_t size);
+// Parity fragments (fec.h) added to every message of two or more fragments, so the
+// receiver rebuilds it despite as many losses without a retransmission. 0 = none (default)
+void setParityFragments(size_t count);
+// Drives debugSender->transfer: submits the fragments the scheduler has room for and probes
+// when the ACK is late. Call it on every radio event and periodically; returns 807 once
+// the message is given up
+int serviceTransfer(device *debugSender);
+// ACK for debugSender->transfer, standalone or attached to any frame of the peer (call
+// it for every frame received from the peer): queues only the fragments still missing.
+// Rounds and their ACKs feed the link quality of the peer (link.h)
+int handleAck(const uint8_t *frame, size_t frame_length, device *debugSender);
+// Fragment frame for this node: answers with an ACK when asked and, once the message is
+// complete, stores its text in debugReceiver (*message_ready = true)
+int receiveFragment(const uint8_t *frame, size_t frame_length, device *debugReceiver, bool *message_ready);
+// Frames go at the rate agreed with the peer: pass every received frame to
+// linkObserveFrame (link.h), with its RSSI and SNR, before handleAck or receiveFragment
+
+// Mesh mode (mesh.h): frames of this node are flooded through relays and frames for
+// others are relayed. NULL = direct links only (default)
+void setMeshNode(mesh_node *node);
+// Every received frame goes here after linkObserveFrame: false if it is not for this node
+// (someone else's, queued for relaying, or a copy already seen). Always true without mesh
+bool acceptFrame(const uint8_t *frame, size_t frame_length);
+// Submits the relays that are due. Call it on every radio event and again after the
+// microseconds it returns (-1 = nothing waiting)
+int64_t serviceMesh(void);
+
 
 
 
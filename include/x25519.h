@@ -0,0 +1,26 @@
+#ifndef X25519_H
+#define X25519_H
+
+#include <stdint.h>
+
+/*
+ * X25519 Diffie-Hellman (RFC 7748) in plain C, constant time.
+ *
+ * Field elements use 10 limbs of 26/25 bits so every product fits a
+ * 32x32->64 multiply. One scalar multiplication is the whole cost of a
+ * handshake (see session.h); messages themselves only use the AEAD.
+ */
+
+#define X25519_KEY_SIZE 32
+
+/*
+ * shared = scalar * point. scalar is clamped internally as the RFC
+ * requires, so any 32 random bytes are a valid secret key.
+ */
+void x25519(uint8_t shared[X25519_KEY_SIZE], const uint8_t scalar[X25519_KEY_SIZE],
+            const uint8_t point[X25519_KEY_SIZE]);
+
+// public_key = secret_key * base point (u = 9)
+void x25519PublicKey(uint8_t public_key[X25519_KEY_SIZE], const uint8_t secret_key[X25519_KEY_SIZE]);
+
+#endif
@@ -0,0 +1,429 @@
+#include <string.h>
+#include "aead.h"
+
+static uint32_t readLittleEndian32(const uint8_t *bytes){
+
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void writeLittleEndian32(uint8_t *bytes, uint32_t value){
+
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+// Tag comparison that takes the same time wherever the first difference is
+static bool tagsEqual(const uint8_t *first, const uint8_t *second){
+
+    uint8_t difference = 0;
+    for(size_t index = 0; index < AEAD_TAG_SIZE; index++){
+        difference |= first[index] ^ second[index];
+    }
+    return difference == 0;
+}
+
+// Wipe that the compiler cannot drop as a dead store
+static void secureZero(void *data, size_t length){
+
+    volatile uint8_t *bytes = data;
+    while(length--){
+        *bytes++ = 0;
+    }
+}
+
+void aeadBuildNonce(uint8_t nonce[AEAD_NONCE_SIZE], uint32_t transmitter_id, uint32_t sequence, uint32_t domain){
+
+    writeLittleEndian32(&nonce[0], transmitter_id);
+    writeLittleEndian32(&nonce[4], sequence);
+    writeLittleEndian32(&nonce[8], domain);
+}
+
+#ifdef AEAD_USE_AES_GCM
+
+/*
+ * AES-256-GCM through mbedtls. ESP-IDF routes the AES block function to
+ * the accelerator; GHASH stays in software.
+ */
+
+const char *aeadBackendName(void){
+
+    return "AES-256-GCM (ESP32 AES accelerator)";
+}
+
+int aeadStart(aead_context *context, const uint8_t key[AEAD_KEY_SIZE],
+              const uint8_t nonce[AEAD_NONCE_SIZE], bool encrypting){
+
+    context->encrypting = encrypting;
+    context->aad_done = false;
+    context->aad_length = 0;
+    context->text_length = 0;
+
+    mbedtls_gcm_init(&context->gcm);
+    if(mbedtls_gcm_setkey(&context->gcm, MBEDTLS_CIPHER_ID_AES, key, AEAD_KEY_SIZE * 8) != 0 ||
+       mbedtls_gcm_starts(&context->gcm, encrypting ? MBEDTLS_GCM_ENCRYPT : MBEDTLS_GCM_DECRYPT,
+                          nonce, AEAD_NONCE_SIZE) != 0){
+        mbedtls_gcm_free(&context->gcm);
+        return AEAD_ERROR_BACKEND;
+    }
+    return AEAD_OK;
+}
+
+int aeadAddAad(aead_context *context, const uint8_t *aad, size_t aad_length){
+
+    if(context->aad_done){
+        return AEAD_ERROR_STATE;
+    }
+    if(mbedtls_gcm_update_ad(&context->gcm, aad, aad_length) != 0){
+        return AEAD_ERROR_BACKEND;
+    }
+    context->aad_length += aad_length;
+    return AEAD_OK;
+}
+
+int aeadUpdate(aead_context *context, uint8_t *data, size_t length){
+
+    size_t output_length = 0;
+
+    context->aad_done = true;
+    // GCM is a counter mode: output may alias input
+    if(mbedtls_gcm_update(&context->gcm, data, length, data, length, &output_length) != 0 ||
+       output_length != length){
+        return AEAD_ERROR_BACKEND;
+    }
+    context->text_length += length;
+    return AEAD_OK;
+}
+
+static int finishTag(aead_context *context, uint8_t tag[AEAD_TAG_SIZE]){
+
+    size_t output_length = 0;
+    int result = mbedtls_gcm_finish(&context->gcm, NULL, 0, &output_length, tag, AEAD_TAG_SIZE);
+    mbedtls_gcm_free(&context->gcm);
+    return result == 0 ? AEAD_OK : AEAD_ERROR_BACKEND;
+}
+
+#else // ChaCha20-Poly1305
+
+/*
+ * ChaCha20 (RFC 8439 section 2.3). Counter 0 produces the Poly1305 key,
+ * text starts at counter 1.
+ */
+
+#define ROTATE_LEFT(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+#define QUARTER_ROUND(a, b, c, d)                       \
+    a += b; d ^= a; d = ROTATE_LEFT(d, 16);             \
+    c += d; b ^= c; b = ROTATE_LEFT(b, 12);             \
+    a += b; d ^= a; d = ROTATE_LEFT(d, 8);              \
+    c += d; b ^= c; b = ROTATE_LEFT(b, 7)
+
+static void chachaBlock(const uint32_t state[16], uint8_t output[64]){
+
+    uint32_t working[16];
+    memcpy(working, state, sizeof(working));
+
+    for(int double_round = 0; double_round < 10; double_round++){
+        QUARTER_ROUND(working[0], working[4], working[8],  working[12]);
+        QUARTER_ROUND(working[1], working[5], working[9],  working[13]);
+        QUARTER_ROUND(working[2], working[6], working[10], working[14]);
+        QUARTER_ROUND(working[3], working[7], working[11], working[15]);
+        QUARTER_ROUND(working[0], working[5], working[10], working[15]);
+        QUARTER_ROUND(working[1], working[6], working[11], working[12]);
+        QUARTER_ROUND(working[2], working[7], working[8],  working[13]);
+        QUARTER_ROUND(working[3], working[4], working[9],  working[14]);
+    }
+
+    for(int word = 0; word < 16; word++){
+        writeLittleEndian32(&output[4 * word], working[word] + state[word]);
+    }
+}
+
+/*
+ * Poly1305 (RFC 8439 section 2.5) with 26-bit limbs, so every product
+ * fits a 32x32->64 multiply (what the ESP32 has).
+ */
+
+#define LIMB_MASK 0x3FFFFFF
+
+static void polyStart(aead_context *context, const uint8_t key[32]){
+
+    // r is clamped as the RFC requires
+    context->poly_r[0] = readLittleEndian32(&key[0]) & 0x3FFFFFF;
+    context->poly_r[1] = (readLittleEndian32(&key[3]) >> 2) & 0x3FFFF03;
+    context->poly_r[2] = (readLittleEndian32(&key[6]) >> 4) & 0x3FFC0FF;
+    context->poly_r[3] = (readLittleEndian32(&key[9]) >> 6) & 0x3F03FFF;
+    context->poly_r[4] = (readLittleEndian32(&key[12]) >> 8) & 0x00FFFFF;
+
+    for(int word = 0; word < 4; word++){
+        context->poly_pad[word] = readLittleEndian32(&key[16 + 4 * word]);
+    }
+    memset(context->poly_h, 0, sizeof(context->poly_h));
+    context->poly_buffered = 0;
+}
+
+static void polyBlock(aead_context *context, const uint8_t block[16]){
+
+    const uint32_t *r = context->poly_r;
+    uint32_t *h = context->poly_h;
+    const uint32_t s1 = r[1] * 5, s2 = r[2] * 5, s3 = r[3] * 5, s4 = r[4] * 5;
+
+    // h += block, with the 2^128 bit every full block carries
+    h[0] += readLittleEndian32(&block[0]) & LIMB_MASK;
+    h[1] += (readLittleEndian32(&block[3]) >> 2) & LIMB_MASK;
+    h[2] += (readLittleEndian32(&block[6]) >> 4) & LIMB_MASK;
+    h[3] += (readLittleEndian32(&block[9]) >> 6) & LIMB_MASK;
+    h[4] += (readLittleEndian32(&block[12]) >> 8) | (1u << 24);
+
+    // h *= r mod 2^130 - 5
+    uint64_t d0 = (uint64_t)h[0] * r[0] + (uint64_t)h[1] * s4 + (uint64_t)h[2] * s3 + (uint64_t)h[3] * s2 + (uint64_t)h[4] * s1;
+    uint64_t d1 = (uint64_t)h[0] * r[1] + (uint64_t)h[1] * r[0] + (uint64_t)h[2] * s4 + (uint64_t)h[3] * s3 + (uint64_t)h[4] * s2;
+    uint64_t d2 = (uint64_t)h[0] * r[2] + (uint64_t)h[1] * r[1] + (uint64_t)h[2] * r[0] + (uint64_t)h[3] * s4 + (uint64_t)h[4] * s3;
+    uint64_t d3 = (uint64_t)h[0] * r[3] + (uint64_t)h[1] * r[2] + (uint64_t)h[2] * r[1] + (uint64_t)h[3] * r[0] + (uint64_t)h[4] * s4;
+    uint64_t d4 = (uint64_t)h[0] * r[4] + (uint64_t)h[1] * r[3] + (uint64_t)h[2] * r[2] + (uint64_t)h[3] * r[1] + (uint64_t)h[4] * r[0];
+
+    uint32_t carry;
+    carry = (uint32_t)(d0 >> 26); h[0] = (uint32_t)d0 & LIMB_MASK;
+    d1 += carry; carry = (uint32_t)(d1 >> 26); h[1] = (uint32_t)d1 & LIMB_MASK;
+    d2 += carry; carry = (uint32_t)(d2 >> 26); h[2] = (uint32_t)d2 & LIMB_MASK;
+    d3 += carry; carry = (uint32_t)(d3 >> 26); h[3] = (uint32_t)d3 & LIMB_MASK;
+    d4 += carry; carry = (uint32_t)(d4 >> 26); h[4] = (uint32_t)d4 & LIMB_MASK;
+    h[0] += carry * 5; carry = h[0] >> 26; h[0] &= LIMB_MASK;
+    h[1] += carry;
+}
+
+static void polyUpdate(aead_context *context, const uint8_t *data, size_t length){
+
+    if(context->poly_buffered > 0){
+        size_t take = 16 - context->poly_buffered;
+        if(take > length){
+            take = length;
+        }
+        memcpy(&context->poly_buffer[context->poly_buffered], data, take);
+        context->poly_buffered += take;
+        data += take;
+        length -= take;
+        if(context->poly_buffered < 16){
+            return;
+        }
+        polyBlock(context, context->poly_buffer);
+        context->poly_buffered = 0;
+    }
+
+    while(length >= 16){
+        polyBlock(context, data);
+        data += 16;
+        length -= 16;
+    }
+
+    memcpy(context->poly_buffer, data, length);
+    context->poly_buffered = length;
+}
+
+// The AEAD construction zero pads AAD and text to 16 bytes
+static void polyPad(aead_context *context){
+
+    static const uint8_t zeros[16] = {0};
+    if(context->poly_buffered > 0){
+        polyUpdate(context, zeros, 16 - context->poly_buffered);
+    }
+}
+
+static void polyFinish(aead_context *context, uint8_t tag[AEAD_TAG_SIZE]){
+
+    uint32_t *h = context->poly_h;
+    uint32_t carry;
+
+    // Full carry propagation
+    carry = h[1] >> 26; h[1] &= LIMB_MASK;
+    h[2] += carry; carry = h[2] >> 26; h[2] &= LIMB_MASK;
+    h[3] += carry; carry = h[3] >> 26; h[3] &= LIMB_MASK;
+    h[4] += carry; carry = h[4] >> 26; h[4] &= LIMB_MASK;
+    h[0] += carry * 5; carry = h[0] >> 26; h[0] &= LIMB_MASK;
+    h[1] += carry;
+
+    // g = h - (2^130 - 5); keep g if it did not go negative (constant time)
+    uint32_t g[5];
+    g[0] = h[0] + 5; carry = g[0] >> 26; g[0] &= LIMB_MASK;
+    g[1] = h[1] + carry; carry = g[1] >> 26; g[1] &= LIMB_MASK;
+    g[2] = h[2] + carry; carry = g[2] >> 26; g[2] &= LIMB_MASK;
+    g[3] = h[3] + carry; carry = g[3] >> 26; g[3] &= LIMB_MASK;
+    g[4] = h[4] + carry - (1u << 26);
+
+    uint32_t keep_g = (g[4] >> 31) - 1;
+    for(int limb = 0; limb < 5; limb++){
+        h[limb] = (h[limb] & ~keep_g) | (g[limb] & keep_g);
+    }
+
+    // Back to 4 x 32 bits, then tag = h + pad mod 2^128
+    uint32_t words[4] = {
+        h[0] | (h[1] << 26),
+        (h[1] >> 6) | (h[2] << 20),
+        (h[2] >> 12) | (h[3] << 14),
+        (h[3] >> 18) | (h[4] << 8),
+    };
+    uint64_t sum = 0;
+    for(int word = 0; word < 4; word++){
+        sum += (uint64_t)words[word] + context->poly_pad[word];
+        writeLittleEndian32(&tag[4 * word], (uint32_t)sum);
+        sum >>= 32;
+    }
+}
+
+const char *aeadBackendName(void){
+
+    return "ChaCha20-Poly1305 (software)";
+}
+
+int aeadStart(aead_context *context, const uint8_t key[AEAD_KEY_SIZE],
+              const uint8_t nonce[AEAD_NONCE_SIZE], bool encrypting){
+
+    context->encrypting = encrypting;
+    context->aad_done = false;
+    context->aad_length = 0;
+    context->text_length = 0;
+
+    // "expand 32-byte k"
+    context->chacha_state[0] = 0x61707865;
+    context->chacha_state[1] = 0x3320646E;
+    context->chacha_state[2] = 0x79622D32;
+    context->chacha_state[3] = 0x6B206574;
+    for(int word = 0; word < 8; word++){
+        context->chacha_state[4 + word] = readLittleEndian32(&key[4 * word]);
+    }
+    context->chacha_state[12] = 0;
+    for(int word = 0; word < 3; word++){
+        context->chacha_state[13 + word] = readLittleEndian32(&nonce[4 * word]);
+    }
+
+    // One-time Poly1305 key from block 0
+    chachaBlock(context->chacha_state, context->keystream);
+    polyStart(context, context->keystream);
+    context->chacha_state[12] = 1;
+    context->keystream_used = sizeof(context->keystream);
+
+    return AEAD_OK;
+}
+
+int aeadAddAad(aead_context *context, const uint8_t *aad, size_t aad_length){
+
+    if(context->aad_done){
+        return AEAD_ERROR_STATE;
+    }
+    polyUpdate(context, aad, aad_length);
+    context->aad_length += aad_length;
+    return AEAD_OK;
+}
+
+int aeadUpdate(aead_context *context, uint8_t *data, size_t length){
+
+    if(!context->aad_done){
+        polyPad(context);
+        context->aad_done = true;
+    }
+
+    // The tag always covers the ciphertext
+    if(!context->encrypting){
+        polyUpdate(context, data, length);
+    }
+
+    uint8_t *text = data;
+    size_t remaining = length;
+    while(remaining > 0){
+        if(context->keystream_used == sizeof(context->keystream)){
+            chachaBlock(context->chacha_state, context->keystream);
+            context->chacha_state[12]++;
+            context->keystream_used = 0;
+        }
+        size_t take = sizeof(context->keystream) - context->keystream_used;
+        if(take > remaining){
+            take = remaining;
+        }
+        for(size_t index = 0; index < take; index++){
+            text[index] ^= context->keystream[context->keystream_used + index];
+        }
+        context->keystream_used += take;
+        text += take;
+        remaining -= take;
+    }
+
+    if(context->encrypting){
+        polyUpdate(context, data, length);
+    }
+    context->text_length += length;
+    return AEAD_OK;
+}
+
+static int finishTag(aead_context *context, uint8_t tag[AEAD_TAG_SIZE]){
+
+    uint8_t lengths[16];
+
+    // Pads whatever is open: the AAD if no text came, otherwise the text
+    polyPad(context);
+    writeLittleEndian32(&lengths[0], (uint32_t)context->aad_length);
+    writeLittleEndian32(&lengths[4], (uint32_t)(context->aad_length >> 32));
+    writeLittleEndian32(&lengths[8], (uint32_t)context->text_length);
+    writeLittleEndian32(&lengths[12], (uint32_t)(context->text_length >> 32));
+    polyUpdate(context, lengths, sizeof(lengths));
+    polyFinish(context, tag);
+
+    secureZero(context, sizeof(*context));
+    return AEAD_OK;
+}
+
+#endif // AEAD_USE_AES_GCM
+
+int aeadFinishEncrypt(aead_context *context, uint8_t tag[AEAD_TAG_SIZE]){
+
+    if(!context->encrypting){
+        return AEAD_ERROR_STATE;
+    }
+    return finishTag(context, tag);
+}
+
+int aeadFinishDecrypt(aead_context *context, const uint8_t tag[AEAD_TAG_SIZE]){
+
+    uint8_t expected_tag[AEAD_TAG_SIZE];
+
+    if(context->encrypting){
+        return AEAD_ERROR_STATE;
+    }
+    int error = finishTag(context, expected_tag);
+    if(error != AEAD_OK){
+        return error;
+    }
+    error = tagsEqual(expected_tag, tag) ? AEAD_OK : AEAD_ERROR_AUTHENTICATION;
+    secureZero(expected_tag, sizeof(expected_tag));
+    return error;
+}
+
+int aeadSeal(const uint8_t key[AEAD_KEY_SIZE], const uint8_t nonce[AEAD_NONCE_SIZE],
+             const uint8_t *aad, size_t aad_length,
+             uint8_t *data, size_t length, uint8_t tag[AEAD_TAG_SIZE]){
+
+    aead_context context;
+
+    int error = aeadStart(&context, key, nonce, true);
+    if(error == AEAD_OK) error = aeadAddAad(&context, aad, aad_length);
+    if(error == AEAD_OK) error = aeadUpdate(&context, data, length);
+    if(error == AEAD_OK) error = aeadFinishEncrypt(&context, tag);
+    return error;
+}
+
+int aeadOpen(const uint8_t key[AEAD_KEY_SIZE], const uint8_t nonce[AEAD_NONCE_SIZE],
+             const uint8_t *aad, size_t aad_length,
+             uint8_t *data, size_t length, const uint8_t tag[AEAD_TAG_SIZE]){
+
+    aead_context context;
+
+    int error = aeadStart(&context, key, nonce, false);
+    if(error == AEAD_OK) error = aeadAddAad(&context, aad, aad_length);
+    if(error == AEAD_OK) error = aeadUpdate(&context, data, length);
+    if(error == AEAD_OK) error = aeadFinishDecrypt(&context, tag);
+    if(error != AEAD_OK){
+        secureZero(data, length);
+    }
+    return error;
+}
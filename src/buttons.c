@@ -0,0 +1,212 @@
+/**
+ * Botones direccionales por interrupción
+ * --------------------------------------
+ *
+ * Ver buttons.h. Estado de cada botón:
+ *
+ *   - Escuchando: interrupción activa. El primer cambio publica el
+ *     evento y pasa a "rebotando".
+ *   - Rebotando: interrupción desactivada y temporizador en marcha.
+ *     Al vencer se lee el pin: si difiere del último estado publicado,
+ *     se publica el cambio y se abre otra ventana de rebote; si no, se
+ *     vuelve a escuchar.
+ *
+ * Las interrupciones son por NIVEL, no por flanco: cada pin se arma con
+ * el nivel contrario a su estado publicado (nivel bajo si está suelto,
+ * alto si está pulsado), así que saltan justo cuando el botón cambia.
+ * En light sleep solo los niveles pueden despertar al chip, y el mismo
+ * armado sirve de fuente de despertar (gpio_wakeup_enable). Además, si el
+ * pin ya cambió al armarlo, la interrupción salta al momento: no hay
+ * ventana en la que se pueda perder un cambio.
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+#include "buttons.h"
+#include "event_loop.h"
+
+static const char *TAG = "BUTTONS";
+
+// -----------------------------------------------------------------------------
+//  Configuración de pines para los BOTONES (ajusta a tu hardware)
+// -----------------------------------------------------------------------------
+// Se asume: botones conectados a GND y GPIO con resistencia PULLUP interna.
+//  - Cuando NO se pulsa -> nivel lógico 1.
+//  - Cuando se pulsa    -> nivel lógico 0.
+
+#define BTN_UP_GPIO     GPIO_NUM_32
+#define BTN_DOWN_GPIO   GPIO_NUM_33
+#define BTN_LEFT_GPIO   GPIO_NUM_25
+#define BTN_RIGHT_GPIO  GPIO_NUM_26
+
+typedef struct {
+    gpio_num_t gpio;
+    esp_timer_handle_t debounce_timer;
+    volatile bool pressed;      // último estado publicado
+} button_t;
+
+static button_t buttons[BUTTON_COUNT] = {
+    [BUTTON_UP]    = { .gpio = BTN_UP_GPIO },
+    [BUTTON_DOWN]  = { .gpio = BTN_DOWN_GPIO },
+    [BUTTON_LEFT]  = { .gpio = BTN_LEFT_GPIO },
+    [BUTTON_RIGHT] = { .gpio = BTN_RIGHT_GPIO },
+};
+
+// Protege 'pressed' entre la interrupción y el temporizador
+static portMUX_TYPE button_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// -----------------------------------------------------------------------------
+//  PROTOTIPOS de funciones internas
+// -----------------------------------------------------------------------------
+
+static void button_isr(void *arg);
+static void button_debounce_done(void *arg);
+static void button_arm(const button_t *button);
+
+// -----------------------------------------------------------------------------
+//  IMPLEMENTACIÓN
+// -----------------------------------------------------------------------------
+
+static inline bool button_read(const button_t *button)
+{
+    return gpio_get_level(button->gpio) == 0;   // pulsado = nivel 0
+}
+
+static inline app_event_t button_make_event(const button_t *button, int64_t time_us)
+{
+    app_event_t event = {
+        .type = APP_EVENT_BUTTON,
+        .time_us = time_us,
+        .button = {
+            .button = (uint8_t)(button - buttons),
+            .type = button->pressed ? BUTTON_EVENT_PRESS : BUTTON_EVENT_RELEASE,
+            .time_us = time_us,
+        },
+    };
+    return event;
+}
+
+/**
+ * Arma la interrupción (y el despertar de light sleep) con el nivel que
+ * indica un cambio respecto al estado publicado.
+ */
+static void button_arm(const button_t *button)
+{
+    gpio_int_type_t level = button->pressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL;
+    gpio_wakeup_enable(button->gpio, level);   // fija también el tipo de interrupción
+    gpio_intr_enable(button->gpio);
+}
+
+/**
+ * Primer cambio tras un periodo estable: se publica al momento y se
+ * ignoran los rebotes hasta que venza el temporizador.
+ */
+static void IRAM_ATTR button_isr(void *arg)
+{
+    button_t *button = arg;
+    int64_t now = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+
+    gpio_intr_disable(button->gpio);
+
+    portENTER_CRITICAL_ISR(&button_lock);
+    bool pressed = button_read(button);
+    bool changed = (pressed != button->pressed);
+    button->pressed = pressed;
+    portEXIT_CRITICAL_ISR(&button_lock);
+
+    if (changed) {
+        app_event_t event = button_make_event(button, now);
+        event_loop_post_from_isr(&event, &woken);
+    }
+
+    esp_timer_start_once(button->debounce_timer, BUTTONS_DEBOUNCE_US);
+
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * Fin de la ventana de rebote (tarea de esp_timer).
+ */
+static void button_debounce_done(void *arg)
+{
+    button_t *button = arg;
+
+    portENTER_CRITICAL(&button_lock);
+    bool pressed = button_read(button);
+    bool changed = (pressed != button->pressed);
+    button->pressed = pressed;
+    portEXIT_CRITICAL(&button_lock);
+
+    if (changed) {
+        // El botón cambió mientras rebotaba (pulsación muy corta): se
+        // publica ahora y se abre otra ventana para el cambio nuevo
+        app_event_t event = button_make_event(button, esp_timer_get_time());
+        event_loop_post(&event);
+        esp_timer_start_once(button->debounce_timer, BUTTONS_DEBOUNCE_US);
+        return;
+    }
+
+    // Estable: volvemos a escuchar. Si el pin cambia justo ahora, el
+    // nivel armado ya está activo y la interrupción salta igualmente.
+    button_arm(button);
+}
+
+bool buttons_init(void)
+{
+    gpio_config_t io_conf = {0};
+    io_conf.intr_type = GPIO_INTR_DISABLE;       // Se arma por nivel más abajo
+    io_conf.mode = GPIO_MODE_INPUT;              // Modo entrada
+    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+    io_conf.pull_up_en = GPIO_PULLUP_ENABLE;     // Activar PULLUP
+
+    // Máscara de pines (OR de los 4)
+    for (int i = 0; i < BUTTON_COUNT; i++) {
+        io_conf.pin_bit_mask |= 1ULL << buttons[i].gpio;
+    }
+    gpio_config(&io_conf);
+
+    // Puede que otro módulo ya haya instalado el servicio: no es un error
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Error en gpio_install_isr_service: %d", ret);
+        return false;
+    }
+
+    for (int i = 0; i < BUTTON_COUNT; i++) {
+        button_t *button = &buttons[i];
+
+        esp_timer_create_args_t timer_args = {
+            .callback = button_debounce_done,
+            .arg = button,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "button_debounce",
+        };
+        if (esp_timer_create(&timer_args, &button->debounce_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "No se pudo crear el temporizador del botón %d", i);
+            return false;
+        }
+
+        button->pressed = button_read(button);
+        gpio_isr_handler_add(button->gpio, button_isr, button);
+        button_arm(button);
+    }
+
+    // Cualquier pin armado con gpio_wakeup_enable saca al chip de light sleep
+    esp_sleep_enable_gpio_wakeup();
+
+    return true;
+}
+
+bool buttons_is_pressed(button_id_t button)
+{
+    return button < BUTTON_COUNT && buttons[button].pressed;
+}
+
@@ -0,0 +1,202 @@
+#include <string.h>
+#include "compress.h"
+#include "packet.h"
+
+/*
+ * Static canonical Huffman model (see compress.h). To retrain, run
+ * testplayground/huffman_train.c on a corpus and paste its output here.
+ */
+
+// Generated by testplayground/huffman_train.c from 3778 bytes of corpus
+// (4.61 bits per character on the training corpus)
+
+static const uint8_t huffman_code_lengths[256] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  5, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,  7, 10,  9, 15,
+     9,  8,  9,  9, 10, 15, 10, 15,  9, 15, 10, 15,
+    15, 15, 15,  8, 15,  7,  9,  9,  8,  6, 10,  9,
+     9,  7, 15, 11,  8,  8,  7,  7,  9, 15,  7,  7,
+     7,  9, 10, 10, 15, 10, 15, 15, 15, 15, 15, 15,
+    15,  4,  7,  5,  5,  3,  7,  6,  6,  5,  9,  7,
+     5,  5,  4,  4,  6,  9,  5,  5,  4,  6,  7,  7,
+    15,  7,  9, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 10, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15,
+};
+
+static const uint16_t huffman_codes[256] = {
+    0x7F30, 0x7F31, 0x7F32, 0x7F33, 0x7F34, 0x7F35, 0x7F36, 0x7F37, 0x7F38, 0x7F39, 0x0010, 0x7F3A,
+    0x7F3B, 0x7F3C, 0x7F3D, 0x7F3E, 0x7F3F, 0x7F40, 0x7F41, 0x7F42, 0x7F43, 0x7F44, 0x7F45, 0x7F46,
+    0x7F47, 0x7F48, 0x7F49, 0x7F4A, 0x7F4B, 0x7F4C, 0x7F4D, 0x7F4E, 0x0000, 0x7F4F, 0x7F50, 0x7F51,
+    0x7F52, 0x7F53, 0x7F54, 0x7F55, 0x7F56, 0x7F57, 0x7F58, 0x7F59, 0x006A, 0x03F0, 0x01EA, 0x7F5A,
+    0x01EB, 0x00F0, 0x01EC, 0x01ED, 0x03F1, 0x7F5B, 0x03F2, 0x7F5C, 0x01EE, 0x7F5D, 0x03F3, 0x7F5E,
+    0x7F5F, 0x7F60, 0x7F61, 0x00F1, 0x7F62, 0x006B, 0x01EF, 0x01F0, 0x00F2, 0x0030, 0x03F4, 0x01F1,
+    0x01F2, 0x006C, 0x7F63, 0x07F2, 0x00F3, 0x00F4, 0x006D, 0x006E, 0x01F3, 0x7F64, 0x006F, 0x0070,
+    0x0071, 0x01F4, 0x03F5, 0x03F6, 0x7F65, 0x03F7, 0x7F66, 0x7F67, 0x7F68, 0x7F69, 0x7F6A, 0x7F6B,
+    0x7F6C, 0x0004, 0x0072, 0x0011, 0x0012, 0x0001, 0x0073, 0x0031, 0x0032, 0x0013, 0x01F5, 0x0074,
+    0x0014, 0x0015, 0x0005, 0x0006, 0x0033, 0x01F6, 0x0016, 0x0017, 0x0007, 0x0034, 0x0075, 0x0076,
+    0x7F6D, 0x0077, 0x01F7, 0x7F6E, 0x7F6F, 0x7F70, 0x7F71, 0x7F72, 0x7F73, 0x7F74, 0x7F75, 0x7F76,
+    0x7F77, 0x7F78, 0x7F79, 0x7F7A, 0x7F7B, 0x7F7C, 0x7F7D, 0x7F7E, 0x7F7F, 0x7F80, 0x7F81, 0x7F82,
+    0x7F83, 0x7F84, 0x7F85, 0x7F86, 0x7F87, 0x7F88, 0x7F89, 0x7F8A, 0x7F8B, 0x7F8C, 0x7F8D, 0x7F8E,
+    0x7F8F, 0x7F90, 0x7F91, 0x7F92, 0x7F93, 0x7F94, 0x7F95, 0x7F96, 0x7F97, 0x7F98, 0x7F99, 0x7F9A,
+    0x7F9B, 0x7F9C, 0x7F9D, 0x7F9E, 0x7F9F, 0x7FA0, 0x7FA1, 0x7FA2, 0x7FA3, 0x7FA4, 0x7FA5, 0x7FA6,
+    0x7FA7, 0x7FA8, 0x7FA9, 0x7FAA, 0x7FAB, 0x7FAC, 0x7FAD, 0x7FAE, 0x7FAF, 0x7FB0, 0x7FB1, 0x7FB2,
+    0x7FB3, 0x7FB4, 0x7FB5, 0x03F8, 0x7FB6, 0x7FB7, 0x7FB8, 0x7FB9, 0x7FBA, 0x7FBB, 0x7FBC, 0x7FBD,
+    0x7FBE, 0x7FBF, 0x7FC0, 0x7FC1, 0x7FC2, 0x7FC3, 0x7FC4, 0x7FC5, 0x7FC6, 0x7FC7, 0x7FC8, 0x7FC9,
+    0x7FCA, 0x7FCB, 0x7FCC, 0x7FCD, 0x7FCE, 0x7FCF, 0x7FD0, 0x7FD1, 0x7FD2, 0x7FD3, 0x7FD4, 0x7FD5,
+    0x7FD6, 0x7FD7, 0x7FD8, 0x7FD9, 0x7FDA, 0x7FDB, 0x7FDC, 0x7FDD, 0x7FDE, 0x7FDF, 0x7FE0, 0x7FE1,
+    0x7FE2, 0x7FE3, 0x7FE4, 0x7FE5, 0x7FE6, 0x7FE7, 0x7FE8, 0x7FE9, 0x7FEA, 0x7FEB, 0x7FEC, 0x7FED,
+    0x7FEE, 0x7FEF, 0x7FF0, 0x7FF1,
+};
+
+static const uint8_t huffman_sorted_symbols[256] = {
+    0x20, 0x65, 0x61, 0x6E, 0x6F, 0x74, 0x0A, 0x63, 0x64, 0x69, 0x6C, 0x6D,
+    0x72, 0x73, 0x45, 0x67, 0x68, 0x70, 0x75, 0x2C, 0x41, 0x49, 0x4E, 0x4F,
+    0x52, 0x53, 0x54, 0x62, 0x66, 0x6B, 0x76, 0x77, 0x79, 0x31, 0x3F, 0x44,
+    0x4C, 0x4D, 0x2E, 0x30, 0x32, 0x33, 0x38, 0x42, 0x43, 0x47, 0x48, 0x50,
+    0x55, 0x6A, 0x71, 0x7A, 0x2D, 0x34, 0x36, 0x3A, 0x46, 0x56, 0x57, 0x59,
+    0xC3, 0x4B, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+    0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x21, 0x22, 0x23,
+    0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2F, 0x35, 0x37, 0x39,
+    0x3B, 0x3C, 0x3D, 0x3E, 0x40, 0x4A, 0x51, 0x58, 0x5A, 0x5B, 0x5C, 0x5D,
+    0x5E, 0x5F, 0x60, 0x78, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F, 0x80, 0x81, 0x82,
+    0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E,
+    0x8F, 0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A,
+    0x9B, 0x9C, 0x9D, 0x9E, 0x9F, 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6,
+    0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF, 0xB0, 0xB1, 0xB2,
+    0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE,
+    0xBF, 0xC0, 0xC1, 0xC2, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB,
+    0xCC, 0xCD, 0xCE, 0xCF, 0xD0, 0xD1, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7,
+    0xD8, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF, 0xE0, 0xE1, 0xE2, 0xE3,
+    0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+    0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB,
+    0xFC, 0xFD, 0xFE, 0xFF,
+};
+
+static const uint16_t huffman_length_counts[HUFFMAN_MAX_BITS + 1] = {
+      0,   0,   0,   2,   4,   8,   5,  14,   5,  14,   9,   1,
+      0,   0,   0, 194,
+};
+
+// Bit writer: codes are appended MSB first into a 32-bit buffer and
+// whole bytes are moved out as soon as they are complete
+typedef struct{
+
+    uint8_t *output;
+    size_t output_size;
+    size_t position;
+    uint32_t bit_buffer;
+    int bit_count;
+
+} bit_writer;
+
+static int writeBits(bit_writer *writer, uint32_t code, int length){
+
+    // At most 7 bits stay pending, so 7 + 15 always fits in 32 bits
+    writer->bit_buffer = (writer->bit_buffer << length) | code;
+    writer->bit_count += length;
+
+    while(writer->bit_count >= 8){
+        if(writer->position == writer->output_size){
+            return COMPRESS_ERROR_BUFFER_TOO_SMALL;
+        }
+        writer->bit_count -= 8;
+        writer->output[writer->position++] = (uint8_t)(writer->bit_buffer >> writer->bit_count);
+    }
+    return COMPRESS_OK;
+}
+
+int huffmanCompress(const uint8_t *input, size_t input_length,
+                    uint8_t *output, size_t output_size, size_t *output_length){
+
+    size_t header_length = packetWriteVarint(output, output_size, (uint32_t)input_length);
+    if(header_length == 0){
+        return COMPRESS_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    bit_writer writer = { output, output_size, header_length, 0, 0 };
+
+    for(size_t index = 0; index < input_length; index++){
+        uint8_t symbol = input[index];
+        int error = writeBits(&writer, huffman_codes[symbol], huffman_code_lengths[symbol]);
+        if(error != COMPRESS_OK){
+            return error;
+        }
+    }
+
+    // Pad the last byte with zeros
+    if(writer.bit_count > 0){
+        int error = writeBits(&writer, 0, 8 - writer.bit_count);
+        if(error != COMPRESS_OK){
+            return error;
+        }
+    }
+
+    *output_length = writer.position;
+    return COMPRESS_OK;
+}
+
+int huffmanDecompress(const uint8_t *input, size_t input_length,
+                      uint8_t *output, size_t output_size, size_t *output_length){
+
+    uint32_t original_length;
+    size_t position = packetReadVarint(input, input_length, &original_length);
+    if(position == 0){
+        return COMPRESS_ERROR_CORRUPTED;
+    }
+    if(original_length > output_size){
+        return COMPRESS_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    size_t bit_position = position * 8;
+    const size_t bit_end = input_length * 8;
+
+    for(uint32_t index = 0; index < original_length; index++){
+        // Canonical decoding: walk the lengths keeping the first code of
+        // each one, until the bits read fall inside a length's range
+        int code = 0, first = 0, symbol_index = 0;
+        int length;
+
+        for(length = 1; length <= HUFFMAN_MAX_BITS; length++){
+            if(bit_position == bit_end){
+                return COMPRESS_ERROR_CORRUPTED;
+            }
+            code |= (input[bit_position >> 3] >> (7 - (bit_position & 7))) & 1;
+            bit_position++;
+
+            int count = huffman_length_counts[length];
+            if(code - first < count){
+                output[index] = huffman_sorted_symbols[symbol_index + code - first];
+                break;
+            }
+            symbol_index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+
+        if(length > HUFFMAN_MAX_BITS){
+            return COMPRESS_ERROR_CORRUPTED; // unused code
+        }
+    }
+
+    *output_length = original_length;
+    return COMPRESS_OK;
+}
+
+const compression_codec huffman_codec = {
+    .name = "static-huffman",
+    .compress = huffmanCompress,
+    .decompress = huffmanDecompress,
+};
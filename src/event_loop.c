@@ -0,0 +1,194 @@
+/**
+ * Bucle de eventos de la aplicación
+ * ---------------------------------
+ *
+ * Ver event_loop.h. La espera es un xQueueReceive cuyo timeout es el
+ * tiempo que falta para el temporizador más próximo (o infinito si no hay
+ * ninguno). Con tickless idle, FreeRTOS no vuelve a despertar al chip
+ * hasta ese momento, salvo que llegue antes un evento a la cola.
+ */
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+
+#include "event_loop.h"
+
+static const char *TAG = "EVENT_LOOP";
+
+static QueueHandle_t event_queue;
+
+// Vencimiento de cada temporizador en us (0 = parado)
+static int64_t event_timer_deadline_us[EVENT_LOOP_MAX_TIMERS];
+
+static event_loop_stats_t event_stats;
+static volatile uint32_t event_dropped;   // también desde interrupciones
+static int64_t event_last_return_us;      // fin de la última espera
+
+// -----------------------------------------------------------------------------
+//  PROTOTIPOS de funciones internas
+// -----------------------------------------------------------------------------
+
+static int event_next_timer(void);
+static TickType_t event_ticks_until(int64_t delay_us);
+
+// -----------------------------------------------------------------------------
+//  IMPLEMENTACIÓN
+// -----------------------------------------------------------------------------
+
+bool event_loop_init(void)
+{
+    event_queue = xQueueCreate(EVENT_LOOP_QUEUE_LEN, sizeof(app_event_t));
+    if (event_queue == NULL) {
+        ESP_LOGE(TAG, "No se pudo crear la cola de eventos");
+        return false;
+    }
+
+#if CONFIG_PM_ENABLE
+    // Escalado de frecuencia y light sleep automático cuando todas las
+    // tareas están bloqueadas (requiere CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = EVENT_LOOP_MAX_FREQ_MHZ,
+        .min_freq_mhz = EVENT_LOOP_MIN_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        // Sin gestor de energía el juego funciona igual, solo gasta más
+        ESP_LOGW(TAG, "esp_pm_configure falló (%d): sin light sleep", ret);
+    }
+#endif
+
+    event_last_return_us = esp_timer_get_time();
+    return true;
+}
+
+bool event_loop_post(const app_event_t *event)
+{
+    if (xQueueSend(event_queue, event, 0) != pdTRUE) {
+        event_dropped++;
+        return false;
+    }
+    return true;
+}
+
+bool IRAM_ATTR event_loop_post_from_isr(const app_event_t *event, BaseType_t *woken)
+{
+    if (xQueueSendFromISR(event_queue, event, woken) != pdTRUE) {
+        event_dropped++;
+        return false;
+    }
+    return true;
+}
+
+void event_loop_start_timer(uint8_t timer_id, uint32_t delay_ms)
+{
+    if (timer_id >= EVENT_LOOP_MAX_TIMERS) return;
+
+    // Un vencimiento de 0 significa "parado": nunca lo usamos como valor real
+    int64_t deadline = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    event_timer_deadline_us[timer_id] = deadline ? deadline : 1;
+}
+
+void event_loop_stop_timer(uint8_t timer_id)
+{
+    if (timer_id >= EVENT_LOOP_MAX_TIMERS) return;
+    event_timer_deadline_us[timer_id] = 0;
+}
+
+/**
+ * Índice del temporizador que vence antes, o -1 si no hay ninguno activo.
+ */
+static int event_next_timer(void)
+{
+    int next = -1;
+    for (int i = 0; i < EVENT_LOOP_MAX_TIMERS; i++) {
+        if (event_timer_deadline_us[i] == 0) continue;
+        if (next < 0 || event_timer_deadline_us[i] < event_timer_deadline_us[next]) {
+            next = i;
+        }
+    }
+    return next;
+}
+
+/**
+ * Ticks de FreeRTOS que cubren 'delay_us' (redondeando hacia arriba, para
+ * no despertar antes de tiempo y tener que volver a dormir).
+ */
+static TickType_t event_ticks_until(int64_t delay_us)
+{
+    const int64_t tick_us = (int64_t)portTICK_PERIOD_MS * 1000;
+    return (TickType_t)((delay_us + tick_us - 1) / tick_us);
+}
+
+void event_loop_wait(app_event_t *event)
+{
+    int64_t now = esp_timer_get_time();
+    event_stats.busy_us += now - event_last_return_us;
+
+    while (1) {
+        int next = event_next_timer();
+        if (next >= 0 && event_timer_deadline_us[next] <= now) {
+            // Temporizador vencido: se entrega antes que nuevos eventos
+            event->type = APP_EVENT_TIMER;
+            event->time_us = event_timer_deadline_us[next];
+            event->timer_id = (uint8_t)next;
+            event_timer_deadline_us[next] = 0;
+            break;
+        }
+
+        TickType_t wait = portMAX_DELAY;
+        if (next >= 0) {
+            wait = event_ticks_until(event_timer_deadline_us[next] - now);
+        }
+
+        bool received = xQueueReceive(event_queue, event, wait) == pdTRUE;
+
+        int64_t after = esp_timer_get_time();
+        event_stats.idle_us += after - now;
+        event_stats.wakeups++;
+        now = after;
+
+        if (received) break;
+    }
+
+    switch (event->type) {
+    case APP_EVENT_BUTTON: event_stats.button_events++; break;
+    case APP_EVENT_TIMER:  event_stats.timer_events++;  break;
+    case APP_EVENT_RADIO:  event_stats.radio_events++;  break;
+    default: break;
+    }
+
+    event_last_return_us = now;
+}
+
+void event_loop_get_stats(event_loop_stats_t *stats)
+{
+    *stats = event_stats;
+    stats->dropped = event_dropped;
+}
+
+void event_loop_report(void)
+{
+    event_loop_stats_t stats;
+    event_loop_get_stats(&stats);
+
+    int64_t total_us = stats.idle_us + stats.busy_us;
+    ESP_LOGI(TAG, "Despertares: %u (botones %u, temporizadores %u, radio %u), perdidos %u",
+             (unsigned)stats.wakeups, (unsigned)stats.button_events,
+             (unsigned)stats.timer_events, (unsigned)stats.radio_events,
+             (unsigned)stats.dropped);
+    ESP_LOGI(TAG, "Esperando %lld ms de %lld ms (%lld%%)",
+             (long long)(stats.idle_us / 1000), (long long)(total_us / 1000),
+             (long long)(total_us ? stats.idle_us * 100 / total_us : 0));
+
+#if CONFIG_PM_PROFILING
+    // Tiempo real en cada modo de energía, incluido light sleep ("SLEEP")
+    esp_pm_dump_locks(stdout);
+#endif
+}
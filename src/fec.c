@@ -0,0 +1,186 @@
+#include <string.h>
+#include "fec.h"
+
+// x^8 + x^4 + x^3 + x^2 + 1, with 2 as generator
+#define FIELD_POLYNOMIAL 0x11D
+
+static uint8_t gf_exp[512]; // doubled: a sum of two logs needs no mod 255
+static uint8_t gf_log[256];
+static bool tables_ready = false;
+
+static void buildTables(void){
+
+    unsigned value = 1;
+    for(int power = 0; power < 255; power++){
+        gf_exp[power] = (uint8_t)value;
+        gf_exp[power + 255] = (uint8_t)value;
+        gf_log[value] = (uint8_t)power;
+        value <<= 1;
+        if(value & 0x100){
+            value ^= FIELD_POLYNOMIAL;
+        }
+    }
+    tables_ready = true;
+}
+
+static uint8_t gfMul(uint8_t a, uint8_t b){
+
+    if(a == 0 || b == 0){
+        return 0;
+    }
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static uint8_t gfInverse(uint8_t a){
+
+    return gf_exp[255 - gf_log[a]];
+}
+
+uint8_t fecCoefficient(size_t parity_index, size_t data_index){
+
+    if(!tables_ready){
+        buildTables();
+    }
+    // Rows and columns from disjoint sets: the xor is never 0
+    return gfInverse((uint8_t)((FEC_MAX_SHARDS + parity_index) ^ data_index));
+}
+
+// Products of coefficient with every low nibble and every high nibble.
+// Multiplying is linear: each entry is the xor of coefficient * x^bit
+// over the bits of its index
+static void nibbleTables(uint8_t coefficient, uint8_t *low, uint8_t *high){
+
+    uint8_t powers[8];
+    powers[0] = coefficient;
+    for(int bit = 1; bit < 8; bit++){
+        uint8_t previous = powers[bit - 1];
+        powers[bit] = (uint8_t)((previous << 1) ^ ((previous & 0x80) ? (FIELD_POLYNOMIAL & 0xFF) : 0));
+    }
+    low[0] = 0;
+    high[0] = 0;
+    for(int bit = 0; bit < 4; bit++){
+        int step = 1 << bit;
+        for(int nibble = 0; nibble < step; nibble++){
+            low[step + nibble] = low[nibble] ^ powers[bit];
+            high[step + nibble] = high[nibble] ^ powers[bit + 4];
+        }
+    }
+}
+
+void fecMulAdd(uint8_t *dst, const uint8_t *src, uint8_t coefficient, size_t length){
+
+    if(coefficient == 0){
+        return;
+    }
+    if(coefficient == 1){
+        for(size_t index = 0; index < length; index++){
+            dst[index] ^= src[index];
+        }
+        return;
+    }
+
+    uint8_t low[16], high[16];
+    nibbleTables(coefficient, low, high);
+    for(size_t index = 0; index < length; index++){
+        uint8_t byte = src[index];
+        dst[index] ^= low[byte & 0x0F] ^ high[byte >> 4];
+    }
+}
+
+void fecScale(uint8_t *dst, uint8_t coefficient, size_t length){
+
+    if(coefficient == 1){
+        return;
+    }
+    if(coefficient == 0){
+        memset(dst, 0, length);
+        return;
+    }
+
+    uint8_t low[16], high[16];
+    nibbleTables(coefficient, low, high);
+    for(size_t index = 0; index < length; index++){
+        uint8_t byte = dst[index];
+        dst[index] = low[byte & 0x0F] ^ high[byte >> 4];
+    }
+}
+
+void fecEncode(const uint8_t *data, size_t data_length, size_t shard_size, size_t parity_index, uint8_t *parity){
+
+    memset(parity, 0, shard_size);
+    // The padding of the last shard is zeros: it adds nothing
+    for(size_t shard = 0; shard * shard_size < data_length; shard++){
+        size_t offset = shard * shard_size;
+        size_t length = data_length - offset < shard_size ? data_length - offset : shard_size;
+        fecMulAdd(parity, &data[offset], fecCoefficient(parity_index, shard), length);
+    }
+}
+
+bool fecRecover(uint8_t *shards, size_t shard_size, size_t data_count, const uint8_t *held){
+
+    if(data_count == 0 || data_count > FEC_MAX_SHARDS){
+        return false;
+    }
+
+    // Slots holding a parity shard instead of their data shard
+    uint8_t lost[FEC_MAX_SHARDS];
+    uint8_t parity[FEC_MAX_SHARDS];
+    size_t lost_count = 0;
+    uint32_t seen = 0;
+    for(size_t slot = 0; slot < data_count; slot++){
+        uint8_t shard = held[slot];
+        if(shard >= FEC_MAX_SHARDS || (shard < data_count && shard != slot) || (seen & (1u << shard))){
+            return false;
+        }
+        seen |= 1u << shard;
+        if(shard != slot){
+            lost[lost_count] = (uint8_t)slot;
+            parity[lost_count] = (uint8_t)(shard - data_count);
+            lost_count++;
+        }
+    }
+
+    // Take out what the data shards we hold put into each parity: what is
+    // left is a sum over the missing shards only
+    for(size_t row = 0; row < lost_count; row++){
+        uint8_t *target = &shards[lost[row] * shard_size];
+        for(size_t slot = 0; slot < data_count; slot++){
+            if(held[slot] == slot){
+                fecMulAdd(target, &shards[slot * shard_size], fecCoefficient(parity[row], slot), shard_size);
+            }
+        }
+    }
+
+    // Solve that square Cauchy system by Gauss-Jordan, applying each row
+    // operation to the shards too. Its leading minors are Cauchy matrices
+    // as well, never singular, so no pivoting is needed
+    uint8_t matrix[FEC_MAX_SHARDS][FEC_MAX_SHARDS];
+    for(size_t row = 0; row < lost_count; row++){
+        for(size_t column = 0; column < lost_count; column++){
+            matrix[row][column] = fecCoefficient(parity[row], lost[column]);
+        }
+    }
+    for(size_t pivot = 0; pivot < lost_count; pivot++){
+        if(matrix[pivot][pivot] == 0){
+            return false;
+        }
+        uint8_t *pivot_shard = &shards[lost[pivot] * shard_size];
+        uint8_t inverse = gfInverse(matrix[pivot][pivot]);
+        for(size_t column = 0; column < lost_count; column++){
+            matrix[pivot][column] = gfMul(matrix[pivot][column], inverse);
+        }
+        fecScale(pivot_shard, inverse, shard_size);
+
+        for(size_t row = 0; row < lost_count; row++){
+            uint8_t factor = matrix[row][pivot];
+            if(row == pivot || factor == 0){
+                continue;
+            }
+            for(size_t column = 0; column < lost_count; column++){
+                matrix[row][column] ^= gfMul(factor, matrix[pivot][column]);
+            }
+            fecMulAdd(&shards[lost[row] * shard_size], pivot_shard, factor, shard_size);
+        }
+    }
+    return true;
+}
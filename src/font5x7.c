@@ -0,0 +1,162 @@
+/**
+ * Datos de la fuente 5x7 (ASCII imprimible completo)
+ * --------------------------------------------------
+ *
+ * Cada glifo se escribe una sola vez como 5 columnas de 7 bits (bit 0 =
+ * fila superior). Las macros FONT5X7_* generan en tiempo de compilación
+ * las filas transpuestas y las versiones ensanchadas para escala 2 y 3,
+ * de modo que el preprocesador hace todo el trabajo y en flash queda la
+ * tabla ya lista para rasterizar.
+ */
+
+#include "font5x7.h"
+
+// Bit 'row' de la columna 'c', colocado en la posición 'col' de la fila
+#define FONT5X7_BIT(c, row, col)  ((((c) >> (row)) & 1) << (col))
+
+// Fila 'row' del glifo: bit 0 = columna izquierda
+#define FONT5X7_ROW(c0, c1, c2, c3, c4, row)                       \
+    (FONT5X7_BIT(c0, row, 0) | FONT5X7_BIT(c1, row, 1) |           \
+     FONT5X7_BIT(c2, row, 2) | FONT5X7_BIT(c3, row, 3) |           \
+     FONT5X7_BIT(c4, row, 4))
+
+// Repite cada uno de los 5 bits de una fila 2 o 3 veces seguidas
+#define FONT5X7_SPREAD(m, n, i)  ((((m) >> (i)) & 1) * (((1 << (n)) - 1) << ((i) * (n))))
+#define FONT5X7_WIDEN(m, n)                                        \
+    (FONT5X7_SPREAD(m, n, 0) | FONT5X7_SPREAD(m, n, 1) |           \
+     FONT5X7_SPREAD(m, n, 2) | FONT5X7_SPREAD(m, n, 3) |           \
+     FONT5X7_SPREAD(m, n, 4))
+
+#define FONT5X7_ROWS(c0, c1, c2, c3, c4, widen, n)                 \
+    { widen(FONT5X7_ROW(c0, c1, c2, c3, c4, 0), n),                \
+      widen(FONT5X7_ROW(c0, c1, c2, c3, c4, 1), n),                \
+      widen(FONT5X7_ROW(c0, c1, c2, c3, c4, 2), n),                \
+      widen(FONT5X7_ROW(c0, c1, c2, c3, c4, 3), n),                \
+      widen(FONT5X7_ROW(c0, c1, c2, c3, c4, 4), n),                \
+      widen(FONT5X7_ROW(c0, c1, c2, c3, c4, 5), n),                \
+      widen(FONT5X7_ROW(c0, c1, c2, c3, c4, 6), n) }
+
+#define FONT5X7_SAME(m, n)  (m)
+
+#if FONT5X7_PRESCALED
+#define FONT5X7_GLYPH(c0, c1, c2, c3, c4)                          \
+    { { c0, c1, c2, c3, c4 },                                      \
+      FONT5X7_ROWS(c0, c1, c2, c3, c4, FONT5X7_SAME, 1),           \
+      FONT5X7_ROWS(c0, c1, c2, c3, c4, FONT5X7_WIDEN, 2),          \
+      FONT5X7_ROWS(c0, c1, c2, c3, c4, FONT5X7_WIDEN, 3) }
+#else
+#define FONT5X7_GLYPH(c0, c1, c2, c3, c4)                          \
+    { { c0, c1, c2, c3, c4 },                                      \
+      FONT5X7_ROWS(c0, c1, c2, c3, c4, FONT5X7_SAME, 1) }
+#endif
+
+// Entrada de la tabla indexada por carácter
+#define FONT5X7_ENTRY(ch)  [(ch) - FONT5X7_FIRST_CHAR]
+
+const font5x7_glyph_t font5x7_glyphs[FONT5X7_NUM_GLYPHS] = {
+    // SIGNOS Y PUNTUACIÓN
+    FONT5X7_ENTRY(' ')  = FONT5X7_GLYPH(0x00, 0x00, 0x00, 0x00, 0x00),
+    FONT5X7_ENTRY('!')  = FONT5X7_GLYPH(0x00, 0x00, 0x5F, 0x00, 0x00),
+    FONT5X7_ENTRY('"')  = FONT5X7_GLYPH(0x00, 0x07, 0x00, 0x07, 0x00),
+    FONT5X7_ENTRY('#')  = FONT5X7_GLYPH(0x14, 0x7F, 0x14, 0x7F, 0x14),
+    FONT5X7_ENTRY('$')  = FONT5X7_GLYPH(0x24, 0x2A, 0x7F, 0x2A, 0x12),
+    FONT5X7_ENTRY('%')  = FONT5X7_GLYPH(0x23, 0x13, 0x08, 0x64, 0x62),
+    FONT5X7_ENTRY('&')  = FONT5X7_GLYPH(0x36, 0x49, 0x55, 0x22, 0x50),
+    FONT5X7_ENTRY('\'') = FONT5X7_GLYPH(0x00, 0x05, 0x03, 0x00, 0x00),
+    FONT5X7_ENTRY('(')  = FONT5X7_GLYPH(0x00, 0x1C, 0x22, 0x41, 0x00),
+    FONT5X7_ENTRY(')')  = FONT5X7_GLYPH(0x00, 0x41, 0x22, 0x1C, 0x00),
+    FONT5X7_ENTRY('*')  = FONT5X7_GLYPH(0x14, 0x08, 0x3E, 0x08, 0x14),
+    FONT5X7_ENTRY('+')  = FONT5X7_GLYPH(0x08, 0x08, 0x3E, 0x08, 0x08),
+    FONT5X7_ENTRY(',')  = FONT5X7_GLYPH(0x00, 0x50, 0x30, 0x00, 0x00),
+    FONT5X7_ENTRY('-')  = FONT5X7_GLYPH(0x08, 0x08, 0x08, 0x08, 0x08),
+    FONT5X7_ENTRY('.')  = FONT5X7_GLYPH(0x00, 0x40, 0x60, 0x00, 0x00),
+    FONT5X7_ENTRY('/')  = FONT5X7_GLYPH(0x20, 0x10, 0x08, 0x04, 0x02),
+
+    // DÍGITOS 0-9
+    FONT5X7_ENTRY('0')  = FONT5X7_GLYPH(0x3E, 0x51, 0x49, 0x45, 0x3E),
+    FONT5X7_ENTRY('1')  = FONT5X7_GLYPH(0x00, 0x42, 0x7F, 0x40, 0x00),
+    FONT5X7_ENTRY('2')  = FONT5X7_GLYPH(0x42, 0x61, 0x51, 0x49, 0x46),
+    FONT5X7_ENTRY('3')  = FONT5X7_GLYPH(0x21, 0x41, 0x45, 0x4B, 0x31),
+    FONT5X7_ENTRY('4')  = FONT5X7_GLYPH(0x18, 0x14, 0x12, 0x7F, 0x10),
+    FONT5X7_ENTRY('5')  = FONT5X7_GLYPH(0x27, 0x45, 0x45, 0x45, 0x39),
+    FONT5X7_ENTRY('6')  = FONT5X7_GLYPH(0x3C, 0x4A, 0x49, 0x49, 0x30),
+    FONT5X7_ENTRY('7')  = FONT5X7_GLYPH(0x01, 0x71, 0x09, 0x05, 0x03),
+    FONT5X7_ENTRY('8')  = FONT5X7_GLYPH(0x36, 0x49, 0x49, 0x49, 0x36),
+    FONT5X7_ENTRY('9')  = FONT5X7_GLYPH(0x06, 0x49, 0x49, 0x29, 0x1E),
+
+    FONT5X7_ENTRY(':')  = FONT5X7_GLYPH(0x00, 0x36, 0x36, 0x00, 0x00),
+    FONT5X7_ENTRY(';')  = FONT5X7_GLYPH(0x00, 0x56, 0x36, 0x00, 0x00),
+    FONT5X7_ENTRY('<')  = FONT5X7_GLYPH(0x08, 0x14, 0x22, 0x41, 0x00),
+    FONT5X7_ENTRY('=')  = FONT5X7_GLYPH(0x14, 0x14, 0x14, 0x14, 0x14),
+    FONT5X7_ENTRY('>')  = FONT5X7_GLYPH(0x00, 0x41, 0x22, 0x14, 0x08),
+    FONT5X7_ENTRY('?')  = FONT5X7_GLYPH(0x02, 0x01, 0x51, 0x09, 0x06),
+    FONT5X7_ENTRY('@')  = FONT5X7_GLYPH(0x32, 0x49, 0x79, 0x41, 0x3E),
+
+    // MAYÚSCULAS
+    FONT5X7_ENTRY('A')  = FONT5X7_GLYPH(0x7E, 0x11, 0x11, 0x11, 0x7E),
+    FONT5X7_ENTRY('B')  = FONT5X7_GLYPH(0x7F, 0x49, 0x49, 0x49, 0x36),
+    FONT5X7_ENTRY('C')  = FONT5X7_GLYPH(0x3E, 0x41, 0x41, 0x41, 0x22),
+    FONT5X7_ENTRY('D')  = FONT5X7_GLYPH(0x7F, 0x41, 0x41, 0x22, 0x1C),
+    FONT5X7_ENTRY('E')  = FONT5X7_GLYPH(0x7F, 0x49, 0x49, 0x49, 0x41),
+    FONT5X7_ENTRY('F')  = FONT5X7_GLYPH(0x7F, 0x09, 0x09, 0x09, 0x01),
+    FONT5X7_ENTRY('G')  = FONT5X7_GLYPH(0x3E, 0x41, 0x49, 0x49, 0x7A),
+    FONT5X7_ENTRY('H')  = FONT5X7_GLYPH(0x7F, 0x08, 0x08, 0x08, 0x7F),
+    FONT5X7_ENTRY('I')  = FONT5X7_GLYPH(0x00, 0x41, 0x7F, 0x41, 0x00),
+    FONT5X7_ENTRY('J')  = FONT5X7_GLYPH(0x20, 0x40, 0x41, 0x3F, 0x01),
+    FONT5X7_ENTRY('K')  = FONT5X7_GLYPH(0x7F, 0x08, 0x14, 0x22, 0x41),
+    FONT5X7_ENTRY('L')  = FONT5X7_GLYPH(0x7F, 0x40, 0x40, 0x40, 0x40),
+    FONT5X7_ENTRY('M')  = FONT5X7_GLYPH(0x7F, 0x02, 0x0C, 0x02, 0x7F),
+    FONT5X7_ENTRY('N')  = FONT5X7_GLYPH(0x7F, 0x04, 0x08, 0x10, 0x7F),
+    FONT5X7_ENTRY('O')  = FONT5X7_GLYPH(0x3E, 0x41, 0x41, 0x41, 0x3E),
+    FONT5X7_ENTRY('P')  = FONT5X7_GLYPH(0x7F, 0x09, 0x09, 0x09, 0x06),
+    FONT5X7_ENTRY('Q')  = FONT5X7_GLYPH(0x3E, 0x41, 0x51, 0x21, 0x5E),
+    FONT5X7_ENTRY('R')  = FONT5X7_GLYPH(0x7F, 0x09, 0x19, 0x29, 0x46),
+    FONT5X7_ENTRY('S')  = FONT5X7_GLYPH(0x46, 0x49, 0x49, 0x49, 0x31),
+    FONT5X7_ENTRY('T')  = FONT5X7_GLYPH(0x01, 0x01, 0x7F, 0x01, 0x01),
+    FONT5X7_ENTRY('U')  = FONT5X7_GLYPH(0x3F, 0x40, 0x40, 0x40, 0x3F),
+    FONT5X7_ENTRY('V')  = FONT5X7_GLYPH(0x1F, 0x20, 0x40, 0x20, 0x1F),
+    FONT5X7_ENTRY('W')  = FONT5X7_GLYPH(0x3F, 0x40, 0x38, 0x40, 0x3F),
+    FONT5X7_ENTRY('X')  = FONT5X7_GLYPH(0x63, 0x14, 0x08, 0x14, 0x63),
+    FONT5X7_ENTRY('Y')  = FONT5X7_GLYPH(0x07, 0x08, 0x70, 0x08, 0x07),
+    FONT5X7_ENTRY('Z')  = FONT5X7_GLYPH(0x61, 0x51, 0x49, 0x45, 0x43),
+
+    FONT5X7_ENTRY('[')  = FONT5X7_GLYPH(0x00, 0x7F, 0x41, 0x41, 0x00),
+    FONT5X7_ENTRY('\\') = FONT5X7_GLYPH(0x02, 0x04, 0x08, 0x10, 0x20),
+    FONT5X7_ENTRY(']')  = FONT5X7_GLYPH(0x00, 0x41, 0x41, 0x7F, 0x00),
+    FONT5X7_ENTRY('^')  = FONT5X7_GLYPH(0x04, 0x02, 0x01, 0x02, 0x04),
+    FONT5X7_ENTRY('_')  = FONT5X7_GLYPH(0x40, 0x40, 0x40, 0x40, 0x40),
+    FONT5X7_ENTRY('`')  = FONT5X7_GLYPH(0x00, 0x01, 0x02, 0x04, 0x00),
+
+    // MINÚSCULAS
+    FONT5X7_ENTRY('a')  = FONT5X7_GLYPH(0x20, 0x54, 0x54, 0x54, 0x78),
+    FONT5X7_ENTRY('b')  = FONT5X7_GLYPH(0x7F, 0x48, 0x44, 0x44, 0x38),
+    FONT5X7_ENTRY('c')  = FONT5X7_GLYPH(0x38, 0x44, 0x44, 0x44, 0x20),
+    FONT5X7_ENTRY('d')  = FONT5X7_GLYPH(0x38, 0x44, 0x44, 0x48, 0x7F),
+    FONT5X7_ENTRY('e')  = FONT5X7_GLYPH(0x38, 0x54, 0x54, 0x54, 0x18),
+    FONT5X7_ENTRY('f')  = FONT5X7_GLYPH(0x08, 0x7E, 0x09, 0x01, 0x02),
+    FONT5X7_ENTRY('g')  = FONT5X7_GLYPH(0x0C, 0x52, 0x52, 0x52, 0x3E),
+    FONT5X7_ENTRY('h')  = FONT5X7_GLYPH(0x7F, 0x08, 0x04, 0x04, 0x78),
+    FONT5X7_ENTRY('i')  = FONT5X7_GLYPH(0x00, 0x44, 0x7D, 0x40, 0x00),
+    FONT5X7_ENTRY('j')  = FONT5X7_GLYPH(0x20, 0x40, 0x44, 0x3D, 0x00),
+    FONT5X7_ENTRY('k')  = FONT5X7_GLYPH(0x7F, 0x10, 0x28, 0x44, 0x00),
+    FONT5X7_ENTRY('l')  = FONT5X7_GLYPH(0x00, 0x41, 0x7F, 0x40, 0x00),
+    FONT5X7_ENTRY('m')  = FONT5X7_GLYPH(0x7C, 0x04, 0x18, 0x04, 0x78),
+    FONT5X7_ENTRY('n')  = FONT5X7_GLYPH(0x7C, 0x08, 0x04, 0x04, 0x78),
+    FONT5X7_ENTRY('o')  = FONT5X7_GLYPH(0x38, 0x44, 0x44, 0x44, 0x38),
+    FONT5X7_ENTRY('p')  = FONT5X7_GLYPH(0x7C, 0x14, 0x14, 0x14, 0x08),
+    FONT5X7_ENTRY('q')  = FONT5X7_GLYPH(0x08, 0x14, 0x14, 0x18, 0x7C),
+    FONT5X7_ENTRY('r')  = FONT5X7_GLYPH(0x7C, 0x08, 0x04, 0x04, 0x08),
+    FONT5X7_ENTRY('s')  = FONT5X7_GLYPH(0x48, 0x54, 0x54, 0x54, 0x20),
+    FONT5X7_ENTRY('t')  = FONT5X7_GLYPH(0x04, 0x3F, 0x44, 0x40, 0x20),
+    FONT5X7_ENTRY('u')  = FONT5X7_GLYPH(0x3C, 0x40, 0x40, 0x20, 0x7C),
+    FONT5X7_ENTRY('v')  = FONT5X7_GLYPH(0x1C, 0x20, 0x40, 0x20, 0x1C),
+    FONT5X7_ENTRY('w')  = FONT5X7_GLYPH(0x3C, 0x40, 0x30, 0x40, 0x3C),
+    FONT5X7_ENTRY('x')  = FONT5X7_GLYPH(0x44, 0x28, 0x10, 0x28, 0x44),
+    FONT5X7_ENTRY('y')  = FONT5X7_GLYPH(0x0C, 0x50, 0x50, 0x50, 0x3C),
+    FONT5X7_ENTRY('z')  = FONT5X7_GLYPH(0x44, 0x64, 0x54, 0x4C, 0x44),
+
+    FONT5X7_ENTRY('{')  = FONT5X7_GLYPH(0x00, 0x08, 0x36, 0x41, 0x00),
+    FONT5X7_ENTRY('|')  = FONT5X7_GLYPH(0x00, 0x00, 0x7F, 0x00, 0x00),
+    FONT5X7_ENTRY('}')  = FONT5X7_GLYPH(0x00, 0x41, 0x36, 0x08, 0x00),
+    FONT5X7_ENTRY('~')  = FONT5X7_GLYPH(0x08, 0x04, 0x08, 0x10, 0x08),
+};
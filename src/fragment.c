@@ -0,0 +1,528 @@
+#include <string.h>
+#include "fragment.h"
+#include "sha256.h"
+
+#define ALL_FRAGMENTS(count) ((uint16_t)((1u << (count)) - 1))
+
+// Keeps the ACK MAC apart from every other HMAC under the same key
+static const char ACK_LABEL[] = "fragment ack";
+
+static unsigned countBits(uint16_t bitmap){
+
+    unsigned count = 0;
+    for(; bitmap != 0; bitmap &= (uint16_t)(bitmap - 1)){
+        count++;
+    }
+    return count;
+}
+
+// Largest chunk behind a fragment header of header_size bytes
+static size_t chunkCapacity(const packet_header *message_header, size_t max_frame_size, size_t header_size){
+
+    // Fragment header with the largest payload length it could carry
+    packet_header header = *message_header;
+    size_t overhead = packetHeaderSize(&header, max_frame_size) + header_size + PACKET_CRC_SIZE;
+    if(max_frame_size <= overhead){
+        return 0;
+    }
+    size_t chunk_size = max_frame_size - overhead;
+    return chunk_size > 255 ? 255 : chunk_size; // travels in one byte
+}
+
+size_t fragmentChunkSize(const uint8_t *message_frame, size_t message_length, size_t max_frame_size){
+
+    packet_view view;
+    if(packetDecode(message_frame, message_length, &view) != PACKET_OK){
+        return 0;
+    }
+    return chunkCapacity(&view.header, max_frame_size, FRAGMENT_HEADER_SIZE);
+}
+
+int fragmentSenderStart(fragment_sender *sender, const uint8_t *message_frame, size_t message_length,
+                        size_t max_frame_size, size_t parity_count){
+
+    if(sender->state == FRAGMENT_SENDING || sender->state == FRAGMENT_WAITING_ACK){
+        return FRAGMENT_ERROR_BUSY;
+    }
+
+    packet_view view;
+    int error = packetDecode(message_frame, message_length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    if(message_length > sizeof(sender->message)){
+        return FRAGMENT_ERROR_TOO_LARGE;
+    }
+
+    size_t chunk_size = chunkCapacity(&view.header, max_frame_size, FRAGMENT_HEADER_SIZE);
+    if(chunk_size == 0){
+        return FRAGMENT_ERROR_TOO_LARGE;
+    }
+    size_t count = (message_length + chunk_size - 1) / chunk_size;
+    if(count > FRAGMENT_MAX_COUNT){
+        return FRAGMENT_ERROR_TOO_LARGE;
+    }
+    size_t data_count = count;
+
+    // With parity the header grows by two bytes, which may take one more
+    // data fragment; the chunk is then evened out over the data fragments
+    if(parity_count > 0 && count >= 2){
+        size_t fec_chunk_size = chunkCapacity(&view.header, max_frame_size, FRAGMENT_FEC_HEADER_SIZE);
+        size_t fec_data_count = fec_chunk_size > 0 ? (message_length + fec_chunk_size - 1) / fec_chunk_size : 0;
+        if(fec_data_count >= 2 && fec_data_count < FRAGMENT_MAX_COUNT){
+            data_count = fec_data_count;
+            chunk_size = (message_length + data_count - 1) / data_count;
+            size_t room = FRAGMENT_MAX_COUNT - data_count;
+            count = data_count + (parity_count < room ? parity_count : room);
+        }
+    }
+
+    // Same ids and sequence as the message: the sequence names the message
+    // in its fragments and ACKs
+    sender->header = view.header;
+    sender->header.packet_type = PACKET_TYPE_FRAGMENT;
+    sender->header.flags = count > data_count ? PACKET_FLAG_FEC : PACKET_FLAG_NONE;
+
+    memcpy(sender->message, message_frame, message_length);
+    sender->message_length = message_length;
+    sender->chunk_size = (uint8_t)chunk_size;
+    sender->count = (uint8_t)count;
+    sender->data_count = (uint8_t)data_count;
+    sender->acknowledged = 0;
+    sender->sent = 0;
+    sender->round_pending = ALL_FRAGMENTS(count);
+    sender->round_sent = 0;
+    sender->rounds = 0;
+    sender->ack_deadline_us = 0;
+    sender->state = FRAGMENT_SENDING;
+    return FRAGMENT_OK;
+}
+
+bool fragmentSenderNext(fragment_sender *sender, uint8_t *frame, size_t frame_size, size_t *frame_length){
+
+    if(sender->state != FRAGMENT_SENDING || sender->round_pending == 0){
+        return false;
+    }
+
+    uint8_t index = 0;
+    while((sender->round_pending & (1u << index)) == 0){
+        index++;
+    }
+    sender->round_pending &= (uint16_t)~(1u << index);
+
+    // Parity fragments are whole chunks, encoded straight into the frame
+    bool parity = index >= sender->data_count;
+    size_t offset = (size_t)index * sender->chunk_size;
+    size_t chunk_length = sender->chunk_size;
+    if(!parity && sender->message_length - offset < chunk_length){
+        chunk_length = sender->message_length - offset;
+    }
+
+    packet_header header = sender->header;
+    if(sender->round_pending == 0){
+        header.flags |= PACKET_FLAG_ACK_REQUEST;
+    }
+    bool fec = (header.flags & PACKET_FLAG_FEC) != 0;
+    size_t fragment_header_size = fec ? FRAGMENT_FEC_HEADER_SIZE : FRAGMENT_HEADER_SIZE;
+
+    size_t header_length = 0;
+    if(packetWriteHeader(&header, fragment_header_size + chunk_length, frame, frame_size, &header_length) != PACKET_OK){
+        return false;
+    }
+    frame[header_length] = (uint8_t)((index << 4) | (sender->count - 1));
+    frame[header_length + 1] = sender->chunk_size;
+    if(fec){
+        frame[header_length + 2] = sender->data_count;
+        frame[header_length + 3] = (uint8_t)(sender->message_length - (size_t)(sender->data_count - 1) * sender->chunk_size);
+    }
+    uint8_t *chunk = &frame[header_length + fragment_header_size];
+    if(parity){
+        fecEncode(sender->message, sender->message_length, sender->chunk_size, index - sender->data_count, chunk);
+    } else {
+        memcpy(chunk, &sender->message[offset], chunk_length);
+    }
+    *frame_length = packetWriteCrc(frame, header_length + fragment_header_size + chunk_length);
+
+    sender->stats.fragments_sent++;
+    if(sender->sent & (1u << index)){
+        sender->stats.retransmissions++;
+    }
+    sender->sent |= (uint16_t)(1u << index);
+    sender->round_sent |= (uint16_t)(1u << index);
+
+    if(sender->round_pending == 0){
+        sender->state = FRAGMENT_WAITING_ACK;
+    }
+    return true;
+}
+
+// Enough of the fragments arrived to rebuild the message
+static bool delivered(const fragment_sender *sender){
+
+    uint16_t all = ALL_FRAGMENTS(sender->count);
+    if(sender->count == sender->data_count){
+        return sender->acknowledged == all;
+    }
+    return countBits(sender->acknowledged & all) >= sender->data_count;
+}
+
+// With parity any fragments will do: only as many missing ones as are still short
+static uint16_t stillNeeded(const fragment_sender *sender){
+
+    uint16_t missing = ALL_FRAGMENTS(sender->count) & (uint16_t)~sender->acknowledged;
+    if(sender->count == sender->data_count){
+        return missing;
+    }
+    unsigned short_by = sender->data_count - countBits(sender->acknowledged & ALL_FRAGMENTS(sender->count));
+    uint16_t needed = 0;
+    for(uint16_t bit = 1; short_by > 0 && missing != 0; bit <<= 1){
+        if(missing & bit){
+            needed |= bit;
+            missing &= (uint16_t)~bit;
+            short_by--;
+        }
+    }
+    return needed;
+}
+
+// Next round with whatever is still missing, or give up
+static int startRound(fragment_sender *sender, uint16_t fragments){
+
+    sender->rounds++;
+    if(sender->rounds >= FRAGMENT_MAX_ROUNDS){
+        sender->state = FRAGMENT_FAILED;
+        sender->stats.messages_failed++;
+        return FRAGMENT_ERROR_GAVE_UP;
+    }
+    sender->round_pending = fragments;
+    sender->round_sent = 0;
+    sender->state = FRAGMENT_SENDING;
+    return FRAGMENT_OK;
+}
+
+static void writeLittleEndian32(uint8_t *bytes, uint32_t value){
+
+    for(int byte = 0; byte < 4; byte++){
+        bytes[byte] = (uint8_t)(value >> (8 * byte));
+    }
+}
+
+// MAC of an ACK from transmitter_id to receiver_id; zeros without a key
+static void ackMac(const uint8_t *key, uint32_t transmitter_id, uint32_t receiver_id, uint32_t sequence,
+                   uint16_t bitmap, uint8_t mac[PACKET_ACK_MAC_SIZE]){
+
+    if(key == NULL){
+        memset(mac, 0, PACKET_ACK_MAC_SIZE);
+        return;
+    }
+
+    uint8_t data[sizeof(ACK_LABEL) - 1 + 3 * 4 + PACKET_ACK_BITMAP_SIZE];
+    size_t length = sizeof(ACK_LABEL) - 1;
+    memcpy(data, ACK_LABEL, length);
+    writeLittleEndian32(&data[length], transmitter_id);
+    writeLittleEndian32(&data[length + 4], receiver_id);
+    writeLittleEndian32(&data[length + 8], sequence);
+    length += 3 * 4;
+    data[length++] = (uint8_t)bitmap;
+    data[length++] = (uint8_t)(bitmap >> 8);
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    hmacSha256(key, FRAGMENT_ACK_KEY_SIZE, data, length, digest);
+    memcpy(mac, digest, PACKET_ACK_MAC_SIZE);
+}
+
+static bool macEqual(const uint8_t *first, const uint8_t *second){
+
+    uint8_t difference = 0;
+    for(size_t index = 0; index < PACKET_ACK_MAC_SIZE; index++){
+        difference |= first[index] ^ second[index];
+    }
+    return difference == 0;
+}
+
+int fragmentSenderHandleAck(fragment_sender *sender, const uint8_t *frame, size_t frame_length){
+
+    packet_view view;
+    int error = packetDecode(frame, frame_length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    if(view.header.packet_type != PACKET_TYPE_ACK){
+        return FRAGMENT_ERROR_WRONG_TYPE;
+    }
+    if(view.payload_length != FRAGMENT_ACK_PAYLOAD_SIZE){
+        return FRAGMENT_ERROR_MALFORMED;
+    }
+    uint16_t bitmap = (uint16_t)(view.payload[0] | (view.payload[1] << 8));
+    return fragmentSenderApplyAck(sender, &view.header, view.header.sequence, bitmap,
+                                  &view.payload[PACKET_ACK_BITMAP_SIZE]);
+}
+
+int fragmentSenderApplyAck(fragment_sender *sender, const packet_header *from, uint32_t sequence, uint16_t bitmap,
+                           const uint8_t mac[PACKET_ACK_MAC_SIZE]){
+
+    // A late ACK of an earlier message is not an error worth reporting
+    // upstream, but it must not touch the current one
+    if((sender->state != FRAGMENT_SENDING && sender->state != FRAGMENT_WAITING_ACK) ||
+       from->transmitter_id != sender->header.receiver_id ||
+       from->receiver_id != sender->header.transmitter_id ||
+       sequence != sender->header.sequence){
+        return FRAGMENT_ERROR_NOT_OURS;
+    }
+    if(sender->ack_key != NULL){
+        uint8_t expected[PACKET_ACK_MAC_SIZE];
+        ackMac(sender->ack_key, from->transmitter_id, from->receiver_id, sequence, bitmap, expected);
+        if(!macEqual(expected, mac)){
+            sender->stats.acks_forged++;
+            return FRAGMENT_ERROR_FORGED;
+        }
+    }
+
+    uint16_t all = ALL_FRAGMENTS(sender->count);
+    sender->acknowledged |= bitmap & all;
+    sender->stats.acks_received++;
+
+    if(delivered(sender)){
+        sender->state = FRAGMENT_DELIVERED;
+        sender->round_pending = 0;
+        sender->stats.messages_delivered++;
+        return FRAGMENT_OK;
+    }
+
+    // Still sending this round: just skip what already arrived
+    if(sender->state == FRAGMENT_SENDING){
+        sender->round_pending &= (uint16_t)~sender->acknowledged;
+        if(sender->round_pending != 0){
+            return FRAGMENT_OK;
+        }
+    }
+    return startRound(sender, stillNeeded(sender));
+}
+
+int fragmentSenderTimeout(fragment_sender *sender){
+
+    if(sender->state != FRAGMENT_WAITING_ACK){
+        return FRAGMENT_OK;
+    }
+    sender->stats.timeouts++;
+
+    // Probe with the highest missing fragment: cheap if only the ACK was
+    // lost, and its ACK lists anything else that is missing
+    uint16_t missing = ALL_FRAGMENTS(sender->count) & (uint16_t)~sender->acknowledged;
+    uint16_t probe = 0x8000;
+    while((missing & probe) == 0){
+        probe >>= 1;
+    }
+    return startRound(sender, probe);
+}
+
+void fragmentReassemblerInit(fragment_reassembler *reassembler, uint32_t local_id){
+
+    memset(reassembler, 0, sizeof(*reassembler));
+    reassembler->local_id = local_id;
+}
+
+// Buffer for this peer: its own, a free one, or the oldest idle one
+static fragment_entry *findEntry(fragment_reassembler *reassembler, uint32_t peer_id, int64_t now_us){
+
+    fragment_entry *oldest = NULL;
+
+    for(int index = 0; index < FRAGMENT_MAX_PEERS; index++){
+        fragment_entry *entry = &reassembler->entries[index];
+        if(entry->in_use && entry->peer_id == peer_id){
+            return entry;
+        }
+    }
+    for(int index = 0; index < FRAGMENT_MAX_PEERS; index++){
+        fragment_entry *entry = &reassembler->entries[index];
+        if(!entry->in_use){
+            return entry;
+        }
+        if(oldest == NULL || entry->last_us < oldest->last_us){
+            oldest = entry;
+        }
+    }
+
+    // Completed messages only linger to re-ACK duplicates: fair game
+    if(oldest->complete || now_us - oldest->last_us >= FRAGMENT_REASSEMBLY_TIMEOUT_US){
+        oldest->in_use = false;
+        reassembler->stats.evictions++;
+        return oldest;
+    }
+    return NULL;
+}
+
+static int writeAck(fragment_reassembler *reassembler, const fragment_entry *entry,
+                    uint8_t *ack, size_t ack_size, size_t *ack_length){
+
+    packet_header header = {
+        .version = PACKET_VERSION,
+        .packet_type = PACKET_TYPE_ACK,
+        .flags = PACKET_FLAG_NONE,
+        .transmitter_id = reassembler->local_id,
+        .receiver_id = entry->peer_id,
+        .sequence = entry->sequence,
+    };
+    uint8_t payload[FRAGMENT_ACK_PAYLOAD_SIZE] = { (uint8_t)entry->received, (uint8_t)(entry->received >> 8) };
+    ackMac(reassembler->ack_key, header.transmitter_id, header.receiver_id, header.sequence, entry->received,
+           &payload[PACKET_ACK_BITMAP_SIZE]);
+
+    int error = packetEncode(&header, payload, sizeof(payload), ack, ack_size, ack_length);
+    if(error == PACKET_OK){
+        reassembler->stats.acks_sent++;
+    }
+    return error;
+}
+
+/*
+ * FEC: a data fragment goes to its own chunk, a parity one to the chunk of
+ * a missing data fragment, which fecRecover rebuilds from it. A parity
+ * fragment in the way of a late data fragment moves to another free chunk
+ * (there is one until the message is complete).
+ */
+static void storeShard(fragment_entry *entry, uint8_t index, const uint8_t *chunk, size_t chunk_length){
+
+    size_t chunk_size = entry->chunk_size;
+    uint8_t slot = index;
+    if(index >= entry->data_count || (entry->slots & (1u << index))){
+        uint8_t free_slot = 0;
+        while(entry->slots & (1u << free_slot)){
+            free_slot++;
+        }
+        if(index < entry->data_count){
+            memcpy(&entry->data[free_slot * chunk_size], &entry->data[index * chunk_size], chunk_size);
+            entry->held[free_slot] = entry->held[index];
+            entry->slots |= (uint16_t)(1u << free_slot);
+        } else {
+            slot = free_slot;
+        }
+    }
+    memcpy(&entry->data[slot * chunk_size], chunk, chunk_length);
+    memset(&entry->data[slot * chunk_size + chunk_length], 0, chunk_size - chunk_length);
+    entry->held[slot] = index;
+    entry->slots |= (uint16_t)(1u << slot);
+}
+
+int fragmentReceive(fragment_reassembler *reassembler, const uint8_t *frame, size_t frame_length, int64_t now_us,
+                    uint8_t *message, size_t message_size, size_t *message_length,
+                    uint8_t *ack, size_t ack_size, size_t *ack_length){
+
+    *message_length = 0;
+    *ack_length = 0;
+
+    packet_view view;
+    int error = packetDecode(frame, frame_length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    if(view.header.packet_type != PACKET_TYPE_FRAGMENT){
+        return FRAGMENT_ERROR_WRONG_TYPE;
+    }
+    if(view.header.receiver_id != reassembler->local_id){
+        return FRAGMENT_ERROR_NOT_OURS;
+    }
+    bool fec = (view.header.flags & PACKET_FLAG_FEC) != 0;
+    size_t fragment_header_size = fec ? FRAGMENT_FEC_HEADER_SIZE : FRAGMENT_HEADER_SIZE;
+    if(view.payload_length <= fragment_header_size){
+        return FRAGMENT_ERROR_MALFORMED;
+    }
+
+    uint8_t index = view.payload[0] >> 4;
+    uint8_t count = (uint8_t)((view.payload[0] & 0x0F) + 1);
+    uint8_t chunk_size = view.payload[1];
+    uint8_t data_count = fec ? view.payload[2] : count;
+    const uint8_t *chunk = &view.payload[fragment_header_size];
+    size_t chunk_length = view.payload_length - fragment_header_size;
+
+    bool last = (index == data_count - 1);
+    size_t last_length = 0;
+    if(index >= count || chunk_size == 0){
+        return FRAGMENT_ERROR_MALFORMED;
+    }
+    if(fec){
+        // Parity fragments sit past the message: only the data ones must fit in it
+        last_length = view.payload[3];
+        if(data_count < 2 || data_count >= count || last_length == 0 || last_length > chunk_size ||
+           (size_t)data_count * chunk_size > FRAGMENT_REASSEMBLY_SIZE ||
+           (size_t)(data_count - 1) * chunk_size + last_length > PACKET_MAX_MESSAGE_SIZE ||
+           chunk_length != (last ? last_length : chunk_size)){
+            return FRAGMENT_ERROR_MALFORMED;
+        }
+    } else if((last ? chunk_length > chunk_size : chunk_length != chunk_size) ||
+              (size_t)(count - 1) * chunk_size >= PACKET_MAX_MESSAGE_SIZE ||
+              (size_t)index * chunk_size + chunk_length > PACKET_MAX_MESSAGE_SIZE){
+        return FRAGMENT_ERROR_MALFORMED;
+    }
+
+    fragment_entry *entry = findEntry(reassembler, view.header.transmitter_id, now_us);
+    if(entry == NULL){
+        reassembler->stats.dropped++;
+        return FRAGMENT_ERROR_NO_BUFFER;
+    }
+
+    // Another sequence from this peer: it moved on to a new message
+    if(!entry->in_use || entry->sequence != view.header.sequence){
+        entry->in_use = true;
+        entry->complete = false;
+        entry->peer_id = view.header.transmitter_id;
+        entry->sequence = view.header.sequence;
+        entry->count = count;
+        entry->data_count = data_count;
+        entry->chunk_size = chunk_size;
+        entry->received = 0;
+        entry->slots = 0;
+        entry->last_length = last_length;
+    } else if(entry->count != count || entry->data_count != data_count || entry->chunk_size != chunk_size ||
+              (fec && entry->last_length != last_length)){
+        return FRAGMENT_ERROR_MALFORMED;
+    }
+    entry->last_us = now_us;
+    reassembler->stats.fragments_received++;
+
+    // Already delivered: the sender missed our ACK, tell it again. With
+    // parity the rest of the round follows anyway: answer its end only
+    if(entry->complete){
+        reassembler->stats.duplicates++;
+        if(fec && !(view.header.flags & PACKET_FLAG_ACK_REQUEST)){
+            return FRAGMENT_OK;
+        }
+        return writeAck(reassembler, entry, ack, ack_size, ack_length);
+    }
+
+    if(entry->received & (1u << index)){
+        reassembler->stats.duplicates++;
+    } else if(fec){
+        storeShard(entry, index, chunk, chunk_length);
+        entry->received |= (uint16_t)(1u << index);
+    } else {
+        memcpy(&entry->data[(size_t)index * chunk_size], chunk, chunk_length);
+        entry->received |= (uint16_t)(1u << index);
+        if(last){
+            entry->last_length = chunk_length;
+        }
+    }
+
+    // With parity any data-count fragments will do
+    bool rebuilt = fec ? countBits(entry->slots) == data_count : entry->received == ALL_FRAGMENTS(count);
+    if(rebuilt){
+        size_t length = (size_t)(data_count - 1) * chunk_size + entry->last_length;
+        if(length > message_size){
+            return PACKET_ERROR_BUFFER_TOO_SMALL;
+        }
+        if(fec && entry->received != entry->slots){ // a parity fragment among them
+            if(!fecRecover(entry->data, chunk_size, data_count, entry->held)){
+                return FRAGMENT_ERROR_MALFORMED;
+            }
+            reassembler->stats.recovered++;
+        }
+        memcpy(message, entry->data, length);
+        *message_length = length;
+        entry->complete = true;
+        reassembler->stats.messages_reassembled++;
+    }
+
+    if((entry->complete && !fec) || (view.header.flags & PACKET_FLAG_ACK_REQUEST)){
+        return writeAck(reassembler, entry, ack, ack_size, ack_length);
+    }
+    return FRAGMENT_OK;
+}
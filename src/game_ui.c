@@ -0,0 +1,181 @@
+/**
+ * Pantallas de Stratagem Hero (MVP)
+ * ---------------------------------
+ *
+ * Funciones de dibujo del minijuego. Solo usan la API pública del driver
+ * ILI9341, así que compilan igual para el ESP32 y para el emulador de
+ * host (ver ili9341_sim.h).
+ */
+
+#include <string.h>
+
+#include "game_ui.h"
+#include "text_label.h"
+
+// Etiquetas de la pantalla de input: solo repintan los caracteres que
+// cambian entre una llamada y la siguiente
+static text_label_t game_input_label;
+static text_label_t game_timer_label;
+
+// -----------------------------------------------------------------------------
+//  PROTOTIPOS de funciones internas
+// -----------------------------------------------------------------------------
+
+static void game_draw_sequence(Direction *seq, int length);
+static const char *direction_to_char(Direction d);
+
+// -----------------------------------------------------------------------------
+//  IMPLEMENTACIÓN: DIBUJO DE UI DEL JUEGO SOBRE ILI9341
+// -----------------------------------------------------------------------------
+
+/**
+ * Dibuja la pantalla de menú inicial:
+ *  - Título del juego.
+ *  - Instrucciones mínimas.
+ */
+void game_draw_menu_screen(void)
+{
+    ili9341_fill_screen(COLOR_BG);
+
+    int y = 20;
+    ili9341_draw_string(10, y, "STRATAGEM HERO", COLOR_INFO, COLOR_BG, 2); y += TEXT_LINE_HEIGHT * 2;
+    ili9341_draw_string(10, y, "MVP ESP32 + ILI9341", COLOR_TEXT, COLOR_BG, 1); y += TEXT_LINE_HEIGHT * 2;
+
+    ili9341_draw_string(10, y, "Pulsa cualquier flecha", COLOR_TEXT, COLOR_BG, 1); y += TEXT_LINE_HEIGHT;
+    ili9341_draw_string(10, y, "para empezar", COLOR_TEXT, COLOR_BG, 1);
+}
+
+/**
+ * Dibuja la secuencia de direcciones generada (como letras U, D, L, R)
+ * en una única línea, separadas por un espacio (igual que el progreso en
+ * la pantalla de input).
+ */
+static void game_draw_sequence(Direction *seq, int length)
+{
+    int y = 10 + TEXT_LINE_HEIGHT * 2;  // debajo de "SECUENCIA:"
+
+    char text[TEXT_LABEL_MAX_CHARS + 1];
+    int len = 0;
+    for (int i = 0; i < length && len + 1 < TEXT_LABEL_MAX_CHARS; i++) {
+        if (i > 0) text[len++] = ' ';
+        text[len++] = direction_to_char(seq[i])[0];
+    }
+    text[len] = '\0';
+
+    ili9341_draw_string(10, y, text, COLOR_TEXT, COLOR_BG, 2);
+}
+
+/**
+ * Pantalla de memorización: cabecera y secuencia.
+ */
+void game_draw_show_sequence_screen(Direction *seq, int length)
+{
+    ili9341_fill_screen(COLOR_BG);
+
+    // Texto cabecera
+    ili9341_draw_string(10, 10, "SECUENCIA:", COLOR_INFO, COLOR_BG, 2);
+
+    // Dibuja la secuencia como letras U, D, L, R
+    game_draw_sequence(seq, length);
+}
+
+/**
+ * Pantalla de input: se limpia la secuencia y se muestran las cabeceras.
+ */
+void game_draw_input_screen(void)
+{
+    ili9341_fill_screen(COLOR_BG);
+    ili9341_draw_string(10, 10, "INTRODUCE LA SECUENCIA", COLOR_INFO, COLOR_BG, 2);
+    ili9341_draw_string(10, 10 + TEXT_LINE_HEIGHT * 2, "TU INPUT:", COLOR_TEXT, COLOR_BG, 2);
+
+    // La pantalla acaba de borrarse: las etiquetas empiezan vacías
+    text_label_init(&game_input_label, 10, 10 + TEXT_LINE_HEIGHT * 3,
+                    TEXT_LABEL_MAX_CHARS, 2, COLOR_BG);
+    text_label_init(&game_timer_label, 10, ILI9341_HEIGHT - TEXT_LINE_HEIGHT * 2,
+                    TEXT_LABEL_MAX_CHARS, 2, COLOR_BG);
+}
+
+/**
+ * Dibuja el progreso del jugador en la línea "TU INPUT:".
+ * Muestra todas las flechas de la secuencia (separadas por un espacio),
+ * y pinta en verde las que ya se han introducido correctamente. Con cada
+ * paso acertado solo se repinta la flecha que cambia de color.
+ */
+void game_draw_input_progress(Direction *seq, int length, int current_index)
+{
+    char text[TEXT_LABEL_MAX_CHARS + 1];
+    uint16_t colors[TEXT_LABEL_MAX_CHARS];
+    int len = 0;
+
+    for (int i = 0; i < length && len + 1 < TEXT_LABEL_MAX_CHARS; i++) {
+        uint16_t color = (i < current_index) ? COLOR_GOOD : COLOR_TEXT;
+        if (i > 0) {
+            colors[len] = color;
+            text[len++] = ' ';
+        }
+        colors[len] = color;
+        text[len++] = direction_to_char(seq[i])[0];
+    }
+    text[len] = '\0';
+
+    text_label_print_colors(&game_input_label, text, colors);
+}
+
+/**
+ * Dibuja un temporizador simple en la parte inferior de la pantalla.
+ * Muestra el tiempo restante en décimas de segundo. Las cifras van
+ * alineadas a la derecha, así que cada décima suele cambiar un solo
+ * carácter (dos o tres al cambiar de segundo).
+ */
+void game_draw_timer(uint32_t remaining_ms)
+{
+    static const char prefix[] = "TIEMPO: ";
+    char buf[32];
+
+    memcpy(buf, prefix, sizeof(prefix) - 1);
+    size_t len = sizeof(prefix) - 1;
+    len += text_label_format_fixed(buf + len, sizeof(buf) - len - 1,
+                                   (int32_t)(remaining_ms / 100), 1, 4);
+    buf[len++] = 's';
+    buf[len] = '\0';
+
+    text_label_print(&game_timer_label, buf, COLOR_INFO);
+}
+
+/**
+ * Muestra el resultado del intento (ÉXITO o FALLO) en grande
+ * en el centro de la pantalla.
+ */
+void game_draw_result(int success)
+{
+    ili9341_fill_screen(COLOR_BG);
+
+    const char *msg = success ? "EXITO" : "FALLO";
+    uint16_t color = success ? COLOR_GOOD : COLOR_BAD;
+
+    int x = 40;
+    int y = ILI9341_HEIGHT / 2 - TEXT_LINE_HEIGHT;
+
+    ili9341_draw_string(x, y, msg, color, COLOR_BG, 3);
+}
+
+/**
+ * Convierte una dirección en un texto corto para dibujar en pantalla.
+ * Aquí usamos:
+ *  - DIR_UP    -> "U"
+ *  - DIR_DOWN  -> "D"
+ *  - DIR_LEFT  -> "L"
+ *  - DIR_RIGHT -> "R"
+ *
+ * Puedes cambiarlo para dibujar flechas, iconos, etc.
+ */
+static const char *direction_to_char(Direction d)
+{
+    switch (d) {
+    case DIR_UP:    return "U";
+    case DIR_DOWN:  return "D";
+    case DIR_LEFT:  return "L";
+    case DIR_RIGHT: return "R";
+    default:        return "?";
+    }
+}
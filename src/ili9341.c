@@ -15,14 +15,25 @@
  * entender el flujo básico y extenderlo en tu propio proyecto.
  */
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+
+#ifdef ESP_PLATFORM
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#else
+#include "ili9341_sim.h"   // Backend de host: SPI/GPIO emulados
+#endif
 
 #include "ili9341.h"
+#include "ili9341_image.h"
+#include "font5x7.h"
 
 // TAG para logs relacionados con la pantalla
 static const char *TAG = "ILI9341_DRV";
@@ -57,9 +68,253 @@ static const char *TAG = "ILI9341_DRV";
 // Se usará el host VSPI (SPI3) del ESP32
 #define ILI9341_SPI_HOST   HSPI_HOST
 
+// Número de transacciones que pueden estar encoladas a la vez en el driver
+// SPI (debe coincidir con queue_size al registrar el dispositivo).
+#define ILI9341_QUEUE_SIZE    7
+
+// Píxeles por bloque DMA al rellenar áreas (1024 píxeles = 2 KB)
+#define ILI9341_BLOCK_PIXELS  1024
+
 // Handle global del dispositivo SPI asociado a la pantalla
 static spi_device_handle_t ili9341_spi;
 
+// -----------------------------------------------------------------------------
+//  TRANSFERENCIAS ENCOLADAS (DMA NO BLOQUEANTE)
+// -----------------------------------------------------------------------------
+
+/**
+ * En lugar de usar spi_device_transmit (que espera a que termine cada
+ * transacción), encolamos las transacciones con spi_device_queue_trans y
+ * solo recogemos sus resultados cuando necesitamos reutilizar un
+ * descriptor o un buffer. Así la CPU puede preparar el siguiente bloque
+ * (o ejecutar la lógica del juego) mientras el anterior sale por el bus.
+ *
+ * El nivel de la línea D/C viaja dentro de cada transacción (campo user)
+ * y lo aplica el callback pre-transferencia, justo antes de que el
+ * hardware empiece a enviarla.
+ *
+ * Campo user de cada transacción:
+ *   bit 0     -> nivel D/C (0 = comando, 1 = datos)
+ *   bits 1..  -> índice + 1 del bloque DMA usado (0 = ninguno), o
+ *                ILI9341_FB_BLOCK + 1 si lee del framebuffer RGB565
+ */
+
+#define ILI9341_USER_DC_BIT        0x01
+#define ILI9341_USER_BLOCK_SHIFT   1
+
+// Pool circular de descriptores de transacción
+static spi_transaction_t ili9341_trans_pool[ILI9341_QUEUE_SIZE];
+static int ili9341_trans_next;      // siguiente descriptor a usar
+static int ili9341_trans_pending;   // transacciones encoladas sin recoger
+
+// Doble buffer DMA para rellenos y bloques de píxeles
+DMA_ATTR static uint16_t ili9341_block_buf[2][ILI9341_BLOCK_PIXELS];
+
+// "Bloque" de las transacciones que leen directamente del framebuffer RGB565
+#define ILI9341_FB_BLOCK  2
+
+// Transacciones en vuelo que leen cada buffer (y el framebuffer)
+static int ili9341_block_inflight[ILI9341_FB_BLOCK + 1];
+static int ili9341_block_next;         // buffer que se entregará a continuación
+
+// Si es false, cada primitiva espera a que termine su transferencia
+static bool ili9341_async_enabled = false;
+
+/**
+ * ORDEN DE BYTES
+ *
+ * El ILI9341 espera cada píxel RGB565 con el byte alto primero, pero el
+ * ESP32 es little-endian: un uint16_t en memoria guarda primero el byte
+ * bajo. Todo lo que se envía por DMA (bloques y framebuffer RGB565) se
+ * guarda ya intercambiado, "en orden de bus".
+ */
+static inline uint16_t ili9341_to_bus(uint16_t color)
+{
+    return (uint16_t)((color << 8) | (color >> 8));
+}
+
+/**
+ * Copia 'count' píxeles RGB565 de 'src' a 'dst' pasándolos a orden de bus.
+ *
+ * Cuando ambos punteros quedan alineados a 4 bytes se procesan dos
+ * píxeles por palabra de 32 bits: un par de máscaras y desplazamientos
+ * intercambian los bytes de los dos a la vez.
+ */
+static void ili9341_swap_copy(uint16_t *dst, const uint16_t *src, uint32_t count)
+{
+    // Un píxel suelto si hace falta para llegar a una dirección alineada
+    if (count > 0 && (((uintptr_t)dst | (uintptr_t)src) & 2)) {
+        if (((uintptr_t)dst & 2) != ((uintptr_t)src & 2)) {
+            // No se pueden alinear los dos a la vez: píxel a píxel
+            for (uint32_t i = 0; i < count; i++) {
+                dst[i] = ili9341_to_bus(src[i]);
+            }
+            return;
+        }
+        *dst++ = ili9341_to_bus(*src++);
+        count--;
+    }
+
+    uint32_t *dst_words = (uint32_t *)dst;
+    const uint32_t *src_words = (const uint32_t *)src;
+    uint32_t words = count / 2;
+    for (uint32_t i = 0; i < words; i++) {
+        uint32_t v = src_words[i];
+        dst_words[i] = ((v & 0x00FF00FFu) << 8) | ((v >> 8) & 0x00FF00FFu);
+    }
+
+    if (count & 1) {
+        dst[count - 1] = ili9341_to_bus(src[count - 1]);
+    }
+}
+
+/**
+ * Estado conocido de la ventana de dirección del panel.
+ *
+ * El ILI9341 recuerda CASET/RASET hasta que se vuelven a enviar, y tras
+ * RAMWR cada píxel recibido avanza un puntero interno dentro de la
+ * ventana. Guardando ese estado podemos omitir CASET/RASET idénticos y
+ * seguir escribiendo sin comandos cuando la siguiente zona empieza justo
+ * donde se quedó el puntero.
+ */
+typedef struct {
+    bool     valid;        // x0..y1 reflejan lo que tiene el panel
+    bool     ramwr_open;   // el último comando fue RAMWR: los datos son píxeles
+    uint16_t x0, y0, x1, y1;
+    uint32_t written;      // píxeles escritos desde el último RAMWR
+} ili9341_window_state_t;
+
+static ili9341_window_state_t ili9341_window;
+static ili9341_stats_t ili9341_stats;
+
+// Nivel actual de D/C (-1 = desconocido). Solo lo toca el callback SPI.
+static int ili9341_dc_level = -1;
+static volatile uint32_t ili9341_dc_writes_saved;
+
+/**
+ * Callback que ejecuta el driver SPI justo antes de cada transacción.
+ * Pone la línea D/C al nivel indicado en t->user, solo si cambia.
+ */
+static void IRAM_ATTR ili9341_spi_pre_transfer_callback(spi_transaction_t *t)
+{
+    int dc = (int)(intptr_t)t->user & ILI9341_USER_DC_BIT;
+    if (dc == ili9341_dc_level) {
+        ili9341_dc_writes_saved++;
+        return;
+    }
+    gpio_set_level(ILI9341_PIN_DC, dc);
+    ili9341_dc_level = dc;
+}
+
+/**
+ * Recoge el resultado de la transacción más antigua en vuelo.
+ *  - timeout: ticks a esperar (0 = solo comprobar).
+ * Devuelve true si se ha recogido alguna transacción.
+ */
+static bool ili9341_reap_one(TickType_t timeout)
+{
+    if (ili9341_trans_pending == 0) return false;
+
+    spi_transaction_t *done = NULL;
+    esp_err_t ret = spi_device_get_trans_result(ili9341_spi, &done, timeout);
+    if (ret != ESP_OK) {
+        return false;
+    }
+
+    ili9341_trans_pending--;
+
+    // Si la transacción leía de un bloque DMA, ese bloque queda un poco más libre
+    int block = ((int)(intptr_t)done->user >> ILI9341_USER_BLOCK_SHIFT) - 1;
+    if (block >= 0) {
+        ili9341_block_inflight[block]--;
+    }
+    return true;
+}
+
+/**
+ * Encola una transacción.
+ *  - data/len:  bytes a enviar. Si len <= 4 se copian dentro del propio
+ *               descriptor, así el llamador puede usar buffers temporales.
+ *  - dc:        0 = comando, 1 = datos.
+ *  - block:     índice del bloque DMA que se envía, o -1 si no es uno.
+ */
+static void ili9341_queue_trans(const void *data, int len, int dc, int block)
+{
+    // Si el pool está lleno, la transacción más antigua libera su descriptor
+    if (ili9341_trans_pending == ILI9341_QUEUE_SIZE) {
+        ili9341_reap_one(portMAX_DELAY);
+    }
+
+    spi_transaction_t *t = &ili9341_trans_pool[ili9341_trans_next];
+    ili9341_trans_next = (ili9341_trans_next + 1) % ILI9341_QUEUE_SIZE;
+
+    memset(t, 0, sizeof(*t));
+    t->length = len * 8;   // longitud en bits
+    t->user = (void *)(intptr_t)((dc ? ILI9341_USER_DC_BIT : 0) |
+                                 ((block + 1) << ILI9341_USER_BLOCK_SHIFT));
+
+    if (len <= 4) {
+        t->flags = SPI_TRANS_USE_TXDATA;
+        memcpy(t->tx_data, data, len);
+    } else {
+        t->tx_buffer = data;
+    }
+
+    esp_err_t ret = spi_device_queue_trans(ili9341_spi, t, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error encolando transacción SPI (%d bytes)", len);
+        return;
+    }
+
+    ili9341_trans_pending++;
+    if (block >= 0) {
+        ili9341_block_inflight[block]++;
+    }
+
+    // Contabilidad: tras RAMWR los datos son píxeles y avanzan el puntero
+    ili9341_stats.transactions++;
+    if (dc && ili9341_window.ramwr_open) {
+        ili9341_stats.pixel_bytes += len;
+        ili9341_window.written += len / 2;
+    } else {
+        ili9341_stats.cmd_bytes += len;
+    }
+}
+
+/**
+ * Devuelve el índice de un bloque DMA libre para escribir en él.
+ * Alterna entre los dos buffers: mientras uno se envía, se rellena el otro.
+ */
+static int ili9341_acquire_block(void)
+{
+    int block = ili9341_block_next;
+    ili9341_block_next ^= 1;
+
+    while (ili9341_block_inflight[block] > 0) {
+        ili9341_reap_one(portMAX_DELAY);
+    }
+    return block;
+}
+
+/**
+ * Encola el envío de los primeros 'pixels' píxeles de un bloque DMA.
+ */
+static void ili9341_submit_block(int block, uint32_t pixels)
+{
+    ili9341_queue_trans(ili9341_block_buf[block], pixels * 2, 1, block);
+}
+
+/**
+ * Al final de cada primitiva: en modo bloqueante esperamos a que termine
+ * todo lo encolado, como hacía el driver original.
+ */
+static void ili9341_end_primitive(void)
+{
+    if (!ili9341_async_enabled) {
+        ili9341_flush();
+    }
+}
+
 // -----------------------------------------------------------------------------
 //  AYUDANTES INTERNOS: GPIO Y SPI BÁSICO
 // -----------------------------------------------------------------------------
@@ -70,37 +325,26 @@ static spi_device_handle_t ili9341_spi;
  */
 static void ili9341_send_cmd(uint8_t cmd)
 {
-    gpio_set_level(ILI9341_PIN_DC, 0);  // Modo comando
-
-    spi_transaction_t t;
-    memset(&t, 0, sizeof(t));
-    t.length = 8;           // 8 bits
-    t.tx_buffer = &cmd;
+    // Cualquier comando distinto de RAMWR termina la escritura en memoria
+    ili9341_window.ramwr_open = false;
 
-    esp_err_t ret = spi_device_transmit(ili9341_spi, &t);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error enviando comando 0x%02X", cmd);
-    }
+    ili9341_queue_trans(&cmd, 1, 0, -1);
 }
 
 /**
  * Envía un bloque de datos al ILI9341.
  * DC = 1 indica "DATA".
+ *
+ * Los bloques de más de 4 bytes se envían desde la memoria del llamador,
+ * así que esperamos a que terminen antes de volver.
  */
 static void ili9341_send_data(const uint8_t *data, int len)
 {
     if (len <= 0) return;
 
-    gpio_set_level(ILI9341_PIN_DC, 1);  // Modo datos
-
-    spi_transaction_t t;
-    memset(&t, 0, sizeof(t));
-    t.length = len * 8;   // longitud en bits
-    t.tx_buffer = data;
-
-    esp_err_t ret = spi_device_transmit(ili9341_spi, &t);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error enviando datos SPI (%d bytes)", len);
+    ili9341_queue_trans(data, len, 1, -1);
+    if (len > 4) {
+        ili9341_flush();
     }
 }
 
@@ -135,7 +379,9 @@ static void ili9341_send_data16(uint16_t data)
 #define ILI9341_CMD_CASET    0x2A
 #define ILI9341_CMD_RASET    0x2B
 #define ILI9341_CMD_RAMWR    0x2C
+#define ILI9341_CMD_VSCRDEF  0x33
 #define ILI9341_CMD_MADCTL   0x36
+#define ILI9341_CMD_VSCRSADD 0x37
 #define ILI9341_CMD_PIXFMT   0x3A
 
 // MADCTL (Memory Access Control) bits para orientación
@@ -148,31 +394,105 @@ static void ili9341_send_data16(uint16_t data)
 //  CONFIGURACIÓN DE VENTANA DE DIBUJO
 // -----------------------------------------------------------------------------
 
+// Bytes que cuesta enviar CASET o RASET (comando + 4 parámetros) y RAMWR
+#define ILI9341_SET_RANGE_BYTES  5
+#define ILI9341_RAMWR_BYTES      1
+
+/**
+ * Envía CASET o RASET con el rango [start, end].
+ */
+static void ili9341_send_range(uint8_t cmd, uint16_t start, uint16_t end)
+{
+    ili9341_send_cmd(cmd);
+    uint8_t data[4] = {
+        (uint8_t)(start >> 8), (uint8_t)(start & 0xFF),
+        (uint8_t)(end >> 8),   (uint8_t)(end & 0xFF)
+    };
+    ili9341_send_data(data, 4);
+}
+
+/**
+ * true si escribir en (x0, y0)-(x1, y1) puede continuar el RAMWR abierto:
+ * el puntero del panel está justo en (x0, y0) y la zona son, o bien un
+ * tramo de la fila actual, o bien filas completas de la ventana.
+ */
+static bool ili9341_window_continues(uint16_t x0, uint16_t y0,
+                                     uint16_t x1, uint16_t y1)
+{
+    const ili9341_window_state_t *win = &ili9341_window;
+    if (!win->valid || !win->ramwr_open) return false;
+
+    uint32_t win_w = win->x1 - win->x0 + 1;
+    uint32_t win_h = win->y1 - win->y0 + 1;
+    if (win->written >= win_w * win_h) return false;
+
+    uint16_t cursor_x = win->x0 + win->written % win_w;
+    uint16_t cursor_y = win->y0 + win->written / win_w;
+    if (cursor_x != x0 || cursor_y != y0) return false;
+
+    bool same_row_span = (y0 == y1) && (x1 <= win->x1);
+    bool full_rows = (x0 == win->x0) && (x1 == win->x1) && (y1 <= win->y1);
+    return same_row_span || full_rows;
+}
+
 /**
  * Define el área (ventana) de memoria de vídeo donde se va a escribir.
  * Todo lo que se envíe con RAMWR a continuación rellenará ese rectángulo.
+ *
+ * Solo se envía lo imprescindible:
+ *   - Si la zona continúa donde quedó el puntero del RAMWR abierto, no se
+ *     envía nada.
+ *   - CASET y RASET se omiten si el panel ya tiene ese rango.
  */
 static void ili9341_set_address_window(uint16_t x0, uint16_t y0,
                                        uint16_t x1, uint16_t y1)
 {
+    ili9341_window_state_t *win = &ili9341_window;
+
+    if (ili9341_window_continues(x0, y0, x1, y1)) {
+        ili9341_stats.ramwr_reused++;
+        ili9341_stats.cmd_bytes_saved += 2 * ILI9341_SET_RANGE_BYTES + ILI9341_RAMWR_BYTES;
+        return;
+    }
+
     // Columna (X)
-    ili9341_send_cmd(ILI9341_CMD_CASET);
-    uint8_t data_col[4] = {
-        (uint8_t)(x0 >> 8), (uint8_t)(x0 & 0xFF),
-        (uint8_t)(x1 >> 8), (uint8_t)(x1 & 0xFF)
-    };
-    ili9341_send_data(data_col, 4);
+    if (win->valid && win->x0 == x0 && win->x1 == x1) {
+        ili9341_stats.caset_skipped++;
+        ili9341_stats.cmd_bytes_saved += ILI9341_SET_RANGE_BYTES;
+    } else {
+        ili9341_send_range(ILI9341_CMD_CASET, x0, x1);
+    }
 
     // Fila (Y)
-    ili9341_send_cmd(ILI9341_CMD_RASET);
-    uint8_t data_row[4] = {
-        (uint8_t)(y0 >> 8), (uint8_t)(y0 & 0xFF),
-        (uint8_t)(y1 >> 8), (uint8_t)(y1 & 0xFF)
-    };
-    ili9341_send_data(data_row, 4);
+    if (win->valid && win->y0 == y0 && win->y1 == y1) {
+        ili9341_stats.raset_skipped++;
+        ili9341_stats.cmd_bytes_saved += ILI9341_SET_RANGE_BYTES;
+    } else {
+        ili9341_send_range(ILI9341_CMD_RASET, y0, y1);
+    }
 
-    // Siguiente comando escribirá en esta ventana
+    win->valid = true;
+    win->x0 = x0;
+    win->y0 = y0;
+    win->x1 = x1;
+    win->y1 = y1;
+
+    // Siguiente comando escribirá en esta ventana (el puntero vuelve al inicio)
     ili9341_send_cmd(ILI9341_CMD_RAMWR);
+    win->ramwr_open = true;
+    win->written = 0;
+}
+
+void ili9341_get_stats(ili9341_stats_t *stats)
+{
+    *stats = ili9341_stats;
+    stats->dc_writes_saved = ili9341_dc_writes_saved;
+}
+
+void ili9341_reset_stats(void)
+{
+    memset(&ili9341_stats, 0, sizeof(ili9341_stats));
+    ili9341_dc_writes_saved = 0;
 }
 
 // -----------------------------------------------------------------------------
@@ -226,8 +546,9 @@ void ili9341_init(void)
         .clock_speed_hz = 40 * 1000 * 1000, // 40 MHz (puedes bajar si tu cableado es malo)
         .mode = 0,                          // Modo SPI 0
         .spics_io_num = ILI9341_PIN_CS,     // CS gestionado por el driver
-        .queue_size = 7,
+        .queue_size = ILI9341_QUEUE_SIZE,
         .flags = SPI_DEVICE_HALFDUPLEX,
+        .pre_cb = ili9341_spi_pre_transfer_callback, // D/C según t->user
     };
 
     ret = spi_bus_add_device(ILI9341_SPI_HOST, &devcfg, &ili9341_spi);
@@ -244,8 +565,12 @@ void ili9341_init(void)
 
     // 5. Secuencia de inicialización mínima según hoja de datos
     ili9341_send_cmd(ILI9341_CMD_SWRESET);   // Software reset
+    ili9341_flush();
     vTaskDelay(pdMS_TO_TICKS(120));
 
+    // Tras el reset no sabemos qué ventana tiene el panel
+    memset(&ili9341_window, 0, sizeof(ili9341_window));
+
     ili9341_send_cmd(ILI9341_CMD_SLPOUT);    // Salir de modo SLEEP
     vTaskDelay(pdMS_TO_TICKS(120));
 
@@ -276,186 +601,1117 @@ void ili9341_init(void)
 //  PRIMITIVAS DE DIBUJO
 // -----------------------------------------------------------------------------
 
-void ili9341_fill_screen(uint16_t color)
+void ili9341_set_async(bool enable)
 {
-    // Establecemos toda la pantalla como ventana de dibujo
-    ili9341_set_address_window(0, 0, ILI9341_WIDTH - 1, ILI9341_HEIGHT - 1);
+    if (!enable) {
+        ili9341_flush();
+    }
+    ili9341_async_enabled = enable;
+}
+
+void ili9341_flush(void)
+{
+    while (ili9341_trans_pending > 0) {
+        ili9341_reap_one(portMAX_DELAY);
+    }
+}
+
+bool ili9341_is_busy(void)
+{
+    // Recogemos sin esperar todo lo que ya haya terminado
+    while (ili9341_reap_one(0)) {
+    }
+    return ili9341_trans_pending > 0;
+}
+
+// -----------------------------------------------------------------------------
+//  FRAMEBUFFER OPCIONAL Y RECTÁNGULOS SUCIOS
+// -----------------------------------------------------------------------------
+
+/**
+ * En modo framebuffer las primitivas no tocan el bus: escriben en una
+ * copia de la pantalla en RAM y apuntan qué rectángulos han cambiado.
+ * ili9341_present() envía solo esas zonas, así que el coste de cada
+ * frame depende de lo que cambia y no de cuántas llamadas hace la UI, y
+ * los borrados + redibujados intermedios nunca llegan a verse (sin
+ * parpadeo).
+ *
+ * Los rectángulos sucios se guardan en una lista pequeña. Al añadir uno
+ * se fusiona con los que solapa o toca; si la lista se llena, se fusiona
+ * con el que menos área extra genera.
+ *
+ * Formatos de framebuffer:
+ *   - RGB565:    2 bytes/píxel (150 KB). Se envía tal cual: el DMA lee
+ *                de él, y dibujar encima espera a que termine.
+ *   - INDEXED8:  1 byte/píxel (75 KB), índice a una paleta de 256 colores.
+ *   - INDEXED4:  4 bits/píxel (37,5 KB), paleta de 16 colores. El píxel
+ *                de x par va en el nibble alto.
+ * En los formatos con paleta las primitivas guardan índices y, durante
+ * present, cada franja se expande a RGB565 en un bloque DMA.
+ */
+
+#define ILI9341_MAX_DIRTY_RECTS  8
+
+// Filas por transacción al enviar zonas de ancho completo desde el framebuffer
+#define ILI9341_FB_ROWS_PER_TRANS  16
+
+typedef struct {
+    uint16_t x0, y0, x1, y1;   // esquinas, ambas incluidas
+} ili9341_rect_t;
+
+static void *ili9341_fb;       // NULL = dibujo directo al panel
+static ili9341_fb_format_t ili9341_fb_format;
+
+// Paleta de los formatos indexados. Empieza con los colores ILI9341_COLOR_*
+static uint16_t ili9341_palette[256];
+static int ili9341_palette_used;    // entradas asignadas
+static int ili9341_palette_size;    // 16 (INDEXED4) o 256 (INDEXED8)
+
+static const uint16_t ili9341_default_palette[] = {
+    ILI9341_COLOR_BLACK, ILI9341_COLOR_WHITE, ILI9341_COLOR_RED,
+    ILI9341_COLOR_GREEN, ILI9341_COLOR_BLUE,  ILI9341_COLOR_YELLOW,
+    ILI9341_COLOR_CYAN,  ILI9341_COLOR_MAGENTA,
+};
+static ili9341_rect_t ili9341_dirty[ILI9341_MAX_DIRTY_RECTS];
+static int ili9341_dirty_count;
+
+static uint32_t ili9341_rect_area(const ili9341_rect_t *r)
+{
+    return (uint32_t)(r->x1 - r->x0 + 1) * (uint32_t)(r->y1 - r->y0 + 1);
+}
+
+static ili9341_rect_t ili9341_rect_union(const ili9341_rect_t *a, const ili9341_rect_t *b)
+{
+    ili9341_rect_t u = {
+        .x0 = (a->x0 < b->x0) ? a->x0 : b->x0,
+        .y0 = (a->y0 < b->y0) ? a->y0 : b->y0,
+        .x1 = (a->x1 > b->x1) ? a->x1 : b->x1,
+        .y1 = (a->y1 > b->y1) ? a->y1 : b->y1,
+    };
+    return u;
+}
+
+/**
+ * true si los rectángulos se solapan o se tocan por un borde.
+ */
+static bool ili9341_rect_touches(const ili9341_rect_t *a, const ili9341_rect_t *b)
+{
+    return a->x0 <= b->x1 + 1 && b->x0 <= a->x1 + 1 &&
+           a->y0 <= b->y1 + 1 && b->y0 <= a->y1 + 1;
+}
+
+/**
+ * Marca como sucio el rectángulo (x, y, w, h), ya recortado a la pantalla.
+ */
+static void ili9341_mark_dirty(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    ili9341_rect_t rect = { x, y, x + w - 1, y + h - 1 };
+
+    // Fusionamos con todos los que solapa o toca. Cada fusión puede hacer
+    // que el nuevo rectángulo alcance a otros, así que repetimos.
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (int i = 0; i < ili9341_dirty_count; i++) {
+            if (ili9341_rect_touches(&rect, &ili9341_dirty[i])) {
+                rect = ili9341_rect_union(&rect, &ili9341_dirty[i]);
+                ili9341_dirty[i] = ili9341_dirty[--ili9341_dirty_count];
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (ili9341_dirty_count < ILI9341_MAX_DIRTY_RECTS) {
+        ili9341_dirty[ili9341_dirty_count++] = rect;
+        return;
+    }
+
+    // Lista llena: fusionamos con el rectángulo que menos área añade
+    int best = 0;
+    uint32_t best_growth = UINT32_MAX;
+    for (int i = 0; i < ili9341_dirty_count; i++) {
+        ili9341_rect_t u = ili9341_rect_union(&rect, &ili9341_dirty[i]);
+        uint32_t growth = ili9341_rect_area(&u) - ili9341_rect_area(&ili9341_dirty[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    ili9341_dirty[best] = ili9341_rect_union(&rect, &ili9341_dirty[best]);
+}
+
+// -- Acceso al framebuffer según su formato -----------------------------------
+
+/**
+ * Distancia aproximada entre dos colores RGB565 (suma de cuadrados por
+ * componente, con el verde a 5 bits como los otros dos).
+ */
+static uint32_t ili9341_color_distance(uint16_t a, uint16_t b)
+{
+    int dr = (int)((a >> 11) & 0x1F) - (int)((b >> 11) & 0x1F);
+    int dg = (int)((a >> 6) & 0x1F)  - (int)((b >> 6) & 0x1F);
+    int db = (int)(a & 0x1F)         - (int)(b & 0x1F);
+    return (uint32_t)(dr * dr + dg * dg + db * db);
+}
+
+/**
+ * Convierte un color RGB565 al valor que se guarda en el framebuffer:
+ * el propio color en RGB565 (en orden de bus), o su índice de paleta en
+ * los indexados.
+ *
+ * Si el color no está en la paleta se añade mientras quede sitio; si
+ * está llena se usa el color más parecido.
+ */
+static uint16_t ili9341_fb_value(uint16_t color)
+{
+    if (ili9341_fb_format == ILI9341_FB_RGB565) {
+        return ili9341_to_bus(color);
+    }
+
+    for (int i = 0; i < ili9341_palette_used; i++) {
+        if (ili9341_palette[i] == color) return i;
+    }
+
+    if (ili9341_palette_used < ili9341_palette_size) {
+        ili9341_palette[ili9341_palette_used] = color;
+        return ili9341_palette_used++;
+    }
+
+    int best = 0;
+    uint32_t best_distance = UINT32_MAX;
+    for (int i = 0; i < ili9341_palette_used; i++) {
+        uint32_t distance = ili9341_color_distance(ili9341_palette[i], color);
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * Espera a que el DMA termine de leer el framebuffer RGB565 (present en
+ * modo no bloqueante). Sin esto, el frame siguiente se mezclaría con el
+ * que todavía está saliendo por el bus.
+ */
+static void ili9341_fb_wait_dma(void)
+{
+    while (ili9341_block_inflight[ILI9341_FB_BLOCK] > 0) {
+        ili9341_reap_one(portMAX_DELAY);
+    }
+}
+
+/**
+ * Escribe 'w' valores (ya convertidos con ili9341_fb_value) a partir de (x, y).
+ */
+static void ili9341_fb_write_row(uint16_t x, uint16_t y, const uint16_t *values, uint32_t w)
+{
+    uint32_t offset = (uint32_t)y * ILI9341_WIDTH + x;
+
+    ili9341_fb_wait_dma();
+
+    switch (ili9341_fb_format) {
+    case ILI9341_FB_RGB565:
+        memcpy((uint16_t *)ili9341_fb + offset, values, w * sizeof(uint16_t));
+        break;
+
+    case ILI9341_FB_INDEXED8: {
+        uint8_t *dst = (uint8_t *)ili9341_fb + offset;
+        for (uint32_t i = 0; i < w; i++) {
+            dst[i] = (uint8_t)values[i];
+        }
+        break;
+    }
+
+    case ILI9341_FB_INDEXED4: {
+        uint8_t *fb = ili9341_fb;
+        for (uint32_t i = 0; i < w; i++) {
+            uint32_t pos = offset + i;
+            uint8_t *byte = &fb[pos >> 1];
+            if (pos & 1) {
+                *byte = (*byte & 0xF0) | (values[i] & 0x0F);
+            } else {
+                *byte = (*byte & 0x0F) | (uint8_t)(values[i] << 4);
+            }
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * Rellena 'w' píxeles a partir de (x, y) con un mismo valor.
+ */
+static void ili9341_fb_fill_row(uint16_t x, uint16_t y, uint32_t w, uint16_t value)
+{
+    uint32_t offset = (uint32_t)y * ILI9341_WIDTH + x;
+
+    ili9341_fb_wait_dma();
+
+    switch (ili9341_fb_format) {
+    case ILI9341_FB_RGB565: {
+        uint16_t *dst = (uint16_t *)ili9341_fb + offset;
+        for (uint32_t i = 0; i < w; i++) {
+            dst[i] = value;
+        }
+        break;
+    }
+
+    case ILI9341_FB_INDEXED8:
+        memset((uint8_t *)ili9341_fb + offset, value, w);
+        break;
+
+    case ILI9341_FB_INDEXED4: {
+        uint16_t edge_values[1] = { value };
+        // Píxel suelto al principio (x impar) y al final: nibble a nibble
+        if ((offset & 1) && w > 0) {
+            ili9341_fb_write_row(x, y, edge_values, 1);
+            offset++;
+            x++;
+            w--;
+        }
+        // Parejas de píxeles alineadas: un byte por cada dos
+        memset((uint8_t *)ili9341_fb + (offset >> 1), (value << 4) | (value & 0x0F), w >> 1);
+        if (w & 1) {
+            ili9341_fb_write_row(x + w - 1, y, edge_values, 1);
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * Expande a RGB565 (en orden de bus) 'w' píxeles del framebuffer a partir
+ * de (x, y).
+ */
+static void ili9341_fb_read_row(uint16_t x, uint16_t y, uint16_t *dst, uint32_t w)
+{
+    uint32_t offset = (uint32_t)y * ILI9341_WIDTH + x;
+
+    switch (ili9341_fb_format) {
+    case ILI9341_FB_RGB565:
+        memcpy(dst, (uint16_t *)ili9341_fb + offset, w * sizeof(uint16_t));
+        break;
 
-    // Enviamos color repetido para todos los píxeles
-    uint32_t total_pixels = (uint32_t)ILI9341_WIDTH * (uint32_t)ILI9341_HEIGHT;
+    case ILI9341_FB_INDEXED8: {
+        const uint8_t *src = (const uint8_t *)ili9341_fb + offset;
+        for (uint32_t i = 0; i < w; i++) {
+            dst[i] = ili9341_to_bus(ili9341_palette[src[i]]);
+        }
+        break;
+    }
+
+    case ILI9341_FB_INDEXED4: {
+        const uint8_t *fb = ili9341_fb;
+        for (uint32_t i = 0; i < w; i++) {
+            uint32_t pos = offset + i;
+            uint8_t byte = fb[pos >> 1];
+            dst[i] = ili9341_to_bus(ili9341_palette[(pos & 1) ? (byte & 0x0F) : (byte >> 4)]);
+        }
+        break;
+    }
+    }
+}
 
-    // Para no crear un buffer enorme, escribimos en bloques
-    const int block_size = 1024; // píxeles por bloque
-    uint16_t block[block_size];
-    for (int i = 0; i < block_size; i++) {
-        block[i] = color;
+bool ili9341_framebuffer_enable(ili9341_fb_format_t format)
+{
+    if (ili9341_fb) {
+        if (format == ili9341_fb_format) return true;
+        ili9341_framebuffer_disable();
+    }
+
+    uint32_t pixels = (uint32_t)ILI9341_WIDTH * ILI9341_HEIGHT;
+    size_t size;
+    uint32_t caps;
+    switch (format) {
+    case ILI9341_FB_INDEXED8:
+        size = pixels;
+        caps = MALLOC_CAP_8BIT;
+        ili9341_palette_size = 256;
+        break;
+    case ILI9341_FB_INDEXED4:
+        size = pixels / 2;
+        caps = MALLOC_CAP_8BIT;
+        ili9341_palette_size = 16;
+        break;
+    case ILI9341_FB_RGB565:
+    default:
+        // En RGB565 el DMA lee directamente del framebuffer
+        format = ILI9341_FB_RGB565;
+        size = pixels * sizeof(uint16_t);
+        caps = MALLOC_CAP_DMA;
+        ili9341_palette_size = 0;
+        break;
+    }
+
+    ili9341_fb = heap_caps_malloc(size, caps);
+    if (!ili9341_fb) {
+        ESP_LOGW(TAG, "Sin memoria para el framebuffer (%u bytes), dibujo directo",
+                 (unsigned)size);
+        return false;
+    }
+    ili9341_fb_format = format;
+
+    // Paleta inicial: los colores básicos del juego
+    memset(ili9341_palette, 0, sizeof(ili9341_palette));
+    ili9341_palette_used = 0;
+    if (ili9341_palette_size > 0) {
+        ili9341_palette_used = sizeof(ili9341_default_palette) / sizeof(ili9341_default_palette[0]);
+        memcpy(ili9341_palette, ili9341_default_palette, sizeof(ili9341_default_palette));
+    }
+
+    // No sabemos qué hay en el panel: el primer present lo envía todo.
+    // Todo a cero es negro tanto en RGB565 como en el índice 0 de la paleta.
+    memset(ili9341_fb, 0, size);
+    ili9341_dirty_count = 0;
+    ili9341_mark_dirty(0, 0, ILI9341_WIDTH, ILI9341_HEIGHT);
+    return true;
+}
+
+void ili9341_framebuffer_disable(void)
+{
+    if (!ili9341_fb) return;
+
+    ili9341_present();
+    ili9341_flush();   // el DMA puede seguir leyendo del framebuffer
+
+    heap_caps_free(ili9341_fb);
+    ili9341_fb = NULL;
+    ili9341_dirty_count = 0;
+}
+
+bool ili9341_framebuffer_active(void)
+{
+    return ili9341_fb != NULL;
+}
+
+int ili9341_palette_set(uint8_t index, uint16_t color)
+{
+    if (!ili9341_fb || index >= ili9341_palette_size) return -1;
+
+    ili9341_palette[index] = color;
+    if (index >= ili9341_palette_used) {
+        ili9341_palette_used = index + 1;
+    }
+
+    // Todos los píxeles con ese índice cambian de color
+    ili9341_mark_dirty(0, 0, ILI9341_WIDTH, ILI9341_HEIGHT);
+    return 0;
+}
+
+/**
+ * Envía al panel el contenido del framebuffer dentro de un rectángulo.
+ */
+static void ili9341_push_rect(const ili9341_rect_t *r)
+{
+    uint32_t w = r->x1 - r->x0 + 1;
+
+    ili9341_set_address_window(r->x0, r->y0, r->x1, r->y1);
+
+    if (w == ILI9341_WIDTH && ili9341_fb_format == ILI9341_FB_RGB565) {
+        // Filas completas: son contiguas en RAM y el DMA lee directamente
+        // del framebuffer, sin copias. Hasta que termine, quien vaya a
+        // escribir en el framebuffer espera (ili9341_fb_wait_dma).
+        const uint16_t *fb = ili9341_fb;
+        for (uint32_t y = r->y0; y <= r->y1; y += ILI9341_FB_ROWS_PER_TRANS) {
+            uint32_t rows = r->y1 - y + 1;
+            if (rows > ILI9341_FB_ROWS_PER_TRANS) rows = ILI9341_FB_ROWS_PER_TRANS;
+            ili9341_queue_trans(&fb[y * ILI9341_WIDTH], rows * w * 2, 1, ILI9341_FB_BLOCK);
+        }
+        return;
+    }
+
+    // Resto de casos: copiamos (o expandimos desde la paleta) franjas de
+    // filas a los bloques DMA. Mientras una franja se envía, se prepara la
+    // siguiente en el otro bloque.
+    uint32_t rows_per_block = ILI9341_BLOCK_PIXELS / w;
+    uint32_t y = r->y0;
+    while (y <= r->y1) {
+        int block = ili9341_acquire_block();
+        uint32_t rows = 0;
+        while (rows < rows_per_block && y <= r->y1) {
+            ili9341_fb_read_row(r->x0, y, &ili9341_block_buf[block][rows * w], w);
+            rows++;
+            y++;
+        }
+        ili9341_submit_block(block, rows * w);
+    }
+}
+
+void ili9341_present(void)
+{
+    if (!ili9341_fb) return;
+
+    for (int i = 0; i < ili9341_dirty_count; i++) {
+        ili9341_push_rect(&ili9341_dirty[i]);
+    }
+    ili9341_dirty_count = 0;
+
+    ili9341_end_primitive();
+}
+
+/**
+ * Envía 'total_pixels' píxeles de un mismo color a la ventana activa.
+ *
+ * El bloque DMA se rellena una sola vez y se encola repetidamente: como
+ * solo se lee, varias transacciones en vuelo pueden compartirlo y la CPU
+ * no tiene que volver a tocarlo.
+ */
+static void ili9341_stream_solid(uint16_t color, uint32_t total_pixels)
+{
+    int block = ili9341_acquire_block();
+    uint32_t fill = (total_pixels > ILI9341_BLOCK_PIXELS) ? ILI9341_BLOCK_PIXELS : total_pixels;
+    for (uint32_t i = 0; i < fill; i++) {
+        ili9341_block_buf[block][i] = ili9341_to_bus(color);
     }
 
     while (total_pixels > 0) {
-        uint32_t to_write = (total_pixels > block_size) ? block_size : total_pixels;
-        ili9341_send_data((uint8_t *)block, to_write * 2);
+        uint32_t to_write = (total_pixels > ILI9341_BLOCK_PIXELS) ? ILI9341_BLOCK_PIXELS : total_pixels;
+        ili9341_submit_block(block, to_write);
         total_pixels -= to_write;
     }
 }
 
+void ili9341_fill_screen(uint16_t color)
+{
+    if (ili9341_fb) {
+        ili9341_fill_rect(0, 0, ILI9341_WIDTH, ILI9341_HEIGHT, color);
+        return;
+    }
+
+    // Establecemos toda la pantalla como ventana de dibujo
+    ili9341_set_address_window(0, 0, ILI9341_WIDTH - 1, ILI9341_HEIGHT - 1);
+
+    // Enviamos color repetido para todos los píxeles, en bloques DMA
+    ili9341_stream_solid(color, (uint32_t)ILI9341_WIDTH * (uint32_t)ILI9341_HEIGHT);
+
+    ili9341_end_primitive();
+}
+
 void ili9341_draw_pixel(uint16_t x, uint16_t y, uint16_t color)
 {
     if (x >= ILI9341_WIDTH || y >= ILI9341_HEIGHT) {
         return; // fuera de rango
     }
 
-    ili9341_set_address_window(x, y, x, y);
+    if (ili9341_fb) {
+        ili9341_fb_fill_row(x, y, 1, ili9341_fb_value(color));
+        ili9341_mark_dirty(x, y, 1, 1);
+        return;
+    }
+
+    // La ventana llega hasta el final de la fila: así el siguiente píxel a
+    // la derecha continúa el mismo RAMWR sin reenviar ningún comando.
+    ili9341_set_address_window(x, y, ILI9341_WIDTH - 1, y);
     ili9341_send_data16(color);
+
+    ili9341_end_primitive();
 }
 
 void ili9341_fill_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
 {
     // Clipping muy básico para evitar salir de la pantalla
     if (x >= ILI9341_WIDTH || y >= ILI9341_HEIGHT) return;
+    if (w == 0 || h == 0) return;
 
     if ((x + w) > ILI9341_WIDTH)  w = ILI9341_WIDTH - x;
     if ((y + h) > ILI9341_HEIGHT) h = ILI9341_HEIGHT - y;
 
+    if (ili9341_fb) {
+        uint16_t value = ili9341_fb_value(color);
+        for (uint16_t row = y; row < y + h; row++) {
+            ili9341_fb_fill_row(x, row, w, value);
+        }
+        ili9341_mark_dirty(x, y, w, h);
+        return;
+    }
+
     ili9341_set_address_window(x, y, x + w - 1, y + h - 1);
 
-    uint32_t total_pixels = (uint32_t)w * (uint32_t)h;
-    const int block_size = 1024;
-    uint16_t block[block_size];
-    for (int i = 0; i < block_size; i++) {
-        block[i] = color;
-    }
+    ili9341_stream_solid(color, (uint32_t)w * (uint32_t)h);
 
-    while (total_pixels > 0) {
-        uint32_t to_write = (total_pixels > block_size) ? block_size : total_pixels;
-        ili9341_send_data((uint8_t *)block, to_write * 2);
-        total_pixels -= to_write;
-    }
+    ili9341_end_primitive();
 }
 
 // -----------------------------------------------------------------------------
-//  FUENTE 5x7 BÁSICA PARA TEXTO
+//  TEXTO CON LA FUENTE 5x7
 // -----------------------------------------------------------------------------
 
 /**
- * Para simplificar y evitar una fuente completa, definimos un pequeño
- * subconjunto de caracteres necesarios para el minijuego (A, E, F, I,
- * L, N, O, P, R, S, T, U, espacio, dígitos 0-9, etc.).
- *
- * Cada carácter es una matriz 5x7, almacenada como 5 columnas de 7 bits.
- * El bit menos significativo es la fila superior.
+ * La fuente vive en font5x7.c: una tabla densa indexada por código ASCII,
+ * con las filas ya transpuestas (y ensanchadas para escala 2 y 3) en
+ * tiempo de compilación.
  */
 
-typedef struct {
-    char ch;           // carácter ASCII
-    uint8_t columns[5]; // 5 columnas, 7 bits útiles cada una
-} font5x7_char_t;
-
-// Pequeño set de caracteres: " .": espacio, letras usadas, dígitos.
-// El diseño de cada letra es aproximado; puedes modificarlos a tu gusto.
-
-static const font5x7_char_t font5x7_table[] = {
-    // ESPACIO ' '
-    { ' ', { 0x00, 0x00, 0x00, 0x00, 0x00 } },
-
-    // DÍGITOS 0-9
-    { '0', { 0x3E, 0x51, 0x49, 0x45, 0x3E } }, // 0
-    { '1', { 0x00, 0x42, 0x7F, 0x40, 0x00 } }, // 1
-    { '2', { 0x42, 0x61, 0x51, 0x49, 0x46 } }, // 2
-    { '3', { 0x21, 0x41, 0x45, 0x4B, 0x31 } }, // 3
-    { '4', { 0x18, 0x14, 0x12, 0x7F, 0x10 } }, // 4
-    { '5', { 0x27, 0x45, 0x45, 0x45, 0x39 } }, // 5
-    { '6', { 0x3C, 0x4A, 0x49, 0x49, 0x30 } }, // 6
-    { '7', { 0x01, 0x71, 0x09, 0x05, 0x03 } }, // 7
-    { '8', { 0x36, 0x49, 0x49, 0x49, 0x36 } }, // 8
-    { '9', { 0x06, 0x49, 0x49, 0x29, 0x1E } }, // 9
-
-    // LETRAS BÁSICAS (mayúsculas)
-    { 'A', { 0x7E, 0x11, 0x11, 0x11, 0x7E } },
-    { 'C', { 0x3E, 0x41, 0x41, 0x41, 0x22 } },
-    { 'E', { 0x7F, 0x49, 0x49, 0x49, 0x41 } },
-    { 'F', { 0x7F, 0x09, 0x09, 0x09, 0x01 } },
-    { 'H', { 0x7F, 0x08, 0x08, 0x08, 0x7F } },
-    { 'I', { 0x00, 0x41, 0x7F, 0x41, 0x00 } },
-    { 'L', { 0x7F, 0x40, 0x40, 0x40, 0x40 } },
-    { 'M', { 0x7F, 0x02, 0x0C, 0x02, 0x7F } },
-    { 'N', { 0x7F, 0x04, 0x08, 0x10, 0x7F } },
-    { 'O', { 0x3E, 0x41, 0x41, 0x41, 0x3E } },
-    { 'P', { 0x7F, 0x09, 0x09, 0x09, 0x06 } },
-    { 'R', { 0x7F, 0x09, 0x19, 0x29, 0x46 } },
-    { 'S', { 0x46, 0x49, 0x49, 0x49, 0x31 } },
-    { 'T', { 0x01, 0x01, 0x7F, 0x01, 0x01 } },
-    { 'U', { 0x3F, 0x40, 0x40, 0x40, 0x3F } },
-    { ':', { 0x00, 0x36, 0x36, 0x00, 0x00 } },
-    { '.', { 0x00, 0x40, 0x60, 0x00, 0x00 } },
-};
+/**
+ * Devuelve la fila 'row' del glifo ensanchada a 'scale' (1..3): un bit
+ * por píxel, 5*scale bits útiles, bit 0 = píxel izquierdo.
+ */
+static inline uint32_t ili9341_glyph_row_bits(const font5x7_glyph_t *glyph,
+                                              uint8_t row, uint8_t scale)
+{
+#if FONT5X7_PRESCALED
+    switch (scale) {
+    case 2:  return glyph->rows_x2[row];
+    case 3:  return glyph->rows_x3[row];
+    default: return glyph->rows[row];
+    }
+#else
+    uint32_t bits = 0;
+    for (uint8_t col = 0; col < FONT5X7_CHAR_W; col++) {
+        if (glyph->rows[row] & (1 << col)) {
+            bits |= ((1u << scale) - 1) << (col * scale);
+        }
+    }
+    return bits;
+#endif
+}
 
-// Número de elementos en la tabla
-static const int FONT5X7_TABLE_LEN = sizeof(font5x7_table) / sizeof(font5x7_table[0]);
+// Máximo de caracteres visibles en una fila (con escala 1: 240 / 6 = 40)
+#define ILI9341_MAX_RUN_CHARS  (ILI9341_WIDTH / FONT5X7_ADVANCE + 1)
 
 /**
- * Busca la definición bitmap del carácter indicado.
- * Si no se encuentra, devuelve la de espacio.
+ * Rasteriza una fila de píxeles ('font_row' del bitmap) de una tira de
+ * glifos en 'row', que tiene 'run_w' píxeles de ancho.
  */
-static const font5x7_char_t *font5x7_find(char ch)
+static void ili9341_raster_text_row(uint16_t *row, uint32_t run_w,
+                                    const font5x7_glyph_t *const *glyphs, int count,
+                                    uint8_t font_row, uint16_t color, uint16_t bg,
+                                    uint8_t scale)
 {
-    for (int i = 0; i < FONT5X7_TABLE_LEN; i++) {
-        if (font5x7_table[i].ch == ch) {
-            return &font5x7_table[i];
+    uint32_t px = 0;
+    for (int i = 0; i < count && px < run_w; i++) {
+        if (scale <= 3) {
+            // Fila ya ensanchada desde flash: un bit por píxel
+            uint32_t bits = ili9341_glyph_row_bits(glyphs[i], font_row, scale);
+            uint32_t glyph_w = FONT5X7_CHAR_W * scale;
+            for (uint32_t b = 0; b < glyph_w && px < run_w; b++) {
+                row[px++] = ((bits >> b) & 1) ? color : bg;
+            }
+        } else {
+            uint8_t bits = glyphs[i]->rows[font_row];
+            for (uint8_t col = 0; col < FONT5X7_CHAR_W && px < run_w; col++) {
+                uint16_t pixel = (bits & (1 << col)) ? color : bg;
+                for (uint8_t s = 0; s < scale && px < run_w; s++) {
+                    row[px++] = pixel;
+                }
+            }
+        }
+
+        // Columna de separación entre caracteres
+        for (uint8_t s = 0; s < scale && px < run_w; s++) {
+            row[px++] = bg;
         }
     }
-    // Fallback: espacio
-    return &font5x7_table[0];
 }
 
-void ili9341_draw_char(uint16_t x, uint16_t y, char ch,
-                       uint16_t color, uint16_t bg, uint8_t scale)
+/**
+ * Dibuja una tira de caracteres en una única línea usando UNA sola ventana.
+ *
+ * En vez de un fill_rect por cada píxel encendido, se rasteriza la tira
+ * completa fila a fila en los bloques DMA (fondo y trazo a la vez) y se
+ * envía como un flujo continuo tras un único CASET/RASET/RAMWR. En modo
+ * framebuffer las filas se rasterizan directamente sobre la RAM.
+ *
+ * La separación entre caracteres se pinta con el color de fondo; tras el
+ * último carácter no se añade separación, de modo que un único carácter
+ * ocupa exactamente 5*scale x 7*scale como antes.
+ */
+static void ili9341_draw_text_run(uint16_t x, uint16_t y, const char *text, int len,
+                                  uint16_t color, uint16_t bg, uint8_t scale)
 {
-    const font5x7_char_t *glyph = font5x7_find(ch);
+    if (len <= 0 || scale == 0) return;
+    if (x >= ILI9341_WIDTH || y >= ILI9341_HEIGHT) return;
+
+    // Ancho total de la tira y recorte contra el borde de la pantalla
+    uint32_t advance = FONT5X7_ADVANCE * scale;
+    uint32_t run_w = (uint32_t)len * advance - scale;
+    uint32_t run_h = FONT5X7_CHAR_H * scale;
+    if (x + run_w > ILI9341_WIDTH)  run_w = ILI9341_WIDTH - x;
+    if (y + run_h > ILI9341_HEIGHT) run_h = ILI9341_HEIGHT - y;
+
+    // Solo rasterizamos los caracteres que llegan a verse
+    int visible = (int)((run_w + advance - 1) / advance);
+    if (visible > len) visible = len;
+    if (visible > ILI9341_MAX_RUN_CHARS) visible = ILI9341_MAX_RUN_CHARS;
+
+    const font5x7_glyph_t *glyphs[ILI9341_MAX_RUN_CHARS];
+    for (int i = 0; i < visible; i++) {
+        glyphs[i] = font5x7_glyph(text[i]);
+    }
 
-    // Dimensiones del carácter base
-    const uint8_t char_w = 5;
-    const uint8_t char_h = 7;
+    if (ili9341_fb) {
+        // Se rasteriza con los valores del framebuffer (color o índice) y
+        // cada fila del bitmap se escribe 'scale' veces.
+        uint16_t row[ILI9341_WIDTH];
+        uint16_t fg_value = ili9341_fb_value(color);
+        uint16_t bg_value = ili9341_fb_value(bg);
+        for (uint32_t py = 0; py < run_h; py++) {
+            if (py % scale == 0) {
+                ili9341_raster_text_row(row, run_w, glyphs, visible, py / scale,
+                                        fg_value, bg_value, scale);
+            }
+            ili9341_fb_write_row(x, y + py, row, run_w);
+        }
+        ili9341_mark_dirty(x, y, run_w, run_h);
+        return;
+    }
 
-    uint16_t scaled_w = char_w * scale;
-    uint16_t scaled_h = char_h * scale;
+    ili9341_set_address_window(x, y, x + run_w - 1, y + run_h - 1);
 
-    // Pintar un fondo sólido para el carácter completo
-    ili9341_fill_rect(x, y, scaled_w, scaled_h, bg);
+    uint16_t bus_color = ili9341_to_bus(color);
+    uint16_t bus_bg = ili9341_to_bus(bg);
 
-    // Recorremos columnas y filas del bitmap
-    for (uint8_t col = 0; col < char_w; col++) {
-        uint8_t column_bits = glyph->columns[col];
-        for (uint8_t row = 0; row < char_h; row++) {
-            if (column_bits & (1 << row)) {
-                // Este píxel pertenece al trazo del carácter
-                uint16_t px = x + col * scale;
-                uint16_t py = y + row * scale;
+    // Cuántas filas de píxeles caben en un bloque DMA
+    uint32_t rows_per_block = ILI9341_BLOCK_PIXELS / run_w;
 
-                // Dibujar un bloque scale x scale para dar grosor
-                ili9341_fill_rect(px, py, scale, scale, color);
+    int block = ili9341_acquire_block();
+    uint32_t rows_in_block = 0;
+
+    for (uint32_t py = 0; py < run_h; py++) {
+        uint16_t *row = &ili9341_block_buf[block][rows_in_block * run_w];
+
+        if (py % scale != 0 && rows_in_block > 0) {
+            // Las filas repetidas por la escala son copia de la anterior
+            const uint16_t *prev = &ili9341_block_buf[block][(rows_in_block - 1) * run_w];
+            memcpy(row, prev, run_w * sizeof(uint16_t));
+        } else {
+            // Rasterizamos una fila del bitmap a lo largo de toda la tira
+            ili9341_raster_text_row(row, run_w, glyphs, visible, py / scale,
+                                    bus_color, bus_bg, scale);
+        }
+
+        rows_in_block++;
+        if (rows_in_block == rows_per_block) {
+            // Bloque lleno: sale por DMA mientras rellenamos el otro
+            ili9341_submit_block(block, rows_in_block * run_w);
+            rows_in_block = 0;
+            if (py + 1 < run_h) {
+                block = ili9341_acquire_block();
             }
         }
     }
+
+    if (rows_in_block > 0) {
+        ili9341_submit_block(block, rows_in_block * run_w);
+    }
+}
+
+void ili9341_draw_char(uint16_t x, uint16_t y, char ch,
+                       uint16_t color, uint16_t bg, uint8_t scale)
+{
+    ili9341_draw_text_run(x, y, &ch, 1, color, bg, scale);
+    ili9341_end_primitive();
 }
 
 void ili9341_draw_string(uint16_t x, uint16_t y, const char *text,
                          uint16_t color, uint16_t bg, uint8_t scale)
 {
-    // Avance horizontal entre caracteres (6 columnas: 5 + 1 espacio)
-    uint16_t advance = 6 * scale;
+    // Cada línea (hasta '\n') se envía con una única ventana
+    const char *line = text;
+    while (*line) {
+        int len = 0;
+        while (line[len] && line[len] != '\n') {
+            len++;
+        }
 
-    uint16_t cursor_x = x;
-    const char *p = text;
-    while (*p) {
-        char ch = *p;
-        if (ch == '\n') {
+        ili9341_draw_text_run(x, y, line, len, color, bg, scale);
+
+        if (line[len] == '\n') {
             // Salto de línea manual sencillo
-            cursor_x = x;
             y += (8 * scale); // 7 filas + 1 de espacio
-        } else {
-            ili9341_draw_char(cursor_x, y, ch, color, bg, scale);
-            cursor_x += advance;
+            len++;
         }
-        p++;
+        line += len;
     }
+
+    ili9341_end_primitive();
+}
+
+// -----------------------------------------------------------------------------
+//  BITMAPS RGB565
+// -----------------------------------------------------------------------------
+
+/**
+ * Zona de un bitmap que queda visible tras el recorte.
+ */
+typedef struct {
+    uint16_t dst_x, dst_y;   // esquina en pantalla
+    uint16_t src_x, src_y;   // esquina dentro del bitmap
+    uint16_t w, h;           // tamaño visible
+} ili9341_blit_t;
+
+/**
+ * Recorta el bitmap (x, y, w, h) contra el rectángulo de recorte (ya
+ * limitado a la pantalla). Devuelve false si no queda nada visible.
+ */
+static bool ili9341_clip_blit(int16_t x, int16_t y, uint16_t w, uint16_t h,
+                              int32_t clip_x0, int32_t clip_y0,
+                              int32_t clip_x1, int32_t clip_y1,
+                              ili9341_blit_t *blit)
+{
+    if (clip_x0 < 0) clip_x0 = 0;
+    if (clip_y0 < 0) clip_y0 = 0;
+    if (clip_x1 > ILI9341_WIDTH)  clip_x1 = ILI9341_WIDTH;
+    if (clip_y1 > ILI9341_HEIGHT) clip_y1 = ILI9341_HEIGHT;
+
+    int32_t x0 = (x > clip_x0) ? x : clip_x0;
+    int32_t y0 = (y > clip_y0) ? y : clip_y0;
+    int32_t x1 = ((int32_t)x + w < clip_x1) ? (int32_t)x + w : clip_x1;
+    int32_t y1 = ((int32_t)y + h < clip_y1) ? (int32_t)y + h : clip_y1;
+    if (x0 >= x1 || y0 >= y1) return false;
+
+    blit->dst_x = x0;
+    blit->dst_y = y0;
+    blit->src_x = x0 - x;
+    blit->src_y = y0 - y;
+    blit->w = x1 - x0;
+    blit->h = y1 - y0;
+    return true;
+}
+
+/**
+ * Copia una zona opaca del bitmap al framebuffer o al panel.
+ *  - stride: píxeles por fila del bitmap de origen.
+ */
+static void ili9341_blit_opaque(const ili9341_blit_t *blit, const uint16_t *pixels,
+                                uint16_t stride)
+{
+    const uint16_t *src = pixels + (uint32_t)blit->src_y * stride + blit->src_x;
+
+    if (ili9341_fb) {
+        ili9341_fb_wait_dma();
+        for (uint16_t row = 0; row < blit->h; row++, src += stride) {
+            uint16_t y = blit->dst_y + row;
+            if (ili9341_fb_format == ILI9341_FB_RGB565) {
+                uint16_t *dst = (uint16_t *)ili9341_fb + (uint32_t)y * ILI9341_WIDTH + blit->dst_x;
+                ili9341_swap_copy(dst, src, blit->w);
+            } else {
+                uint16_t values[ILI9341_WIDTH];
+                for (uint16_t i = 0; i < blit->w; i++) {
+                    values[i] = ili9341_fb_value(src[i]);
+                }
+                ili9341_fb_write_row(blit->dst_x, y, values, blit->w);
+            }
+        }
+        ili9341_mark_dirty(blit->dst_x, blit->dst_y, blit->w, blit->h);
+        return;
+    }
+
+    ili9341_set_address_window(blit->dst_x, blit->dst_y,
+                               blit->dst_x + blit->w - 1, blit->dst_y + blit->h - 1);
+
+    // Filas completas en cada bloque DMA; mientras uno sale, se llena el otro
+    uint32_t rows_per_block = ILI9341_BLOCK_PIXELS / blit->w;
+    uint16_t row = 0;
+    while (row < blit->h) {
+        int block = ili9341_acquire_block();
+        uint32_t rows = 0;
+        while (rows < rows_per_block && row < blit->h) {
+            ili9341_swap_copy(&ili9341_block_buf[block][rows * blit->w], src, blit->w);
+            src += stride;
+            rows++;
+            row++;
+        }
+        ili9341_submit_block(block, rows * blit->w);
+    }
+}
+
+void ili9341_draw_bitmap(int16_t x, int16_t y, uint16_t w, uint16_t h,
+                         const uint16_t *pixels)
+{
+    ili9341_blit_t blit;
+    if (!ili9341_clip_blit(x, y, w, h, 0, 0, ILI9341_WIDTH, ILI9341_HEIGHT, &blit)) {
+        return;
+    }
+
+    ili9341_blit_opaque(&blit, pixels, w);
+    ili9341_end_primitive();
+}
+
+void ili9341_draw_bitmap_clipped(int16_t x, int16_t y, uint16_t w, uint16_t h,
+                                 const uint16_t *pixels,
+                                 uint16_t clip_x, uint16_t clip_y,
+                                 uint16_t clip_w, uint16_t clip_h)
+{
+    ili9341_blit_t blit;
+    if (!ili9341_clip_blit(x, y, w, h, clip_x, clip_y,
+                           (int32_t)clip_x + clip_w, (int32_t)clip_y + clip_h, &blit)) {
+        return;
+    }
+
+    ili9341_blit_opaque(&blit, pixels, w);
+    ili9341_end_primitive();
+}
+
+void ili9341_draw_bitmap_transparent(int16_t x, int16_t y, uint16_t w, uint16_t h,
+                                     const uint16_t *pixels, uint16_t transparent)
+{
+    ili9341_blit_t blit;
+    if (!ili9341_clip_blit(x, y, w, h, 0, 0, ILI9341_WIDTH, ILI9341_HEIGHT, &blit)) {
+        return;
+    }
+
+    const uint16_t *src = pixels + (uint32_t)blit.src_y * w + blit.src_x;
+
+    for (uint16_t row = 0; row < blit.h; row++, src += w) {
+        uint16_t y_row = blit.dst_y + row;
+
+        // Recorremos la fila por tramos de píxeles opacos consecutivos
+        uint16_t i = 0;
+        while (i < blit.w) {
+            while (i < blit.w && src[i] == transparent) i++;
+            uint16_t start = i;
+            while (i < blit.w && src[i] != transparent) i++;
+            if (i == start) break;
+
+            ili9341_blit_t run = {
+                .dst_x = blit.dst_x + start, .dst_y = y_row,
+                .src_x = 0, .src_y = 0,
+                .w = i - start, .h = 1,
+            };
+            ili9341_blit_opaque(&run, src + start, w);
+        }
+    }
+
+    ili9341_end_primitive();
+}
+
+// -----------------------------------------------------------------------------
+//  IMÁGENES COMPRIMIDAS (ver ili9341_image.h)
+// -----------------------------------------------------------------------------
+
+/**
+ * Estado del descompresor RLE mientras recorre la imagen.
+ */
+typedef struct {
+    const uint8_t *p;          // siguiente byte por leer
+    const uint8_t *end;        // fin de los datos
+    uint8_t value_size;        // 1 (índice de paleta) o 2 (color RGB565)
+    bool raw_copy;             // los colores RLE16 se copian sin convertir
+    const uint16_t *palette;   // paleta ya convertida (solo RLE8)
+    uint16_t remaining;        // píxeles pendientes del paquete actual
+    bool run;                  // el paquete actual es una repetición
+    uint16_t run_value;        // valor ya convertido de la repetición
+} ili9341_image_cursor_t;
+
+// Paleta de la imagen en curso, ya convertida a orden de bus (o a valores
+// del framebuffer): convertir cada píxel es un simple acceso a la tabla.
+static uint16_t ili9341_image_palette[256];
+
+/**
+ * Convierte un valor leído de la imagen al que se escribe en el destino.
+ */
+static inline uint16_t ili9341_image_value(const ili9341_image_cursor_t *c, const uint8_t *p)
+{
+    if (c->value_size == 1) {
+        return c->palette[*p];
+    }
+    uint16_t color = ili9341_image_read_color(p);
+    return ili9341_fb ? ili9341_fb_value(color) : ili9341_to_bus(color);
+}
+
+/**
+ * Descomprime una fila de 'w' píxeles. Solo las columnas
+ * [out_x, out_x + out_w) se escriben en 'out'; el resto se recorre y se
+ * descarta (recorte horizontal). Con out_w = 0 la fila entera se salta.
+ *
+ * Devuelve false si los datos se acaban antes de completar la fila.
+ */
+static bool ili9341_image_decode_row(ili9341_image_cursor_t *c, uint16_t *out,
+                                     uint16_t w, uint16_t out_x, uint16_t out_w)
+{
+    uint16_t x = 0;
+    uint16_t out_end = out_x + out_w;
+
+    while (x < w) {
+        if (c->remaining == 0) {
+            if (c->p >= c->end) return false;
+            uint8_t ctrl = *c->p++;
+            c->remaining = (ctrl & 0x7F) + 1;
+            c->run = (ctrl & ILI9341_IMAGE_RUN_FLAG) != 0;
+            uint32_t needed = c->run ? c->value_size : (uint32_t)c->remaining * c->value_size;
+            if ((uint32_t)(c->end - c->p) < needed) return false;
+            if (c->run) {
+                c->run_value = ili9341_image_value(c, c->p);
+                c->p += c->value_size;
+            }
+        }
+
+        uint16_t n = (c->remaining < w - x) ? c->remaining : w - x;
+
+        // Parte de este tramo [x, x + n) que cae dentro de la zona visible
+        uint16_t from = (x > out_x) ? x : out_x;
+        uint16_t to = (x + n < out_end) ? x + n : out_end;
+
+        if (from < to) {
+            uint16_t *dst = out + (from - out_x);
+            uint16_t count = to - from;
+            const uint8_t *src = c->p + (uint32_t)(from - x) * c->value_size;
+
+            if (c->run) {
+                for (uint16_t i = 0; i < count; i++) dst[i] = c->run_value;
+            } else if (c->value_size == 1) {
+                for (uint16_t i = 0; i < count; i++) dst[i] = c->palette[src[i]];
+            } else if (c->raw_copy) {
+                memcpy(dst, src, (uint32_t)count * 2);
+            } else {
+                for (uint16_t i = 0; i < count; i++) {
+                    dst[i] = ili9341_image_value(c, src + i * 2);
+                }
+            }
+        }
+
+        if (!c->run) c->p += (uint32_t)n * c->value_size;
+        c->remaining -= n;
+        x += n;
+    }
+    return true;
+}
+
+int ili9341_draw_image(int16_t x, int16_t y, const uint8_t *image, uint32_t size)
+{
+    if (size < ILI9341_IMAGE_HEADER_SIZE ||
+        image[0] != ILI9341_IMAGE_MAGIC0 || image[1] != ILI9341_IMAGE_MAGIC1 ||
+        image[2] != ILI9341_IMAGE_VERSION) {
+        return ILI9341_IMAGE_ERR_HEADER;
+    }
+
+    uint16_t w = ili9341_image_width(image);
+    uint16_t h = ili9341_image_height(image);
+
+    ili9341_image_cursor_t c = {
+        .p = image + ILI9341_IMAGE_HEADER_SIZE,
+        .end = image + size,
+        .palette = ili9341_image_palette,
+    };
+
+    if (image[3] == ILI9341_IMAGE_RLE8) {
+        if (size < ILI9341_IMAGE_HEADER_SIZE + 1) return ILI9341_IMAGE_ERR_TRUNCATED;
+        uint16_t colors = *c.p++ + 1;
+        if ((uint32_t)(c.end - c.p) < colors * 2u) return ILI9341_IMAGE_ERR_TRUNCATED;
+
+        for (uint16_t i = 0; i < colors; i++, c.p += 2) {
+            uint16_t color = ili9341_image_read_color(c.p);
+            ili9341_image_palette[i] = ili9341_fb ? ili9341_fb_value(color) : ili9341_to_bus(color);
+        }
+        // Índices fuera de la paleta: primer color, en vez de basura
+        for (uint16_t i = colors; i < 256; i++) {
+            ili9341_image_palette[i] = ili9341_image_palette[0];
+        }
+        c.value_size = 1;
+    } else if (image[3] == ILI9341_IMAGE_RLE16) {
+        c.value_size = 2;
+        // Los colores ya vienen en orden de bus, que es también el formato
+        // del framebuffer RGB565
+        c.raw_copy = !ili9341_fb || ili9341_fb_format == ILI9341_FB_RGB565;
+    } else {
+        return ILI9341_IMAGE_ERR_HEADER;
+    }
+
+    ili9341_blit_t blit;
+    if (!ili9341_clip_blit(x, y, w, h, 0, 0, ILI9341_WIDTH, ILI9341_HEIGHT, &blit)) {
+        return ILI9341_IMAGE_OK;
+    }
+
+    // Filas por encima de la pantalla: se descomprimen sin escribir nada
+    for (uint16_t row = 0; row < blit.src_y; row++) {
+        if (!ili9341_image_decode_row(&c, NULL, w, 0, 0)) return ILI9341_IMAGE_ERR_TRUNCATED;
+    }
+
+    int result = ILI9341_IMAGE_OK;
+
+    if (ili9341_fb) {
+        uint16_t values[ILI9341_WIDTH];
+        for (uint16_t row = 0; row < blit.h; row++) {
+            if (!ili9341_image_decode_row(&c, values, w, blit.src_x, blit.w)) {
+                result = ILI9341_IMAGE_ERR_TRUNCATED;
+                break;
+            }
+            ili9341_fb_write_row(blit.dst_x, blit.dst_y + row, values, blit.w);
+        }
+        ili9341_mark_dirty(blit.dst_x, blit.dst_y, blit.w, blit.h);
+        return result;
+    }
+
+    ili9341_set_address_window(blit.dst_x, blit.dst_y,
+                               blit.dst_x + blit.w - 1, blit.dst_y + blit.h - 1);
+
+    // Cada fila visible se descomprime directamente dentro del bloque DMA
+    uint32_t rows_per_block = ILI9341_BLOCK_PIXELS / blit.w;
+    uint16_t row = 0;
+    while (row < blit.h && result == ILI9341_IMAGE_OK) {
+        int block = ili9341_acquire_block();
+        uint32_t rows = 0;
+        while (rows < rows_per_block && row < blit.h) {
+            if (!ili9341_image_decode_row(&c, &ili9341_block_buf[block][rows * blit.w],
+                                          w, blit.src_x, blit.w)) {
+                result = ILI9341_IMAGE_ERR_TRUNCATED;
+                break;
+            }
+            rows++;
+            row++;
+        }
+        ili9341_submit_block(block, rows * blit.w);
+    }
+
+    ili9341_end_primitive();
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+//  SCROLL VERTICAL POR HARDWARE
+// -----------------------------------------------------------------------------
+
+/**
+ * El panel divide sus 320 filas en tres zonas (VSCRDEF): una fija arriba
+ * (TFA), la de scroll (VSA) y otra fija abajo (BFA). VSCRSADD elige qué
+ * fila de la memoria se muestra en la primera línea de la zona de scroll,
+ * así que desplazar todo el contenido cuesta un comando de 2 parámetros.
+ *
+ * Estas zonas se cuentan en filas de la memoria del panel. Con MY activo
+ * (ver ili9341_init) la fila y de la pantalla es la fila 319 - y de la
+ * memoria: la zona fija "de arriba" del panel es la de abajo en pantalla
+ * y el scroll avanza al revés. Aquí se hace la conversión para que la API
+ * trabaje siempre en coordenadas de pantalla.
+ */
+
+static uint16_t ili9341_scroll_top;      // filas fijas arriba (en pantalla)
+static uint16_t ili9341_scroll_height;   // filas de la zona de scroll
+
+void ili9341_scroll_define(uint16_t top_fixed, uint16_t bottom_fixed)
+{
+    if (top_fixed + bottom_fixed >= ILI9341_HEIGHT) return;
+
+    ili9341_scroll_top = top_fixed;
+    ili9341_scroll_height = ILI9341_HEIGHT - top_fixed - bottom_fixed;
+
+    // En memoria las zonas fijas van al revés (MY)
+    uint16_t tfa = bottom_fixed;
+    uint16_t bfa = top_fixed;
+    uint8_t data[6] = {
+        (uint8_t)(tfa >> 8), (uint8_t)(tfa & 0xFF),
+        (uint8_t)(ili9341_scroll_height >> 8), (uint8_t)(ili9341_scroll_height & 0xFF),
+        (uint8_t)(bfa >> 8), (uint8_t)(bfa & 0xFF),
+    };
+    ili9341_send_cmd(ILI9341_CMD_VSCRDEF);
+    ili9341_send_data(data, sizeof(data));
+
+    ili9341_scroll_to(0);
+}
+
+void ili9341_scroll_to(uint16_t offset)
+{
+    if (ili9341_scroll_height == 0) return;
+
+    offset %= ili9341_scroll_height;
+
+    // Primera fila de memoria de la zona de scroll (TFA = bottom_fixed)
+    uint16_t tfa = ILI9341_HEIGHT - ili9341_scroll_top - ili9341_scroll_height;
+    uint16_t vsp = tfa + (ili9341_scroll_height - offset) % ili9341_scroll_height;
+
+    ili9341_send_cmd(ILI9341_CMD_VSCRSADD);
+    ili9341_send_data16(vsp);
+    ili9341_end_primitive();
 }
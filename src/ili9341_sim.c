@@ -0,0 +1,433 @@
+/**
+ * Emulador de ILI9341 para el backend de host
+ * -------------------------------------------
+ *
+ * Implementa los sustitutos de SPI/GPIO declarados en ili9341_sim.h y un
+ * modelo sencillo del controlador:
+ *
+ *   - Cada transacción se "envía" al instante: se llama al callback
+ *     pre-transferencia (que fija D/C), se interpretan sus bytes y queda
+ *     lista para spi_device_get_trans_result, en el mismo orden.
+ *   - D/C = 0: el primer byte es un comando. D/C = 1: parámetros del
+ *     último comando, o píxeles si el último comando fue RAMWR.
+ *   - La GRAM se guarda ya orientada como se ve en el cristal. Tomamos
+ *     como referencia la orientación que configura ili9341_init
+ *     (MY | MX | BGR): con ella (x, y) del driver = (x, y) de la captura.
+ *     Cambiar MX/MY respecto a esa referencia espeja la imagen, y quitar
+ *     BGR intercambia rojo y azul, como en el panel real.
+ *   - VSCRDEF/VSCRSADD (scroll vertical) no mueven la GRAM: solo cambian
+ *     qué fila de memoria se ve en cada línea, así que se aplican al leer
+ *     (ili9341_sim_get_pixel y las capturas).
+ *   - En modo tiempo real (ili9341_sim_set_realtime) cada transacción
+ *     ocupa el bus simulado su tiempo estimado, una detrás de otra, y
+ *     spi_device_get_trans_result espera de verdad a que "termine".
+ *
+ * Este archivo solo se compila en el host (sin ESP_PLATFORM).
+ */
+
+#ifndef ESP_PLATFORM
+
+#include <string.h>
+#include <time.h>
+
+#include "ili9341.h"
+#include "ili9341_sim.h"
+
+// Comandos que interpreta el modelo
+#define SIM_CMD_CASET   0x2A
+#define SIM_CMD_RASET   0x2B
+#define SIM_CMD_RAMWR   0x2C
+#define SIM_CMD_VSCRDEF 0x33
+#define SIM_CMD_MADCTL  0x36
+#define SIM_CMD_VSCRSADD 0x37
+
+#define SIM_MADCTL_MY   0x80
+#define SIM_MADCTL_MX   0x40
+#define SIM_MADCTL_MV   0x20
+#define SIM_MADCTL_BGR  0x08
+
+// Orientación de referencia (la que deja ili9341_init)
+#define SIM_MADCTL_REFERENCE  (SIM_MADCTL_MY | SIM_MADCTL_MX | SIM_MADCTL_BGR)
+
+// Transacciones completadas pendientes de recoger (mayor que cualquier queue_size)
+#define SIM_DONE_QUEUE_LEN  64
+
+struct ili9341_sim_device {
+    transaction_cb_t pre_cb;
+    int dc_level;
+
+    // Transacciones ya procesadas, en orden, hasta que el driver las recoja
+    spi_transaction_t *done[SIM_DONE_QUEUE_LEN];
+    uint64_t done_at_ns[SIM_DONE_QUEUE_LEN];   // fin en el bus (modo tiempo real)
+    int done_head;
+    int done_count;
+};
+
+typedef struct {
+    // Estado del controlador
+    uint8_t  cmd;               // último comando recibido
+    uint8_t  params[6];
+    int      param_count;
+    uint16_t col_start, col_end;
+    uint16_t page_start, page_end;
+    uint16_t col, page;         // puntero de escritura de RAMWR
+    uint8_t  madctl;
+    int      pixel_high_byte;   // -1 si no hay medio píxel pendiente
+
+    // Scroll vertical, en filas de memoria del panel
+    uint16_t scroll_tfa, scroll_vsa, scroll_bfa;
+    uint16_t scroll_vsp;
+
+    uint16_t gram[ILI9341_HEIGHT][ILI9341_WIDTH];
+
+    // Estimación de tiempo
+    uint32_t spi_clock_hz;
+    uint32_t trans_overhead_ns;
+    bool     realtime;
+    uint64_t bus_free_at_ns;    // CLOCK_MONOTONIC en que el bus queda libre
+
+    ili9341_sim_stats_t stats;
+} ili9341_sim_panel_t;
+
+static struct ili9341_sim_device sim_device;
+static ili9341_sim_panel_t sim_panel = {
+    .col_end = ILI9341_WIDTH - 1,
+    .page_end = ILI9341_HEIGHT - 1,
+    .madctl = SIM_MADCTL_REFERENCE,
+    .pixel_high_byte = -1,
+    .scroll_vsa = ILI9341_HEIGHT,
+    .spi_clock_hz = 40 * 1000 * 1000,
+    .trans_overhead_ns = 5000,
+};
+
+// -----------------------------------------------------------------------------
+//  MODELO DEL PANEL
+// -----------------------------------------------------------------------------
+
+/**
+ * Escribe un píxel en la posición actual de RAMWR y avanza el puntero.
+ */
+static void sim_write_pixel(uint16_t color)
+{
+    ili9341_sim_panel_t *panel = &sim_panel;
+    uint16_t x = panel->col;
+    uint16_t y = panel->page;
+
+    uint8_t relative = panel->madctl ^ SIM_MADCTL_REFERENCE;
+    if (relative & SIM_MADCTL_MV) {
+        uint16_t tmp = x;
+        x = y;
+        y = tmp;
+    }
+    if (relative & SIM_MADCTL_MX) x = ILI9341_WIDTH - 1 - x;
+    if (relative & SIM_MADCTL_MY) y = ILI9341_HEIGHT - 1 - y;
+
+    if (!(panel->madctl & SIM_MADCTL_BGR)) {
+        // Sin BGR el panel toma el rojo como azul y viceversa
+        color = (uint16_t)((color & 0x07E0) | (color >> 11) | ((color & 0x1F) << 11));
+    }
+
+    if (x < ILI9341_WIDTH && y < ILI9341_HEIGHT) {
+        panel->gram[y][x] = color;
+    }
+
+    // Avance del puntero dentro de la ventana (vuelve al inicio al acabar)
+    if (panel->col < panel->col_end) {
+        panel->col++;
+        return;
+    }
+    panel->col = panel->col_start;
+    panel->page = (panel->page < panel->page_end) ? panel->page + 1 : panel->page_start;
+}
+
+static void sim_command(uint8_t cmd)
+{
+    ili9341_sim_panel_t *panel = &sim_panel;
+    panel->cmd = cmd;
+    panel->param_count = 0;
+    panel->pixel_high_byte = -1;
+
+    if (cmd == SIM_CMD_RAMWR) {
+        panel->col = panel->col_start;
+        panel->page = panel->page_start;
+    }
+}
+
+static void sim_data(uint8_t byte)
+{
+    ili9341_sim_panel_t *panel = &sim_panel;
+
+    if (panel->cmd == SIM_CMD_RAMWR) {
+        panel->stats.pixel_bytes++;
+        if (panel->pixel_high_byte < 0) {
+            panel->pixel_high_byte = byte;
+        } else {
+            // El panel recibe primero el byte alto del RGB565
+            sim_write_pixel((uint16_t)((panel->pixel_high_byte << 8) | byte));
+            panel->pixel_high_byte = -1;
+        }
+        return;
+    }
+
+    panel->stats.param_bytes++;
+    if (panel->param_count < (int)sizeof(panel->params)) {
+        panel->params[panel->param_count] = byte;
+    }
+    panel->param_count++;
+
+    uint16_t start = (uint16_t)((panel->params[0] << 8) | panel->params[1]);
+    uint16_t end = (uint16_t)((panel->params[2] << 8) | panel->params[3]);
+
+    switch (panel->cmd) {
+    case SIM_CMD_CASET:
+        if (panel->param_count == 4) {
+            panel->col_start = start;
+            panel->col_end = end;
+        }
+        break;
+    case SIM_CMD_RASET:
+        if (panel->param_count == 4) {
+            panel->page_start = start;
+            panel->page_end = end;
+        }
+        break;
+    case SIM_CMD_MADCTL:
+        if (panel->param_count == 1) {
+            panel->madctl = byte;
+        }
+        break;
+    case SIM_CMD_VSCRDEF:
+        if (panel->param_count == 6) {
+            uint16_t tfa = start;
+            uint16_t vsa = end;
+            uint16_t bfa = (uint16_t)((panel->params[4] << 8) | panel->params[5]);
+            // El panel ignora definiciones que no suman 320 filas
+            if (tfa + vsa + bfa == ILI9341_HEIGHT && vsa > 0) {
+                panel->scroll_tfa = tfa;
+                panel->scroll_vsa = vsa;
+                panel->scroll_bfa = bfa;
+                panel->scroll_vsp = tfa;
+            }
+        }
+        break;
+    case SIM_CMD_VSCRSADD:
+        if (panel->param_count == 2) {
+            panel->scroll_vsp = start;
+        }
+        break;
+    default:
+        // Parámetros de comandos que no modelamos (PIXFMT, etc.)
+        break;
+    }
+}
+
+static uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Tiempo de bus estimado de una transacción.
+ */
+static uint64_t sim_trans_time_ns(const spi_transaction_t *t)
+{
+    return sim_panel.trans_overhead_ns +
+        (uint64_t)t->length * 1000000000ULL / sim_panel.spi_clock_hz;
+}
+
+/**
+ * Procesa una transacción completa tal como la vería el panel.
+ */
+static void sim_process(const spi_transaction_t *t, int dc)
+{
+    ili9341_sim_panel_t *panel = &sim_panel;
+    size_t len = t->length / 8;
+    const uint8_t *bytes = (t->flags & SPI_TRANS_USE_TXDATA) ? t->tx_data : t->tx_buffer;
+
+    panel->stats.transactions++;
+    panel->stats.bus_time_ns += sim_trans_time_ns(t);
+
+    for (size_t i = 0; i < len; i++) {
+        if (dc == 0) {
+            panel->stats.cmd_bytes++;
+            sim_command(bytes[i]);
+        } else {
+            sim_data(bytes[i]);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  SUSTITUTOS DE GPIO / SPI / FREERTOS
+// -----------------------------------------------------------------------------
+
+// Pin D/C del driver (ver ili9341.c). Es el único GPIO que afecta al modelo.
+#define SIM_PIN_DC  2
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(int gpio_num, uint32_t level)
+{
+    if (gpio_num == SIM_PIN_DC) {
+        sim_device.dc_level = level ? 1 : 0;
+    }
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_initialize(int host, const spi_bus_config_t *config, int dma_chan)
+{
+    (void)host;
+    (void)config;
+    (void)dma_chan;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(int host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle)
+{
+    (void)host;
+    memset(&sim_device, 0, sizeof(sim_device));
+    sim_device.pre_cb = config->pre_cb;
+    *handle = &sim_device;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans,
+                                 TickType_t timeout)
+{
+    (void)timeout;
+    if (handle->done_count == SIM_DONE_QUEUE_LEN) {
+        return ESP_FAIL;
+    }
+
+    // El "hardware" envía la transacción en el acto
+    if (handle->pre_cb) {
+        handle->pre_cb(trans);
+    }
+    sim_process(trans, handle->dc_level);
+
+    int tail = (handle->done_head + handle->done_count) % SIM_DONE_QUEUE_LEN;
+    handle->done[tail] = trans;
+    handle->done_at_ns[tail] = 0;
+    handle->done_count++;
+
+    if (sim_panel.realtime) {
+        // Empieza cuando acabe la anterior (o ya, si el bus está libre)
+        uint64_t start = sim_now_ns();
+        if (start < sim_panel.bus_free_at_ns) start = sim_panel.bus_free_at_ns;
+        sim_panel.bus_free_at_ns = start + sim_trans_time_ns(trans);
+        handle->done_at_ns[tail] = sim_panel.bus_free_at_ns;
+    }
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans,
+                                      TickType_t timeout)
+{
+    if (handle->done_count == 0) {
+        return ESP_FAIL;
+    }
+
+    uint64_t done_at = handle->done_at_ns[handle->done_head];
+    uint64_t now = sim_now_ns();
+    if (done_at > now) {
+        // Modo tiempo real: la transacción sigue "en el bus"
+        if (timeout == 0) {
+            return ESP_FAIL;
+        }
+        struct timespec ts = {
+            .tv_sec = (time_t)(done_at / 1000000000ULL),
+            .tv_nsec = (long)(done_at % 1000000000ULL),
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+        }
+    }
+
+    *trans = handle->done[handle->done_head];
+    handle->done_head = (handle->done_head + 1) % SIM_DONE_QUEUE_LEN;
+    handle->done_count--;
+    return ESP_OK;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    (void)ticks;
+}
+
+// -----------------------------------------------------------------------------
+//  API DEL EMULADOR
+// -----------------------------------------------------------------------------
+
+void ili9341_sim_configure(uint32_t spi_clock_hz, uint32_t trans_overhead_ns)
+{
+    if (spi_clock_hz > 0) {
+        sim_panel.spi_clock_hz = spi_clock_hz;
+    }
+    sim_panel.trans_overhead_ns = trans_overhead_ns;
+}
+
+void ili9341_sim_set_realtime(bool enable)
+{
+    sim_panel.realtime = enable;
+    sim_panel.bus_free_at_ns = 0;
+}
+
+void ili9341_sim_get_stats(ili9341_sim_stats_t *stats)
+{
+    *stats = sim_panel.stats;
+}
+
+void ili9341_sim_reset_stats(void)
+{
+    memset(&sim_panel.stats, 0, sizeof(sim_panel.stats));
+}
+
+uint16_t ili9341_sim_get_pixel(uint16_t x, uint16_t y)
+{
+    if (x >= ILI9341_WIDTH || y >= ILI9341_HEIGHT) return 0;
+
+    // Con la orientación de referencia (MY) la línea que barre el panel y
+    // la fila de memoria van al revés que las filas de la captura
+    const ili9341_sim_panel_t *panel = &sim_panel;
+    uint16_t line = ILI9341_HEIGHT - 1 - y;
+    uint16_t memory_row = line;
+    if (line >= panel->scroll_tfa && line < panel->scroll_tfa + panel->scroll_vsa) {
+        uint16_t vsp = panel->scroll_vsp;
+        if (vsp < panel->scroll_tfa || vsp >= panel->scroll_tfa + panel->scroll_vsa) {
+            vsp = panel->scroll_tfa;   // fuera de la zona: sin desplazamiento
+        }
+        memory_row = panel->scroll_tfa +
+            (line - panel->scroll_tfa + vsp - panel->scroll_tfa) % panel->scroll_vsa;
+    }
+    return panel->gram[ILI9341_HEIGHT - 1 - memory_row][x];
+}
+
+int ili9341_sim_dump_ppm(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) return -1;
+
+    fprintf(file, "P6\n%d %d\n255\n", ILI9341_WIDTH, ILI9341_HEIGHT);
+    for (int y = 0; y < ILI9341_HEIGHT; y++) {
+        for (int x = 0; x < ILI9341_WIDTH; x++) {
+            uint16_t c = ili9341_sim_get_pixel(x, y);
+            // Expandimos 5/6/5 bits a 8 bits por componente
+            uint8_t rgb[3] = {
+                (uint8_t)(((c >> 11) & 0x1F) * 255 / 31),
+                (uint8_t)(((c >> 5) & 0x3F) * 255 / 63),
+                (uint8_t)((c & 0x1F) * 255 / 31),
+            };
+            fwrite(rgb, 1, sizeof(rgb), file);
+        }
+    }
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+#endif // ESP_PLATFORM
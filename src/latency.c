@@ -0,0 +1,216 @@
+/**
+ * Latencia de la entrada a la pantalla
+ * ------------------------------------
+ *
+ * Ver latency.h. Cubos del histograma (4 por potencia de 2):
+ *
+ *   valor 0..3       -> cubo = valor
+ *   valor >= 4       -> msb = bit más alto, sub = 2 bits siguientes
+ *                       cubo = (msb - 1) * 4 + sub
+ *
+ * El cubo c cubre [base, base + 2^(msb-2)) con base = (4 + sub) << (msb - 2).
+ * Los contadores son atómicos: la tarea de render suma muestras mientras
+ * el juego puede estar leyendo el informe.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <time.h>
+#endif
+
+#include "latency.h"
+
+#define LATENCY_SUB_BITS  2
+#define LATENCY_SUB       (1u << LATENCY_SUB_BITS)
+
+typedef struct {
+    atomic_uint buckets[LATENCY_BUCKETS];
+    atomic_uint count;
+    atomic_uint max_us;
+    uint32_t budget_us;
+} latency_histogram_t;
+
+static latency_histogram_t latency_histograms[LATENCY_STAGE_COUNT];
+
+static const char *const latency_stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_STAGE_DISPATCH] = "gpio -> juego",
+    [LATENCY_STAGE_LOGIC]    = "juego -> render",
+    [LATENCY_STAGE_DRAW]     = "render -> panel",
+    [LATENCY_STAGE_TOTAL]    = "TOTAL",
+};
+
+// -----------------------------------------------------------------------------
+//  PROTOTIPOS de funciones internas
+// -----------------------------------------------------------------------------
+
+static unsigned latency_bucket(uint32_t value);
+static uint32_t latency_bucket_upper(unsigned bucket);
+static uint32_t latency_percentile(const latency_histogram_t *hist, uint32_t count,
+                                   uint32_t percent);
+
+// -----------------------------------------------------------------------------
+//  IMPLEMENTACIÓN
+// -----------------------------------------------------------------------------
+
+int64_t latency_now_us(void)
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static unsigned latency_bucket(uint32_t value)
+{
+    if (value < LATENCY_SUB) return value;
+
+    unsigned msb = 31 - (unsigned)__builtin_clz(value);
+    unsigned sub = (value >> (msb - LATENCY_SUB_BITS)) & (LATENCY_SUB - 1);
+    unsigned bucket = (msb - 1) * LATENCY_SUB + sub;
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+/**
+ * Mayor valor que cae en el cubo.
+ */
+static uint32_t latency_bucket_upper(unsigned bucket)
+{
+    if (bucket < LATENCY_SUB) return bucket;
+
+    unsigned msb = bucket / LATENCY_SUB + 1;
+    unsigned sub = bucket % LATENCY_SUB;
+    unsigned shift = msb - LATENCY_SUB_BITS;
+    return ((LATENCY_SUB + sub) << shift) + (1u << shift) - 1;
+}
+
+void latency_trace_begin(latency_trace_t *trace, int64_t input_us)
+{
+    for (int i = 0; i < LATENCY_POINT_COUNT; i++) {
+        trace->time_us[i] = 0;
+    }
+    trace->time_us[LATENCY_POINT_INPUT] = input_us;
+    trace->time_us[LATENCY_POINT_HANDLED] = latency_now_us();
+}
+
+void latency_trace_mark(latency_trace_t *trace, latency_point_t point)
+{
+    if (point < LATENCY_POINT_COUNT) {
+        trace->time_us[point] = latency_now_us();
+    }
+}
+
+void latency_trace_finish(const latency_trace_t *trace)
+{
+    const int64_t *t = trace->time_us;
+    latency_record(LATENCY_STAGE_DISPATCH, t[LATENCY_POINT_HANDLED] - t[LATENCY_POINT_INPUT]);
+    latency_record(LATENCY_STAGE_LOGIC, t[LATENCY_POINT_ISSUED] - t[LATENCY_POINT_HANDLED]);
+    latency_record(LATENCY_STAGE_DRAW, t[LATENCY_POINT_DISPLAYED] - t[LATENCY_POINT_ISSUED]);
+    latency_record(LATENCY_STAGE_TOTAL, t[LATENCY_POINT_DISPLAYED] - t[LATENCY_POINT_INPUT]);
+}
+
+void latency_record(latency_stage_t stage, int64_t elapsed_us)
+{
+    if (stage >= LATENCY_STAGE_COUNT) return;
+    latency_histogram_t *hist = &latency_histograms[stage];
+
+    if (elapsed_us < 0) elapsed_us = 0;
+    uint32_t value = (elapsed_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed_us;
+
+    atomic_fetch_add_explicit(&hist->buckets[latency_bucket(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+
+    unsigned max = atomic_load_explicit(&hist->max_us, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&hist->max_us, &max, value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+void latency_set_budget(latency_stage_t stage, uint32_t budget_us)
+{
+    if (stage < LATENCY_STAGE_COUNT) {
+        latency_histograms[stage].budget_us = budget_us;
+    }
+}
+
+/**
+ * Cota superior del cubo donde cae el percentil 'percent' (1..100).
+ */
+static uint32_t latency_percentile(const latency_histogram_t *hist, uint32_t count,
+                                   uint32_t percent)
+{
+    // Rango de la muestra buscada, redondeando hacia arriba (p99 de 10 = la 10ª)
+    uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    if (rank == 0) rank = 1;
+
+    uint32_t seen = 0;
+    for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        if (seen >= rank) {
+            return latency_bucket_upper(i);
+        }
+    }
+    return latency_bucket_upper(LATENCY_BUCKETS - 1);
+}
+
+void latency_get_summary(latency_stage_t stage, latency_summary_t *summary)
+{
+    summary->count = 0;
+    summary->p50_us = summary->p99_us = summary->max_us = 0;
+    if (stage >= LATENCY_STAGE_COUNT) return;
+
+    const latency_histogram_t *hist = &latency_histograms[stage];
+    summary->count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    summary->max_us = atomic_load_explicit(&hist->max_us, memory_order_relaxed);
+    if (summary->count == 0) return;
+
+    summary->p50_us = latency_percentile(hist, summary->count, 50);
+    summary->p99_us = latency_percentile(hist, summary->count, 99);
+
+    // El cubo puede pasarse del máximo real: nunca se informa por encima
+    if (summary->p50_us > summary->max_us) summary->p50_us = summary->max_us;
+    if (summary->p99_us > summary->max_us) summary->p99_us = summary->max_us;
+}
+
+void latency_report(void)
+{
+    printf("Latencia entrada -> pantalla (us)\n");
+    printf("  %-16s %8s %8s %8s %8s %10s\n",
+           "etapa", "n", "p50", "p99", "max", "presup.");
+
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        latency_summary_t summary;
+        latency_get_summary((latency_stage_t)stage, &summary);
+        uint32_t budget = latency_histograms[stage].budget_us;
+
+        printf("  %-16s %8u %8u %8u %8u", latency_stage_names[stage],
+               (unsigned)summary.count, (unsigned)summary.p50_us,
+               (unsigned)summary.p99_us, (unsigned)summary.max_us);
+        if (budget == 0) {
+            printf(" %10s\n", "-");
+        } else {
+            printf(" %10u%s\n", (unsigned)budget,
+                   summary.p99_us > budget ? "  SUPERADO" : "");
+        }
+    }
+}
+
+void latency_reset(void)
+{
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        latency_histogram_t *hist = &latency_histograms[stage];
+        for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+            atomic_store_explicit(&hist->buckets[i], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&hist->count, 0, memory_order_relaxed);
+        atomic_store_explicit(&hist->max_us, 0, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,413 @@
+#include <string.h>
+#include "link.h"
+
+static bool initialized = false;
+static link_config config;
+static link_peer peers[LINK_MAX_PEERS];
+static uint32_t local_id = 0;
+
+// Lowest SNR each spreading factor still demodulates (SX1276/77/78 datasheet)
+static float snrFloor(uint8_t spreading_factor){
+
+    return -7.5f - 2.5f * (float)(spreading_factor - 7);
+}
+
+static uint8_t encodeRate(uint8_t spreading_factor, uint8_t coding_rate){
+
+    return (uint8_t)((spreading_factor << 4) | (coding_rate & 0x0F));
+}
+
+static sx1278_rate_t baseRate(void){
+
+    sx1278_rate_t base = config.base;
+    if(base.spreading_factor == 0){
+        base = sx1278_config_rate();
+    }
+    if(base.spreading_factor == 0){
+        base = (sx1278_rate_t){ 7, 5 }; // radio not started: its default
+    }
+    return base;
+}
+
+void linkInit(const link_config *new_config){
+
+    static const link_config default_config = LINK_CONFIG_DEFAULT;
+    config = new_config != NULL ? *new_config : default_config;
+    if(config.fallback_failures == 0){
+        config.fallback_failures = 1;
+    }
+    memset(peers, 0, sizeof(peers));
+    initialized = true;
+}
+
+void linkSetLocalId(uint32_t id){
+
+    local_id = id;
+}
+
+static void ensureInit(void){
+
+    if(!initialized){
+        linkInit(NULL);
+    }
+}
+
+static link_peer *findPeer(uint32_t peer){
+
+    for(size_t index = 0; index < LINK_MAX_PEERS; index++){
+        if(peers[index].in_use && peers[index].peer == peer){
+            return &peers[index];
+        }
+    }
+    return NULL;
+}
+
+// Known peer, or a fresh entry at base in place of the one heard from longest ago
+static link_peer *takePeer(uint32_t peer){
+
+    link_peer *entry = findPeer(peer);
+    if(entry != NULL){
+        return entry;
+    }
+    entry = &peers[0];
+    for(size_t index = 0; index < LINK_MAX_PEERS; index++){
+        if(!peers[index].in_use){
+            entry = &peers[index];
+            break;
+        }
+        if(peers[index].last_heard_us < entry->last_heard_us){
+            entry = &peers[index];
+        }
+    }
+    sx1278_rate_t base = baseRate();
+    memset(entry, 0, sizeof(*entry));
+    entry->in_use = true;
+    entry->peer = peer;
+    entry->spreading_factor = base.spreading_factor;
+    entry->coding_rate = base.coding_rate;
+    return entry;
+}
+
+static void backToBase(link_peer *entry){
+
+    sx1278_rate_t base = baseRate();
+    entry->spreading_factor = base.spreading_factor;
+    entry->offered = 0;
+    entry->previous = 0;
+    entry->answering = false;
+    entry->accepted = false;
+    entry->fallback_from = 0;
+    entry->failures = 0;
+    entry->stats.loss = 0;
+}
+
+static void switchTo(link_peer *entry, uint8_t spreading_factor){
+
+    entry->spreading_factor = spreading_factor;
+    entry->offered = 0;
+    entry->failures = 0;
+    entry->stats.loss = 0; // measured at the old rate
+    entry->stats.rate_changes++;
+}
+
+void linkService(int64_t now_us){
+
+    ensureInit();
+    uint8_t base = baseRate().spreading_factor;
+
+    for(size_t index = 0; index < LINK_MAX_PEERS; index++){
+        link_peer *entry = &peers[index];
+        if(!entry->in_use){
+            continue;
+        }
+        int64_t hold_us = (int64_t)config.hold_ms * 1000;
+        if(entry->accepted){
+            hold_us += (int64_t)LINK_ACCEPTOR_GUARD_MS * 1000;
+        }
+        if(entry->spreading_factor != base && now_us - entry->last_heard_us > hold_us){
+            backToBase(entry);
+        }
+        if(entry->blocked != 0 && now_us >= entry->blocked_until_us){
+            entry->blocked = 0;
+        }
+    }
+}
+
+// Spreading factor the SNR and the loss ask for
+static uint8_t wantedSpreadingFactor(const link_peer *entry){
+
+    if(entry->stats.frames_heard == 0){
+        return entry->spreading_factor;
+    }
+
+    uint8_t wanted = config.max_spreading_factor;
+    for(uint8_t spreading_factor = config.min_spreading_factor;
+        spreading_factor <= config.max_spreading_factor; spreading_factor++){
+        if(entry->stats.snr_db >= snrFloor(spreading_factor) + config.snr_margin_db){
+            wanted = spreading_factor;
+            break;
+        }
+    }
+    // Slower only once clearly below the margin of the current one
+    if(wanted > entry->spreading_factor &&
+       entry->stats.snr_db >= snrFloor(entry->spreading_factor) + config.snr_margin_db - config.snr_hysteresis_db){
+        wanted = entry->spreading_factor;
+    }
+    if(entry->blocked != 0 && wanted <= entry->blocked){
+        wanted = (uint8_t)(entry->blocked + 1);
+    }
+    return wanted > config.max_spreading_factor ? config.max_spreading_factor : wanted;
+}
+
+static void average(float *value, float sample, bool first){
+
+    *value = first ? sample : *value + LINK_AVERAGE_WEIGHT * (sample - *value);
+}
+
+void linkObserveFrame(const uint8_t *frame, size_t frame_length, int16_t rssi_dbm, float snr_db, int64_t now_us){
+
+    ensureInit();
+
+    packet_view view;
+    if(packetDecode(frame, frame_length, &view) != PACKET_OK){
+        return;
+    }
+    // A relayed copy (mesh.h) tells about the relay, not the origin
+    uint32_t peer = view.has_mesh ? view.mesh.hop_id : view.header.transmitter_id;
+    bool for_us = view.has_mesh || view.header.receiver_id == local_id;
+    link_peer *entry = for_us ? takePeer(peer) : findPeer(peer);
+    if(entry == NULL){
+        return;
+    }
+    bool first = entry->stats.frames_heard == 0;
+    average(&entry->stats.rssi_dbm, (float)rssi_dbm, first);
+    average(&entry->stats.snr_db, snr_db, first);
+    entry->stats.frames_heard++;
+    if(!for_us){
+        // Overheard: the signal is the peer's, the rate it offers or
+        // answers belongs to another conversation
+        return;
+    }
+    entry->last_heard_us = now_us;
+
+    if(view.has_mesh){
+        return;
+    }
+    if(!view.has_rate){
+        // Heard at the new rate without an offer: the sender got the answer
+        if(entry->answer_sent){
+            entry->answering = false;
+        }
+        return;
+    }
+    uint8_t spreading_factor = view.rate >> 4;
+    if(spreading_factor < 7 || spreading_factor > 12){
+        return;
+    }
+
+    if(view.header.packet_type == PACKET_TYPE_ACK){
+        // Answer to an offer of ours: the peer listens there now, even if
+        // we have changed our mind since
+        if(spreading_factor != entry->spreading_factor){
+            entry->accepted = false;
+            switchTo(entry, spreading_factor);
+        }
+        entry->offered = 0;
+        return;
+    }
+    if(view.header.packet_type == PACKET_TYPE_FRAGMENT){
+        // Offer: switch now, the answer goes at the old rate
+        if(spreading_factor != entry->spreading_factor){
+            entry->previous = entry->spreading_factor;
+            entry->accepted = true;
+            entry->answer_sent = false;
+            switchTo(entry, spreading_factor);
+        } else if(entry->answer_sent){
+            // Heard at the new rate: the sender moved without the answer
+            // (linkReportTimeout), so it listens there too
+            entry->previous = spreading_factor;
+        }
+        entry->answering = true;
+    }
+}
+
+static void block(link_peer *entry, uint8_t spreading_factor, int64_t now_us){
+
+    if(spreading_factor > entry->blocked){
+        entry->blocked = spreading_factor;
+    }
+    entry->blocked_until_us = now_us + (int64_t)config.holddown_ms * 1000;
+}
+
+static void reportLoss(link_peer *entry, unsigned sent, unsigned lost, int64_t now_us){
+
+    if(sent == 0){
+        return;
+    }
+    bool first = entry->stats.fragments_sent == 0;
+    average(&entry->stats.loss, (float)lost / (float)sent, first);
+    entry->stats.fragments_sent += sent;
+    entry->stats.fragments_lost += lost;
+
+    sx1278_rate_t base = baseRate();
+    if(entry->stats.loss > config.loss_low && entry->coding_rate < 8){
+        entry->coding_rate++;
+    } else if(entry->stats.loss < config.loss_low / 2 && entry->coding_rate > base.coding_rate){
+        entry->coding_rate--;
+    }
+    // Losing frames with all the redundancy already on: this rate is out
+    // for a while, whatever the SNR says
+    if(entry->stats.loss > config.loss_high && entry->coding_rate >= 8 &&
+       entry->spreading_factor < config.max_spreading_factor){
+        block(entry, entry->spreading_factor, now_us);
+    }
+}
+
+void linkReportAck(uint32_t peer, unsigned sent, unsigned delivered, int64_t now_us){
+
+    ensureInit();
+
+    link_peer *entry = takePeer(peer);
+    entry->failures = 0;
+    entry->fallback_from = 0;
+    reportLoss(entry, sent, delivered < sent ? sent - delivered : 0, now_us);
+}
+
+void linkReportTimeout(uint32_t peer, unsigned sent, int64_t now_us){
+
+    ensureInit();
+
+    link_peer *entry = takePeer(peer);
+    reportLoss(entry, sent, sent, now_us);
+    if(++entry->failures < config.fallback_failures){
+        return;
+    }
+
+    if(entry->offered != 0){
+        // Maybe only the answer got lost and the peer already switched
+        switchTo(entry, entry->offered);
+        return;
+    }
+    uint8_t base = baseRate().spreading_factor;
+    if(entry->spreading_factor != base){
+        uint8_t agreed = entry->spreading_factor;
+        if(agreed < base){
+            block(entry, agreed, now_us);
+        }
+        backToBase(entry);
+        entry->fallback_from = agreed;
+        entry->stats.fallbacks++;
+        return;
+    }
+    if(entry->fallback_from != 0){
+        // Not heard at base either: the peer may still be at the agreed
+        // rate (a lost round, not a lost link) until its hold runs out
+        entry->spreading_factor = entry->fallback_from;
+        entry->failures = 0;
+    }
+}
+
+int linkAttachRate(uint8_t *frame, size_t length, size_t frame_size, size_t *packet_length){
+
+    ensureInit();
+    *packet_length = length;
+
+    packet_view view;
+    int error = packetDecode(frame, length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    link_peer *entry = findPeer(view.header.receiver_id);
+    if(entry == NULL || view.has_rate || view.has_mesh){
+        return PACKET_OK;
+    }
+
+    if(view.header.packet_type == PACKET_TYPE_ACK){
+        if(!entry->answering){
+            return PACKET_OK;
+        }
+        entry->answer_sent = true;
+        return packetAttachRate(frame, length, frame_size, encodeRate(entry->spreading_factor, entry->coding_rate),
+                                packet_length);
+    }
+    if(view.header.packet_type != PACKET_TYPE_FRAGMENT){
+        return PACKET_OK;
+    }
+
+    // Looking for the peer after a fallback: an offer it cannot hear would
+    // only send the next try to the wrong rate
+    uint8_t wanted = wantedSpreadingFactor(entry);
+    if(wanted == entry->spreading_factor || entry->fallback_from != 0){
+        entry->offered = 0;
+        return PACKET_OK;
+    }
+    entry->offered = wanted;
+    return packetAttachRate(frame, length, frame_size, encodeRate(wanted, entry->coding_rate), packet_length);
+}
+
+void linkFrameRate(const uint8_t *frame, size_t frame_length, sx1278_rate_t *rate){
+
+    ensureInit();
+    *rate = baseRate();
+
+    packet_view view;
+    if(packetDecode(frame, frame_length, &view) != PACKET_OK || view.has_mesh){
+        return; // floods go where every node listens
+    }
+    linkPeerRate(view.header.receiver_id, rate);
+
+    // The answer to an offer goes where the sender still listens
+    const link_peer *entry = findPeer(view.header.receiver_id);
+    if(entry != NULL && view.header.packet_type == PACKET_TYPE_ACK && view.has_rate && entry->previous != 0){
+        rate->spreading_factor = entry->previous;
+    }
+}
+
+uint32_t linkAirtimeUs(const uint8_t *frame, size_t frame_length){
+
+    sx1278_rate_t rate;
+    linkFrameRate(frame, frame_length, &rate);
+    return sx1278_airtime_rate_us(frame_length, &rate);
+}
+
+void linkPeerRate(uint32_t peer, sx1278_rate_t *rate){
+
+    ensureInit();
+    *rate = baseRate();
+
+    const link_peer *entry = findPeer(peer);
+    if(entry != NULL){
+        rate->spreading_factor = entry->spreading_factor;
+        rate->coding_rate = entry->coding_rate;
+    }
+}
+
+void linkListenRate(sx1278_rate_t *rate){
+
+    ensureInit();
+    *rate = baseRate();
+
+    const link_peer *latest = NULL;
+    for(size_t index = 0; index < LINK_MAX_PEERS; index++){
+        if(peers[index].in_use && (latest == NULL || peers[index].last_heard_us > latest->last_heard_us)){
+            latest = &peers[index];
+        }
+    }
+    if(latest == NULL){
+        return;
+    }
+    // Until the answer is out the sender is still at the old rate
+    rate->spreading_factor = latest->answering && !latest->answer_sent && latest->previous != 0
+        ? latest->previous : latest->spreading_factor;
+}
+
+bool linkGetPeer(uint32_t peer, link_peer *out){
+
+    ensureInit();
+    const link_peer *entry = findPeer(peer);
+    if(entry == NULL){
+        return false;
+    }
+    *out = *entry;
+    return true;
+}
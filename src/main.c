@@ -5,8 +5,10 @@
  * Este archivo es un TEMPLATE didáctico, pensado para que entiendas:
  *  - Cómo se inicializa el ESP32 (FreeRTOS, app_main).
  *  - Cómo se configura el bus SPI y el driver de una pantalla ILI9341.
- *  - Cómo leer 4 botones físicos (↑ ↓ ← →).
- *  - Cómo estructurar un minijuego con máquina de estados.
+ *  - Cómo leer 4 botones físicos (↑ ↓ ← →) por interrupción.
+ *  - Cómo estructurar un minijuego como máquina de estados dirigida por
+ *    eventos: la tarea duerme (y el chip entra en light sleep) hasta la
+ *    siguiente pulsación o temporizador.
  *
  * IMPORTANTE:
  *  - TODO está escrito en C (no C++).
@@ -20,54 +22,37 @@
 #include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_timer.h"     // Para obtener tiempo en microsegundos
 #include "esp_system.h"    // esp_random()
 #include "esp_random.h"
 
 #include "ili9341.h"       // Nuestro driver de pantalla (en C)
+#include "game_ui.h"       // Pantallas del minijuego
+#include "render.h"        // Tarea de render (dibuja en el otro núcleo)
+#include "buttons.h"       // Botones por interrupción
+#include "event_loop.h"    // Espera de eventos con light sleep
+#include "latency.h"       // Latencia pulsación -> panel
+#include "sx1278.h"        // Radio LoRa por interrupciones
+#include "scheduler.h"     // Cola de transmisión: prioridades, duty cycle y LBT
+#include "link.h"          // Velocidad de datos por vecino según la calidad del enlace
 
 // TAG para logs por puerto serie
 static const char *TAG = "STRATAGEM_HERO";
 
-// -----------------------------------------------------------------------------
-//  Configuración de pines para los BOTONES (ajusta a tu hardware)
-// -----------------------------------------------------------------------------
-// Se asume: botones conectados a GND y GPIO con resistencia PULLUP interna.
-//  - Cuando NO se pulsa -> nivel lógico 1.
-//  - Cuando se pulsa    -> nivel lógico 0.
-
-#define BTN_UP_GPIO     GPIO_NUM_32
-#define BTN_DOWN_GPIO   GPIO_NUM_33
-#define BTN_LEFT_GPIO   GPIO_NUM_25
-#define BTN_RIGHT_GPIO  GPIO_NUM_26
-
 // -----------------------------------------------------------------------------
 //  Definiciones del JUEGO
 // -----------------------------------------------------------------------------
 
-// Direcciones posibles (coinciden con el enunciado)
+// Máquina de estados del minijuego. Cada estado solo reacciona a eventos
+// (pulsaciones y temporizadores); entre eventos la tarea está dormida.
 typedef enum {
-    DIR_UP = 0,
-    DIR_DOWN,
-    DIR_LEFT,
-    DIR_RIGHT
-} Direction;
-
-// Máquina de estados del minijuego
-typedef enum {
-    GAME_MENU_INIT = 0,  // Mostrar "Pulsa para empezar"
-    GAME_GEN_SEQ,        // Generar secuencia aleatoria
+    GAME_MENU = 0,       // "Pulsa para empezar": espera cualquier dirección
     GAME_SHOW_SEQ,       // Mostrar secuencia al jugador
     GAME_WAIT_INPUT,     // Leer direcciones y compararlas
     GAME_RESULT          // Mostrar ÉXITO / FALLO
 } GameState;
 
-// Tamaño máximo de la secuencia
-#define MAX_SEQ_LENGTH   6
-
 // Límite mínimo y máximo de longitud de secuencia
 #define MIN_SEQ_LENGTH   3
 #define MAX_SEQ_LENGTH   6
@@ -75,31 +60,83 @@ typedef enum {
 // Tiempo máximo para introducir la secuencia (en milisegundos)
 #define INPUT_TIME_LIMIT_MS  10000  // 10 s
 
-// para UI (layout muy simple)
-#define COLOR_BG      ILI9341_COLOR_BLACK
-#define COLOR_TEXT    ILI9341_COLOR_WHITE
-#define COLOR_GOOD    ILI9341_COLOR_GREEN
-#define COLOR_BAD     ILI9341_COLOR_RED
-#define COLOR_INFO    ILI9341_COLOR_YELLOW
-
-// Área de texto principal
-#define TEXT_LINE_HEIGHT   16  // depende del tamaño de fuente 8x8 escalada x2
+// Tiempo que se muestra la secuencia y el resultado
+#define SHOW_SEQ_TIME_MS     2000
+#define RESULT_TIME_MS       2500
+
+// El reloj muestra décimas: solo se redibuja cuando cambia la cifra
+#define CLOCK_STEP_MS        100
+
+// Presupuestos de latencia pulsación -> panel (p99). El total incluye el
+// cambio a la pantalla de la secuencia, que la redibuja entera (~32 ms
+// de bus a 40 MHz).
+#define LATENCY_BUDGET_DISPATCH_US   1000
+#define LATENCY_BUDGET_TOTAL_US     50000
+
+// Id de este nodo en la red LoRa: el receiver_id de los frames que le
+// llegan. Lo que otros nodos se dicen entre ellos no cambia nuestras
+// velocidades acordadas
+#ifndef RADIO_NODE_ID
+#define RADIO_NODE_ID        1
+#endif
+
+// Cada cuánto se revisan los acuerdos de velocidad aunque no llegue nada
+#define RADIO_LINK_PERIOD_MS 1000
+
+// Temporizadores del bucle de eventos
+enum {
+    GAME_TIMER_SHOW_SEQ = 0,  // fin de la pantalla con la secuencia
+    GAME_TIMER_CLOCK,         // siguiente cambio del reloj en pantalla
+    GAME_TIMER_DEADLINE,      // se acabó el tiempo para responder
+    GAME_TIMER_RESULT,        // vuelta al menú
+    RADIO_TIMER_LINK,         // repaso de los acuerdos de velocidad
+    RADIO_TIMER_SCHEDULER,    // el planificador puede pasar otro frame a la radio
+};
+
+typedef struct {
+    GameState state;
+    Direction sequence[MAX_SEQ_LENGTH];     // Secuencia objetivo
+    int length;
+    int current_index;                      // Progreso dentro de sequence[]
+    int64_t state_start_us;                 // Cuándo se entró en el estado
+    int64_t input_deadline_us;              // Fin del tiempo para responder
+} game_t;
 
 // -----------------------------------------------------------------------------
 //  PROTOTIPOS de funciones internas
 // -----------------------------------------------------------------------------
 
-static void buttons_init(void);
-static int  button_is_pressed(gpio_num_t gpio_num);
-static Direction wait_for_any_direction(TickType_t timeout_ticks, int *pressed);
-
-static void game_draw_menu_screen(void);
-static void game_draw_sequence(Direction *seq, int length);
-static void game_draw_input_progress(Direction *seq, int length, int current_index);
-static void game_draw_timer(uint32_t remaining_ms);
-static void game_draw_result(int success);
-
-static const char *direction_to_char(Direction d);
+static void game_enter_menu(game_t *game);
+static void game_start_round(game_t *game);
+static void game_enter_input(game_t *game);
+static void game_update_clock(game_t *game, int64_t now_us);
+static void game_finish(game_t *game, int won);
+static void game_handle_event(game_t *game, const app_event_t *event);
+static void radio_service_link(int64_t now_us);
+static void radio_service_scheduler(int64_t now_us);
+
+static void draw_menu_screen_cmd(const void *arg);
+static void draw_show_sequence_cmd(const void *arg);
+static void draw_input_screen_cmd(const void *arg);
+static void draw_timer_cmd(const void *arg);
+static void draw_input_progress_cmd(const void *arg);
+static void draw_result_cmd(const void *arg);
+
+// Argumentos de las pantallas que muestran la secuencia. Se copian dentro
+// del comando de render, así que el juego puede seguir cambiándola.
+typedef struct {
+    Direction sequence[MAX_SEQ_LENGTH];
+    int length;
+    int progress;
+} sequence_draw_arg_t;
+
+_Static_assert(sizeof(sequence_draw_arg_t) <= RENDER_CALL_ARG_MAX,
+               "sequence_draw_arg_t no cabe en un comando de render");
+
+// Los eventos de botón se traducen a Direction por su número
+_Static_assert(BUTTON_UP == (int)DIR_UP && BUTTON_DOWN == (int)DIR_DOWN &&
+               BUTTON_LEFT == (int)DIR_LEFT && BUTTON_RIGHT == (int)DIR_RIGHT,
+               "button_id_t y Direction deben ir en el mismo orden");
 
 // -----------------------------------------------------------------------------
 //  INICIALIZACIÓN DE HARDWARE Y ARRANQUE DEL JUEGO
@@ -111,367 +148,357 @@ static const char *direction_to_char(Direction d);
  * Punto de entrada en ESP-IDF. Aquí:
  *  - Inicializamos logs.
  *  - Inicializamos la pantalla ILI9341.
- *  - Configuramos los pines de los botones.
- *  - Entramos en el bucle principal del minijuego.
+ *  - Arrancamos el bucle de eventos y los botones.
+ *  - Procesamos eventos del minijuego para siempre.
  */
 void app_main(void)
 {
-    // Pequeño retardo al arranque (suele ser útil al flashear)
-    vTaskDelay(pdMS_TO_TICKS(5000));
-
     ESP_LOGI(TAG, "Iniciando Stratagem Hero (MVP)...");
 
     // 1. Inicializar pantalla ILI9341 (SPI + comandos de inicio)
     ili9341_init();
 
+    // Las primitivas solo encolan DMA: el juego sigue mientras el bus trabaja
+    ili9341_set_async(true);
+
+    // Dibujamos sobre un framebuffer y enviamos solo lo que cambia. La UI
+    // solo usa la paleta básica, así que 4 bits/píxel bastan (37,5 KB).
+    // Si no hay RAM suficiente, el driver sigue dibujando directo al panel.
+    ili9341_framebuffer_enable(ILI9341_FB_INDEXED4);
+
+    // A partir de aquí solo la tarea de render (núcleo 1) toca la pantalla:
+    // este bucle encola comandos y nunca espera al bus SPI
+    if (!render_start()) {
+        ESP_LOGE(TAG, "No se pudo arrancar la tarea de render");
+        return;
+    }
+
     // Limpiar pantalla con un color de fondo
-    ili9341_fill_screen(COLOR_BG);
-
-    // 2. Inicializar botones
-    buttons_init();
-
-    // 3. Variables del juego
-    Direction sequence[MAX_SEQ_LENGTH];        // Secuencia objetivo
-    int seq_length = 3;                        // Empezamos con 3 pasos
-    GameState state = GAME_MENU_INIT;          // Estado inicial
-    int running = 1;                           // Por si quisieras salir algún día
-
-    // 4. Bucle principal del juego (máquina de estados)
-    while (running) {
-        switch (state) {
-        case GAME_MENU_INIT: {
-            // Pantalla de bienvenida
-            game_draw_menu_screen();
-
-            ESP_LOGI(TAG, "Esperando que el jugador pulse cualquier dirección...");
-
-            // Espera bloqueante hasta que pulse cualquiera de los cuatro botones
-            int pressed = 0;
-            (void)wait_for_any_direction(portMAX_DELAY, &pressed);
-            if (pressed) {
-                // Siguiente estado: generar nueva secuencia
-                state = GAME_GEN_SEQ;
-            }
-            break;
-        }
+    render_fill_screen(COLOR_BG);
+    render_present();
+
+    // 2. Bucle de eventos (y gestor de energía) antes que los botones,
+    //    que publican en él desde su interrupción
+    if (!event_loop_init()) {
+        ESP_LOGE(TAG, "No se pudo crear el bucle de eventos");
+        return;
+    }
 
-        case GAME_GEN_SEQ: {
-            // Longitud aleatoria entre MIN_SEQ_LENGTH y MAX_SEQ_LENGTH
-            uint32_t r = esp_random();
-            seq_length = MIN_SEQ_LENGTH + (r % (MAX_SEQ_LENGTH - MIN_SEQ_LENGTH + 1));
+    if (!buttons_init()) {
+        ESP_LOGE(TAG, "No se pudieron inicializar los botones");
+        return;
+    }
 
-            ESP_LOGI(TAG, "Generando secuencia de longitud %d", seq_length);
+    // La radio comparte el bus SPI de la pantalla y publica en el bucle de
+    // eventos. Es opcional: sin módulo conectado el juego funciona igual
+    if (!sx1278_init(NULL)) {
+        ESP_LOGW(TAG, "Radio SX1278 no disponible");
+    } else {
+        // Un acuerdo caduca aunque el vecino calle: sin este repaso la
+        // radio podría quedarse sorda a la velocidad base para siempre
+        event_loop_start_timer(RADIO_TIMER_LINK, RADIO_LINK_PERIOD_MS);
+    }
+    linkSetLocalId(RADIO_NODE_ID);
 
-            for (int i = 0; i < seq_length; i++) {
-                // esp_random() devuelve 32 bits, tomamos los 2 LSB para obtener [0..3]
-                sequence[i] = (Direction)(esp_random() % 4);
-            }
+    latency_set_budget(LATENCY_STAGE_DISPATCH, LATENCY_BUDGET_DISPATCH_US);
+    latency_set_budget(LATENCY_STAGE_TOTAL, LATENCY_BUDGET_TOTAL_US);
 
-            state = GAME_SHOW_SEQ;
-            break;
-        }
+    // 3. Bucle principal: dormir hasta el siguiente evento y procesarlo
+    game_t game = {0};
+    game_enter_menu(&game);
 
-        case GAME_SHOW_SEQ: {
-            // Mostramos la secuencia para que el jugador la memorice
-            ESP_LOGI(TAG, "Mostrando secuencia al jugador");
+    while (1) {
+        app_event_t event;
+        event_loop_wait(&event);
+        game_handle_event(&game, &event);
+    }
+}
 
-            ili9341_fill_screen(COLOR_BG);
+// -----------------------------------------------------------------------------
+//  IMPLEMENTACIÓN: MÁQUINA DE ESTADOS
+// -----------------------------------------------------------------------------
 
-            // Texto cabecera
-            ili9341_draw_string(10, 10, "SECUENCIA:", COLOR_INFO, COLOR_BG, 2);
+static void game_set_state(game_t *game, GameState state)
+{
+    game->state = state;
+    game->state_start_us = esp_timer_get_time();
+}
 
-            // Dibuja la secuencia como letras U, D, L, R
-            game_draw_sequence(sequence, seq_length);
+/**
+ * Pantalla de bienvenida. También es el momento de enseñar cuánto ha
+ * dormido el chip desde el arranque.
+ */
+static void game_enter_menu(game_t *game)
+{
+    game_set_state(game, GAME_MENU);
 
-            // Pausa unos segundos para que el jugador la vea
-            vTaskDelay(pdMS_TO_TICKS(2000));
+    render_call(draw_menu_screen_cmd, NULL, 0);
+    render_present();
 
-            // Limpia parcialmente para el modo de input
-            ili9341_fill_screen(COLOR_BG);
-            ili9341_draw_string(10, 10, "INTRODUCE LA SECUENCIA", COLOR_INFO, COLOR_BG, 2);
-            ili9341_draw_string(10, 10 + TEXT_LINE_HEIGHT * 2, "TU INPUT:", COLOR_TEXT, COLOR_BG, 2);
+    event_loop_report();
+    latency_report();
+    ESP_LOGI(TAG, "Esperando que el jugador pulse cualquier dirección...");
+}
 
-            state = GAME_WAIT_INPUT;
-            break;
-        }
+/**
+ * Genera una secuencia aleatoria y la muestra SHOW_SEQ_TIME_MS.
+ */
+static void game_start_round(game_t *game)
+{
+    // Longitud aleatoria entre MIN_SEQ_LENGTH y MAX_SEQ_LENGTH
+    uint32_t r = esp_random();
+    game->length = MIN_SEQ_LENGTH + (r % (MAX_SEQ_LENGTH - MIN_SEQ_LENGTH + 1));
 
-        case GAME_WAIT_INPUT: {
-            ESP_LOGI(TAG, "Esperando entradas del jugador...");
-
-            int current_index = 0;    // Progreso dentro de sequence[]
-            int success = 1;          // Suponemos éxito hasta que falle
-
-            // Tiempo de inicio (en microsegundos)
-            int64_t start_us = esp_timer_get_time();
-            int64_t limit_us = (int64_t)INPUT_TIME_LIMIT_MS * 1000;
-
-            while (current_index < seq_length) {
-                int64_t now_us = esp_timer_get_time();
-                int64_t elapsed_us = now_us - start_us;
-
-                if (elapsed_us >= limit_us) {
-                    // Se acabó el tiempo
-                    ESP_LOGW(TAG, "Tiempo agotado");
-                    success = 0;
-                    break;
-                }
-
-                // Tiempo restante en ms (para dibujar temporizador)
-                uint32_t remaining_ms = (uint32_t)((limit_us - elapsed_us) / 1000);
-                game_draw_timer(remaining_ms);
-
-                // Esperamos a que se pulse algún botón, pero con timeout pequeño
-                int pressed = 0;
-                Direction d = wait_for_any_direction(pdMS_TO_TICKS(50), &pressed);
-                if (!pressed) {
-                    // No se ha pulsado nada en este slice de 50 ms, seguimos
-                    continue;
-                }
-
-                // Comprobamos si coincide con la secuencia objetivo
-                if (d == sequence[current_index]) {
-                    ESP_LOGI(TAG, "Paso %d correcto", current_index + 1);
-                    current_index++;
-                    // Actualizamos la representación gráfica del input
-                    game_draw_input_progress(sequence, seq_length, current_index);
-                } else {
-                    ESP_LOGI(TAG, "Paso %d INCORRECTO", current_index + 1);
-                    success = 0;
-                    break;
-                }
-            }
-
-            // Hemos salido del bucle: o completó secuencia, o fallo, o timeout
-            game_draw_result(success && (current_index == seq_length));
-
-            // Pequeña pausa antes de volver al menú
-            vTaskDelay(pdMS_TO_TICKS(2500));
-
-            state = GAME_MENU_INIT;
-            break;
-        }
+    ESP_LOGI(TAG, "Generando secuencia de longitud %d", game->length);
 
-        case GAME_RESULT:
-            // En esta implementación, la lógica de resultado se maneja
-            // directamente dentro de GAME_WAIT_INPUT, por simplicidad.
-            state = GAME_MENU_INIT;
-            break;
-        }
+    for (int i = 0; i < game->length; i++) {
+        // esp_random() devuelve 32 bits, tomamos los 2 LSB para obtener [0..3]
+        game->sequence[i] = (Direction)(esp_random() % 4);
     }
+
+    game_set_state(game, GAME_SHOW_SEQ);
+    ESP_LOGI(TAG, "Mostrando secuencia al jugador");
+
+    sequence_draw_arg_t draw_arg = { .length = game->length };
+    memcpy(draw_arg.sequence, game->sequence, game->length * sizeof(Direction));
+    render_call(draw_show_sequence_cmd, &draw_arg, sizeof(draw_arg));
+    render_present();
+
+    event_loop_start_timer(GAME_TIMER_SHOW_SEQ, SHOW_SEQ_TIME_MS);
 }
 
-// -----------------------------------------------------------------------------
-//  IMPLEMENTACIÓN: BOTONES FÍSICOS
-// -----------------------------------------------------------------------------
+static void game_enter_input(game_t *game)
+{
+    game_set_state(game, GAME_WAIT_INPUT);
+    game->current_index = 0;
+    game->input_deadline_us = game->state_start_us + (int64_t)INPUT_TIME_LIMIT_MS * 1000;
+
+    ESP_LOGI(TAG, "Esperando entradas del jugador...");
+
+    render_call(draw_input_screen_cmd, NULL, 0);
+    render_present();
+
+    event_loop_start_timer(GAME_TIMER_DEADLINE, INPUT_TIME_LIMIT_MS);
+    game_update_clock(game, game->state_start_us);
+}
 
 /**
- * Configura los GPIO de los 4 botones como entradas con PULLUP interno.
+ * Dibuja el tiempo restante y programa el siguiente redibujado justo
+ * cuando cambie la décima que se ve en pantalla (no antes).
  */
-static void buttons_init(void)
+static void game_update_clock(game_t *game, int64_t now_us)
 {
-    gpio_config_t io_conf = {0};
-    io_conf.intr_type = GPIO_INTR_DISABLE;       // Sin interrupciones (polling)
-    io_conf.mode = GPIO_MODE_INPUT;              // Modo entrada
-    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-    io_conf.pull_up_en = GPIO_PULLUP_ENABLE;     // Activar PULLUP
-
-    // Máscara de pines (OR de los 4)
-    io_conf.pin_bit_mask = (1ULL << BTN_UP_GPIO) |
-                           (1ULL << BTN_DOWN_GPIO) |
-                           (1ULL << BTN_LEFT_GPIO) |
-                           (1ULL << BTN_RIGHT_GPIO);
-
-    gpio_config(&io_conf);
+    int64_t remaining_us = game->input_deadline_us - now_us;
+    if (remaining_us <= 0) return;
+
+    uint32_t remaining_ms = (uint32_t)(remaining_us / 1000);
+    render_call(draw_timer_cmd, &remaining_ms, sizeof(remaining_ms));
+    render_present();
+
+    // Milisegundos hasta el siguiente múltiplo de CLOCK_STEP_MS (mínimo 1)
+    uint32_t next_ms = remaining_ms % CLOCK_STEP_MS;
+    event_loop_start_timer(GAME_TIMER_CLOCK, next_ms ? next_ms : CLOCK_STEP_MS);
 }
 
-/**
- * Devuelve 1 si el botón (GPIO) está pulsado, 0 en caso contrario.
- *
- * Recuerda: botón a GND con PULLUP -> pulsado = nivel 0 lógico.
- */
-static int button_is_pressed(gpio_num_t gpio_num)
+static void game_finish(game_t *game, int won)
 {
-    int level = gpio_get_level(gpio_num);
-    return (level == 0); // 0 = pulsado
+    event_loop_stop_timer(GAME_TIMER_CLOCK);
+    event_loop_stop_timer(GAME_TIMER_DEADLINE);
+
+    game_set_state(game, GAME_RESULT);
+    render_call(draw_result_cmd, &won, sizeof(won));
+    render_present();
+
+    // Pequeña pausa antes de volver al menú
+    event_loop_start_timer(GAME_TIMER_RESULT, RESULT_TIME_MS);
 }
 
 /**
- * Espera a que se pulse alguno de los 4 botones direccionales.
- *
- *  - timeout_ticks: tiempo máximo a esperar en ticks de FreeRTOS.
- *                   Si es portMAX_DELAY, espera indefinidamente.
- *  - pressed: puntero de salida, vale 1 si se ha pulsado
- *             algún botón antes de timeout, 0 si no.
- *
- * Devuelve: la Direction correspondiente si se ha pulsado algo;
- *           si no, devuelve DIR_UP por defecto (pero pressed = 0).
+ * Pulsación durante GAME_WAIT_INPUT: comprobamos si coincide con la
+ * secuencia objetivo.
  */
-static Direction wait_for_any_direction(TickType_t timeout_ticks, int *pressed)
+static void game_handle_direction(game_t *game, Direction d)
 {
-    TickType_t start = xTaskGetTickCount();
+    if (d != game->sequence[game->current_index]) {
+        ESP_LOGI(TAG, "Paso %d INCORRECTO", game->current_index + 1);
+        game_finish(game, 0);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Paso %d correcto", game->current_index + 1);
+    game->current_index++;
 
-    if (pressed) {
-        *pressed = 0;
+    // Actualizamos la representación gráfica del input
+    sequence_draw_arg_t draw_arg = { .length = game->length, .progress = game->current_index };
+    memcpy(draw_arg.sequence, game->sequence, game->length * sizeof(Direction));
+    render_call(draw_input_progress_cmd, &draw_arg, sizeof(draw_arg));
+    render_present();
+
+    if (game->current_index == game->length) {
+        game_finish(game, 1);
     }
+}
 
-    while (1) {
-        // Comprobamos cada botón. Si hay varios pulsados, devolvemos el primero
-        if (button_is_pressed(BTN_UP_GPIO)) {
-            // Sencillo "debounce": esperamos a que se suelte antes de salir
-            while (button_is_pressed(BTN_UP_GPIO)) {
-                vTaskDelay(pdMS_TO_TICKS(10));
-            }
-            if (pressed) *pressed = 1;
-            return DIR_UP;
+static void game_handle_event(game_t *game, const app_event_t *event)
+{
+    if (event->type == APP_EVENT_BUTTON) {
+        // Solo cuentan las pulsaciones (no las sueltas) hechas después de
+        // entrar en el estado: lo pulsado mientras se mostraba la
+        // secuencia puede llegar tarde a la cola y no debe contar.
+        if (event->button.type != BUTTON_EVENT_PRESS ||
+            event->button.time_us < game->state_start_us) {
+            return;
         }
-        if (button_is_pressed(BTN_DOWN_GPIO)) {
-            while (button_is_pressed(BTN_DOWN_GPIO)) {
-                vTaskDelay(pdMS_TO_TICKS(10));
-            }
-            if (pressed) *pressed = 1;
-            return DIR_DOWN;
+
+        // Traza de latencia: desde la interrupción hasta que lo dibujado
+        // como respuesta llega al panel
+        latency_trace_t trace;
+        latency_trace_begin(&trace, event->button.time_us);
+
+        switch (game->state) {
+        case GAME_MENU:
+            game_start_round(game);
+            break;
+        case GAME_WAIT_INPUT:
+            game_handle_direction(game, (Direction)event->button.button);
+            break;
+        default:
+            return;   // pulsación sin respuesta en pantalla
         }
-        if (button_is_pressed(BTN_LEFT_GPIO)) {
-            while (button_is_pressed(BTN_LEFT_GPIO)) {
-                vTaskDelay(pdMS_TO_TICKS(10));
-            }
-            if (pressed) *pressed = 1;
-            return DIR_LEFT;
+
+        latency_trace_mark(&trace, LATENCY_POINT_ISSUED);
+        render_latency(&trace);
+        return;
+    }
+
+    if (event->type == APP_EVENT_RADIO) {
+        // El juego todavía no usa la radio: vaciamos la cola para que no
+        // se pierdan los siguientes y dejamos constancia en el log
+        sx1278_packet_t packet;
+        while (sx1278_receive(&packet, 0)) {
+            ESP_LOGI(TAG, "Radio: %u bytes, RSSI %d dBm, SNR %.1f dB",
+                     packet.length, packet.rssi_dbm, packet.snr_db);
+            // Aun sin usarlo, el frame cuenta para la calidad del enlace
+            // con quien lo envió (y para la velocidad acordada con él)
+            linkObserveFrame(packet.data, packet.length, packet.rssi_dbm,
+                             packet.snr_db, packet.time_us);
         }
-        if (button_is_pressed(BTN_RIGHT_GPIO)) {
-            while (button_is_pressed(BTN_RIGHT_GPIO)) {
-                vTaskDelay(pdMS_TO_TICKS(10));
-            }
-            if (pressed) *pressed = 1;
-            return DIR_RIGHT;
+        radio_service_link(event->time_us);
+        // La radio quedó libre (o devolvió un frame por canal ocupado): el
+        // planificador le pasa el siguiente
+        if (event->radio_flags & (SX1278_EVENT_TX_DONE | SX1278_EVENT_TX_BUSY)) {
+            radio_service_scheduler(event->time_us);
         }
+        return;
+    }
 
-        // Nadie está pulsado -> comprobamos timeout
-        if (timeout_ticks != portMAX_DELAY) {
-            TickType_t now = xTaskGetTickCount();
-            if ((now - start) >= timeout_ticks) {
-                // Timeout alcanzado
-                if (pressed) *pressed = 0;
-                return DIR_UP;  // valor por defecto, irrelevante si pressed=0
-            }
+    if (event->type != APP_EVENT_TIMER) return;
+
+    switch (event->timer_id) {
+    case GAME_TIMER_SHOW_SEQ:
+        if (game->state == GAME_SHOW_SEQ) game_enter_input(game);
+        break;
+    case GAME_TIMER_CLOCK:
+        if (game->state == GAME_WAIT_INPUT) game_update_clock(game, event->time_us);
+        break;
+    case GAME_TIMER_DEADLINE:
+        if (game->state == GAME_WAIT_INPUT) {
+            ESP_LOGW(TAG, "Tiempo agotado");
+            game_finish(game, 0);
         }
-
-        // Pequeño retardo para no saturar la CPU
-        vTaskDelay(pdMS_TO_TICKS(10));
+        break;
+    case GAME_TIMER_RESULT:
+        if (game->state == GAME_RESULT) game_enter_menu(game);
+        break;
+    case RADIO_TIMER_LINK:
+        radio_service_link(event->time_us);
+        event_loop_start_timer(RADIO_TIMER_LINK, RADIO_LINK_PERIOD_MS);
+        break;
+    case RADIO_TIMER_SCHEDULER:
+        radio_service_scheduler(event->time_us);
+        break;
+    default:
+        break;
     }
 }
 
 // -----------------------------------------------------------------------------
-//  IMPLEMENTACIÓN: DIBUJO DE UI DEL JUEGO SOBRE ILI9341
+//  IMPLEMENTACIÓN: RADIO
 // -----------------------------------------------------------------------------
 
 /**
- * Dibuja la pantalla de menú inicial:
- *  - Título del juego.
- *  - Instrucciones mínimas.
+ * Deja caducar los acuerdos de velocidad y escucha a la acordada con el
+ * último vecino que oímos (la base si no queda ninguno).
  */
-static void game_draw_menu_screen(void)
+static void radio_service_link(int64_t now_us)
 {
-    ili9341_fill_screen(COLOR_BG);
-
-    int y = 20;
-    ili9341_draw_string(10, y, "STRATAGEM HERO", COLOR_INFO, COLOR_BG, 2); y += TEXT_LINE_HEIGHT * 2;
-    ili9341_draw_string(10, y, "MVP ESP32 + ILI9341", COLOR_TEXT, COLOR_BG, 1); y += TEXT_LINE_HEIGHT * 2;
-
-    ili9341_draw_string(10, y, "Pulsa cualquier flecha", COLOR_TEXT, COLOR_BG, 1); y += TEXT_LINE_HEIGHT;
-    ili9341_draw_string(10, y, "para empezar", COLOR_TEXT, COLOR_BG, 1);
+    sx1278_rate_t rate;
+    linkService(now_us);
+    linkListenRate(&rate);
+    sx1278_set_rx_rate(&rate);
 }
 
 /**
- * Dibuja la secuencia de direcciones generada (como letras U, D, L, R)
- * en una única línea.
+ * Pasa a la radio lo que el planificador tenga listo y lo vuelve a llamar
+ * cuando él diga: un frame que espera al duty cycle o al backoff del LBT
+ * no tiene otro evento que lo despierte.
  */
-static void game_draw_sequence(Direction *seq, int length)
+static void radio_service_scheduler(int64_t now_us)
 {
-    int x = 10;
-    int y = 10 + TEXT_LINE_HEIGHT * 2;  // debajo de "SECUENCIA:"
-
-    for (int i = 0; i < length; i++) {
-        const char *s = direction_to_char(seq[i]);
-        ili9341_draw_string(x, y, s, COLOR_TEXT, COLOR_BG, 2);
-        x += 20; // separador horizontal
+    int64_t delay_us = schedulerService(now_us);
+    if (delay_us < 0) {
+        event_loop_stop_timer(RADIO_TIMER_SCHEDULER);   // cola vacía
+        return;
     }
+    // Redondeo hacia arriba: despertar antes de tiempo no sirve de nada
+    uint32_t delay_ms = (uint32_t)((delay_us + 999) / 1000);
+    event_loop_start_timer(RADIO_TIMER_SCHEDULER, delay_ms ? delay_ms : 1);
 }
 
+// -----------------------------------------------------------------------------
+//  IMPLEMENTACIÓN: DIBUJO EN LA TAREA DE RENDER
+// -----------------------------------------------------------------------------
+
 /**
- * Dibuja el progreso del jugador en la línea "TU INPUT:".
- * Muestra todas las flechas de la secuencia, y pinta en verde
- * las que ya se han introducido correctamente.
+ * Adaptadores entre render_call y las pantallas de game_ui.c: cada uno
+ * recibe su copia de los argumentos y se ejecuta en la tarea de render.
  */
-static void game_draw_input_progress(Direction *seq, int length, int current_index)
+
+static void draw_menu_screen_cmd(const void *arg)
 {
-    int x = 10;
-    int y = 10 + TEXT_LINE_HEIGHT * 3;  // misma línea que "TU INPUT:" pero desplazada
-
-    // Limpiamos el área de entrada simple: un rectángulo horizontal
-    // (esto es muy básico, optimizable según necesidades)
-    ili9341_fill_rect(0, y - 2, ILI9341_WIDTH, TEXT_LINE_HEIGHT * 2, COLOR_BG);
-
-    for (int i = 0; i < length; i++) {
-        const char *s = direction_to_char(seq[i]);
-        uint16_t color = (i < current_index) ? COLOR_GOOD : COLOR_TEXT;
-        ili9341_draw_string(x, y, s, color, COLOR_BG, 2);
-        x += 20;
-    }
+    (void)arg;
+    game_draw_menu_screen();
 }
 
-/**
- * Dibuja un temporizador simple en la parte inferior de la pantalla.
- * Muestra el tiempo restante en segundos (con resolución aproximada).
- */
-static void game_draw_timer(uint32_t remaining_ms)
+static void draw_show_sequence_cmd(const void *arg)
 {
-    char buf[32];
-    float seconds = remaining_ms / 1000.0f;
-    snprintf(buf, sizeof(buf), "TIEMPO: %.1fs", (double)seconds);
-
-    int y = ILI9341_HEIGHT - TEXT_LINE_HEIGHT * 2;
-
-    // Limpiar zona inferior
-    ili9341_fill_rect(0, y - 2, ILI9341_WIDTH, TEXT_LINE_HEIGHT * 2 + 4, COLOR_BG);
-
-    ili9341_draw_string(10, y, buf, COLOR_INFO, COLOR_BG, 2);
+    const sequence_draw_arg_t *draw_arg = arg;
+    game_draw_show_sequence_screen((Direction *)draw_arg->sequence, draw_arg->length);
 }
 
-/**
- * Muestra el resultado del intento (ÉXITO o FALLO) en grande
- * en el centro de la pantalla.
- */
-static void game_draw_result(int success)
+static void draw_input_screen_cmd(const void *arg)
 {
-    ili9341_fill_screen(COLOR_BG);
-
-    const char *msg = success ? "EXITO" : "FALLO";
-    uint16_t color = success ? COLOR_GOOD : COLOR_BAD;
+    (void)arg;
+    game_draw_input_screen();
+}
 
-    int x = 40;
-    int y = ILI9341_HEIGHT / 2 - TEXT_LINE_HEIGHT;
+static void draw_timer_cmd(const void *arg)
+{
+    uint32_t remaining_ms;
+    memcpy(&remaining_ms, arg, sizeof(remaining_ms));
+    game_draw_timer(remaining_ms);
+}
 
-    ili9341_draw_string(x, y, msg, color, COLOR_BG, 3);
+static void draw_input_progress_cmd(const void *arg)
+{
+    const sequence_draw_arg_t *draw_arg = arg;
+    game_draw_input_progress((Direction *)draw_arg->sequence, draw_arg->length,
+                             draw_arg->progress);
 }
 
-/**
- * Convierte una dirección en un texto corto para dibujar en pantalla.
- * Aquí usamos:
- *  - DIR_UP    -> "U"
- *  - DIR_DOWN  -> "D"
- *  - DIR_LEFT  -> "L"
- *  - DIR_RIGHT -> "R"
- *
- * Puedes cambiarlo para dibujar flechas, iconos, etc.
- */
-static const char *direction_to_char(Direction d)
+static void draw_result_cmd(const void *arg)
 {
-    switch (d) {
-    case DIR_UP:    return "U";
-    case DIR_DOWN:  return "D";
-    case DIR_LEFT:  return "L";
-    case DIR_RIGHT: return "R";
-    default:        return "?";
-    }
+    int won;
+    memcpy(&won, arg, sizeof(won));
+    game_draw_result(won);
 }
@@ -0,0 +1,248 @@
+#include <string.h>
+#include "link.h"
+#include "mesh.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_random.h"
+#else
+#include <stdio.h>
+#include <time.h>
+#endif
+
+// Where the flood ids of this boot start. Neighbours may still hold the
+// ones of the last boot in their caches, so a fixed start would have our
+// new floods taken for duplicates
+static uint32_t firstFloodId(void){
+
+#ifdef ESP_PLATFORM
+    return esp_random();
+#else
+    uint32_t value = (uint32_t)time(NULL) ^ ((uint32_t)clock() << 16);
+    FILE *source = fopen("/dev/urandom", "rb");
+    if(source != NULL){
+        if(fread(&value, sizeof(value), 1, source) != 1){
+            value ^= 0x9E3779B9u;
+        }
+        fclose(source);
+    }
+    return value;
+#endif
+}
+
+void meshInit(mesh_node *node, uint32_t local_id, const mesh_config *config){
+
+    static const mesh_config default_config = MESH_CONFIG_DEFAULT;
+    memset(node, 0, sizeof(*node));
+    node->local_id = local_id;
+    node->config = config != NULL ? *config : default_config;
+    if(node->config.relay_slots == 0){
+        node->config.relay_slots = 1;
+    }
+    node->random_state = (local_id * 2654435761u) | 1;
+    node->next_flood_id = firstFloodId();
+}
+
+static uint32_t nextRandom(mesh_node *node){
+
+    // xorshift32: a delay spread, not secrets
+    node->random_state ^= node->random_state << 13;
+    node->random_state ^= node->random_state >> 17;
+    node->random_state ^= node->random_state << 5;
+    return node->random_state;
+}
+
+// splitmix64 of the key; each hash takes 16 bits of it
+static uint64_t floodHash(uint32_t origin, uint32_t flood_id){
+
+    uint64_t hash = ((uint64_t)origin << 32) | flood_id;
+    hash += 0x9E3779B97F4A7C15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+    return hash ^ (hash >> 31);
+}
+
+static bool generationContains(const uint8_t *bits, uint64_t hash){
+
+    for(int index = 0; index < MESH_CACHE_HASHES; index++){
+        uint32_t bit = (uint32_t)(hash >> (16 * index)) & (MESH_CACHE_BITS - 1);
+        if(!(bits[bit / 8] & (1u << (bit % 8)))){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void cacheInsertHash(mesh_node *node, uint64_t hash){
+
+    if(node->generation_inserts >= MESH_CACHE_GENERATION){
+        node->current ^= 1;
+        memset(node->cache[node->current], 0, sizeof(node->cache[0]));
+        node->generation_inserts = 0;
+    }
+    uint8_t *bits = node->cache[node->current];
+    for(int index = 0; index < MESH_CACHE_HASHES; index++){
+        uint32_t bit = (uint32_t)(hash >> (16 * index)) & (MESH_CACHE_BITS - 1);
+        bits[bit / 8] |= (uint8_t)(1u << (bit % 8));
+    }
+    node->generation_inserts++;
+}
+
+static void cacheInsert(mesh_node *node, uint32_t origin, uint32_t flood_id){
+
+    cacheInsertHash(node, floodHash(origin, flood_id));
+}
+
+/*
+ * Seen before? A hit in the older generation only is copied to the
+ * current one: whether a real copy or a false positive, it must outlive
+ * the next rotation like any flood seen now.
+ */
+static bool cacheSeen(mesh_node *node, uint32_t origin, uint32_t flood_id){
+
+    uint64_t hash = floodHash(origin, flood_id);
+    if(generationContains(node->cache[node->current], hash)){
+        return true;
+    }
+    if(generationContains(node->cache[node->current ^ 1], hash)){
+        cacheInsertHash(node, hash);
+        return true;
+    }
+    return false;
+}
+
+int meshAttach(mesh_node *node, uint8_t *frame, size_t length, size_t frame_size, size_t *packet_length){
+
+    packet_view view;
+    int error = packetDecode(frame, length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+
+    packet_mesh mesh = { node->next_flood_id, node->local_id, node->config.hops };
+    error = packetSetMesh(frame, length, frame_size, &mesh, packet_length);
+    if(error != PACKET_OK){
+        return error;
+    }
+    // Our own copies, relayed back, are duplicates
+    cacheInsert(node, view.header.transmitter_id, node->next_flood_id);
+    node->next_flood_id++;
+    node->stats.floods++;
+    return PACKET_OK;
+}
+
+static mesh_relay *findRelay(mesh_node *node, uint32_t origin, uint32_t flood_id){
+
+    for(size_t index = 0; index < MESH_RELAY_SLOTS; index++){
+        mesh_relay *relay = &node->relays[index];
+        if(relay->in_use && relay->origin == origin && relay->flood_id == flood_id){
+            return relay;
+        }
+    }
+    return NULL;
+}
+
+// Copy of the frame with us as hop and one hop less, due after the random delay
+static void queueRelay(mesh_node *node, const uint8_t *frame, size_t frame_length, const packet_view *view,
+                       int64_t now_us){
+
+    mesh_relay *relay = NULL;
+    for(size_t index = 0; index < MESH_RELAY_SLOTS && relay == NULL; index++){
+        if(!node->relays[index].in_use){
+            relay = &node->relays[index];
+        }
+    }
+    if(relay == NULL){
+        node->stats.relays_dropped++;
+        return;
+    }
+
+    memcpy(relay->frame, frame, frame_length);
+    packet_mesh mesh = { view->mesh.flood_id, node->local_id, (uint8_t)(view->mesh.hops_left - 1) };
+    if(packetSetMesh(relay->frame, frame_length, sizeof(relay->frame), &mesh, &relay->length) != PACKET_OK){
+        node->stats.relays_dropped++; // our id made it longer than PACKET_MAX_SIZE
+        return;
+    }
+
+    int64_t slot_us = (int64_t)linkAirtimeUs(relay->frame, relay->length) + (int64_t)node->config.slot_guard_ms * 1000;
+    relay->in_use = true;
+    relay->origin = view->header.transmitter_id;
+    relay->flood_id = view->mesh.flood_id;
+    relay->copies = 0;
+    relay->due_us = now_us + (int64_t)(nextRandom(node) % node->config.relay_slots) * slot_us;
+}
+
+bool meshReceive(mesh_node *node, const uint8_t *frame, size_t frame_length, int64_t now_us){
+
+    packet_view view;
+    if(packetDecode(frame, frame_length, &view) != PACKET_OK){
+        return false;
+    }
+    bool for_us = view.header.receiver_id == node->local_id || view.header.receiver_id == MESH_BROADCAST_ID;
+    if(!view.has_mesh){
+        return for_us;
+    }
+
+    uint32_t origin = view.header.transmitter_id;
+    if(origin == node->local_id || cacheSeen(node, origin, view.mesh.flood_id)){
+        node->stats.duplicates++;
+        mesh_relay *relay = findRelay(node, origin, view.mesh.flood_id);
+        if(relay != NULL && node->config.suppress_count != 0 && ++relay->copies >= node->config.suppress_count){
+            relay->in_use = false;
+            node->stats.suppressed++;
+        }
+        return false;
+    }
+    cacheInsert(node, origin, view.mesh.flood_id);
+    node->stats.delivered += for_us;
+
+    if(view.header.receiver_id == node->local_id || !node->config.relay){
+        return for_us;
+    }
+    if(view.mesh.hops_left == 0){
+        node->stats.expired++;
+        return for_us;
+    }
+    queueRelay(node, frame, frame_length, &view, now_us);
+    return for_us;
+}
+
+bool meshNextRelay(mesh_node *node, int64_t now_us, uint8_t *frame, size_t frame_size, size_t *frame_length){
+
+    mesh_relay *next = NULL;
+    for(size_t index = 0; index < MESH_RELAY_SLOTS; index++){
+        mesh_relay *relay = &node->relays[index];
+        if(relay->in_use && relay->due_us <= now_us && (next == NULL || relay->due_us < next->due_us)){
+            next = relay;
+        }
+    }
+    if(next == NULL || next->length > frame_size){
+        return false;
+    }
+    memcpy(frame, next->frame, next->length);
+    *frame_length = next->length;
+    next->in_use = false;
+    node->stats.relayed++;
+    return true;
+}
+
+int64_t meshRelayWaitUs(const mesh_node *node, int64_t now_us){
+
+    int64_t wait_us = -1;
+    for(size_t index = 0; index < MESH_RELAY_SLOTS; index++){
+        const mesh_relay *relay = &node->relays[index];
+        if(!relay->in_use){
+            continue;
+        }
+        int64_t until_us = relay->due_us > now_us ? relay->due_us - now_us : 0;
+        if(wait_us < 0 || until_us < wait_us){
+            wait_us = until_us;
+        }
+    }
+    return wait_us;
+}
+
+int64_t meshPathDelayUs(const mesh_node *node, uint32_t airtime_us){
+
+    int64_t slot_us = (int64_t)airtime_us + (int64_t)node->config.slot_guard_ms * 1000;
+    return (int64_t)node->config.hops * ((node->config.relay_slots - 1) * slot_us + airtime_us);
+}
@@ -0,0 +1,333 @@
+#include <string.h>
+#include "packet.h"
+
+// CRC-16/CCITT-FALSE, 4 bits at a time (16 entry table instead of 256)
+static const uint16_t crc16_nibble_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t packetCrc16(const uint8_t *data, size_t length){
+
+    uint16_t crc = 0xFFFF;
+
+    for(size_t index = 0; index < length; index++){
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (data[index] >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (data[index] & 0x0F)]);
+    }
+
+    return crc;
+}
+
+size_t packetWriteVarint(uint8_t *buffer, size_t buffer_size, uint32_t value){
+
+    size_t written = 0;
+
+    do{
+        if(written == buffer_size){
+            return 0;
+        }
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        if(value != 0){
+            byte |= 0x80; // more bytes follow
+        }
+        buffer[written++] = byte;
+    } while(value != 0);
+
+    return written;
+}
+
+size_t packetReadVarint(const uint8_t *buffer, size_t buffer_length, uint32_t *value){
+
+    uint32_t result = 0;
+
+    for(size_t index = 0; index < buffer_length && index < PACKET_VARINT_MAX_SIZE; index++){
+        uint8_t byte = buffer[index];
+
+        // 5th byte can only carry the top 4 bits of a uint32_t
+        if(index == PACKET_VARINT_MAX_SIZE - 1 && (byte & 0xF0) != 0){
+            return 0;
+        }
+
+        result |= (uint32_t)(byte & 0x7F) << (7 * index);
+        if((byte & 0x80) == 0){
+            *value = result;
+            return index + 1;
+        }
+    }
+
+    return 0; // truncated or longer than 5 bytes
+}
+
+static size_t varintSize(uint32_t value){
+
+    size_t size = 1;
+    while(value >= 0x80){
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+size_t packetHeaderSize(const packet_header *header, size_t payload_length){
+
+    return PACKET_FIXED_SIZE
+        + varintSize(header->transmitter_id)
+        + varintSize(header->receiver_id)
+        + varintSize(header->sequence)
+        + varintSize((uint32_t)payload_length);
+}
+
+size_t packetEncodedSize(const packet_header *header, size_t payload_length){
+
+    return packetHeaderSize(header, payload_length) + payload_length + PACKET_CRC_SIZE;
+}
+
+int packetWriteHeader(const packet_header *header, size_t payload_length,
+                      uint8_t *buffer, size_t buffer_size, size_t *header_length){
+
+    size_t total_size = packetEncodedSize(header, payload_length);
+
+    if(total_size > PACKET_MAX_MESSAGE_SIZE){
+        return PACKET_ERROR_PAYLOAD_TOO_LARGE;
+    }
+    if(total_size > buffer_size){
+        return PACKET_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    // Buffer is known to be big enough, so the varint writes cannot fail
+    size_t position = 0;
+    buffer[position++] = (uint8_t)((header->version << 4) | (header->packet_type & 0x0F));
+    buffer[position++] = header->flags;
+    position += packetWriteVarint(&buffer[position], buffer_size - position, header->transmitter_id);
+    position += packetWriteVarint(&buffer[position], buffer_size - position, header->receiver_id);
+    position += packetWriteVarint(&buffer[position], buffer_size - position, header->sequence);
+    position += packetWriteVarint(&buffer[position], buffer_size - position, (uint32_t)payload_length);
+
+    *header_length = position;
+    return PACKET_OK;
+}
+
+size_t packetWriteCrc(uint8_t *buffer, size_t length){
+
+    uint16_t crc = packetCrc16(buffer, length);
+    buffer[length++] = (uint8_t)(crc >> 8);
+    buffer[length++] = (uint8_t)(crc & 0xFF);
+    return length;
+}
+
+int packetEncode(const packet_header *header, const uint8_t *payload, size_t payload_length,
+                 uint8_t *buffer, size_t buffer_size, size_t *packet_length){
+
+    size_t position = 0;
+    int error = packetWriteHeader(header, payload_length, buffer, buffer_size, &position);
+    if(error != PACKET_OK){
+        return error;
+    }
+
+    // Zero copy when the caller already built the payload in place
+    if(payload_length > 0 && payload != &buffer[position]){
+        memmove(&buffer[position], payload, payload_length);
+    }
+    position += payload_length;
+
+    *packet_length = packetWriteCrc(buffer, position);
+    return PACKET_OK;
+}
+
+int packetDecode(const uint8_t *buffer, size_t buffer_length, packet_view *view){
+
+    if(buffer_length < PACKET_FIXED_SIZE + 4 + PACKET_CRC_SIZE){
+        return PACKET_ERROR_TRUNCATED; // not even one byte per varint
+    }
+
+    // CRC first: no point parsing a corrupted frame
+    size_t crc_position = buffer_length - PACKET_CRC_SIZE;
+    uint16_t received_crc = (uint16_t)((buffer[crc_position] << 8) | buffer[crc_position + 1]);
+    if(packetCrc16(buffer, crc_position) != received_crc){
+        return PACKET_ERROR_BAD_CRC;
+    }
+
+    packet_header *header = &view->header;
+    header->version = buffer[0] >> 4;
+    header->packet_type = buffer[0] & 0x0F;
+    header->flags = buffer[1];
+
+    if(header->version != PACKET_VERSION){
+        return PACKET_ERROR_BAD_VERSION;
+    }
+
+    size_t position = PACKET_FIXED_SIZE;
+    uint32_t *fields[] = { &header->transmitter_id, &header->receiver_id, &header->sequence };
+    for(size_t index = 0; index < sizeof(fields) / sizeof(fields[0]); index++){
+        size_t used = packetReadVarint(&buffer[position], crc_position - position, fields[index]);
+        if(used == 0){
+            return PACKET_ERROR_BAD_VARINT;
+        }
+        position += used;
+    }
+
+    uint32_t payload_length;
+    size_t used = packetReadVarint(&buffer[position], crc_position - position, &payload_length);
+    if(used == 0){
+        return PACKET_ERROR_BAD_VARINT;
+    }
+    position += used;
+
+    if(payload_length > crc_position - position){
+        return PACKET_ERROR_TRUNCATED;
+    }
+    view->payload = &buffer[position];
+    view->payload_length = payload_length;
+    view->has_ack = false;
+    view->has_rate = false;
+    view->has_mesh = false;
+    position += payload_length;
+
+    if(header->flags & PACKET_FLAG_MESH){
+        uint32_t *mesh_fields[] = { &view->mesh.flood_id, &view->mesh.hop_id };
+        for(size_t index = 0; index < sizeof(mesh_fields) / sizeof(mesh_fields[0]); index++){
+            used = packetReadVarint(&buffer[position], crc_position - position, mesh_fields[index]);
+            if(used == 0){
+                return PACKET_ERROR_BAD_VARINT;
+            }
+            position += used;
+        }
+        if(position == crc_position){
+            return PACKET_ERROR_TRUNCATED;
+        }
+        view->mesh.hops_left = buffer[position++];
+        view->has_mesh = true;
+    }
+
+    if(header->flags & PACKET_FLAG_RATE_ATTACHED){
+        if(position == crc_position){
+            return PACKET_ERROR_TRUNCATED;
+        }
+        view->rate = buffer[position++];
+        view->has_rate = true;
+    }
+
+    if(header->flags & PACKET_FLAG_ACK_ATTACHED){
+        used = packetReadVarint(&buffer[position], crc_position - position, &view->ack_sequence);
+        if(used == 0){
+            return PACKET_ERROR_BAD_VARINT;
+        }
+        position += used;
+        if(crc_position - position < PACKET_ACK_BITMAP_SIZE + PACKET_ACK_MAC_SIZE){
+            return PACKET_ERROR_TRUNCATED;
+        }
+        view->ack_bitmap = (uint16_t)(buffer[position] | (buffer[position + 1] << 8));
+        view->ack_mac = &buffer[position + PACKET_ACK_BITMAP_SIZE];
+        view->has_ack = true;
+        position += PACKET_ACK_BITMAP_SIZE + PACKET_ACK_MAC_SIZE;
+    }
+
+    // The length prefix (and the trailers, if any) must match exactly what is left before the CRC
+    if(position != crc_position){
+        return PACKET_ERROR_TRUNCATED;
+    }
+    return PACKET_OK;
+}
+
+int packetAttachAck(uint8_t *buffer, size_t length, size_t buffer_size,
+                    uint32_t ack_sequence, uint16_t ack_bitmap, const uint8_t ack_mac[PACKET_ACK_MAC_SIZE],
+                    size_t *packet_length){
+
+    packet_view view;
+    int error = packetDecode(buffer, length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    if(view.has_ack){
+        return PACKET_ERROR_PAYLOAD_TOO_LARGE; // one ACK per frame
+    }
+
+    uint8_t ack[PACKET_ACK_MAX_SIZE];
+    size_t ack_length = packetWriteVarint(ack, sizeof(ack), ack_sequence);
+    ack[ack_length++] = (uint8_t)ack_bitmap;
+    ack[ack_length++] = (uint8_t)(ack_bitmap >> 8);
+    memcpy(&ack[ack_length], ack_mac, PACKET_ACK_MAC_SIZE);
+    ack_length += PACKET_ACK_MAC_SIZE;
+
+    size_t position = length - PACKET_CRC_SIZE;
+    if(position + ack_length + PACKET_CRC_SIZE > PACKET_MAX_SIZE){
+        return PACKET_ERROR_PAYLOAD_TOO_LARGE;
+    }
+    if(position + ack_length + PACKET_CRC_SIZE > buffer_size){
+        return PACKET_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    buffer[1] |= PACKET_FLAG_ACK_ATTACHED;
+    memcpy(&buffer[position], ack, ack_length);
+    *packet_length = packetWriteCrc(buffer, position + ack_length);
+    return PACKET_OK;
+}
+
+int packetAttachRate(uint8_t *buffer, size_t length, size_t buffer_size, uint8_t rate, size_t *packet_length){
+
+    packet_view view;
+    int error = packetDecode(buffer, length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    if(view.has_rate || view.has_ack){
+        return PACKET_ERROR_PAYLOAD_TOO_LARGE; // one rate per frame, before the ACK
+    }
+
+    size_t position = length - PACKET_CRC_SIZE;
+    if(position + 1 + PACKET_CRC_SIZE > PACKET_MAX_SIZE){
+        return PACKET_ERROR_PAYLOAD_TOO_LARGE;
+    }
+    if(position + 1 + PACKET_CRC_SIZE > buffer_size){
+        return PACKET_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    buffer[1] |= PACKET_FLAG_RATE_ATTACHED;
+    buffer[position] = rate;
+    *packet_length = packetWriteCrc(buffer, position + 1);
+    return PACKET_OK;
+}
+
+static size_t writeMeshTrailer(uint8_t trailer[PACKET_MESH_MAX_SIZE], const packet_mesh *mesh){
+
+    size_t length = packetWriteVarint(trailer, PACKET_MESH_MAX_SIZE, mesh->flood_id);
+    length += packetWriteVarint(&trailer[length], PACKET_MESH_MAX_SIZE - length, mesh->hop_id);
+    trailer[length++] = mesh->hops_left;
+    return length;
+}
+
+int packetSetMesh(uint8_t *buffer, size_t length, size_t buffer_size, const packet_mesh *mesh, size_t *packet_length){
+
+    packet_view view;
+    int error = packetDecode(buffer, length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+
+    uint8_t trailer[PACKET_MESH_MAX_SIZE];
+    size_t trailer_length = writeMeshTrailer(trailer, mesh);
+    size_t old_length = 0;
+    if(view.has_mesh){
+        uint8_t old_trailer[PACKET_MESH_MAX_SIZE];
+        old_length = writeMeshTrailer(old_trailer, &view.mesh);
+    }
+
+    // Rate and ACK, if any, follow the trailer
+    size_t position = (size_t)(view.payload - buffer) + view.payload_length;
+    size_t rest = length - PACKET_CRC_SIZE - position - old_length;
+    size_t end = position + trailer_length + rest;
+    if(end + PACKET_CRC_SIZE > PACKET_MAX_SIZE){
+        return PACKET_ERROR_PAYLOAD_TOO_LARGE;
+    }
+    if(end + PACKET_CRC_SIZE > buffer_size){
+        return PACKET_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    memmove(&buffer[position + trailer_length], &buffer[position + old_length], rest);
+    memcpy(&buffer[position], trailer, trailer_length);
+    buffer[1] |= PACKET_FLAG_MESH;
+    *packet_length = packetWriteCrc(buffer, end);
+    return PACKET_OK;
+}
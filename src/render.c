@@ -0,0 +1,436 @@
+/**
+ * Tarea de render con cola de comandos de dibujo
+ * ----------------------------------------------
+ *
+ * Ver render.h. La cola guarda los comandos por valor en un array de
+ * RENDER_QUEUE_LEN posiciones. 'head' y 'tail' cuentan comandos desde el
+ * arranque (no se reinician al dar la vuelta), así que:
+ *
+ *   pendientes = head - tail      (aritmética sin signo)
+ *   posición   = índice & (RENDER_QUEUE_LEN - 1)
+ *
+ * El consumidor ejecuta cada comando en su sitio y solo después avanza
+ * 'tail': cuando head == tail todo lo encolado ya se ha dibujado.
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#else
+#include <pthread.h>
+#include <stdio.h>
+#endif
+
+#include "render.h"
+#include "ili9341.h"
+
+#define RENDER_QUEUE_MASK  (RENDER_QUEUE_LEN - 1)
+
+_Static_assert((RENDER_QUEUE_LEN & RENDER_QUEUE_MASK) == 0,
+               "RENDER_QUEUE_LEN debe ser potencia de 2");
+
+// -----------------------------------------------------------------------------
+//  SEÑALES PARA DORMIR (FreeRTOS o pthreads)
+// -----------------------------------------------------------------------------
+
+/**
+ * Señal binaria: wait() duerme hasta que alguien haga give(); si el give
+ * llegó antes, wait() vuelve al momento. Así no se pierde ningún aviso
+ * entre comprobar la cola y ponerse a dormir.
+ */
+#ifdef ESP_PLATFORM
+
+static const char *TAG = "RENDER";
+
+typedef SemaphoreHandle_t render_signal_t;
+
+static bool render_signal_init(render_signal_t *signal)
+{
+    *signal = xSemaphoreCreateBinary();
+    return *signal != NULL;
+}
+
+static void render_signal_give(render_signal_t *signal)
+{
+    xSemaphoreGive(*signal);
+}
+
+static void render_signal_wait(render_signal_t *signal)
+{
+    xSemaphoreTake(*signal, portMAX_DELAY);
+}
+
+#else
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool set;
+} render_signal_t;
+
+static bool render_signal_init(render_signal_t *signal)
+{
+    signal->set = false;
+    return pthread_mutex_init(&signal->lock, NULL) == 0 &&
+           pthread_cond_init(&signal->cond, NULL) == 0;
+}
+
+static void render_signal_give(render_signal_t *signal)
+{
+    pthread_mutex_lock(&signal->lock);
+    signal->set = true;
+    pthread_cond_signal(&signal->cond);
+    pthread_mutex_unlock(&signal->lock);
+}
+
+static void render_signal_wait(render_signal_t *signal)
+{
+    pthread_mutex_lock(&signal->lock);
+    while (!signal->set) {
+        pthread_cond_wait(&signal->cond, &signal->lock);
+    }
+    signal->set = false;
+    pthread_mutex_unlock(&signal->lock);
+}
+
+#endif // ESP_PLATFORM
+
+// -----------------------------------------------------------------------------
+//  ESTADO DE LA COLA
+// -----------------------------------------------------------------------------
+
+static render_cmd_t render_queue[RENDER_QUEUE_LEN];
+
+static atomic_uint render_head;   // solo lo escribe el productor
+static atomic_uint render_tail;   // solo lo escribe el consumidor
+
+// Quién está (o va a estar) dormido esperando al otro
+static atomic_bool render_consumer_idle;
+static atomic_bool render_producer_waiting;
+
+static render_signal_t render_work_signal;    // productor -> consumidor
+static render_signal_t render_space_signal;   // consumidor -> productor
+
+static atomic_uint render_submitted;
+static atomic_uint render_executed;
+static uint32_t render_full_waits;            // solo el productor
+static uint32_t render_max_depth;             // solo el productor
+
+static bool render_running;
+
+#ifdef ESP_PLATFORM
+static TaskHandle_t render_task_handle;
+#else
+static pthread_t render_thread;
+#endif
+
+// -----------------------------------------------------------------------------
+//  CONSUMIDOR (tarea de render)
+// -----------------------------------------------------------------------------
+
+/**
+ * Ejecuta un comando con el driver. Devuelve false si es RENDER_CMD_STOP.
+ */
+static bool render_execute(const render_cmd_t *cmd)
+{
+    switch (cmd->type) {
+    case RENDER_CMD_FILL_SCREEN:
+        ili9341_fill_screen(cmd->color);
+        break;
+    case RENDER_CMD_FILL_RECT:
+        ili9341_fill_rect(cmd->x, cmd->y, cmd->w, cmd->h, cmd->color);
+        break;
+    case RENDER_CMD_TEXT:
+        ili9341_draw_string(cmd->x, cmd->y, cmd->text, cmd->color, cmd->bg, cmd->scale);
+        break;
+    case RENDER_CMD_BITMAP:
+        ili9341_draw_bitmap(cmd->x, cmd->y, cmd->w, cmd->h, cmd->pixels);
+        break;
+    case RENDER_CMD_IMAGE:
+        ili9341_draw_image(cmd->x, cmd->y, cmd->image.data, cmd->image.size);
+        break;
+    case RENDER_CMD_PRESENT:
+        ili9341_present();
+        break;
+    case RENDER_CMD_CALL:
+        cmd->call.fn(cmd->call.arg);
+        break;
+    case RENDER_CMD_LATENCY: {
+        // Los píxeles están en el panel cuando el bus ha terminado
+        latency_trace_t trace = cmd->latency;
+        ili9341_flush();
+        latency_trace_mark(&trace, LATENCY_POINT_DISPLAYED);
+        latency_trace_finish(&trace);
+        break;
+    }
+    case RENDER_CMD_STOP:
+        return false;
+    default:
+        break;
+    }
+    return true;
+}
+
+static void render_loop(void)
+{
+    bool running = true;
+
+    while (running) {
+        unsigned tail = atomic_load_explicit(&render_tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&render_head, memory_order_acquire);
+
+        if (tail == head) {
+            // Cola vacía: avisamos de que vamos a dormir y comprobamos otra
+            // vez, por si el productor encoló justo antes de ver el aviso
+            atomic_store(&render_consumer_idle, true);
+            if (atomic_load(&render_head) == tail) {
+                render_signal_wait(&render_work_signal);
+            }
+            atomic_store(&render_consumer_idle, false);
+            continue;
+        }
+
+        running = render_execute(&render_queue[tail & RENDER_QUEUE_MASK]);
+
+        // Solo ahora se libera la posición: tail == head significa "dibujado".
+        // Orden secuencial (no solo release): el aviso al productor de abajo
+        // no puede adelantarse a esta escritura.
+        atomic_store(&render_tail, tail + 1);
+        atomic_fetch_add_explicit(&render_executed, 1, memory_order_relaxed);
+
+        if (atomic_load(&render_producer_waiting)) {
+            render_signal_give(&render_space_signal);
+        }
+    }
+}
+
+#ifdef ESP_PLATFORM
+
+static void render_task(void *arg)
+{
+    (void)arg;
+    render_loop();
+    render_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+#else
+
+static void *render_thread_main(void *arg)
+{
+    (void)arg;
+    render_loop();
+    return NULL;
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+//  PRODUCTOR
+// -----------------------------------------------------------------------------
+
+bool render_start(void)
+{
+    if (render_running) return true;
+
+    static bool signals_ready = false;
+    if (!signals_ready) {
+        if (!render_signal_init(&render_work_signal) ||
+            !render_signal_init(&render_space_signal)) {
+            return false;
+        }
+        signals_ready = true;
+    }
+
+    atomic_store(&render_head, 0);
+    atomic_store(&render_tail, 0);
+    atomic_store(&render_consumer_idle, false);
+    atomic_store(&render_producer_waiting, false);
+
+#ifdef ESP_PLATFORM
+    BaseType_t ok = xTaskCreatePinnedToCore(render_task, "render", RENDER_STACK_SIZE, NULL,
+                                            RENDER_TASK_PRIORITY, &render_task_handle,
+                                            RENDER_CORE);
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear la tarea de render");
+        return false;
+    }
+#else
+    if (pthread_create(&render_thread, NULL, render_thread_main, NULL) != 0) {
+        fprintf(stderr, "No se pudo crear el hilo de render\n");
+        return false;
+    }
+#endif
+
+    render_running = true;
+    return true;
+}
+
+void render_stop(void)
+{
+    if (!render_running) return;
+
+    render_cmd_t cmd = { .type = RENDER_CMD_STOP };
+    render_submit(&cmd);
+    render_sync();
+
+#ifdef ESP_PLATFORM
+    // La tarea se borra sola al salir del bucle
+    while (render_task_handle != NULL) {
+        vTaskDelay(1);
+    }
+#else
+    pthread_join(render_thread, NULL);
+#endif
+
+    render_running = false;
+}
+
+bool render_try_submit(const render_cmd_t *cmd)
+{
+    unsigned head = atomic_load_explicit(&render_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&render_tail, memory_order_acquire);
+    unsigned depth = head - tail;
+
+    if (depth >= RENDER_QUEUE_LEN) {
+        return false;
+    }
+
+    render_queue[head & RENDER_QUEUE_MASK] = *cmd;
+    atomic_store(&render_head, head + 1);   // secuencial, igual que tail
+    atomic_fetch_add_explicit(&render_submitted, 1, memory_order_relaxed);
+
+    if (depth + 1 > render_max_depth) {
+        render_max_depth = depth + 1;
+    }
+
+    // Solo se despierta al consumidor si está dormido (o a punto)
+    if (atomic_load(&render_consumer_idle)) {
+        render_signal_give(&render_work_signal);
+    }
+    return true;
+}
+
+/**
+ * Duerme al productor hasta que la tarea de render ejecute algún comando
+ * más, salvo que 'done' ya se cumpla.
+ */
+static void render_wait_for_consumer(bool (*done)(void))
+{
+    atomic_store(&render_producer_waiting, true);
+    while (!done()) {
+        render_signal_wait(&render_space_signal);
+    }
+    atomic_store(&render_producer_waiting, false);
+}
+
+static bool render_queue_has_space(void)
+{
+    return atomic_load(&render_head) - atomic_load(&render_tail) < RENDER_QUEUE_LEN;
+}
+
+static bool render_queue_drained(void)
+{
+    return atomic_load(&render_head) == atomic_load(&render_tail);
+}
+
+void render_submit(const render_cmd_t *cmd)
+{
+    while (!render_try_submit(cmd)) {
+        render_full_waits++;
+        render_wait_for_consumer(render_queue_has_space);
+    }
+}
+
+void render_sync(void)
+{
+    render_wait_for_consumer(render_queue_drained);
+}
+
+void render_get_stats(render_stats_t *stats)
+{
+    stats->submitted = atomic_load(&render_submitted);
+    stats->executed = atomic_load(&render_executed);
+    stats->full_waits = render_full_waits;
+    stats->max_depth = render_max_depth;
+}
+
+// -----------------------------------------------------------------------------
+//  ATAJOS
+// -----------------------------------------------------------------------------
+
+void render_fill_screen(uint16_t color)
+{
+    render_cmd_t cmd = { .type = RENDER_CMD_FILL_SCREEN, .color = color };
+    render_submit(&cmd);
+}
+
+void render_fill_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+    render_cmd_t cmd = {
+        .type = RENDER_CMD_FILL_RECT,
+        .x = (int16_t)x, .y = (int16_t)y, .w = w, .h = h,
+        .color = color,
+    };
+    render_submit(&cmd);
+}
+
+void render_text(uint16_t x, uint16_t y, const char *text,
+                 uint16_t color, uint16_t bg, uint8_t scale)
+{
+    render_cmd_t cmd = {
+        .type = RENDER_CMD_TEXT,
+        .x = (int16_t)x, .y = (int16_t)y,
+        .color = color, .bg = bg, .scale = scale,
+    };
+    strncpy(cmd.text, text, RENDER_TEXT_MAX);
+    cmd.text[RENDER_TEXT_MAX] = '\0';
+    render_submit(&cmd);
+}
+
+void render_bitmap(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint16_t *pixels)
+{
+    render_cmd_t cmd = {
+        .type = RENDER_CMD_BITMAP,
+        .x = x, .y = y, .w = w, .h = h,
+        .pixels = pixels,
+    };
+    render_submit(&cmd);
+}
+
+void render_image(int16_t x, int16_t y, const uint8_t *image, uint32_t size)
+{
+    render_cmd_t cmd = {
+        .type = RENDER_CMD_IMAGE,
+        .x = x, .y = y,
+        .image = { .data = image, .size = size },
+    };
+    render_submit(&cmd);
+}
+
+void render_present(void)
+{
+    render_cmd_t cmd = { .type = RENDER_CMD_PRESENT };
+    render_submit(&cmd);
+}
+
+void render_call(render_call_fn_t fn, const void *arg, size_t size)
+{
+    render_cmd_t cmd = { .type = RENDER_CMD_CALL };
+    cmd.call.fn = fn;
+    if (arg && size > 0) {
+        memcpy(cmd.call.arg, arg, size <= RENDER_CALL_ARG_MAX ? size : RENDER_CALL_ARG_MAX);
+    }
+    render_submit(&cmd);
+}
+
+void render_latency(const latency_trace_t *trace)
+{
+    render_cmd_t cmd = { .type = RENDER_CMD_LATENCY, .latency = *trace };
+    render_submit(&cmd);
+}
@@ -0,0 +1,499 @@
+#include <string.h>
+#include "scheduler.h"
+#include "link.h"
+#include "sx1278.h"
+
+typedef struct{
+
+    uint8_t data[PACKET_MAX_SIZE];
+    size_t length;
+    packet_header header;
+    scheduler_ticket ticket;
+    scheduler_ticket ack_ticket;    // ACK travelling inside this frame, 0 if none
+    uint8_t attempts;               // handed back by LBT so far
+
+} scheduled_frame;
+
+typedef struct{
+
+    scheduler_ticket ticket;
+    scheduler_ticket_state state;
+    scheduler_priority priority;
+    bool piggybacked;
+
+} finished_ticket;
+
+// Each frame at the rate agreed with its receiver (link.h)
+static bool sx1278SendLinked(const uint8_t *frame, size_t length){
+
+    sx1278_rate_t rate;
+    linkFrameRate(frame, length, &rate);
+    return sx1278_send_rate(frame, length, &rate);
+}
+
+static uint32_t sx1278BusyCount(void){
+
+    sx1278_stats_t radio_stats;
+    sx1278_get_stats(&radio_stats);
+    return radio_stats.tx_busy;
+}
+
+static const scheduler_radio sx1278_radio = {
+    .send = sx1278SendLinked,
+    .pending = sx1278_tx_pending,
+    .busy_count = sx1278BusyCount,
+    .airtime_us = linkAirtimeUs,
+};
+
+static bool initialized = false;
+static scheduler_config config;
+static const scheduler_radio *radio;
+
+// One extra slot per queue: a frame handed back by LBT always fits again
+static scheduled_frame queues[SCHEDULER_PRIORITY_COUNT][SCHEDULER_QUEUE_LEN + 1];
+static size_t depths[SCHEDULER_PRIORITY_COUNT];
+
+static bool transmitting = false;
+static scheduled_frame on_air;
+static scheduler_priority on_air_priority;
+static uint32_t on_air_airtime_us;
+static int64_t on_air_end_us;
+static uint32_t on_air_busy_mark;
+
+static int64_t backoff_until_us;
+
+// Airtime per slot of the duty cycle window. One slot more than the window
+// holds: the oldest one may still overlap it, and counting it whole errs on
+// the safe side
+static uint32_t duty_slots[SCHEDULER_DUTY_SLOTS + 1];
+static size_t duty_current;
+static int64_t duty_slot_start_us;
+static bool waiting_budget;
+
+static finished_ticket history[SCHEDULER_HISTORY_LEN];
+static size_t history_next;
+static scheduler_ticket next_ticket = 1;
+static uint32_t random_state;
+static scheduler_stats stats;
+
+static scheduler_priority priorityOf(uint8_t packet_type){
+
+    switch(packet_type){
+    case PACKET_TYPE_ACK:
+        return SCHEDULER_PRIORITY_ACK;
+    case PACKET_TYPE_HANDSHAKE_INIT:
+    case PACKET_TYPE_HANDSHAKE_REPLY:
+        return SCHEDULER_PRIORITY_CONTROL;
+    default:
+        return SCHEDULER_PRIORITY_MESSAGE;
+    }
+}
+
+static bool dutyLimited(void){
+
+    return config.duty_cycle_permille < 1000;
+}
+
+static int64_t dutySlotUs(void){
+
+    int64_t slot_us = (int64_t)config.duty_window_ms * 1000 / SCHEDULER_DUTY_SLOTS;
+    return slot_us > 0 ? slot_us : 1;
+}
+
+// Airtime allowed in any duty_window_ms
+static uint64_t dutyBudgetUs(void){
+
+    return (uint64_t)config.duty_window_ms * config.duty_cycle_permille;
+}
+
+static void advanceSlots(int64_t now_us){
+
+    int64_t slot_us = dutySlotUs();
+    if(now_us - duty_slot_start_us >= slot_us * (SCHEDULER_DUTY_SLOTS + 1)){
+        memset(duty_slots, 0, sizeof(duty_slots));
+        duty_slot_start_us = now_us;
+        return;
+    }
+    while(now_us - duty_slot_start_us >= slot_us){
+        duty_slot_start_us += slot_us;
+        duty_current = (duty_current + 1) % (SCHEDULER_DUTY_SLOTS + 1);
+        duty_slots[duty_current] = 0;
+    }
+}
+
+static uint64_t dutyUsedUs(void){
+
+    uint64_t used = 0;
+    for(size_t slot = 0; slot <= SCHEDULER_DUTY_SLOTS; slot++){
+        used += duty_slots[slot];
+    }
+    return used;
+}
+
+// Time until airtime_us more fits in the window: old slots leave it one by one
+static int64_t budgetWait(uint64_t airtime_us, int64_t now_us){
+
+    if(!dutyLimited()){
+        return 0;
+    }
+    advanceSlots(now_us);
+
+    uint64_t used = dutyUsedUs();
+    uint64_t budget = dutyBudgetUs();
+    for(size_t age = 0; age <= SCHEDULER_DUTY_SLOTS; age++){
+        if(used + airtime_us <= budget){
+            return age == 0 ? 0 : duty_slot_start_us + (int64_t)age * dutySlotUs() - now_us;
+        }
+        used -= duty_slots[(duty_current + 1 + age) % (SCHEDULER_DUTY_SLOTS + 1)];
+    }
+    return duty_slot_start_us + (int64_t)(SCHEDULER_DUTY_SLOTS + 1) * dutySlotUs() - now_us;
+}
+
+static uint32_t nextRandom(void){
+
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void recordFinished(scheduler_ticket ticket, scheduler_ticket_state state, scheduler_priority priority,
+                           bool piggybacked){
+
+    if(ticket == 0){
+        return;
+    }
+    history[history_next] = (finished_ticket){ ticket, state, priority, piggybacked };
+    history_next = (history_next + 1) % SCHEDULER_HISTORY_LEN;
+}
+
+static void removeAt(scheduler_priority priority, size_t index){
+
+    memmove(&queues[priority][index], &queues[priority][index + 1],
+            (depths[priority] - index - 1) * sizeof(scheduled_frame));
+    depths[priority]--;
+}
+
+static void pushFront(scheduler_priority priority, const scheduled_frame *frame){
+
+    memmove(&queues[priority][1], &queues[priority][0], depths[priority] * sizeof(scheduled_frame));
+    queues[priority][0] = *frame;
+    depths[priority]++;
+}
+
+void schedulerInit(const scheduler_config *new_config, const scheduler_radio *new_radio, int64_t now_us){
+
+    static const scheduler_config default_config = SCHEDULER_CONFIG_DEFAULT;
+    config = new_config != NULL ? *new_config : default_config;
+    radio = new_radio != NULL ? new_radio : &sx1278_radio;
+    if(config.duty_cycle_permille == 0){
+        config.duty_cycle_permille = 1000;
+    }
+
+    memset(depths, 0, sizeof(depths));
+    memset(history, 0, sizeof(history));
+    memset(&stats, 0, sizeof(stats));
+    history_next = 0;
+    transmitting = false;
+    backoff_until_us = now_us;
+    memset(duty_slots, 0, sizeof(duty_slots));
+    duty_current = 0;
+    duty_slot_start_us = now_us;
+    waiting_budget = false;
+    random_state = (uint32_t)now_us | 1;
+    initialized = true;
+}
+
+static void ensureInit(int64_t now_us){
+
+    if(!initialized){
+        schedulerInit(NULL, NULL, now_us);
+    }
+}
+
+size_t schedulerQueueRoom(scheduler_priority priority){
+
+    if(priority >= SCHEDULER_PRIORITY_COUNT){
+        return 0;
+    }
+    return depths[priority] < SCHEDULER_QUEUE_LEN ? SCHEDULER_QUEUE_LEN - depths[priority] : 0;
+}
+
+int schedulerSubmit(const uint8_t *frame, size_t frame_length, int64_t now_us, scheduler_ticket *ticket){
+
+    ensureInit(now_us);
+
+    if(frame_length > PACKET_MAX_SIZE ||
+       (dutyLimited() && radio->airtime_us(frame, frame_length) > dutyBudgetUs())){
+        return SCHEDULER_ERROR_TOO_LARGE;
+    }
+    packet_view view;
+    int error = packetDecode(frame, frame_length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    scheduler_priority priority = priorityOf(view.header.packet_type);
+
+    // The receiver's bitmap only grows: the newer ACK says all the older did
+    if(priority == SCHEDULER_PRIORITY_ACK){
+        for(size_t index = 0; index < depths[priority]; index++){
+            scheduled_frame *queued = &queues[priority][index];
+            if(queued->header.packet_type == PACKET_TYPE_ACK &&
+               queued->header.transmitter_id == view.header.transmitter_id &&
+               queued->header.receiver_id == view.header.receiver_id &&
+               queued->header.sequence == view.header.sequence){
+                memcpy(queued->data, frame, frame_length);
+                queued->length = frame_length;
+                queued->header = view.header;   // its flags may differ (rate, mesh)
+                stats.acks_replaced++;
+                if(ticket != NULL){
+                    *ticket = queued->ticket;
+                }
+                return SCHEDULER_OK;
+            }
+        }
+    }
+
+    if(depths[priority] >= SCHEDULER_QUEUE_LEN){
+        stats.rejected++;
+        return SCHEDULER_ERROR_QUEUE_FULL;
+    }
+
+    scheduled_frame *slot = &queues[priority][depths[priority]++];
+    memcpy(slot->data, frame, frame_length);
+    slot->length = frame_length;
+    slot->header = view.header;
+    slot->ticket = next_ticket++;
+    slot->ack_ticket = 0;
+    slot->attempts = 0;
+    if(next_ticket == 0){
+        next_ticket = 1;
+    }
+
+    stats.submitted++;
+    if(ticket != NULL){
+        *ticket = slot->ticket;
+    }
+    return SCHEDULER_OK;
+}
+
+// The radio went idle: sent, or handed back because the channel was busy
+static void finishOnAir(int64_t now_us){
+
+    transmitting = false;
+
+    if(radio->busy_count() == on_air_busy_mark){
+        // Counted when it ends, in the current slot: later than it really
+        // went, so it stays in the window a little longer (the safe side)
+        if(dutyLimited()){
+            advanceSlots(now_us);
+            duty_slots[duty_current] += on_air_airtime_us;
+        }
+        stats.sent++;
+        stats.airtime_us += on_air_airtime_us;
+        recordFinished(on_air.ticket, SCHEDULER_TICKET_SENT, priorityOf(on_air.header.packet_type), false);
+        recordFinished(on_air.ack_ticket, SCHEDULER_TICKET_SENT, SCHEDULER_PRIORITY_ACK, true);
+        return;
+    }
+
+    // Nothing went on air, nothing counts against the duty cycle
+    stats.channel_busy++;
+    on_air.attempts++;
+
+    if(on_air.attempts >= config.lbt_max_attempts){
+        stats.dropped++;
+        recordFinished(on_air.ticket, SCHEDULER_TICKET_DROPPED, priorityOf(on_air.header.packet_type), false);
+        recordFinished(on_air.ack_ticket, SCHEDULER_TICKET_DROPPED, SCHEDULER_PRIORITY_ACK, true);
+        return;
+    }
+
+    pushFront(on_air_priority, &on_air);
+    uint8_t exponent = on_air.attempts < config.lbt_max_exponent ? on_air.attempts : config.lbt_max_exponent;
+    uint32_t slots = 1 + nextRandom() % (1u << exponent);
+    backoff_until_us = now_us + (int64_t)slots * config.lbt_slot_us;
+}
+
+// A DATA or FRAGMENT frame waiting for the same peer as the ACK, if any
+static int findCarrier(const scheduled_frame *ack){
+
+    for(size_t index = 0; index < depths[SCHEDULER_PRIORITY_MESSAGE]; index++){
+        const scheduled_frame *queued = &queues[SCHEDULER_PRIORITY_MESSAGE][index];
+        if((queued->header.packet_type == PACKET_TYPE_DATA || queued->header.packet_type == PACKET_TYPE_FRAGMENT) &&
+           !(queued->header.flags & PACKET_FLAG_ACK_ATTACHED) &&
+           queued->header.transmitter_id == ack->header.transmitter_id &&
+           queued->header.receiver_id == ack->header.receiver_id){
+            return (int)index;
+        }
+    }
+    return -1;
+}
+
+int64_t schedulerService(int64_t now_us){
+
+    ensureInit(now_us);
+
+    if(transmitting){
+        if(radio->pending() > 0){
+            return on_air_end_us > now_us ? on_air_end_us - now_us : SCHEDULER_RETRY_US;
+        }
+        finishOnAir(now_us);
+    }
+    if(backoff_until_us > now_us){
+        return backoff_until_us - now_us;
+    }
+
+    scheduler_priority priority = SCHEDULER_PRIORITY_ACK;
+    while(priority < SCHEDULER_PRIORITY_COUNT && depths[priority] == 0){
+        priority++;
+    }
+    if(priority == SCHEDULER_PRIORITY_COUNT){
+        return -1;
+    }
+
+    scheduled_frame candidate = queues[priority][0];
+    int carrier = -1;
+    // An ACK answering a rate offer goes at the old rate, on its own. So
+    // does a flooded one (mesh.h): nodes that already relayed the carrier
+    // would drop it as a duplicate
+    if(config.piggyback_acks && priority == SCHEDULER_PRIORITY_ACK &&
+       candidate.header.packet_type == PACKET_TYPE_ACK && candidate.ack_ticket == 0 &&
+       !(candidate.header.flags & (PACKET_FLAG_RATE_ATTACHED | PACKET_FLAG_MESH))){
+        carrier = findCarrier(&candidate);
+    }
+    if(carrier >= 0){
+        packet_view ack;
+        scheduled_frame combined = queues[SCHEDULER_PRIORITY_MESSAGE][carrier];
+        if(packetDecode(candidate.data, candidate.length, &ack) == PACKET_OK &&
+           ack.payload_length == PACKET_ACK_BITMAP_SIZE + PACKET_ACK_MAC_SIZE &&
+           packetAttachAck(combined.data, combined.length, sizeof(combined.data), ack.header.sequence,
+                           (uint16_t)(ack.payload[0] | (ack.payload[1] << 8)), &ack.payload[PACKET_ACK_BITMAP_SIZE],
+                           &combined.length) == PACKET_OK){
+            combined.header.flags |= PACKET_FLAG_ACK_ATTACHED;
+            combined.ack_ticket = candidate.ticket;
+            candidate = combined;
+        } else {
+            carrier = -1;
+        }
+    }
+
+    uint32_t airtime_us = radio->airtime_us(candidate.data, candidate.length);
+    int64_t wait_us = budgetWait(airtime_us, now_us);
+    if(wait_us > 0){
+        if(!waiting_budget){
+            stats.duty_waits++;
+            waiting_budget = true;
+        }
+        return wait_us;
+    }
+    waiting_budget = false;
+
+    uint32_t busy_mark = radio->busy_count();
+    if(!radio->send(candidate.data, candidate.length)){
+        return SCHEDULER_RETRY_US;
+    }
+
+    removeAt(priority, 0);
+    if(carrier >= 0){
+        removeAt(SCHEDULER_PRIORITY_MESSAGE, (size_t)carrier);
+        stats.acks_piggybacked++;
+    }
+
+    on_air = candidate;
+    on_air_priority = priority;
+    on_air_airtime_us = airtime_us;
+    on_air_end_us = now_us + airtime_us;
+    on_air_busy_mark = busy_mark;
+    transmitting = true;
+    return airtime_us;
+}
+
+// Until a frame of own_us airtime, with ahead_us of airtime in front of it, can start
+static int64_t expectedWait(uint64_t ahead_us, uint32_t own_us, int64_t now_us){
+
+    int64_t start_us = now_us;
+    if(transmitting && on_air_end_us > start_us){
+        start_us = on_air_end_us;
+    }
+    if(backoff_until_us > start_us){
+        start_us = backoff_until_us;
+    }
+    int64_t channel_us = start_us - now_us + (int64_t)ahead_us;
+    int64_t budget_us = budgetWait(ahead_us + own_us + (transmitting ? on_air_airtime_us : 0), now_us);
+    return channel_us > budget_us ? channel_us : budget_us;
+}
+
+int schedulerTicketInfo(scheduler_ticket ticket, int64_t now_us, scheduler_ticket_info *info){
+
+    ensureInit(now_us);
+    memset(info, 0, sizeof(*info));
+
+    if(ticket == 0){
+        return SCHEDULER_ERROR_UNKNOWN_TICKET;
+    }
+    if(transmitting && (on_air.ticket == ticket || on_air.ack_ticket == ticket)){
+        info->state = SCHEDULER_TICKET_ON_AIR;
+        info->priority = on_air.ticket == ticket ? priorityOf(on_air.header.packet_type) : SCHEDULER_PRIORITY_ACK;
+        info->piggybacked = on_air.ack_ticket == ticket;
+        return SCHEDULER_OK;
+    }
+
+    uint64_t ahead_us = 0;
+    uint8_t position = 0;
+    for(int priority = 0; priority < SCHEDULER_PRIORITY_COUNT; priority++){
+        for(size_t index = 0; index < depths[priority]; index++){
+            const scheduled_frame *queued = &queues[priority][index];
+            if(queued->ticket == ticket || queued->ack_ticket == ticket){
+                info->state = SCHEDULER_TICKET_QUEUED;
+                info->priority = queued->ticket == ticket ? priorityOf(queued->header.packet_type) : SCHEDULER_PRIORITY_ACK;
+                info->piggybacked = queued->ack_ticket == ticket;
+                info->position = position;
+                info->expected_wait_us = expectedWait(ahead_us, radio->airtime_us(queued->data, queued->length), now_us);
+                return SCHEDULER_OK;
+            }
+            ahead_us += radio->airtime_us(queued->data, queued->length);
+            position++;
+        }
+    }
+
+    for(size_t index = 0; index < SCHEDULER_HISTORY_LEN; index++){
+        if(history[index].ticket == ticket){
+            info->state = history[index].state;
+            info->priority = history[index].priority;
+            info->piggybacked = history[index].piggybacked;
+            return SCHEDULER_OK;
+        }
+    }
+    return SCHEDULER_ERROR_UNKNOWN_TICKET;
+}
+
+void schedulerGetStatus(int64_t now_us, scheduler_status *status){
+
+    ensureInit(now_us);
+    memset(status, 0, sizeof(*status));
+
+    uint64_t ahead_us = 0;
+    for(int priority = 0; priority < SCHEDULER_PRIORITY_COUNT; priority++){
+        status->depth[priority] = (uint8_t)depths[priority];
+        for(size_t index = 0; index < depths[priority]; index++){
+            ahead_us += radio->airtime_us(queues[priority][index].data, queues[priority][index].length);
+        }
+        status->expected_wait_us[priority] = expectedWait(ahead_us, 0, now_us);
+    }
+    status->queued_airtime_us = (uint32_t)ahead_us;
+
+    if(dutyLimited()){
+        advanceSlots(now_us);
+        uint64_t used = dutyUsedUs();
+        uint64_t budget = dutyBudgetUs();
+        status->duty_credit_us = used < budget ? (uint32_t)(budget - used) : 0;
+    } else {
+        status->duty_credit_us = UINT32_MAX;
+    }
+    status->on_air = transmitting;
+}
+
+void schedulerGetStats(scheduler_stats *out){
+
+    *out = stats;
+}
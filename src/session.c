@@ -0,0 +1,400 @@
+#include <string.h>
+#include "packet.h"
+#include "session.h"
+#include "sha256.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_random.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#define SESSION_KDF_LABEL "hermes session v1"
+
+static void fillRandom(uint8_t *buffer, size_t length){
+
+#ifdef ESP_PLATFORM
+    // Hardware RNG; true random while the radio (RF) is on, see esp_random.h
+    esp_fill_random(buffer, length);
+#else
+    FILE *source = fopen("/dev/urandom", "rb");
+    if(source == NULL || fread(buffer, 1, length, source) != length){
+        // The host build is only for simulation: fail loudly, never weakly
+        fprintf(stderr, "session: no /dev/urandom\n");
+        abort();
+    }
+    fclose(source);
+#endif
+}
+
+static void secureZero(void *data, size_t length){
+
+    volatile uint8_t *bytes = data;
+    while(length--){
+        *bytes++ = 0;
+    }
+}
+
+static bool bytesEqual(const uint8_t *first, const uint8_t *second, size_t length){
+
+    uint8_t difference = 0;
+    for(size_t index = 0; index < length; index++){
+        difference |= first[index] ^ second[index];
+    }
+    return difference == 0;
+}
+
+static void writeLittleEndian32(uint8_t *bytes, uint32_t value){
+
+    for(int byte = 0; byte < 4; byte++){
+        bytes[byte] = (uint8_t)(value >> (8 * byte));
+    }
+}
+
+void sessionCacheInit(session_cache *cache, uint32_t local_id, const uint8_t network_key[AEAD_KEY_SIZE]){
+
+    memset(cache, 0, sizeof(*cache));
+    cache->local_id = local_id;
+    memcpy(cache->network_key, network_key, AEAD_KEY_SIZE);
+}
+
+static session_entry *findEntry(session_cache *cache, uint32_t peer_id){
+
+    for(int index = 0; index < SESSION_CACHE_SIZE; index++){
+        if(cache->entries[index].in_use && cache->entries[index].peer_id == peer_id){
+            return &cache->entries[index];
+        }
+    }
+    return NULL;
+}
+
+static void touchEntry(session_cache *cache, session_entry *entry){
+
+    entry->last_used = ++cache->use_clock;
+}
+
+// Entry for peer_id, taking a free slot or the least recently used one
+static session_entry *claimEntry(session_cache *cache, uint32_t peer_id){
+
+    session_entry *entry = findEntry(cache, peer_id);
+    if(entry != NULL){
+        return entry;
+    }
+
+    session_entry *victim = &cache->entries[0];
+    for(int index = 0; index < SESSION_CACHE_SIZE; index++){
+        session_entry *candidate = &cache->entries[index];
+        if(!candidate->in_use){
+            victim = candidate;
+            break;
+        }
+        if(candidate->last_used < victim->last_used){
+            victim = candidate;
+        }
+    }
+
+    if(victim->in_use){
+        cache->stats.evictions++;
+    }
+    secureZero(victim, sizeof(*victim));
+    victim->in_use = true;
+    victim->peer_id = peer_id;
+    return victim;
+}
+
+/*
+ * auth = HMAC-SHA256(network key, header | public key [| initiator public]),
+ * truncated. A REPLY also covers the initiator's ephemeral key, so a late
+ * reply to an older INIT is rejected instead of deriving mismatched keys.
+ */
+static void handshakeAuth(const session_cache *cache, const uint8_t *frame, size_t signed_length,
+                          const uint8_t *initiator_public, uint8_t auth[SESSION_AUTH_SIZE]){
+
+    uint8_t signed_data[PACKET_HEADER_MAX_SIZE + 2 * X25519_KEY_SIZE];
+    uint8_t mac[SHA256_DIGEST_SIZE];
+
+    memcpy(signed_data, frame, signed_length);
+    signed_data[1] &= (uint8_t)~PACKET_TRAILER_FLAGS; // a relay may have added the mesh trailer
+    if(initiator_public != NULL){
+        memcpy(&signed_data[signed_length], initiator_public, X25519_KEY_SIZE);
+        signed_length += X25519_KEY_SIZE;
+    }
+    hmacSha256(cache->network_key, AEAD_KEY_SIZE, signed_data, signed_length, mac);
+    memcpy(auth, mac, SESSION_AUTH_SIZE);
+}
+
+static int writeHandshakeFrame(session_cache *cache, uint8_t packet_type, uint32_t peer_id, uint8_t key_phase,
+                               const uint8_t public_key[X25519_KEY_SIZE], const uint8_t *initiator_public,
+                               uint8_t *frame, size_t frame_size, size_t *frame_length){
+
+    packet_header header = {
+        .version = PACKET_VERSION,
+        .packet_type = packet_type,
+        .flags = key_phase ? PACKET_FLAG_KEY_PHASE : PACKET_FLAG_NONE,
+        .transmitter_id = cache->local_id,
+        .receiver_id = peer_id,
+        .sequence = cache->handshake_sequence++,
+    };
+
+    size_t header_length = 0;
+    int error = packetWriteHeader(&header, SESSION_HANDSHAKE_PAYLOAD_SIZE, frame, frame_size, &header_length);
+    if(error != PACKET_OK){
+        return error;
+    }
+
+    memcpy(&frame[header_length], public_key, X25519_KEY_SIZE);
+    handshakeAuth(cache, frame, header_length + X25519_KEY_SIZE, initiator_public,
+                  &frame[header_length + X25519_KEY_SIZE]);
+
+    *frame_length = packetWriteCrc(frame, header_length + SESSION_HANDSHAKE_PAYLOAD_SIZE);
+    return 0;
+}
+
+/*
+ * Shared secret -> one key per direction. Wipes the ephemeral secret:
+ * after this the session keys cannot be recomputed from stored state.
+ */
+static int deriveSession(session_cache *cache, session_entry *entry, uint8_t key_phase, int64_t now_us,
+                         const uint8_t peer_public[X25519_KEY_SIZE], bool we_initiated){
+
+    uint8_t input_key[3 * X25519_KEY_SIZE];
+    uint8_t info[sizeof(SESSION_KDF_LABEL) - 1 + 8];
+    uint8_t keys[2 * AEAD_KEY_SIZE];
+    static const uint8_t all_zero[X25519_KEY_SIZE] = {0};
+
+    x25519(input_key, entry->ephemeral_secret, peer_public);
+    secureZero(entry->ephemeral_secret, sizeof(entry->ephemeral_secret));
+
+    // A low order public key gives an all-zero secret (RFC 7748 section 6.1)
+    if(bytesEqual(input_key, all_zero, X25519_KEY_SIZE)){
+        return SESSION_ERROR_REJECTED;
+    }
+
+    const uint8_t *initiator_public = we_initiated ? entry->ephemeral_public : peer_public;
+    const uint8_t *responder_public = we_initiated ? peer_public : entry->ephemeral_public;
+    uint32_t initiator_id = we_initiated ? cache->local_id : entry->peer_id;
+    uint32_t responder_id = we_initiated ? entry->peer_id : cache->local_id;
+
+    memcpy(&input_key[X25519_KEY_SIZE], initiator_public, X25519_KEY_SIZE);
+    memcpy(&input_key[2 * X25519_KEY_SIZE], responder_public, X25519_KEY_SIZE);
+    memcpy(info, SESSION_KDF_LABEL, sizeof(SESSION_KDF_LABEL) - 1);
+    writeLittleEndian32(&info[sizeof(SESSION_KDF_LABEL) - 1], initiator_id);
+    writeLittleEndian32(&info[sizeof(SESSION_KDF_LABEL) + 3], responder_id);
+
+    hkdfSha256(cache->network_key, AEAD_KEY_SIZE, input_key, sizeof(input_key), info, sizeof(info),
+               keys, sizeof(keys));
+
+    // Frames still in flight under the old keys keep opening until the next
+    // rekey. An INIT sent again under the same phase (our REPLY was lost)
+    // replaces keys the peer never had: the previous ones stay
+    if(entry->established){
+        if(we_initiated || entry->confirmed || key_phase != entry->key_phase){
+            memcpy(entry->previous_receive_key, entry->receive_key, AEAD_KEY_SIZE);
+            memcpy(entry->previous_send_key, entry->send_key, AEAD_KEY_SIZE);
+            entry->previous_replay = entry->replay;
+            entry->has_previous_key = true;
+        }
+        cache->stats.rekeys++;
+    } else {
+        cache->stats.handshakes_completed++;
+    }
+
+    // First half initiator -> responder, second half the other way
+    memcpy(entry->send_key, we_initiated ? &keys[0] : &keys[AEAD_KEY_SIZE], AEAD_KEY_SIZE);
+    memcpy(entry->receive_key, we_initiated ? &keys[AEAD_KEY_SIZE] : &keys[0], AEAD_KEY_SIZE);
+    entry->key_phase = key_phase;
+    memset(&entry->replay, 0, sizeof(entry->replay));
+    entry->established = true;
+    entry->confirmed = we_initiated; // the REPLY shows the responder has them
+    entry->handshake_pending = false;
+    entry->established_us = now_us;
+    entry->messages_sent = 0;
+    touchEntry(cache, entry);
+
+    secureZero(input_key, sizeof(input_key));
+    secureZero(keys, sizeof(keys));
+    return SESSION_OK;
+}
+
+// Our INIT is out and its REPLY may still come
+static bool handshakeWaiting(const session_entry *entry, int64_t now_us){
+
+    return entry->handshake_pending &&
+           now_us - entry->handshake_started_us < (int64_t)SESSION_HANDSHAKE_TIMEOUT_MS * 1000;
+}
+
+int sessionStartHandshake(session_cache *cache, uint32_t peer_id, int64_t now_us,
+                          uint8_t *frame, size_t frame_size, size_t *frame_length){
+
+    session_entry *entry = claimEntry(cache, peer_id);
+    if(entry->handshake_pending){
+        cache->stats.handshakes_retried++;
+    }
+
+    // New keys go under the other phase, so both key sets can coexist
+    entry->pending_key_phase = entry->established ? (uint8_t)!entry->key_phase : 0;
+
+    fillRandom(entry->ephemeral_secret, sizeof(entry->ephemeral_secret));
+    x25519PublicKey(entry->ephemeral_public, entry->ephemeral_secret);
+    entry->handshake_pending = true;
+    entry->handshake_started_us = now_us;
+    touchEntry(cache, entry);
+    cache->stats.handshakes_started++;
+
+    return writeHandshakeFrame(cache, PACKET_TYPE_HANDSHAKE_INIT, peer_id, entry->pending_key_phase,
+                               entry->ephemeral_public, NULL, frame, frame_size, frame_length);
+}
+
+int sessionHandleHandshake(session_cache *cache, const uint8_t *frame, size_t frame_length, int64_t now_us,
+                           uint8_t *reply, size_t reply_size, size_t *reply_length){
+
+    packet_view view;
+    *reply_length = 0;
+
+    int error = packetDecode(frame, frame_length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    if(view.header.packet_type != PACKET_TYPE_HANDSHAKE_INIT &&
+       view.header.packet_type != PACKET_TYPE_HANDSHAKE_REPLY){
+        return SESSION_ERROR_NOT_HANDSHAKE;
+    }
+
+    if(view.header.receiver_id != cache->local_id ||
+       view.payload_length != SESSION_HANDSHAKE_PAYLOAD_SIZE){
+        cache->stats.handshakes_rejected++;
+        return SESSION_ERROR_REJECTED;
+    }
+
+    uint32_t peer_id = view.header.transmitter_id;
+    const uint8_t *peer_public = view.payload;
+    uint8_t key_phase = (view.header.flags & PACKET_FLAG_KEY_PHASE) ? 1 : 0;
+    bool is_reply = view.header.packet_type == PACKET_TYPE_HANDSHAKE_REPLY;
+
+    session_entry *entry = findEntry(cache, peer_id);
+    if(is_reply && (entry == NULL || !entry->handshake_pending)){
+        return SESSION_ERROR_UNEXPECTED;
+    }
+
+    // Checked before touching the cache: a forged frame must not evict anyone
+    uint8_t expected_auth[SESSION_AUTH_SIZE];
+    size_t header_length = (size_t)(view.payload - frame);
+    handshakeAuth(cache, frame, header_length + X25519_KEY_SIZE, is_reply ? entry->ephemeral_public : NULL,
+                  expected_auth);
+    if(!bytesEqual(expected_auth, &view.payload[X25519_KEY_SIZE], SESSION_AUTH_SIZE)){
+        cache->stats.handshakes_rejected++;
+        return SESSION_ERROR_REJECTED;
+    }
+
+    if(is_reply){
+        error = deriveSession(cache, entry, entry->pending_key_phase, now_us, peer_public, true);
+        if(error != SESSION_OK){
+            entry->handshake_pending = false;
+            cache->stats.handshakes_rejected++;
+        }
+        return error;
+    }
+
+    // INIT. If both sides started at once, the lower id stays initiator
+    // (unless our INIT timed out: then it was lost)
+    if(entry != NULL && handshakeWaiting(entry, now_us) && cache->local_id < peer_id){
+        return SESSION_ERROR_COLLISION;
+    }
+
+    entry = claimEntry(cache, peer_id);
+    fillRandom(entry->ephemeral_secret, sizeof(entry->ephemeral_secret));
+    x25519PublicKey(entry->ephemeral_public, entry->ephemeral_secret);
+    entry->handshake_pending = false;
+
+    error = deriveSession(cache, entry, key_phase, now_us, peer_public, false);
+    if(error != SESSION_OK){
+        cache->stats.handshakes_rejected++;
+        return error;
+    }
+
+    return writeHandshakeFrame(cache, PACKET_TYPE_HANDSHAKE_REPLY, peer_id, key_phase,
+                               entry->ephemeral_public, peer_public, reply, reply_size, reply_length);
+}
+
+int sessionGetSendKey(session_cache *cache, uint32_t peer_id, const uint8_t **key, uint8_t *key_phase){
+
+    session_entry *entry = findEntry(cache, peer_id);
+    if(entry == NULL || !entry->established){
+        return SESSION_ERROR_NO_SESSION;
+    }
+    if(entry->messages_sent >= 2 * SESSION_REKEY_MESSAGES){
+        return SESSION_ERROR_EXHAUSTED;
+    }
+
+    entry->messages_sent++;
+    touchEntry(cache, entry);
+    // Responder after a rekey: the peer may not have the new keys yet
+    if(!entry->confirmed && entry->has_previous_key){
+        *key = entry->previous_send_key;
+        *key_phase = (uint8_t)!entry->key_phase;
+        return SESSION_OK;
+    }
+    *key = entry->send_key;
+    *key_phase = entry->key_phase;
+    return SESSION_OK;
+}
+
+int sessionGetReceiveKey(session_cache *cache, uint32_t peer_id, uint8_t key_phase, const uint8_t **key){
+
+    session_entry *entry = findEntry(cache, peer_id);
+    if(entry == NULL || !entry->established){
+        return SESSION_ERROR_NO_SESSION;
+    }
+
+    if(key_phase == entry->key_phase){
+        *key = entry->receive_key;
+    } else if(entry->has_previous_key){
+        *key = entry->previous_receive_key;
+    } else {
+        return SESSION_ERROR_NO_SESSION;
+    }
+    touchEntry(cache, entry);
+    return SESSION_OK;
+}
+
+session_replay *sessionReplayWindow(session_cache *cache, uint32_t peer_id, uint8_t key_phase){
+
+    session_entry *entry = findEntry(cache, peer_id);
+    if(entry == NULL || !entry->established){
+        return NULL;
+    }
+    if(key_phase == entry->key_phase){
+        return &entry->replay;
+    }
+    return entry->has_previous_key ? &entry->previous_replay : NULL;
+}
+
+void sessionConfirmKey(session_cache *cache, uint32_t peer_id, uint8_t key_phase){
+
+    session_entry *entry = findEntry(cache, peer_id);
+    if(entry == NULL || !entry->established || entry->confirmed || key_phase != entry->key_phase){
+        return;
+    }
+    entry->confirmed = true;
+    secureZero(entry->previous_send_key, sizeof(entry->previous_send_key));
+}
+
+bool sessionRekeyDue(const session_cache *cache, uint32_t peer_id, int64_t now_us){
+
+    for(int index = 0; index < SESSION_CACHE_SIZE; index++){
+        const session_entry *entry = &cache->entries[index];
+        if(!entry->in_use || entry->peer_id != peer_id){
+            continue;
+        }
+        if(handshakeWaiting(entry, now_us)){
+            return false; // already on its way
+        }
+        if(!entry->established){
+            return true;
+        }
+        return entry->messages_sent >= SESSION_REKEY_MESSAGES ||
+               now_us - entry->established_us >= (int64_t)SESSION_REKEY_SECONDS * 1000000;
+    }
+    return true;
+}
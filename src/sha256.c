@@ -0,0 +1,188 @@
+#include <string.h>
+#include "sha256.h"
+
+static const uint32_t round_constants[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+#define ROTATE_RIGHT(value, bits) (((value) >> (bits)) | ((value) << (32 - (bits))))
+
+static void sha256Block(sha256_context *context, const uint8_t block[SHA256_BLOCK_SIZE]){
+
+    uint32_t schedule[64];
+    uint32_t working[8];
+
+    for(int word = 0; word < 16; word++){
+        schedule[word] = ((uint32_t)block[4 * word] << 24) | ((uint32_t)block[4 * word + 1] << 16) |
+                         ((uint32_t)block[4 * word + 2] << 8) | (uint32_t)block[4 * word + 3];
+    }
+    for(int word = 16; word < 64; word++){
+        uint32_t sigma0 = ROTATE_RIGHT(schedule[word - 15], 7) ^ ROTATE_RIGHT(schedule[word - 15], 18) ^ (schedule[word - 15] >> 3);
+        uint32_t sigma1 = ROTATE_RIGHT(schedule[word - 2], 17) ^ ROTATE_RIGHT(schedule[word - 2], 19) ^ (schedule[word - 2] >> 10);
+        schedule[word] = schedule[word - 16] + sigma0 + schedule[word - 7] + sigma1;
+    }
+
+    memcpy(working, context->state, sizeof(working));
+
+    for(int round = 0; round < 64; round++){
+        uint32_t sum1 = ROTATE_RIGHT(working[4], 6) ^ ROTATE_RIGHT(working[4], 11) ^ ROTATE_RIGHT(working[4], 25);
+        uint32_t choose = (working[4] & working[5]) ^ (~working[4] & working[6]);
+        uint32_t temp1 = working[7] + sum1 + choose + round_constants[round] + schedule[round];
+        uint32_t sum0 = ROTATE_RIGHT(working[0], 2) ^ ROTATE_RIGHT(working[0], 13) ^ ROTATE_RIGHT(working[0], 22);
+        uint32_t majority = (working[0] & working[1]) ^ (working[0] & working[2]) ^ (working[1] & working[2]);
+        uint32_t temp2 = sum0 + majority;
+
+        memmove(&working[1], &working[0], 7 * sizeof(working[0]));
+        working[4] += temp1;
+        working[0] = temp1 + temp2;
+    }
+
+    for(int word = 0; word < 8; word++){
+        context->state[word] += working[word];
+    }
+}
+
+void sha256Start(sha256_context *context){
+
+    static const uint32_t initial_state[8] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+    };
+    memcpy(context->state, initial_state, sizeof(initial_state));
+    context->total_length = 0;
+    context->buffered = 0;
+}
+
+void sha256Update(sha256_context *context, const uint8_t *data, size_t length){
+
+    context->total_length += length;
+
+    while(length > 0){
+        size_t take = SHA256_BLOCK_SIZE - context->buffered;
+        if(take > length){
+            take = length;
+        }
+        memcpy(&context->buffer[context->buffered], data, take);
+        context->buffered += take;
+        data += take;
+        length -= take;
+
+        if(context->buffered == SHA256_BLOCK_SIZE){
+            sha256Block(context, context->buffer);
+            context->buffered = 0;
+        }
+    }
+}
+
+void sha256Finish(sha256_context *context, uint8_t digest[SHA256_DIGEST_SIZE]){
+
+    uint64_t total_bits = context->total_length * 8;
+    uint8_t padding[SHA256_BLOCK_SIZE + 8] = { 0x80 };
+
+    // 0x80, zeros up to 56 mod 64, then the bit length big-endian
+    size_t padding_length = (context->buffered < 56 ? 56 : 120) - context->buffered;
+    for(int byte = 0; byte < 8; byte++){
+        padding[padding_length + byte] = (uint8_t)(total_bits >> (56 - 8 * byte));
+    }
+    sha256Update(context, padding, padding_length + 8);
+
+    for(int word = 0; word < 8; word++){
+        digest[4 * word] = (uint8_t)(context->state[word] >> 24);
+        digest[4 * word + 1] = (uint8_t)(context->state[word] >> 16);
+        digest[4 * word + 2] = (uint8_t)(context->state[word] >> 8);
+        digest[4 * word + 3] = (uint8_t)context->state[word];
+    }
+}
+
+// Key of an HMAC padded (or hashed down) to one block
+static void hmacBlockKey(const uint8_t *key, size_t key_length, uint8_t block_key[SHA256_BLOCK_SIZE]){
+
+    memset(block_key, 0, SHA256_BLOCK_SIZE);
+    if(key_length > SHA256_BLOCK_SIZE){
+        sha256_context context;
+        sha256Start(&context);
+        sha256Update(&context, key, key_length);
+        sha256Finish(&context, block_key);
+    } else if(key_length > 0){
+        memcpy(block_key, key, key_length);
+    }
+}
+
+// Starts the inner hash: the message goes in with sha256Update
+static void hmacStart(sha256_context *context, const uint8_t block_key[SHA256_BLOCK_SIZE]){
+
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    for(int index = 0; index < SHA256_BLOCK_SIZE; index++){
+        pad[index] = block_key[index] ^ 0x36;
+    }
+    sha256Start(context);
+    sha256Update(context, pad, sizeof(pad));
+}
+
+static void hmacFinish(sha256_context *context, const uint8_t block_key[SHA256_BLOCK_SIZE],
+                       uint8_t mac[SHA256_DIGEST_SIZE]){
+
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    sha256Finish(context, mac);
+    for(int index = 0; index < SHA256_BLOCK_SIZE; index++){
+        pad[index] = block_key[index] ^ 0x5C;
+    }
+    sha256Start(context);
+    sha256Update(context, pad, sizeof(pad));
+    sha256Update(context, mac, SHA256_DIGEST_SIZE);
+    sha256Finish(context, mac);
+}
+
+void hmacSha256(const uint8_t *key, size_t key_length, const uint8_t *data, size_t data_length,
+                uint8_t mac[SHA256_DIGEST_SIZE]){
+
+    uint8_t block_key[SHA256_BLOCK_SIZE];
+    sha256_context context;
+
+    hmacBlockKey(key, key_length, block_key);
+    hmacStart(&context, block_key);
+    sha256Update(&context, data, data_length);
+    hmacFinish(&context, block_key, mac);
+
+    memset(block_key, 0, sizeof(block_key));
+}
+
+void hkdfSha256(const uint8_t *salt, size_t salt_length, const uint8_t *input_key, size_t input_key_length,
+                const uint8_t *info, size_t info_length, uint8_t *output, size_t output_length){
+
+    uint8_t pseudo_random_key[SHA256_DIGEST_SIZE];
+    uint8_t block_key[SHA256_BLOCK_SIZE];
+    uint8_t previous[SHA256_DIGEST_SIZE];
+    size_t previous_length = 0;
+    sha256_context context;
+
+    // Extract
+    hmacSha256(salt, salt_length, input_key, input_key_length, pseudo_random_key);
+
+    // Expand: T(n) = HMAC(PRK, T(n-1) | info | n), hashed piece by piece
+    // so info can be any length
+    hmacBlockKey(pseudo_random_key, sizeof(pseudo_random_key), block_key);
+    for(uint8_t counter = 1; output_length > 0; counter++){
+        hmacStart(&context, block_key);
+        sha256Update(&context, previous, previous_length);
+        sha256Update(&context, info, info_length);
+        sha256Update(&context, &counter, 1);
+        hmacFinish(&context, block_key, previous);
+        previous_length = SHA256_DIGEST_SIZE;
+
+        size_t take = output_length < SHA256_DIGEST_SIZE ? output_length : SHA256_DIGEST_SIZE;
+        memcpy(output, previous, take);
+        output += take;
+        output_length -= take;
+    }
+
+    memset(pseudo_random_key, 0, sizeof(pseudo_random_key));
+    memset(block_key, 0, sizeof(block_key));
+    memset(previous, 0, sizeof(previous));
+}
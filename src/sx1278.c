@@ -0,0 +1,992 @@
+/**
+ * Driver LoRa SX1278 por interrupciones
+ * -------------------------------------
+ *
+ * Ver sx1278.h. El archivo tiene tres capas:
+ *
+ *   1. Acceso al hardware (sx1278_hw_*): registros por SPI, reset y la
+ *      interrupción de DIO0. En el ESP32 están aquí; en el host las da el
+ *      chip simulado (sx1278_sim.c).
+ *   2. Primitivas del sistema (señales, cerrojo, tarea) para FreeRTOS o
+ *      pthreads, como en render.c.
+ *   3. El driver: colas TX/RX y la tarea de radio.
+ *
+ * Protocolo SPI del SX1278: primer byte = dirección del registro con el
+ * bit 7 a 1 para escribir y a 0 para leer; los bytes siguientes van a
+ * direcciones consecutivas, salvo en RegFifo (0x00), donde cada byte
+ * avanza RegFifoAddrPtr. Por eso un paquete entero entra o sale de la
+ * FIFO en una sola transacción.
+ *
+ * La FIFO (256 bytes) se usa entera para un solo sentido cada vez:
+ * TX y RX empiezan en la dirección 0. Antes de cargar un paquete para
+ * transmitir se recoge el RxDone que pudiera haber quedado pendiente.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+#include "event_loop.h"
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "sx1278_sim.h"
+#endif
+
+#include "sx1278.h"
+
+// -----------------------------------------------------------------------------
+//  REGISTROS (modo LoRa)
+// -----------------------------------------------------------------------------
+
+#define REG_FIFO                 0x00
+#define REG_OP_MODE              0x01
+#define REG_FRF_MSB              0x06   // + MID (0x07) y LSB (0x08)
+#define REG_PA_CONFIG            0x09
+#define REG_OCP                  0x0B
+#define REG_LNA                  0x0C
+#define REG_FIFO_ADDR_PTR        0x0D
+#define REG_FIFO_TX_BASE_ADDR    0x0E
+#define REG_FIFO_RX_BASE_ADDR    0x0F
+#define REG_FIFO_RX_CURRENT_ADDR 0x10
+#define REG_IRQ_FLAGS_MASK       0x11
+#define REG_IRQ_FLAGS            0x12
+#define REG_RX_NB_BYTES          0x13
+#define REG_MODEM_STAT           0x18
+#define REG_PKT_SNR_VALUE        0x19
+#define REG_PKT_RSSI_VALUE       0x1A
+#define REG_RSSI_VALUE           0x1B
+#define REG_MODEM_CONFIG_1       0x1D
+#define REG_MODEM_CONFIG_2       0x1E
+#define REG_PREAMBLE_MSB         0x20   // + LSB (0x21)
+#define REG_PAYLOAD_LENGTH       0x22
+#define REG_MODEM_CONFIG_3       0x26
+#define REG_SYNC_WORD            0x39
+#define REG_DIO_MAPPING_1        0x40
+#define REG_VERSION              0x42
+
+#define SX1278_VERSION           0x12
+
+// RegOpMode: bit 7 = LoRa, bit 3 = banda baja (< 525 MHz), bits 2-0 = modo
+#define MODE_LONG_RANGE          0x80
+#define MODE_LOW_FREQUENCY       0x08
+#define MODE_SLEEP               0x00
+#define MODE_STDBY               0x01
+#define MODE_TX                  0x03
+#define MODE_RX_CONTINUOUS       0x05
+
+// RegIrqFlags (se borran escribiendo un 1)
+#define IRQ_RX_DONE              0x40
+#define IRQ_PAYLOAD_CRC_ERROR    0x20
+#define IRQ_TX_DONE              0x08
+#define IRQ_RX_FLAGS             (IRQ_RX_DONE | IRQ_PAYLOAD_CRC_ERROR)
+
+// RegDioMapping1, bits 7-6: qué flag saca DIO0
+#define DIO0_RX_DONE             0x00
+#define DIO0_TX_DONE             0x40
+
+// RegModemStat: el módem ve un preámbulo LoRa
+#define MODEM_STAT_SIGNAL_DETECTED 0x01
+
+// RSSI del paquete (y del canal) en la banda baja: -164 + RegPktRssiValue
+#define RSSI_OFFSET_LF           164
+
+#define FXOSC_HZ                 32000000
+
+// -----------------------------------------------------------------------------
+//  ACCESO AL HARDWARE
+// -----------------------------------------------------------------------------
+
+/**
+ * Lo que el driver necesita del chip. En el host lo implementa
+ * sx1278_sim.c sobre el modelo de registros.
+ */
+typedef void (*sx1278_dio0_handler_t)(void *arg);
+
+bool sx1278_hw_init(sx1278_dio0_handler_t handler);
+void sx1278_hw_reset(void);
+void sx1278_hw_write(uint8_t reg, const uint8_t *data, size_t length);
+void sx1278_hw_read(uint8_t reg, uint8_t *data, size_t length);
+void sx1278_hw_dio0_enable(bool enable);
+
+#ifdef ESP_PLATFORM
+
+static const char *TAG = "SX1278_DRV";
+
+/**
+ * Conexiones del módulo SX1278 (Ra-02 o similar) con el ESP32:
+ *
+ *   ESP32         ->  SX1278
+ *   ---------------------------
+ *   MOSI (GPIO23) -> MOSI     (compartido con la pantalla)
+ *   MISO (GPIO19) -> MISO     (compartido con la pantalla)
+ *   SCK  (GPIO18) -> SCK      (compartido con la pantalla)
+ *   CS   (GPIO13) -> NSS
+ *   RST  (GPIO14) -> RESET
+ *   DIO0 (GPIO27) -> DIO0
+ */
+
+#define SX1278_PIN_CS      13
+#define SX1278_PIN_RST     14
+#define SX1278_PIN_DIO0    27
+
+#define SX1278_SPI_HOST    HSPI_HOST
+
+// El SX1278 admite hasta 10 MHz de SCK
+#define SX1278_SPI_CLOCK_HZ  (8 * 1000 * 1000)
+
+static spi_device_handle_t sx1278_spi;
+
+// Las ráfagas de FIFO pasan por aquí: memoria interna y alineada para el DMA
+static DMA_ATTR uint8_t sx1278_dma_buffer[SX1278_MAX_PAYLOAD + 1];
+
+bool sx1278_hw_init(sx1278_dio0_handler_t handler)
+{
+    // El bus lo crea ili9341_init; solo añadimos nuestro CS. Half-duplex:
+    // fase de dirección (8 bits) y luego escritura O lectura
+    spi_device_interface_config_t devcfg = {
+        .clock_speed_hz = SX1278_SPI_CLOCK_HZ,
+        .mode = 0,
+        .spics_io_num = SX1278_PIN_CS,
+        .queue_size = 1,
+        .address_bits = 8,
+        .flags = SPI_DEVICE_HALFDUPLEX,
+    };
+    esp_err_t ret = spi_bus_add_device(SX1278_SPI_HOST, &devcfg, &sx1278_spi);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error en spi_bus_add_device: %d", ret);
+        return false;
+    }
+
+    gpio_config_t rst_conf = {
+        .pin_bit_mask = 1ULL << SX1278_PIN_RST,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = 0,
+        .pull_down_en = 0,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    gpio_config(&rst_conf);
+    gpio_set_level(SX1278_PIN_RST, 1);
+
+    // DIO0 por nivel alto, como los botones: puede despertar al chip de
+    // light sleep y no se pierde aunque llegue con la interrupción apagada
+    gpio_config_t dio0_conf = {
+        .pin_bit_mask = 1ULL << SX1278_PIN_DIO0,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = 0,
+        .pull_down_en = 1,
+        .intr_type = GPIO_INTR_HIGH_LEVEL,
+    };
+    gpio_config(&dio0_conf);
+
+    // Puede que otro módulo ya haya instalado el servicio: no es un error
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Error en gpio_install_isr_service: %d", ret);
+        return false;
+    }
+    gpio_intr_disable(SX1278_PIN_DIO0);
+    gpio_isr_handler_add(SX1278_PIN_DIO0, handler, NULL);
+    gpio_wakeup_enable(SX1278_PIN_DIO0, GPIO_INTR_HIGH_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+
+    return true;
+}
+
+void sx1278_hw_reset(void)
+{
+    // RESET a nivel bajo al menos 100 us; el chip está listo 5 ms después
+    gpio_set_level(SX1278_PIN_RST, 0);
+    vTaskDelay(1);
+    gpio_set_level(SX1278_PIN_RST, 1);
+    vTaskDelay(pdMS_TO_TICKS(10));
+}
+
+void sx1278_hw_write(uint8_t reg, const uint8_t *data, size_t length)
+{
+    memcpy(sx1278_dma_buffer, data, length);
+
+    spi_transaction_t t = {
+        .addr = reg | 0x80,
+        .length = length * 8,
+        .tx_buffer = sx1278_dma_buffer,
+    };
+    // Sondeo del bus, no del chip: el acceso dura unos pocos us y así
+    // convive con las transacciones en cola de la pantalla
+    spi_device_polling_transmit(sx1278_spi, &t);
+}
+
+void sx1278_hw_read(uint8_t reg, uint8_t *data, size_t length)
+{
+    spi_transaction_t t = {
+        .addr = reg & 0x7F,
+        .rxlength = length * 8,
+        .rx_buffer = sx1278_dma_buffer,
+    };
+    spi_device_polling_transmit(sx1278_spi, &t);
+    memcpy(data, sx1278_dma_buffer, length);
+}
+
+// También se llama desde la ISR: en IRAM
+void IRAM_ATTR sx1278_hw_dio0_enable(bool enable)
+{
+    if (enable) {
+        gpio_intr_enable(SX1278_PIN_DIO0);
+    } else {
+        gpio_intr_disable(SX1278_PIN_DIO0);
+    }
+}
+
+#endif // ESP_PLATFORM
+
+// -----------------------------------------------------------------------------
+//  SEÑALES, CERROJO Y RELOJ (FreeRTOS o pthreads)
+// -----------------------------------------------------------------------------
+
+/**
+ * Señal binaria como la de render.c, pero con espera limitada: wait()
+ * devuelve false si pasan timeout_ms sin que nadie haga give().
+ */
+#ifdef ESP_PLATFORM
+
+typedef SemaphoreHandle_t radio_signal_t;
+typedef SemaphoreHandle_t radio_lock_t;
+
+static bool radio_signal_init(radio_signal_t *signal)
+{
+    *signal = xSemaphoreCreateBinary();
+    return *signal != NULL;
+}
+
+static void radio_signal_give(radio_signal_t *signal)
+{
+    xSemaphoreGive(*signal);
+}
+
+static bool radio_signal_wait(radio_signal_t *signal, uint32_t timeout_ms)
+{
+    TickType_t ticks = timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xSemaphoreTake(*signal, ticks) == pdTRUE;
+}
+
+static bool radio_lock_init(radio_lock_t *lock)
+{
+    *lock = xSemaphoreCreateMutex();
+    return *lock != NULL;
+}
+
+static void radio_lock(radio_lock_t *lock)
+{
+    xSemaphoreTake(*lock, portMAX_DELAY);
+}
+
+static void radio_unlock(radio_lock_t *lock)
+{
+    xSemaphoreGive(*lock);
+}
+
+static int64_t radio_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+#else
+
+#define IRAM_ATTR
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "I (%s) " fmt "\n", tag, ##__VA_ARGS__)
+
+static const char *TAG = "SX1278_DRV";
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool set;
+} radio_signal_t;
+
+typedef pthread_mutex_t radio_lock_t;
+
+static bool radio_signal_init(radio_signal_t *signal)
+{
+    signal->set = false;
+    return pthread_mutex_init(&signal->lock, NULL) == 0 &&
+           pthread_cond_init(&signal->cond, NULL) == 0;
+}
+
+static void radio_signal_give(radio_signal_t *signal)
+{
+    pthread_mutex_lock(&signal->lock);
+    signal->set = true;
+    pthread_cond_signal(&signal->cond);
+    pthread_mutex_unlock(&signal->lock);
+}
+
+static bool radio_signal_wait(radio_signal_t *signal, uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&signal->lock);
+    while (!signal->set) {
+        if (timeout_ms == UINT32_MAX) {
+            pthread_cond_wait(&signal->cond, &signal->lock);
+        } else if (pthread_cond_timedwait(&signal->cond, &signal->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    bool was_set = signal->set;
+    signal->set = false;
+    pthread_mutex_unlock(&signal->lock);
+    return was_set;
+}
+
+static bool radio_lock_init(radio_lock_t *lock)
+{
+    return pthread_mutex_init(lock, NULL) == 0;
+}
+
+static void radio_lock(radio_lock_t *lock)
+{
+    pthread_mutex_lock(lock);
+}
+
+static void radio_unlock(radio_lock_t *lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+static int64_t radio_time_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+#endif // ESP_PLATFORM
+
+// -----------------------------------------------------------------------------
+//  ESTADO DEL DRIVER
+// -----------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t data[SX1278_MAX_PAYLOAD];
+    uint8_t length;
+    sx1278_rate_t rate;
+} radio_frame_t;
+
+// Colas circulares protegidas por radio_queue_lock. La ISR no las toca:
+// solo avisa a la tarea
+static radio_frame_t tx_queue[SX1278_TX_QUEUE_LEN];
+static size_t tx_head, tx_count;
+static sx1278_packet_t rx_queue[SX1278_RX_QUEUE_LEN];
+static size_t rx_head, rx_count;
+static radio_lock_t radio_queue_lock;
+
+static radio_signal_t radio_work_signal;   // ISR / sx1278_send -> tarea
+static radio_signal_t radio_rx_signal;     // tarea -> sx1278_receive
+
+static atomic_bool radio_running;
+static atomic_bool dio0_pending;           // la ISR vio DIO0 en alto
+
+// Solo los toca la tarea de radio
+static bool radio_transmitting;
+static bool radio_receiving;
+static sx1278_rate_t modem_rate;           // la que está en RegModemConfig
+
+// A la que se escucha entre transmisiones (sx1278_set_rx_rate), bajo
+// radio_queue_lock
+static sx1278_rate_t rx_rate;
+
+static sx1278_config_t radio_config;
+static sx1278_stats_t radio_stats;
+
+#ifdef ESP_PLATFORM
+static TaskHandle_t radio_task_handle;
+#else
+static pthread_t radio_thread;
+#endif
+
+// Anchos de banda posibles (RegModemConfig1, bits 7-4 = índice)
+static const uint32_t bandwidths_hz[] = {
+    7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000,
+};
+#define BANDWIDTH_COUNT (sizeof(bandwidths_hz) / sizeof(bandwidths_hz[0]))
+
+// -----------------------------------------------------------------------------
+//  REGISTROS
+// -----------------------------------------------------------------------------
+
+static void write_register(uint8_t reg, uint8_t value)
+{
+    sx1278_hw_write(reg, &value, 1);
+    radio_stats.spi_transactions++;
+}
+
+static uint8_t read_register(uint8_t reg)
+{
+    uint8_t value = 0;
+    sx1278_hw_read(reg, &value, 1);
+    radio_stats.spi_transactions++;
+    return value;
+}
+
+static void set_mode(uint8_t mode)
+{
+    write_register(REG_OP_MODE, MODE_LONG_RANGE | MODE_LOW_FREQUENCY | mode);
+}
+
+/**
+ * Índice del ancho de banda: el menor válido que no baja de 'hz'.
+ */
+static uint8_t bandwidth_index(uint32_t hz)
+{
+    for (uint8_t i = 0; i < BANDWIDTH_COUNT; i++) {
+        if (bandwidths_hz[i] >= hz) return i;
+    }
+    return BANDWIDTH_COUNT - 1;
+}
+
+/**
+ * Duración de un símbolo LoRa: 2^SF / BW.
+ */
+static uint32_t symbol_time_us(uint8_t spreading_factor)
+{
+    return (uint32_t)(((uint64_t)1000000 << spreading_factor) / radio_config.bandwidth_hz);
+}
+
+/**
+ * Recorta una velocidad a lo que el chip admite; NULL = la de la
+ * configuración.
+ */
+static sx1278_rate_t valid_rate(const sx1278_rate_t *rate)
+{
+    sx1278_rate_t valid = { radio_config.spreading_factor, radio_config.coding_rate };
+    if (rate == NULL) return valid;
+
+    valid = *rate;
+    if (valid.spreading_factor < 7) valid.spreading_factor = 7;
+    if (valid.spreading_factor > 12) valid.spreading_factor = 12;
+    if (valid.coding_rate < 5) valid.coding_rate = 5;
+    if (valid.coding_rate > 8) valid.coding_rate = 8;
+    return valid;
+}
+
+/**
+ * Escribe SF y CR en RegModemConfig1-3. El chip debe estar en standby.
+ */
+static void apply_rate(sx1278_rate_t rate)
+{
+    // Cabecera explícita (la longitud viaja en el aire) y CRC del paquete
+    write_register(REG_MODEM_CONFIG_1, (uint8_t)((bandwidth_index(radio_config.bandwidth_hz) << 4) |
+                                                 ((rate.coding_rate - 4) << 1)));
+    write_register(REG_MODEM_CONFIG_2, (uint8_t)((rate.spreading_factor << 4) | 0x04));
+
+    // AGC automático; LowDataRateOptimize obligatorio con símbolos > 16 ms
+    write_register(REG_MODEM_CONFIG_3, symbol_time_us(rate.spreading_factor) > 16000 ? 0x0C : 0x04);
+
+    modem_rate = rate;
+}
+
+static bool same_rate(sx1278_rate_t a, sx1278_rate_t b)
+{
+    return a.spreading_factor == b.spreading_factor && a.coding_rate == b.coding_rate;
+}
+
+/**
+ * Vuelca radio_config en los registros. El chip debe estar en standby.
+ */
+static void apply_config(void)
+{
+    // Frf = f * 2^19 / FXOSC, 24 bits en una ráfaga (MSB, MID, LSB)
+    uint32_t frf = (uint32_t)(((uint64_t)radio_config.frequency_hz << 19) / FXOSC_HZ);
+    uint8_t frf_bytes[3] = { (uint8_t)(frf >> 16), (uint8_t)(frf >> 8), (uint8_t)frf };
+    sx1278_hw_write(REG_FRF_MSB, frf_bytes, sizeof(frf_bytes));
+    radio_stats.spi_transactions++;
+
+    // PA_BOOST: Pout = 2 + OutputPower dBm. Límite de corriente a 100 mA
+    write_register(REG_PA_CONFIG, 0x80 | 0x70 | (uint8_t)(radio_config.tx_power_dbm - 2));
+    write_register(REG_OCP, 0x20 | 0x0B);
+
+    // LNA con ganancia máxima y el refuerzo de corriente para 433 MHz
+    write_register(REG_LNA, 0x23);
+
+    apply_rate(valid_rate(NULL));
+
+    uint8_t preamble[2] = { (uint8_t)(radio_config.preamble_length >> 8),
+                            (uint8_t)radio_config.preamble_length };
+    sx1278_hw_write(REG_PREAMBLE_MSB, preamble, sizeof(preamble));
+    radio_stats.spi_transactions++;
+
+    write_register(REG_SYNC_WORD, radio_config.sync_word);
+
+    write_register(REG_FIFO_TX_BASE_ADDR, 0);
+    write_register(REG_FIFO_RX_BASE_ADDR, 0);
+    write_register(REG_IRQ_FLAGS_MASK, 0x00);
+    write_register(REG_IRQ_FLAGS, 0xFF);
+}
+
+// -----------------------------------------------------------------------------
+//  INTERRUPCIÓN Y TAREA DE RADIO
+// -----------------------------------------------------------------------------
+
+/**
+ * ISR de DIO0. No toca el SPI: apaga la interrupción (es por nivel y
+ * seguiría saltando hasta que se borren los flags) y despierta a la tarea.
+ */
+static void IRAM_ATTR sx1278_dio0_isr(void *arg)
+{
+    (void)arg;
+    sx1278_hw_dio0_enable(false);
+    atomic_store(&dio0_pending, true);
+    radio_stats.interrupts++;
+
+#ifdef ESP_PLATFORM
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(radio_work_signal, &woken);
+    if (woken) portYIELD_FROM_ISR();
+#else
+    radio_signal_give(&radio_work_signal);
+#endif
+}
+
+/**
+ * Saca el paquete que RxDone dejó en la FIFO y lo pone en la cola RX.
+ */
+static void read_packet(uint32_t *events)
+{
+    sx1278_packet_t packet;
+
+    packet.time_us = radio_time_us();
+    packet.length = read_register(REG_RX_NB_BYTES);
+    write_register(REG_FIFO_ADDR_PTR, read_register(REG_FIFO_RX_CURRENT_ADDR));
+    sx1278_hw_read(REG_FIFO, packet.data, packet.length);
+    radio_stats.spi_transactions++;
+
+    // SNR en cuartos de dB con signo. Bajo el ruido, el RSSI del registro
+    // no incluye la pérdida: se corrige con la SNR
+    int8_t snr_quarters = (int8_t)read_register(REG_PKT_SNR_VALUE);
+    packet.snr_db = snr_quarters / 4.0f;
+    packet.rssi_dbm = (int16_t)(read_register(REG_PKT_RSSI_VALUE) - RSSI_OFFSET_LF);
+    if (snr_quarters < 0) {
+        packet.rssi_dbm += snr_quarters / 4;
+    }
+
+    radio_lock(&radio_queue_lock);
+    if (rx_count < SX1278_RX_QUEUE_LEN) {
+        rx_queue[(rx_head + rx_count) % SX1278_RX_QUEUE_LEN] = packet;
+        rx_count++;
+        radio_stats.rx_packets++;
+        *events |= SX1278_EVENT_RX;
+    } else {
+        radio_stats.rx_dropped++;
+    }
+    radio_unlock(&radio_queue_lock);
+
+    if (*events & SX1278_EVENT_RX) {
+        radio_signal_give(&radio_rx_signal);
+    }
+}
+
+/**
+ * Atiende los flags de RegIrqFlags (ya leídos) y los borra.
+ */
+static void handle_irq_flags(uint8_t flags, uint32_t *events)
+{
+    if (flags == 0) return;
+    write_register(REG_IRQ_FLAGS, flags);
+
+    if (flags & IRQ_TX_DONE) {
+        // El chip ya volvió solo a standby
+        radio_lock(&radio_queue_lock);
+        radio_transmitting = false;
+        radio_stats.tx_done++;
+        radio_unlock(&radio_queue_lock);
+        *events |= SX1278_EVENT_TX_DONE;
+    }
+    if (flags & IRQ_RX_DONE) {
+        if (flags & IRQ_PAYLOAD_CRC_ERROR) {
+            radio_stats.rx_crc_errors++;
+            *events |= SX1278_EVENT_RX_ERROR;
+        } else {
+            read_packet(events);
+        }
+    }
+}
+
+/**
+ * Listen-before-talk: ¿hay alguien en el canal? Solo tiene sentido con la
+ * radio ya escuchando. RegModemStat y RegRssiValue (0x18 y 0x1B) salen en
+ * una sola ráfaga.
+ */
+static bool channel_busy(void)
+{
+    if (radio_config.lbt_threshold_dbm == 0 || !radio_receiving) return false;
+
+    uint8_t status[REG_RSSI_VALUE - REG_MODEM_STAT + 1];
+    sx1278_hw_read(REG_MODEM_STAT, status, sizeof(status));
+    radio_stats.spi_transactions++;
+
+    int16_t rssi_dbm = (int16_t)(status[REG_RSSI_VALUE - REG_MODEM_STAT] - RSSI_OFFSET_LF);
+    return (status[0] & MODEM_STAT_SIGNAL_DETECTED) || rssi_dbm > radio_config.lbt_threshold_dbm;
+}
+
+/**
+ * Carga el siguiente frame de la cola TX y empieza a transmitir. Si no
+ * hay ninguno, deja la radio escuchando. Con el canal ocupado el frame se
+ * devuelve (SX1278_EVENT_TX_BUSY) y la radio sigue escuchando.
+ */
+static void start_next(uint32_t *events)
+{
+    radio_frame_t frame;
+    bool have_frame = false;
+    bool busy = false;
+
+    radio_lock(&radio_queue_lock);
+    bool waiting = tx_count > 0;
+    radio_unlock(&radio_queue_lock);
+    if (waiting) {
+        busy = channel_busy();
+    }
+
+    radio_lock(&radio_queue_lock);
+    if (tx_count > 0) {
+        frame = tx_queue[tx_head];
+        tx_head = (tx_head + 1) % SX1278_TX_QUEUE_LEN;
+        tx_count--;
+        if (busy) {
+            radio_stats.tx_busy++;
+        } else {
+            have_frame = true;
+            // Cuenta como pendiente hasta TxDone (sx1278_tx_pending)
+            radio_transmitting = true;
+        }
+    }
+    bool more = tx_count > 0;
+    radio_unlock(&radio_queue_lock);
+
+    if (busy) {
+        *events |= SX1278_EVENT_TX_BUSY;
+        // El siguiente de la cola mira el canal por su cuenta
+        if (more) radio_signal_give(&radio_work_signal);
+        return;
+    }
+
+    if (!have_frame) {
+        radio_lock(&radio_queue_lock);
+        sx1278_rate_t listen = rx_rate;
+        radio_unlock(&radio_queue_lock);
+
+        if (radio_receiving && !same_rate(modem_rate, listen)) {
+            // Otra velocidad de escucha: antes, lo que hubiera llegado
+            set_mode(MODE_STDBY);
+            radio_receiving = false;
+            handle_irq_flags(read_register(REG_IRQ_FLAGS) & IRQ_RX_FLAGS, events);
+        }
+        if (!radio_receiving) {
+            if (!same_rate(modem_rate, listen)) apply_rate(listen);
+            write_register(REG_DIO_MAPPING_1, DIO0_RX_DONE);
+            write_register(REG_FIFO_ADDR_PTR, 0);
+            set_mode(MODE_RX_CONTINUOUS);
+            radio_receiving = true;
+        }
+        return;
+    }
+
+    // Salir de recepción y recoger un RxDone que llegara justo antes: su
+    // paquete está en la misma zona de la FIFO que vamos a sobrescribir
+    set_mode(MODE_STDBY);
+    if (radio_receiving) {
+        radio_receiving = false;
+        handle_irq_flags(read_register(REG_IRQ_FLAGS) & IRQ_RX_FLAGS, events);
+    }
+
+    if (!same_rate(modem_rate, frame.rate)) apply_rate(frame.rate);
+    write_register(REG_DIO_MAPPING_1, DIO0_TX_DONE);
+    write_register(REG_FIFO_ADDR_PTR, 0);
+    sx1278_hw_write(REG_FIFO, frame.data, frame.length);
+    radio_stats.spi_transactions++;
+    write_register(REG_PAYLOAD_LENGTH, frame.length);
+    set_mode(MODE_TX);
+}
+
+static void radio_loop(void)
+{
+    while (atomic_load(&radio_running)) {
+        radio_signal_wait(&radio_work_signal, UINT32_MAX);
+        if (!atomic_load(&radio_running)) break;
+
+        uint32_t events = 0;
+
+        if (atomic_exchange(&dio0_pending, false)) {
+            handle_irq_flags(read_register(REG_IRQ_FLAGS), &events);
+            // Flags borrados: DIO0 ya está en bajo y se puede rearmar
+            sx1278_hw_dio0_enable(true);
+        }
+        if (!radio_transmitting) {
+            start_next(&events);
+        }
+
+#ifdef ESP_PLATFORM
+        if (events != 0) {
+            app_event_t event = {
+                .type = APP_EVENT_RADIO,
+                .time_us = esp_timer_get_time(),
+                .radio_flags = events,
+            };
+            event_loop_post(&event);
+        }
+#endif
+    }
+
+    sx1278_hw_dio0_enable(false);
+    set_mode(MODE_SLEEP);
+}
+
+#ifdef ESP_PLATFORM
+static void radio_task(void *arg)
+{
+    (void)arg;
+    radio_loop();
+    radio_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+#else
+static void *radio_thread_main(void *arg)
+{
+    (void)arg;
+    radio_loop();
+    return NULL;
+}
+#endif
+
+// -----------------------------------------------------------------------------
+//  API PÚBLICA
+// -----------------------------------------------------------------------------
+
+bool sx1278_init(const sx1278_config_t *config)
+{
+    if (atomic_load(&radio_running)) return true;
+
+    static const sx1278_config_t default_config = SX1278_CONFIG_DEFAULT;
+    radio_config = config ? *config : default_config;
+
+    // Valores fuera de rango se recortan al más cercano que el chip admite
+    if (radio_config.spreading_factor < 7) radio_config.spreading_factor = 7;
+    if (radio_config.spreading_factor > 12) radio_config.spreading_factor = 12;
+    if (radio_config.coding_rate < 5) radio_config.coding_rate = 5;
+    if (radio_config.coding_rate > 8) radio_config.coding_rate = 8;
+    if (radio_config.tx_power_dbm < 2) radio_config.tx_power_dbm = 2;
+    if (radio_config.tx_power_dbm > 17) radio_config.tx_power_dbm = 17;
+    radio_config.bandwidth_hz = bandwidths_hz[bandwidth_index(radio_config.bandwidth_hz)];
+
+    static bool primitives_ready = false;
+    static bool hw_ready = false;
+    if (!primitives_ready) {
+        if (!radio_signal_init(&radio_work_signal) ||
+            !radio_signal_init(&radio_rx_signal) ||
+            !radio_lock_init(&radio_queue_lock)) {
+            return false;
+        }
+        primitives_ready = true;
+    }
+    if (!hw_ready) {
+        if (!sx1278_hw_init(sx1278_dio0_isr)) return false;
+        hw_ready = true;
+    }
+
+    sx1278_hw_reset();
+    uint8_t version = read_register(REG_VERSION);
+    if (version != SX1278_VERSION) {
+        ESP_LOGE(TAG, "RegVersion = 0x%02X (se esperaba 0x%02X): ¿está conectada la radio?",
+                 version, SX1278_VERSION);
+        return false;
+    }
+
+    // El modo LoRa solo se puede elegir en sleep
+    write_register(REG_OP_MODE, MODE_LOW_FREQUENCY | MODE_SLEEP);
+    set_mode(MODE_SLEEP);
+    set_mode(MODE_STDBY);
+    apply_config();
+
+    tx_head = tx_count = 0;
+    rx_head = rx_count = 0;
+    rx_rate = valid_rate(NULL);
+    radio_transmitting = false;
+    radio_receiving = false;
+    atomic_store(&dio0_pending, false);
+    atomic_store(&radio_running, true);
+
+#ifdef ESP_PLATFORM
+    BaseType_t ok = xTaskCreatePinnedToCore(radio_task, "radio", SX1278_STACK_SIZE, NULL,
+                                            SX1278_TASK_PRIORITY, &radio_task_handle,
+                                            SX1278_CORE);
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear la tarea de radio");
+        atomic_store(&radio_running, false);
+        return false;
+    }
+#else
+    if (pthread_create(&radio_thread, NULL, radio_thread_main, NULL) != 0) {
+        ESP_LOGE(TAG, "No se pudo crear el hilo de radio");
+        atomic_store(&radio_running, false);
+        return false;
+    }
+#endif
+
+    // La tarea pone la radio a escuchar y arma DIO0
+    sx1278_hw_dio0_enable(true);
+    radio_signal_give(&radio_work_signal);
+
+    ESP_LOGI(TAG, "SX1278 listo: %lu Hz, SF%u, %lu Hz, CR 4/%u, %d dBm",
+             (unsigned long)radio_config.frequency_hz, radio_config.spreading_factor,
+             (unsigned long)radio_config.bandwidth_hz, radio_config.coding_rate,
+             radio_config.tx_power_dbm);
+    return true;
+}
+
+void sx1278_stop(void)
+{
+    if (!atomic_exchange(&radio_running, false)) return;
+    radio_signal_give(&radio_work_signal);
+
+#ifdef ESP_PLATFORM
+    while (radio_task_handle != NULL) {
+        vTaskDelay(1);
+    }
+#else
+    pthread_join(radio_thread, NULL);
+#endif
+}
+
+bool sx1278_send(const uint8_t *frame, size_t length)
+{
+    return sx1278_send_rate(frame, length, NULL);
+}
+
+bool sx1278_send_rate(const uint8_t *frame, size_t length, const sx1278_rate_t *rate)
+{
+    bool queued = false;
+
+    radio_lock(&radio_queue_lock);
+    if (atomic_load(&radio_running) && length > 0 && length <= SX1278_MAX_PAYLOAD &&
+        tx_count < SX1278_TX_QUEUE_LEN) {
+        radio_frame_t *slot = &tx_queue[(tx_head + tx_count) % SX1278_TX_QUEUE_LEN];
+        memcpy(slot->data, frame, length);
+        slot->length = (uint8_t)length;
+        slot->rate = valid_rate(rate);
+        tx_count++;
+        queued = true;
+        radio_stats.tx_queued++;
+    } else {
+        radio_stats.tx_rejected++;
+    }
+    radio_unlock(&radio_queue_lock);
+
+    if (queued) {
+        radio_signal_give(&radio_work_signal);
+    }
+    return queued;
+}
+
+sx1278_rate_t sx1278_config_rate(void)
+{
+    return valid_rate(NULL);
+}
+
+void sx1278_set_rx_rate(const sx1278_rate_t *rate)
+{
+    sx1278_rate_t listen = valid_rate(rate);
+
+    radio_lock(&radio_queue_lock);
+    bool changed = !same_rate(rx_rate, listen);
+    rx_rate = listen;
+    radio_unlock(&radio_queue_lock);
+
+    // La tarea la aplica en cuanto la radio quede libre
+    if (changed && atomic_load(&radio_running)) {
+        radio_signal_give(&radio_work_signal);
+    }
+}
+
+bool sx1278_receive(sx1278_packet_t *packet, uint32_t timeout_ms)
+{
+    int64_t deadline_us = radio_time_us() + (int64_t)timeout_ms * 1000;
+
+    for (;;) {
+        radio_lock(&radio_queue_lock);
+        if (rx_count > 0) {
+            *packet = rx_queue[rx_head];
+            rx_head = (rx_head + 1) % SX1278_RX_QUEUE_LEN;
+            rx_count--;
+            radio_unlock(&radio_queue_lock);
+            return true;
+        }
+        radio_unlock(&radio_queue_lock);
+
+        int64_t left_us = deadline_us - radio_time_us();
+        if (left_us <= 0) return false;
+        // La señal puede venir de un paquete que ya se llevó otro lector
+        radio_signal_wait(&radio_rx_signal, (uint32_t)((left_us + 999) / 1000));
+    }
+}
+
+size_t sx1278_tx_pending(void)
+{
+    radio_lock(&radio_queue_lock);
+    size_t pending = tx_count + (radio_transmitting ? 1 : 0);
+    radio_unlock(&radio_queue_lock);
+    return pending;
+}
+
+uint32_t sx1278_airtime_us(size_t length)
+{
+    return sx1278_airtime_rate_us(length, NULL);
+}
+
+uint32_t sx1278_airtime_rate_us(size_t length, const sx1278_rate_t *rate)
+{
+    sx1278_rate_t valid = valid_rate(rate);
+    uint32_t symbol_us = symbol_time_us(valid.spreading_factor);
+    int sf = valid.spreading_factor;
+    int low_data_rate = symbol_us > 16000 ? 1 : 0;
+
+    // Preámbulo: n + 4,25 símbolos
+    uint64_t preamble_us = ((uint64_t)(4 * radio_config.preamble_length + 17) * symbol_us) / 4;
+
+    // Carga: 8 + max(ceil((8L - 4SF + 28 + 16 CRC - 20 IH) / (4 (SF - 2 DE))), 0) * CR
+    int numerator = 8 * (int)length - 4 * sf + 28 + 16;
+    int denominator = 4 * (sf - 2 * low_data_rate);
+    int blocks = numerator > 0 ? (numerator + denominator - 1) / denominator : 0;
+    uint32_t payload_symbols = 8 + (uint32_t)blocks * valid.coding_rate;
+
+    return (uint32_t)(preamble_us + (uint64_t)payload_symbols * symbol_us);
+}
+
+void sx1278_get_stats(sx1278_stats_t *stats)
+{
+    radio_lock(&radio_queue_lock);
+    *stats = radio_stats;
+    radio_unlock(&radio_queue_lock);
+}
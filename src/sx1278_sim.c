@@ -0,0 +1,476 @@
+/**
+ * SX1278 simulado para el backend de host
+ * ---------------------------------------
+ *
+ * Implementa el acceso al hardware que usa src/sx1278.c (sx1278_hw_*)
+ * sobre un modelo del chip en modo LoRa:
+ *
+ *   - Cada llamada a sx1278_hw_read/write es una transacción SPI: los
+ *     bytes van a registros consecutivos, salvo en RegFifo, donde avanzan
+ *     RegFifoAddrPtr (como el chip real).
+ *   - RegOpMode: el bit LoRa solo cambia en sleep. Al entrar en TX se toma
+ *     RegPayloadLength bytes desde RegFifoTxBaseAddr; un hilo del
+ *     simulador espera su tiempo en el aire (calculado con los registros
+ *     de módem, no con la configuración del driver), lo entrega al
+ *     callback, marca TxDone y vuelve a standby.
+ *   - RegIrqFlags se borra escribiendo unos.
+ *   - DIO0 está en alto mientras el flag que elige RegDioMapping1 esté
+ *     activo. Si además la "interrupción" está armada, se llama al
+ *     manejador del driver (sin tener el cerrojo del modelo, porque el
+ *     manejador vuelve a entrar para desarmarla).
+ *
+ * Este archivo solo se compila en el host (sin ESP_PLATFORM).
+ */
+
+#ifndef ESP_PLATFORM
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "sx1278.h"
+#include "sx1278_sim.h"
+
+#define SIM_REG_FIFO                 0x00
+#define SIM_REG_OP_MODE              0x01
+#define SIM_REG_FIFO_ADDR_PTR        0x0D
+#define SIM_REG_FIFO_TX_BASE_ADDR    0x0E
+#define SIM_REG_FIFO_RX_BASE_ADDR    0x0F
+#define SIM_REG_FIFO_RX_CURRENT_ADDR 0x10
+#define SIM_REG_IRQ_FLAGS_MASK       0x11
+#define SIM_REG_IRQ_FLAGS            0x12
+#define SIM_REG_RX_NB_BYTES          0x13
+#define SIM_REG_MODEM_STAT           0x18
+#define SIM_REG_PKT_SNR_VALUE        0x19
+#define SIM_REG_PKT_RSSI_VALUE       0x1A
+#define SIM_REG_RSSI_VALUE           0x1B
+#define SIM_REG_MODEM_CONFIG_1       0x1D
+#define SIM_REG_MODEM_CONFIG_2       0x1E
+#define SIM_REG_PREAMBLE_MSB         0x20
+#define SIM_REG_PREAMBLE_LSB         0x21
+#define SIM_REG_PAYLOAD_LENGTH       0x22
+#define SIM_REG_MODEM_CONFIG_3       0x26
+#define SIM_REG_SYNC_WORD            0x39
+#define SIM_REG_DIO_MAPPING_1        0x40
+#define SIM_REG_VERSION              0x42
+
+#define SIM_MODE_LONG_RANGE          0x80
+#define SIM_MODE_MASK                0x07
+#define SIM_MODE_SLEEP               0x00
+#define SIM_MODE_STDBY               0x01
+#define SIM_MODE_TX                  0x03
+#define SIM_MODE_RX_CONTINUOUS       0x05
+
+#define SIM_IRQ_RX_DONE              0x40
+#define SIM_IRQ_PAYLOAD_CRC_ERROR    0x20
+#define SIM_IRQ_VALID_HEADER         0x10
+#define SIM_IRQ_TX_DONE              0x08
+#define SIM_IRQ_CAD_DONE             0x04
+
+#define SIM_MODEM_STAT_SIGNAL        0x01
+#define SIM_MODEM_STAT_CLEAR         0x10
+
+#define SIM_RSSI_OFFSET_LF           164
+#define SIM_NOISE_FLOOR_DBM          (-120)
+
+// Las mismas firmas que declara sx1278.c
+typedef void (*sx1278_dio0_handler_t)(void *arg);
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_cond;
+
+static uint8_t sim_registers[128];
+static uint8_t sim_fifo[256];
+static uint8_t sim_rx_addr;               // dónde escribe el próximo paquete recibido
+
+// Transmisión en curso
+static bool sim_tx_active;
+static int64_t sim_tx_done_us;
+static uint8_t sim_tx_frame[SX1278_MAX_PAYLOAD];
+static size_t sim_tx_length;
+
+static bool sim_realtime = false;
+static bool sim_dio0_enabled = false;
+static sx1278_dio0_handler_t sim_dio0_handler;
+static sx1278_sim_tx_hook_t sim_tx_hook;
+static void *sim_tx_context;
+
+static sx1278_sim_stats_t sim_stats;
+
+static bool sim_thread_started = false;
+static pthread_t sim_thread;
+
+static const uint32_t sim_bandwidths_hz[] = {
+    7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000,
+};
+
+static int64_t sim_now_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * Valores de los registros tras un reset (tabla de registros del
+ * datasheet; solo los que usa el modelo).
+ */
+static void sim_reset_registers(void)
+{
+    memset(sim_registers, 0, sizeof(sim_registers));
+    memset(sim_fifo, 0, sizeof(sim_fifo));
+
+    sim_registers[SIM_REG_OP_MODE] = 0x09;              // FSK, banda baja, standby
+    sim_registers[SIM_REG_FIFO_TX_BASE_ADDR] = 0x80;
+    sim_registers[SIM_REG_MODEM_CONFIG_1] = 0x72;       // 125 kHz, 4/5, cabecera explícita
+    sim_registers[SIM_REG_MODEM_CONFIG_2] = 0x70;       // SF7
+    sim_registers[SIM_REG_PREAMBLE_LSB] = 0x08;
+    sim_registers[SIM_REG_PAYLOAD_LENGTH] = 0x01;
+    sim_registers[SIM_REG_SYNC_WORD] = 0x12;
+    sim_registers[SIM_REG_VERSION] = 0x12;
+    sim_registers[SIM_REG_MODEM_STAT] = SIM_MODEM_STAT_CLEAR;
+    sim_registers[SIM_REG_RSSI_VALUE] = SIM_NOISE_FLOOR_DBM + SIM_RSSI_OFFSET_LF;
+
+    sim_rx_addr = 0;
+    sim_tx_active = false;
+}
+
+/**
+ * Tiempo en el aire según los registros de módem (AN1200.13).
+ */
+static uint32_t sim_airtime_us(size_t length)
+{
+    uint8_t config1 = sim_registers[SIM_REG_MODEM_CONFIG_1];
+    uint8_t config2 = sim_registers[SIM_REG_MODEM_CONFIG_2];
+    int bw_index = config1 >> 4;
+    if (bw_index > 9) bw_index = 9;
+
+    int sf = config2 >> 4;
+    int coding_rate = ((config1 >> 1) & 0x07) + 4;
+    int implicit_header = config1 & 0x01;
+    int crc = (config2 >> 2) & 0x01;
+    int low_data_rate = (sim_registers[SIM_REG_MODEM_CONFIG_3] >> 3) & 0x01;
+    int preamble = (sim_registers[SIM_REG_PREAMBLE_MSB] << 8) | sim_registers[SIM_REG_PREAMBLE_LSB];
+
+    double symbol_us = (double)(1 << sf) * 1e6 / sim_bandwidths_hz[bw_index];
+    double blocks = ceil((8.0 * length - 4 * sf + 28 + 16 * crc - 20 * implicit_header) /
+                         (4.0 * (sf - 2 * low_data_rate)));
+    if (blocks < 0) blocks = 0;
+
+    return (uint32_t)((preamble + 4.25 + 8 + blocks * coding_rate) * symbol_us);
+}
+
+static bool sim_lora_mode(uint8_t mode)
+{
+    return (sim_registers[SIM_REG_OP_MODE] & SIM_MODE_LONG_RANGE) &&
+           (sim_registers[SIM_REG_OP_MODE] & SIM_MODE_MASK) == mode;
+}
+
+static void sim_write_op_mode(uint8_t value)
+{
+    uint8_t previous = sim_registers[SIM_REG_OP_MODE];
+
+    // LongRangeMode solo se puede cambiar en sleep
+    if ((previous & SIM_MODE_MASK) != SIM_MODE_SLEEP) {
+        value = (uint8_t)((value & ~SIM_MODE_LONG_RANGE) | (previous & SIM_MODE_LONG_RANGE));
+    }
+    sim_registers[SIM_REG_OP_MODE] = value;
+
+    // Salir de TX antes de tiempo corta la transmisión
+    if (!sim_lora_mode(SIM_MODE_TX)) {
+        sim_tx_active = false;
+    }
+
+    if (sim_lora_mode(SIM_MODE_TX) && !sim_tx_active) {
+        sim_tx_length = sim_registers[SIM_REG_PAYLOAD_LENGTH];
+        uint8_t address = sim_registers[SIM_REG_FIFO_TX_BASE_ADDR];
+        for (size_t i = 0; i < sim_tx_length; i++) {
+            sim_tx_frame[i] = sim_fifo[(uint8_t)(address + i)];
+        }
+
+        uint32_t airtime = sim_airtime_us(sim_tx_length);
+        sim_stats.airtime_us += airtime;
+        sim_tx_done_us = sim_now_us() + (sim_realtime ? airtime : 0);
+        sim_tx_active = true;
+        pthread_cond_signal(&sim_cond);
+    } else if (sim_lora_mode(SIM_MODE_RX_CONTINUOUS)) {
+        sim_rx_addr = sim_registers[SIM_REG_FIFO_RX_BASE_ADDR];
+    }
+}
+
+static void sim_write_byte(uint8_t reg, uint8_t value)
+{
+    switch (reg) {
+    case SIM_REG_FIFO:
+        sim_fifo[sim_registers[SIM_REG_FIFO_ADDR_PTR]++] = value;
+        sim_stats.fifo_bytes++;
+        return;
+    case SIM_REG_OP_MODE:
+        sim_write_op_mode(value);
+        break;
+    case SIM_REG_IRQ_FLAGS:
+        sim_registers[SIM_REG_IRQ_FLAGS] &= (uint8_t)~value;
+        break;
+    case SIM_REG_FIFO_RX_CURRENT_ADDR:
+    case SIM_REG_RX_NB_BYTES:
+    case SIM_REG_MODEM_STAT:
+    case SIM_REG_PKT_SNR_VALUE:
+    case SIM_REG_PKT_RSSI_VALUE:
+    case SIM_REG_RSSI_VALUE:
+    case SIM_REG_VERSION:
+        break;  // solo lectura
+    default:
+        sim_registers[reg] = value;
+        break;
+    }
+    sim_stats.register_writes++;
+}
+
+static uint8_t sim_read_byte(uint8_t reg)
+{
+    if (reg == SIM_REG_FIFO) {
+        sim_stats.fifo_bytes++;
+        return sim_fifo[sim_registers[SIM_REG_FIFO_ADDR_PTR]++];
+    }
+    sim_stats.register_reads++;
+    return sim_registers[reg];
+}
+
+/**
+ * Si DIO0 está en alto y la interrupción armada, llama al manejador.
+ * Se llama sin el cerrojo tomado.
+ */
+static void sim_update_dio0(void)
+{
+    pthread_mutex_lock(&sim_lock);
+
+    uint8_t mapping = sim_registers[SIM_REG_DIO_MAPPING_1] >> 6;
+    uint8_t flag = mapping == 0 ? SIM_IRQ_RX_DONE :
+                   mapping == 1 ? SIM_IRQ_TX_DONE :
+                   mapping == 2 ? SIM_IRQ_CAD_DONE : 0;
+    uint8_t active = sim_registers[SIM_REG_IRQ_FLAGS] & (uint8_t)~sim_registers[SIM_REG_IRQ_FLAGS_MASK];
+    bool fire = sim_dio0_enabled && sim_dio0_handler != NULL && (active & flag) != 0;
+    sx1278_dio0_handler_t handler = sim_dio0_handler;
+
+    pthread_mutex_unlock(&sim_lock);
+
+    if (fire) {
+        handler(NULL);
+    }
+}
+
+/**
+ * Hilo del simulador: termina las transmisiones cuando pasa su tiempo en
+ * el aire.
+ */
+static void *sim_thread_main(void *arg)
+{
+    (void)arg;
+    uint8_t frame[SX1278_MAX_PAYLOAD];
+
+    pthread_mutex_lock(&sim_lock);
+    for (;;) {
+        if (!sim_tx_active) {
+            pthread_cond_wait(&sim_cond, &sim_lock);
+            continue;
+        }
+
+        int64_t now = sim_now_us();
+        if (now < sim_tx_done_us) {
+            struct timespec deadline = {
+                .tv_sec = sim_tx_done_us / 1000000,
+                .tv_nsec = (sim_tx_done_us % 1000000) * 1000,
+            };
+            pthread_cond_timedwait(&sim_cond, &sim_lock, &deadline);
+            continue;
+        }
+
+        size_t length = sim_tx_length;
+        memcpy(frame, sim_tx_frame, length);
+        sim_tx_active = false;
+        sim_registers[SIM_REG_OP_MODE] = (uint8_t)((sim_registers[SIM_REG_OP_MODE] & ~SIM_MODE_MASK) |
+                                                   SIM_MODE_STDBY);
+        sim_registers[SIM_REG_IRQ_FLAGS] |= SIM_IRQ_TX_DONE;
+        sim_stats.packets_sent++;
+
+        sx1278_sim_tx_hook_t hook = sim_tx_hook;
+        void *context = sim_tx_context;
+
+        pthread_mutex_unlock(&sim_lock);
+        if (hook) {
+            hook(frame, length, context);
+        }
+        sim_update_dio0();
+        pthread_mutex_lock(&sim_lock);
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+//  ACCESO AL HARDWARE QUE USA EL DRIVER
+// -----------------------------------------------------------------------------
+
+bool sx1278_hw_init(sx1278_dio0_handler_t handler)
+{
+    pthread_mutex_lock(&sim_lock);
+    sim_dio0_handler = handler;
+    sim_dio0_enabled = false;
+
+    bool ok = true;
+    if (!sim_thread_started) {
+        // Plazos en reloj monotónico, como sim_now_us
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&sim_cond, &attr);
+        pthread_condattr_destroy(&attr);
+
+        sim_reset_registers();
+        ok = pthread_create(&sim_thread, NULL, sim_thread_main, NULL) == 0;
+        if (ok) {
+            pthread_detach(sim_thread);
+        }
+        sim_thread_started = ok;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return ok;
+}
+
+void sx1278_hw_reset(void)
+{
+    pthread_mutex_lock(&sim_lock);
+    sim_reset_registers();
+    pthread_mutex_unlock(&sim_lock);
+}
+
+void sx1278_hw_write(uint8_t reg, const uint8_t *data, size_t length)
+{
+    pthread_mutex_lock(&sim_lock);
+    sim_stats.spi_transactions++;
+    for (size_t i = 0; i < length; i++) {
+        sim_write_byte(reg, data[i]);
+        if (reg != SIM_REG_FIFO) reg = (reg + 1) & 0x7F;
+    }
+    pthread_mutex_unlock(&sim_lock);
+
+    sim_update_dio0();
+}
+
+void sx1278_hw_read(uint8_t reg, uint8_t *data, size_t length)
+{
+    pthread_mutex_lock(&sim_lock);
+    sim_stats.spi_transactions++;
+    for (size_t i = 0; i < length; i++) {
+        data[i] = sim_read_byte(reg);
+        if (reg != SIM_REG_FIFO) reg = (reg + 1) & 0x7F;
+    }
+    pthread_mutex_unlock(&sim_lock);
+}
+
+void sx1278_hw_dio0_enable(bool enable)
+{
+    pthread_mutex_lock(&sim_lock);
+    sim_dio0_enabled = enable;
+    pthread_mutex_unlock(&sim_lock);
+
+    // Por nivel: si DIO0 ya estaba en alto, salta al armarla
+    if (enable) {
+        sim_update_dio0();
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  API DEL SIMULADOR
+// -----------------------------------------------------------------------------
+
+void sx1278_sim_set_realtime(bool enable)
+{
+    pthread_mutex_lock(&sim_lock);
+    sim_realtime = enable;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+void sx1278_sim_set_tx_hook(sx1278_sim_tx_hook_t hook, void *context)
+{
+    pthread_mutex_lock(&sim_lock);
+    sim_tx_hook = hook;
+    sim_tx_context = context;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+bool sx1278_sim_inject(const uint8_t *frame, size_t length, int16_t rssi_dbm, float snr_db,
+                       bool crc_error)
+{
+    pthread_mutex_lock(&sim_lock);
+
+    if (!sim_lora_mode(SIM_MODE_RX_CONTINUOUS) || length == 0 || length > SX1278_MAX_PAYLOAD) {
+        sim_stats.packets_missed++;
+        pthread_mutex_unlock(&sim_lock);
+        return false;
+    }
+
+    uint8_t start = sim_rx_addr;
+    for (size_t i = 0; i < length; i++) {
+        sim_fifo[(uint8_t)(start + i)] = frame[i];
+    }
+    sim_rx_addr = (uint8_t)(start + length);
+
+    // Inverso de lo que hace el driver: SNR en cuartos de dB y, bajo el
+    // ruido, RSSI del registro sin la corrección por SNR
+    long snr_quarters = lroundf(snr_db * 4.0f);
+    if (snr_quarters < -128) snr_quarters = -128;
+    if (snr_quarters > 127) snr_quarters = 127;
+    long rssi_register = rssi_dbm + SIM_RSSI_OFFSET_LF - (snr_quarters < 0 ? snr_quarters / 4 : 0);
+    if (rssi_register < 0) rssi_register = 0;
+    if (rssi_register > 255) rssi_register = 255;
+
+    sim_registers[SIM_REG_FIFO_RX_CURRENT_ADDR] = start;
+    sim_registers[SIM_REG_RX_NB_BYTES] = (uint8_t)length;
+    sim_registers[SIM_REG_PKT_SNR_VALUE] = (uint8_t)(int8_t)snr_quarters;
+    sim_registers[SIM_REG_PKT_RSSI_VALUE] = (uint8_t)rssi_register;
+    sim_registers[SIM_REG_IRQ_FLAGS] |= SIM_IRQ_RX_DONE | SIM_IRQ_VALID_HEADER |
+                                        (crc_error ? SIM_IRQ_PAYLOAD_CRC_ERROR : 0);
+    sim_stats.packets_received++;
+
+    pthread_mutex_unlock(&sim_lock);
+
+    sim_update_dio0();
+    return true;
+}
+
+void sx1278_sim_set_channel(int16_t rssi_dbm, bool signal_detected)
+{
+    long rssi_register = rssi_dbm + SIM_RSSI_OFFSET_LF;
+    if (rssi_register < 0) rssi_register = 0;
+    if (rssi_register > 255) rssi_register = 255;
+
+    pthread_mutex_lock(&sim_lock);
+    sim_registers[SIM_REG_RSSI_VALUE] = (uint8_t)rssi_register;
+    sim_registers[SIM_REG_MODEM_STAT] = signal_detected ? SIM_MODEM_STAT_SIGNAL : SIM_MODEM_STAT_CLEAR;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+uint8_t sx1278_sim_get_register(uint8_t reg)
+{
+    pthread_mutex_lock(&sim_lock);
+    uint8_t value = sim_registers[reg & 0x7F];
+    pthread_mutex_unlock(&sim_lock);
+    return value;
+}
+
+void sx1278_sim_get_stats(sx1278_sim_stats_t *stats)
+{
+    pthread_mutex_lock(&sim_lock);
+    *stats = sim_stats;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+void sx1278_sim_reset_stats(void)
+{
+    pthread_mutex_lock(&sim_lock);
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    pthread_mutex_unlock(&sim_lock);
+}
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,175 @@
+/**
+ * Consola de texto con scroll por hardware
+ * ----------------------------------------
+ *
+ * Las líneas de texto no se mueven nunca en la memoria del panel: la
+ * línea visible r está dibujada en la fila
+ *
+ *     top + (scroll + r * line_height) % height
+ *
+ * y hacer scroll solo cambia 'scroll'. Como height es múltiplo de
+ * line_height, ninguna línea queda partida por el borde de la zona.
+ *
+ * Tras un salto de línea en la última línea, el cursor queda en una línea
+ * que aún no existe en pantalla (scroll_pending): el scroll se hace al
+ * escribir en ella.
+ */
+
+#include <string.h>
+
+#include "text_console.h"
+
+// -----------------------------------------------------------------------------
+//  PROTOTIPOS de funciones internas
+// -----------------------------------------------------------------------------
+
+static uint16_t text_console_line_y(const text_console_t *con, uint8_t row);
+static void text_console_draw(text_console_t *con, const char *text, uint8_t len);
+
+// -----------------------------------------------------------------------------
+//  IMPLEMENTACIÓN
+// -----------------------------------------------------------------------------
+
+/**
+ * Fila de pantalla (en memoria) donde está dibujada la línea visible 'row'.
+ */
+static uint16_t text_console_line_y(const text_console_t *con, uint8_t row)
+{
+    return con->top + (con->scroll + (uint16_t)row * con->line_height) % con->height;
+}
+
+/**
+ * Dibuja 'len' caracteres en la posición del cursor y lo avanza.
+ *
+ * Si hay un scroll pendiente, el tramo se rellena con espacios hasta el
+ * final de la línea y se dibuja sobre la línea más antigua antes de
+ * mover la zona: el texto nuevo y el borrado de la línea salen en una
+ * sola ventana de píxeles, seguida de un VSCRSADD.
+ */
+static void text_console_draw(text_console_t *con, const char *text, uint8_t len)
+{
+    char buf[TEXT_CONSOLE_MAX_COLUMNS + 1];
+    uint8_t draw_len = len;
+    bool scroll = con->scroll_pending;
+
+    memcpy(buf, text, len);
+    if (scroll) {
+        // La línea de arriba (la más antigua) pasa a ser la nueva de abajo
+        con->scroll = (con->scroll + con->line_height) % con->height;
+        con->scroll_pending = false;
+
+        memset(buf + len, ' ', con->columns - len);
+        draw_len = con->columns;
+    }
+    buf[draw_len] = '\0';
+
+    if (draw_len > 0) {
+        ili9341_draw_string(con->col * FONT5X7_ADVANCE * con->scale,
+                            text_console_line_y(con, con->row),
+                            buf, con->fg, con->bg, con->scale);
+    }
+    if (scroll) {
+        ili9341_scroll_to(con->scroll);
+    }
+    con->col += len;
+}
+
+void text_console_init(text_console_t *con, uint16_t top_fixed, uint16_t bottom_fixed,
+                       uint8_t scale, uint16_t fg, uint16_t bg)
+{
+    if (scale == 0) scale = 1;
+
+    memset(con, 0, sizeof(*con));
+    con->top = top_fixed;
+    con->scale = scale;
+    con->line_height = (FONT5X7_CHAR_H + 1) * scale;
+    con->columns = ILI9341_WIDTH / (FONT5X7_ADVANCE * scale);
+    con->fg = fg;
+    con->bg = bg;
+
+    uint16_t available = ILI9341_HEIGHT - top_fixed - bottom_fixed;
+    con->rows = available / con->line_height;
+    con->height = con->rows * con->line_height;
+
+    // Las filas que no llegan a una línea completa pasan a la zona fija de abajo
+    ili9341_scroll_define(top_fixed, ILI9341_HEIGHT - top_fixed - con->height);
+    text_console_clear(con);
+}
+
+void text_console_clear(text_console_t *con)
+{
+    con->scroll = 0;
+    con->row = 0;
+    con->col = 0;
+    con->scroll_pending = false;
+
+    ili9341_scroll_to(0);
+    ili9341_fill_rect(0, con->top, ILI9341_WIDTH, con->height, con->bg);
+}
+
+void text_console_set_color(text_console_t *con, uint16_t fg)
+{
+    con->fg = fg;
+}
+
+void text_console_newline(text_console_t *con)
+{
+    // Una línea vacía tras otro salto: hay que mostrarla ya (en blanco)
+    if (con->scroll_pending) {
+        text_console_draw(con, "", 0);
+    }
+
+    con->col = 0;
+    if (con->row + 1 < con->rows) {
+        con->row++;
+        return;
+    }
+
+    // Desde la última línea no se hace scroll todavía: se hará junto con
+    // el primer texto de la línea nueva, que así nunca se ve a medio borrar
+    con->scroll_pending = true;
+}
+
+void text_console_write(text_console_t *con, const char *text)
+{
+    if (con->rows == 0) return;
+
+    while (*text) {
+        if (*text == '\n') {
+            text_console_newline(con);
+            text++;
+            continue;
+        }
+
+        uint8_t space = con->columns - con->col;
+        if (space == 0) {
+            // Salto automático: el espacio que separaba las palabras no se
+            // arrastra al principio de la línea siguiente
+            text_console_newline(con);
+            if (*text == ' ') text++;
+            continue;
+        }
+
+        uint8_t len = 0;
+        while (len < space && text[len] != '\0' && text[len] != '\n') {
+            len++;
+        }
+
+        // Si una palabra queda cortada, la llevamos entera a la línea siguiente
+        if (len == space && text[len] != '\0' && text[len] != '\n' && text[len] != ' ') {
+            uint8_t cut = len;
+            while (cut > 0 && text[cut - 1] != ' ') cut--;
+
+            if (cut > 0) {
+                len = cut;
+            } else if (con->col > 0) {
+                text_console_newline(con);
+                continue;
+            }
+            // Palabra más larga que una línea: se parte donde toque
+        }
+
+        text_console_draw(con, text, len);
+        text += len;
+    }
+}
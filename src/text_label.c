@@ -0,0 +1,176 @@
+/**
+ * Etiquetas de texto con redibujado incremental
+ * ---------------------------------------------
+ *
+ * Ver text_label.h. Cada celda ocupa FONT5X7_ADVANCE * scale píxeles de
+ * ancho, igual que en ili9341_draw_string, así que un tramo de celdas
+ * seguidas se puede enviar como una sola cadena. La columna de separación
+ * entre caracteres es siempre fondo y no hace falta repintarla.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "text_label.h"
+
+// -----------------------------------------------------------------------------
+//  PROTOTIPOS de funciones internas
+// -----------------------------------------------------------------------------
+
+static void text_label_update(text_label_t *label, const char *text,
+                              const uint16_t *colors, uint16_t fg);
+static void text_label_draw_run(text_label_t *label, uint8_t start, uint8_t len, uint16_t color);
+
+// -----------------------------------------------------------------------------
+//  IMPLEMENTACIÓN
+// -----------------------------------------------------------------------------
+
+void text_label_init(text_label_t *label, uint16_t x, uint16_t y, uint8_t capacity,
+                     uint8_t scale, uint16_t bg)
+{
+    if (scale == 0) scale = 1;
+
+    // Solo las celdas que caben enteras en pantalla
+    uint16_t advance = FONT5X7_ADVANCE * scale;
+    uint16_t fit = (x < ILI9341_WIDTH) ? (ILI9341_WIDTH - x + scale) / advance : 0;
+    if (capacity > fit) capacity = fit;
+    if (capacity > TEXT_LABEL_MAX_CHARS) capacity = TEXT_LABEL_MAX_CHARS;
+
+    memset(label, 0, sizeof(*label));
+    label->x = x;
+    label->y = y;
+    label->scale = scale;
+    label->capacity = capacity;
+    label->bg = bg;
+    text_label_reset(label);
+}
+
+void text_label_reset(text_label_t *label)
+{
+    memset(label->text, ' ', sizeof(label->text));
+    label->length = 0;
+}
+
+/**
+ * Envía las celdas [start, start + len) tal como están en label->text.
+ */
+static void text_label_draw_run(text_label_t *label, uint8_t start, uint8_t len, uint16_t color)
+{
+    char buf[TEXT_LABEL_MAX_CHARS + 1];
+    memcpy(buf, &label->text[start], len);
+    buf[len] = '\0';
+
+    uint16_t x = label->x + start * FONT5X7_ADVANCE * label->scale;
+    ili9341_draw_string(x, label->y, buf, color, label->bg, label->scale);
+    label->glyphs_drawn += len;
+}
+
+static void text_label_update(text_label_t *label, const char *text,
+                              const uint16_t *colors, uint16_t fg)
+{
+    size_t new_len = strlen(text);
+    if (new_len > label->capacity) new_len = label->capacity;
+
+    // Hay que recorrer también lo que había antes para borrar lo que sobre
+    uint8_t end = (new_len > label->length) ? (uint8_t)new_len : label->length;
+
+    // Tramo de celdas cambiadas pendiente de enviar. Un espacio solo pinta
+    // fondo, así que vale con cualquier color; el resto corta el tramo si
+    // su color no coincide con el del tramo.
+    int run_start = -1;
+    bool run_colored = false;
+    uint16_t run_color = label->bg;
+
+    for (uint8_t i = 0; i < end; i++) {
+        char ch = (i < new_len) ? text[i] : ' ';
+        uint16_t color = (i < new_len && colors) ? colors[i] : fg;
+
+        bool changed = (ch != label->text[i]) ||
+                       (ch != ' ' && color != label->colors[i]);
+        if (!changed) {
+            if (run_start >= 0) {
+                text_label_draw_run(label, (uint8_t)run_start, i - run_start, run_color);
+                run_start = -1;
+            }
+            continue;
+        }
+
+        if (run_start >= 0 && ch != ' ' && run_colored && color != run_color) {
+            text_label_draw_run(label, (uint8_t)run_start, i - run_start, run_color);
+            run_start = -1;
+        }
+        if (run_start < 0) {
+            run_start = i;
+            run_colored = false;
+            run_color = label->bg;
+        }
+        if (ch != ' ' && !run_colored) {
+            run_color = color;
+            run_colored = true;
+        }
+
+        label->text[i] = ch;
+        label->colors[i] = color;
+    }
+
+    if (run_start >= 0) {
+        text_label_draw_run(label, (uint8_t)run_start, end - run_start, run_color);
+    }
+
+    // Los espacios finales no cuentan: la próxima vez no hay que borrarlos
+    while (new_len > 0 && label->text[new_len - 1] == ' ') new_len--;
+    label->length = (uint8_t)new_len;
+}
+
+void text_label_print(text_label_t *label, const char *text, uint16_t fg)
+{
+    text_label_update(label, text, NULL, fg);
+}
+
+void text_label_print_colors(text_label_t *label, const char *text, const uint16_t *colors)
+{
+    text_label_update(label, text, colors, label->bg);
+}
+
+void text_label_clear(text_label_t *label)
+{
+    text_label_update(label, "", NULL, label->bg);
+}
+
+size_t text_label_format_fixed(char *out, size_t size, int32_t value,
+                               uint8_t decimals, uint8_t width)
+{
+    // Cifras de derecha a izquierda (un int32_t tiene como mucho 10)
+    char digits[12];
+    size_t count = 0;
+    bool negative = value < 0;
+    uint32_t v = negative ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+
+    do {
+        digits[count++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0 && count < sizeof(digits));
+
+    // Al menos un cero delante del punto: "0.5", no ".5"
+    while (count < (size_t)decimals + 1 && count < sizeof(digits)) {
+        digits[count++] = '0';
+    }
+
+    size_t len = count + (decimals ? 1 : 0) + (negative ? 1 : 0);
+    size_t pad = (width > len) ? width - len : 0;
+    if (len + pad + 1 > size) {
+        if (size > 0) out[0] = '\0';
+        return 0;
+    }
+
+    char *p = out;
+    memset(p, ' ', pad);
+    p += pad;
+    if (negative) *p++ = '-';
+    while (count > 0) {
+        if (count == decimals) *p++ = '.';
+        *p++ = digits[--count];
+    }
+    *p = '\0';
+    return (size_t)(p - out);
+}
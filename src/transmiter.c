@@ -1,6 +1,235 @@
 
 #include <stdio.h>
+#include <time.h>
 #include "transmitter.h"
+#include "sx1278.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#else
+// Debug traces only: off on the host, as with the default log level on the ESP32
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+#endif
+
+static const char *TAG = "TRANSMITTER";
+
+// Active compression stage; both ends must use the same one
+static const compression_codec *active_codec = &huffman_codec;
+
+void setCompressionCodec(const compression_codec *codec){
+
+    active_codec = codec;
+}
+
+// Shared key of the encryption stage; plaintext frames until one is set
+static uint8_t encryption_key[AEAD_KEY_SIZE];
+static bool encryption_enabled = false;
+
+void setEncryptionKey(const uint8_t *key){
+
+    if(key == NULL){
+        memset(encryption_key, 0, sizeof(encryption_key));
+        encryption_enabled = false;
+        return;
+    }
+    memcpy(encryption_key, key, sizeof(encryption_key));
+    encryption_enabled = true;
+}
+
+// With the shared key fixed, a sequence sent again after a reboot would repeat
+// its nonce. A mark kept in NVS stays SEQUENCE_RESERVE ahead of the sequences
+// sealed under it, and a reboot resumes from the mark: one flash write per
+// block. Session keys are new on every boot and need none of this. The host
+// build keeps no mark (the simulations never reboot)
+#define SEQUENCE_RESERVE     256
+#define SEQUENCE_NAMESPACE   "transmitter"
+#define REPLAY_WINDOW        32
+
+static bool sequence_loaded = false;
+static uint32_t sequence_owner;     // transmitter id the mark belongs to
+static uint32_t sequence_reserved;  // sequences below it are covered by the mark
+
+#ifdef ESP_PLATFORM
+static bool openSequenceStore(nvs_handle_t *handle){
+
+    esp_err_t error = nvs_open(SEQUENCE_NAMESPACE, NVS_READWRITE, handle);
+    if(error == ESP_ERR_NVS_NOT_INITIALIZED && nvs_flash_init() == ESP_OK){
+        error = nvs_open(SEQUENCE_NAMESPACE, NVS_READWRITE, handle);
+    }
+    return error == ESP_OK;
+}
+#endif
+
+static bool loadSequenceMark(uint32_t transmitter_id, uint32_t *mark){
+
+    *mark = 0;
+#ifdef ESP_PLATFORM
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_handle_t handle;
+    snprintf(key, sizeof(key), "seq%08lx", (unsigned long)transmitter_id);
+    if(!openSequenceStore(&handle)){
+        return false;
+    }
+    esp_err_t error = nvs_get_u32(handle, key, mark);
+    nvs_close(handle);
+    return error == ESP_OK || error == ESP_ERR_NVS_NOT_FOUND;
+#else
+    (void)transmitter_id;
+    return true;
+#endif
+}
+
+static bool storeSequenceMark(uint32_t transmitter_id, uint32_t mark){
+
+#ifdef ESP_PLATFORM
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_handle_t handle;
+    snprintf(key, sizeof(key), "seq%08lx", (unsigned long)transmitter_id);
+    if(!openSequenceStore(&handle)){
+        return false;
+    }
+    esp_err_t error = nvs_set_u32(handle, key, mark);
+    if(error == ESP_OK){
+        error = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return error == ESP_OK;
+#else
+    (void)transmitter_id;
+    (void)mark;
+    return true;
+#endif
+}
+
+// Moves debugSender->sequence past the stored mark and pushes the mark ahead of it
+static int reserveSequence(device *debugSender){
+
+    uint32_t transmitter_id = (uint32_t)debugSender->transmitter_id;
+    if(!sequence_loaded || sequence_owner != transmitter_id){
+        uint32_t mark = 0;
+        if(!loadSequenceMark(transmitter_id, &mark)){
+            return 305; // Error 305 -> Sequence could not be reserved: the frame is not sealed
+        }
+        sequence_loaded = true;
+        sequence_owner = transmitter_id;
+        sequence_reserved = mark;
+        if(debugSender->sequence < mark){
+            debugSender->sequence = mark;
+        }
+    }
+
+    if(debugSender->sequence >= sequence_reserved){
+        uint32_t mark = debugSender->sequence + SEQUENCE_RESERVE;
+        if(mark < debugSender->sequence || !storeSequenceMark(transmitter_id, mark)){
+            return 305; // out of sequences: the shared key must change
+        }
+        sequence_reserved = mark;
+    }
+    return 0;
+}
+
+// Replay check of authenticated frames: a window of the last REPLAY_WINDOW sequences
+static bool sequenceFresh(const session_replay *replay, uint32_t sequence){
+
+    if(replay->sequence_window == 0 || sequence > replay->highest_sequence){
+        return true;
+    }
+    uint32_t age = replay->highest_sequence - sequence;
+    return age < REPLAY_WINDOW && !(replay->sequence_window & (1u << age));
+}
+
+static void sequenceReceived(session_replay *replay, uint32_t sequence){
+
+    if(replay->sequence_window == 0){
+        replay->highest_sequence = sequence;
+        replay->sequence_window = 1;
+        return;
+    }
+    if(sequence > replay->highest_sequence){
+        uint32_t shift = sequence - replay->highest_sequence;
+        replay->sequence_window = shift >= REPLAY_WINDOW ? 1 : (replay->sequence_window << shift) | 1;
+        replay->highest_sequence = sequence;
+        return;
+    }
+    replay->sequence_window |= 1u << (replay->highest_sequence - sequence);
+}
+
+// Largest frame put on air; longer message frames are fragmented (fragment.h)
+static size_t max_frame_size = PACKET_MAX_SIZE;
+
+// Time the receiver gets to turn an ACK around, on top of the airtime
+#define ACK_MARGIN_US (250 * 1000)
+
+void setMaxFrameSize(size_t size){
+
+    max_frame_size = size > PACKET_MAX_SIZE ? PACKET_MAX_SIZE : size;
+}
+
+// Parity fragments added to messages sent in two or more fragments (fec.h)
+static size_t parity_fragments = 0;
+
+void setParityFragments(size_t count){
+
+    parity_fragments = count;
+}
+
+// Mesh mode (mesh.h): our frames are flooded, others' relayed
+static mesh_node *mesh = NULL;
+
+void setMeshNode(mesh_node *node){
+
+    mesh = node;
+}
+
+// Room left for the payload once the mesh trailer is on
+static size_t frameLimit(void){
+
+    return mesh != NULL ? max_frame_size - PACKET_MESH_MAX_SIZE : max_frame_size;
+}
+
+static int64_t nowUs(void){
+
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+static int queueFragments(device *debugSender, int64_t now, scheduler_ticket *first_ticket);
+
+// Radio listening where link.h says, after agreements changed or lapsed
+static void followLinkRate(int64_t now){
+
+    linkService(now);
+    sx1278_rate_t rate;
+    linkListenRate(&rate);
+    sx1278_set_rx_rate(&rate);
+}
+
+// Trailers of a finished frame of ours: the mesh one when flooding, else a rate offer or answer (link.h)
+static int attachTrailers(uint8_t *frame, size_t frame_size, size_t *frame_length){
+
+    if(mesh != NULL){
+        return meshAttach(mesh, frame, *frame_length, frame_size, frame_length);
+    }
+    linkAttachRate(frame, *frame_length, frame_size, frame_length); // a full frame goes without
+    return 0;
+}
+
+static unsigned countFragments(uint16_t bitmap){
+
+    unsigned count = 0;
+    for(; bitmap != 0; bitmap &= (uint16_t)(bitmap - 1)){
+        count++;
+    }
+    return count;
+}
 
 int getReceiver(int receiver_id){
 
@@ -25,36 +254,426 @@ char* getMessage(char *message){
 
 //errors 200 -> NOT possible Communications (user associated)
 //errors 300 -> Message Couldnt be send
+//errors 400 -> Packet could not be encoded/decoded (see packet.h)
+//errors 500 -> Message could not be compressed/decompressed (see compress.h)
+//errors 600 -> Message could not be encrypted/decrypted (see aead.h)
+//errors 700 -> Session could not be established/used (see session.h)
+//errors 800 -> Message could not be fragmented/reassembled (see fragment.h)
+//errors 900 -> Frame could not be scheduled (see scheduler.h)
 
-int sendMessage(int receiver_id, int emmisorID,char *message, device *debugSender, device *debugReceiver){
+int sendMessage(int receiver_id, int emmisorID,char *message, device *debugSender, device *debugReceiver,
+                scheduler_ticket *ticket){
 
-    printf("sendingMessage\n");
+    int error = validateConnection(receiver_id, emmisorID, message, debugSender, debugReceiver);
+    if(error != 0){
+        return error; // Respective 2xx error code
+    }
 
+    // Only the frame goes on air: header + actual text length + CRC
+    uint8_t frame[PACKET_MAX_MESSAGE_SIZE];
+    size_t frame_length = 0;
 
-    if(validateConnection(receiver_id, emmisorID, message, debugSender, debugReceiver) == 0){
-        printf("Sender Message = %s \n", debugSender->message);
-        printf("Receiver Message = %s \n", debugReceiver->message);
-        
-        if(setMessage(message, debugReceiver) != 0){
+    error = encodeMessage(message, debugSender, frame, sizeof(frame), &frame_length);
+    if(error != 0){
+        return error;
+    }
+    ESP_LOGD(TAG, "Packet size = %u bytes", (unsigned)frame_length);
+
+    // With a transfer: fragments, ACKs and retries from here on (serviceTransfer)
+    if(debugSender->transfer != NULL){
+        fragment_sender *transfer = debugSender->transfer;
+        error = fragmentSenderStart(transfer, frame, frame_length, frameLimit(), parity_fragments);
+        if(error != FRAGMENT_OK){
+            return error;
+        }
+        ESP_LOGD(TAG, "Sending in %u fragments (%u parity)", (unsigned)transfer->count,
+                 (unsigned)(transfer->count - transfer->data_count));
+        return queueFragments(debugSender, nowUs(), ticket);
+    }
+
+    if(frame_length > frameLimit()){
+        return 301; // Error 301 -> Message does not fit in one frame (needs a transfer)
+    }
+    error = attachTrailers(frame, sizeof(frame), &frame_length);
+    if(error != 0){
+        return error;
+    }
+
+    // Queued in the scheduler (scheduler.h), which hands it to the radio when
+    // its turn, the duty cycle and the channel allow
+    int64_t now = nowUs();
+    followLinkRate(now);
+    scheduler_ticket queued = 0;
+    error = schedulerSubmit(frame, frame_length, now, &queued);
+    if(error != SCHEDULER_OK){
+        return error;
+    }
+    schedulerService(now);
+
+    scheduler_ticket_info info;
+    if(schedulerTicketInfo(queued, now, &info) == SCHEDULER_OK){
+        ESP_LOGD(TAG, "Ticket %u: %u us on air, expected wait %lld us", (unsigned)queued,
+                 (unsigned)linkAirtimeUs(frame, frame_length), (long long)info.expected_wait_us);
+    }
+    if(ticket != NULL){
+        *ticket = queued;
+    }
+    return 0;
+}
+
+// Submits the fragments the message queue has room for; *first_ticket gets the first one
+static int queueFragments(device *debugSender, int64_t now, scheduler_ticket *first_ticket){
+
+    fragment_sender *transfer = debugSender->transfer;
+    followLinkRate(now);
+
+    while(transfer->state == FRAGMENT_SENDING && schedulerQueueRoom(SCHEDULER_PRIORITY_MESSAGE) > 0){
+        uint8_t frame[PACKET_MAX_SIZE];
+        size_t frame_length = 0;
+        if(!fragmentSenderNext(transfer, frame, sizeof(frame), &frame_length)){
+            break;
+        }
+        int error = attachTrailers(frame, sizeof(frame), &frame_length);
+        if(error != 0){
+            return error;
+        }
+        scheduler_ticket ticket = 0;
+        error = schedulerSubmit(frame, frame_length, now, &ticket);
+        if(error != SCHEDULER_OK){
+            return error;
+        }
+        if(first_ticket != NULL){
+            *first_ticket = ticket;
+            first_ticket = NULL;
+        }
 
-            return 301;
+        // Round out: the scheduler knows when it starts; then its airtime and the ACK back
+        // (through the relays, when flooding)
+        if(transfer->state == FRAGMENT_WAITING_ACK){
+            scheduler_ticket_info info;
+            schedulerTicketInfo(ticket, now, &info);
+            sx1278_rate_t rate;
+            linkPeerRate(transfer->header.receiver_id, &rate);
+            uint32_t frame_airtime = linkAirtimeUs(frame, frame_length);
+            uint32_t ack_airtime = sx1278_airtime_rate_us(PACKET_HEADER_MAX_SIZE + FRAGMENT_ACK_PAYLOAD_SIZE +
+                                                          PACKET_MESH_MAX_SIZE + PACKET_CRC_SIZE, &rate);
+            transfer->ack_deadline_us = now + info.expected_wait_us + frame_airtime + ack_airtime + ACK_MARGIN_US;
+            if(mesh != NULL){
+                transfer->ack_deadline_us += meshPathDelayUs(mesh, frame_airtime) + meshPathDelayUs(mesh, ack_airtime);
+            }
         }
-        printf("Received Message = %s \n", debugReceiver->message);
+    }
+    schedulerService(now);
+    return 0;
+}
+
+int serviceTransfer(device *debugSender){
+
+    fragment_sender *transfer = debugSender->transfer;
+    if(transfer == NULL){
         return 0;
     }
-    else{
-        return validateConnection(receiver_id, emmisorID, message, debugSender, debugReceiver) ;// Will return the respective error code BUT also will duplicate Sender/receiver info #TODO check to changethat
+
+    int64_t now = nowUs();
+    if(transfer->state == FRAGMENT_WAITING_ACK && now >= transfer->ack_deadline_us){
+        linkReportTimeout(transfer->header.receiver_id, countFragments(transfer->round_sent), now);
+        int error = fragmentSenderTimeout(transfer);
+        if(error != FRAGMENT_OK){
+            return error; // 807: given up
+        }
+    }
+    if(transfer->state == FRAGMENT_FAILED){
+        return FRAGMENT_ERROR_GAVE_UP;
     }
 
- 
- 
+    // Only as many fragments as the message queue takes; the rest go on the
+    // next call (after a TX done event)
+    return queueFragments(debugSender, now, NULL);
+}
 
+// Key of the ACK MACs (fragment.h): known to both ends before any session
+static const uint8_t *ackKey(const device *node){
 
+    if(node->sessions != NULL){
+        return node->sessions->network_key;
+    }
+    return encryption_enabled ? encryption_key : NULL;
 }
 
-int setMessage(char *message, device *debugReceiver ){
-    
-    strncpy(debugReceiver->message, message, MESSAGE_SIZE);
+int handleAck(const uint8_t *frame, size_t frame_length, device *debugSender){
+
+    fragment_sender *transfer = debugSender->transfer;
+    if(transfer == NULL){
+        return FRAGMENT_ERROR_NOT_OURS;
+    }
+    // The first ACK after a round tells how much of it arrived (link.h)
+    bool round_out = transfer->state == FRAGMENT_WAITING_ACK;
+    uint16_t round = transfer->round_sent;
+
+    // A standalone ACK, or one attached to a frame of the peer (packetAttachAck)
+    transfer->ack_key = ackKey(debugSender);
+    packet_view view;
+    int error = packetDecode(frame, frame_length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+    if(view.header.packet_type == PACKET_TYPE_ACK){
+        error = fragmentSenderHandleAck(transfer, frame, frame_length);
+    } else if(view.has_ack){
+        error = fragmentSenderApplyAck(transfer, &view.header, view.ack_sequence, view.ack_bitmap, view.ack_mac);
+    } else {
+        return FRAGMENT_ERROR_WRONG_TYPE;
+    }
+    if(error != FRAGMENT_OK){
+        return error;
+    }
+    if(round_out){
+        linkReportAck(transfer->header.receiver_id, countFragments(round),
+                      countFragments(round & transfer->acknowledged), nowUs());
+    }
+    if(transfer->state == FRAGMENT_DELIVERED){
+        ESP_LOGD(TAG, "Message %u delivered", (unsigned)transfer->header.sequence);
+        return 0;
+    }
+    return serviceTransfer(debugSender); // resend only what is missing
+}
+
+int receiveFragment(const uint8_t *frame, size_t frame_length, device *debugReceiver, bool *message_ready){
+
+    uint8_t message[PACKET_MAX_MESSAGE_SIZE];
+    uint8_t ack[PACKET_MAX_SIZE];
+    size_t message_length = 0, ack_length = 0;
+
+    *message_ready = false;
+    if(debugReceiver->reassembly == NULL){
+        return FRAGMENT_ERROR_WRONG_TYPE;
+    }
+
+    debugReceiver->reassembly->ack_key = ackKey(debugReceiver);
+    int error = fragmentReceive(debugReceiver->reassembly, frame, frame_length, nowUs(),
+                                message, sizeof(message), &message_length, ack, sizeof(ack), &ack_length);
+    if(error != FRAGMENT_OK){
+        return error;
+    }
+
+    // A lost ACK is recovered by the sender's probe, so a full queue is not fatal.
+    // It answers the rate offer the fragment may have carried (link.h)
+    if(ack_length > 0){
+        int64_t now = nowUs();
+        attachTrailers(ack, sizeof(ack), &ack_length);
+        schedulerSubmit(ack, ack_length, now, NULL);
+        schedulerService(now);
+        followLinkRate(now);
+    }
+    if(message_length == 0){
+        return 0;
+    }
+
+    error = receiveMessage(message, message_length, debugReceiver);
+    if(error != 0){
+        return error;
+    }
+    *message_ready = true;
+    return 0;
+}
+
+bool acceptFrame(const uint8_t *frame, size_t frame_length){
+
+    if(mesh == NULL){
+        return true;
+    }
+    bool for_us = meshReceive(mesh, frame, frame_length, nowUs());
+    serviceMesh(); // a relay drawn with no delay goes now
+    return for_us;
+}
+
+int64_t serviceMesh(void){
+
+    if(mesh == NULL){
+        return -1;
+    }
+    int64_t now = nowUs();
+    uint8_t frame[PACKET_MAX_SIZE];
+    size_t frame_length = 0;
+    // Relays take their chances in the message queue: a full one drops them
+    while(meshNextRelay(mesh, now, frame, sizeof(frame), &frame_length)){
+        schedulerSubmit(frame, frame_length, now, NULL);
+    }
+    schedulerService(now);
+    return meshRelayWaitUs(mesh, now);
+}
+
+int encodeMessage(const char *message, device *debugSender, uint8_t *frame, size_t frame_size, size_t *frame_length){
+
+    packet_header header = {
+        .version = PACKET_VERSION,
+        .packet_type = PACKET_TYPE_DATA,
+        .flags = PACKET_FLAG_NONE,
+        .transmitter_id = (uint32_t)debugSender->transmitter_id,
+        .receiver_id = (uint32_t)debugSender->receiver_id,
+        .sequence = debugSender->sequence,
+    };
+
+    // Text goes without the terminator: the length prefix already says where it ends
+    const uint8_t *payload = (const uint8_t *)message;
+    size_t payload_length = strnlen(message, MESSAGE_SIZE);
+
+    // Compressed only if it actually saves bytes; otherwise raw text goes out
+    uint8_t compressed[MESSAGE_SIZE];
+    size_t compressed_length = 0;
+    if(active_codec != NULL &&
+       active_codec->compress(payload, payload_length, compressed, sizeof(compressed), &compressed_length) == COMPRESS_OK &&
+       compressed_length < payload_length){
+        payload = compressed;
+        payload_length = compressed_length;
+        header.flags |= PACKET_FLAG_COMPRESSED;
+    }
+
+    // Session key for this peer when the device has sessions, shared key otherwise
+    const uint8_t *key = encryption_enabled ? encryption_key : NULL;
+    if(debugSender->sessions != NULL){
+        uint8_t key_phase = 0;
+        int error = sessionGetSendKey(debugSender->sessions, header.receiver_id, &key, &key_phase);
+        if(error != SESSION_OK){
+            return error; // 7xx: handshake first (see session.h)
+        }
+        if(key_phase){
+            header.flags |= PACKET_FLAG_KEY_PHASE;
+        }
+    } else if(key != NULL){
+        int error = reserveSequence(debugSender);
+        if(error != 0){
+            return error;
+        }
+        header.sequence = debugSender->sequence;
+    }
+
+    if(key == NULL){
+        int error = packetEncode(&header, payload, payload_length, frame, frame_size, frame_length);
+        if(error != PACKET_OK){
+            return error;
+        }
+        debugSender->sequence++;
+        return 0;
+    }
+
+    // On air: header | ciphertext | tag | CRC. The header is authenticated
+    // too (AAD), so ids, sequence and flags cannot be altered unnoticed
+    header.flags |= PACKET_FLAG_ENCRYPTED;
+    size_t header_length = 0;
+    int error = packetWriteHeader(&header, payload_length + AEAD_TAG_SIZE, frame, frame_size, &header_length);
+    if(error != PACKET_OK){
+        return error;
+    }
+
+    uint8_t *ciphertext = &frame[header_length];
+    memcpy(ciphertext, payload, payload_length);
+
+    // Unique per key: the sequence only grows, under the shared key it resumes
+    // past the NVS mark after a reboot, and session keys are new every boot
+    uint8_t nonce[AEAD_NONCE_SIZE];
+    aeadBuildNonce(nonce, header.transmitter_id, header.sequence, header.packet_type);
+    error = aeadSeal(key, nonce, frame, header_length,
+                     ciphertext, payload_length, &ciphertext[payload_length]);
+    if(error != AEAD_OK){
+        return error;
+    }
+
+    *frame_length = packetWriteCrc(frame, header_length + payload_length + AEAD_TAG_SIZE);
+    debugSender->sequence++;
+    return 0;
+}
+
+int receiveMessage(uint8_t *frame, size_t frame_length, device *debugReceiver){
+
+    packet_view view;
+
+    int error = packetDecode(frame, frame_length, &view);
+    if(error != PACKET_OK){
+        return error;
+    }
+
+    if(view.header.packet_type != PACKET_TYPE_DATA){
+        return 302; // Error 302 -> Not a message packet
+    }
+    if(view.header.transmitter_id != (uint32_t)debugReceiver->transmitter_id ||
+       view.header.receiver_id != (uint32_t)debugReceiver->receiver_id){
+        return 203; // Error 203 -> Packet belongs to another link
+    }
+
+    if(view.header.flags & PACKET_FLAG_ENCRYPTED){
+        const uint8_t *key = encryption_enabled ? encryption_key : NULL;
+        session_replay *replay = &debugReceiver->replay;
+        uint8_t key_phase = (view.header.flags & PACKET_FLAG_KEY_PHASE) ? 1 : 0;
+        if(debugReceiver->sessions != NULL){
+            error = sessionGetReceiveKey(debugReceiver->sessions, view.header.transmitter_id, key_phase, &key);
+            if(error != SESSION_OK){
+                return error;
+            }
+            replay = sessionReplayWindow(debugReceiver->sessions, view.header.transmitter_id, key_phase);
+        }
+        if(key == NULL){
+            return 304; // Error 304 -> Encrypted message but no key configured
+        }
+        if(!sequenceFresh(replay, view.header.sequence)){
+            return 306; // Error 306 -> Replayed frame (sequence already received or too old)
+        }
+        if(view.payload_length < AEAD_TAG_SIZE){
+            return AEAD_ERROR_AUTHENTICATION;
+        }
+
+        // Decrypted in place: view.payload points inside frame. Trailers (ACK,
+        // rate, mesh) were added after sealing, so the AAD is the header without their flags
+        size_t header_length = (size_t)(view.payload - frame);
+        frame[1] &= (uint8_t)~PACKET_TRAILER_FLAGS;
+        uint8_t *text = &frame[header_length];
+        size_t text_length = view.payload_length - AEAD_TAG_SIZE;
+
+        uint8_t nonce[AEAD_NONCE_SIZE];
+        aeadBuildNonce(nonce, view.header.transmitter_id, view.header.sequence, view.header.packet_type);
+        error = aeadOpen(key, nonce, frame, header_length, text, text_length, &text[text_length]);
+        if(error != AEAD_OK){
+            return error;
+        }
+        sequenceReceived(replay, view.header.sequence);
+        if(debugReceiver->sessions != NULL){
+            // Opened: the sender has these keys (see sessionConfirmKey)
+            sessionConfirmKey(debugReceiver->sessions, view.header.transmitter_id, key_phase);
+        }
+        view.payload_length = text_length;
+    }
+
+    if(view.header.flags & PACKET_FLAG_COMPRESSED){
+        if(active_codec == NULL){
+            return 303; // Error 303 -> Compressed message but no codec configured
+        }
+        // Decompressed straight into the receiver buffer
+        size_t message_length = 0;
+        error = active_codec->decompress(view.payload, view.payload_length,
+                                         (uint8_t *)debugReceiver->message, MESSAGE_SIZE - 1, &message_length);
+        if(error != COMPRESS_OK){
+            return error;
+        }
+        debugReceiver->message[message_length] = '\0';
+        return 0;
+    }
+
+    // Payload is read straight from the frame, no intermediate copy
+    if(setMessage((const char *)view.payload, view.payload_length, debugReceiver) != 0){
+        return 301;
+    }
+    return 0;
+}
+
+int setMessage(const char *message, size_t message_length, device *debugReceiver){
+
+    if(message_length >= MESSAGE_SIZE){
+        return 301; // Error 301 -> Message does not fit
+    }
+
+    // Copy only the text that arrived, not the full MESSAGE_SIZE buffer
+    memcpy(debugReceiver->message, message, message_length);
+    debugReceiver->message[message_length] = '\0';
     return 0;
 }
 
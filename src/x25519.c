@@ -0,0 +1,236 @@
+#include <string.h>
+#include "x25519.h"
+
+/*
+ * GF(2^255 - 19) element: value = sum(limb[i] * 2^ceil(25.5 * i)), limbs
+ * alternate 26 and 25 bits. Limbs are signed so subtraction needs no
+ * bias; a carried element has every limb below 2^26 in magnitude.
+ */
+typedef int64_t field_element[10];
+
+static void secureZero(void *data, size_t length){
+    volatile uint8_t *bytes = data;
+    while(length--){ *bytes++ = 0; }
+}
+
+static int limbBits(int limb){
+
+    return (limb & 1) ? 25 : 26;
+}
+
+static void fieldCarry(field_element element){
+
+    for(int pass = 0; pass < 2; pass++){
+        for(int limb = 0; limb < 10; limb++){
+            int64_t carry = element[limb] >> limbBits(limb);
+            element[limb] -= carry * ((int64_t)1 << limbBits(limb)); // carry may be negative: no shift
+            if(limb < 9){
+                element[limb + 1] += carry;
+            } else {
+                element[0] += carry * 19; // 2^255 = 19 mod p
+            }
+        }
+    }
+}
+
+static void fieldAdd(field_element out, const field_element first, const field_element second){
+
+    for(int limb = 0; limb < 10; limb++){
+        out[limb] = first[limb] + second[limb];
+    }
+}
+
+static void fieldSubtract(field_element out, const field_element first, const field_element second){
+
+    for(int limb = 0; limb < 10; limb++){
+        out[limb] = first[limb] - second[limb];
+    }
+}
+
+/*
+ * Schoolbook product. Two odd limbs multiply to twice the weight the
+ * indices suggest (25.5 bit spacing), and anything at or above 2^255
+ * wraps around times 19. Inputs up to 2^27 per limb keep every sum
+ * below 2^63.
+ */
+static void fieldMultiply(field_element out, const field_element first, const field_element second){
+
+    int64_t product[10] = {0};
+
+    for(int first_limb = 0; first_limb < 10; first_limb++){
+        for(int second_limb = 0; second_limb < 10; second_limb++){
+            int64_t term = first[first_limb] * second[second_limb];
+            if((first_limb & 1) && (second_limb & 1)){
+                term *= 2;
+            }
+            int target = first_limb + second_limb;
+            if(target >= 10){
+                term *= 19;
+                target -= 10;
+            }
+            product[target] += term;
+        }
+    }
+
+    fieldCarry(product);
+    memcpy(out, product, sizeof(product));
+}
+
+static void fieldSquare(field_element out, const field_element element){
+
+    fieldMultiply(out, element, element);
+}
+
+static void fieldMultiplySmall(field_element out, const field_element element, int32_t factor){
+
+    for(int limb = 0; limb < 10; limb++){
+        out[limb] = element[limb] * factor;
+    }
+    fieldCarry(out);
+}
+
+// element^(p - 2) = 1 / element (Fermat). p - 2 = 2^255 - 21
+static void fieldInvert(field_element out, const field_element element){
+
+    field_element result;
+    memcpy(result, element, sizeof(result));
+
+    for(int bit = 253; bit >= 0; bit--){
+        fieldSquare(result, result);
+        if(bit != 2 && bit != 4){ // the only zero bits of 2^255 - 21
+            fieldMultiply(result, result, element);
+        }
+    }
+    memcpy(out, result, sizeof(result));
+}
+
+// Swaps first and second when swap is 1, without branching on it
+static void fieldConditionalSwap(field_element first, field_element second, int64_t swap){
+
+    int64_t mask = -swap;
+    for(int limb = 0; limb < 10; limb++){
+        int64_t difference = (first[limb] ^ second[limb]) & mask;
+        first[limb] ^= difference;
+        second[limb] ^= difference;
+    }
+}
+
+static void fieldFromBytes(field_element out, const uint8_t bytes[32]){
+
+    int bit_position = 0;
+    for(int limb = 0; limb < 10; limb++){
+        int64_t value = 0;
+        for(int bit = 0; bit < limbBits(limb); bit++, bit_position++){
+            value |= (int64_t)((bytes[bit_position >> 3] >> (bit_position & 7)) & 1) << bit;
+        }
+        out[limb] = value; // bit 255 is never read, as RFC 7748 asks
+    }
+}
+
+static void fieldToBytes(uint8_t bytes[32], const field_element element){
+
+    // + 2p first: a carried element can still be a little below zero
+    field_element reduced;
+    for(int limb = 0; limb < 10; limb++){
+        int64_t limb_of_p = (1 << limbBits(limb)) - (limb == 0 ? 19 : 1);
+        reduced[limb] = element[limb] + 2 * limb_of_p;
+    }
+    fieldCarry(reduced);
+
+    // Every limb is now in [0, 2^bits) and the value is below 2p, so at
+    // most one p has to go: q = 1 exactly when value + 19 reaches 2^255
+    int64_t quotient = (reduced[0] + 19) >> 26;
+    for(int limb = 1; limb < 10; limb++){
+        quotient = (reduced[limb] + quotient) >> limbBits(limb);
+    }
+
+    reduced[0] += 19 * quotient;
+    for(int limb = 0; limb < 9; limb++){
+        int64_t carry = reduced[limb] >> limbBits(limb);
+        reduced[limb] -= carry * ((int64_t)1 << limbBits(limb));
+        reduced[limb + 1] += carry;
+    }
+    reduced[9] &= (1 << 25) - 1; // drops the 2^255 of q * p
+
+    memset(bytes, 0, 32);
+    int bit_position = 0;
+    for(int limb = 0; limb < 10; limb++){
+        for(int bit = 0; bit < limbBits(limb); bit++, bit_position++){
+            bytes[bit_position >> 3] |= (uint8_t)(((reduced[limb] >> bit) & 1) << (bit_position & 7));
+        }
+    }
+}
+
+void x25519(uint8_t shared[X25519_KEY_SIZE], const uint8_t scalar[X25519_KEY_SIZE],
+            const uint8_t point[X25519_KEY_SIZE]){
+
+    uint8_t clamped[X25519_KEY_SIZE];
+    memcpy(clamped, scalar, sizeof(clamped));
+    clamped[0] &= 248;
+    clamped[31] &= 127;
+    clamped[31] |= 64;
+
+    // Montgomery ladder, RFC 7748 section 5
+    field_element x1, x2 = {1}, z2 = {0}, x3, z3 = {1};
+    field_element a, aa, b, bb, e, c, d, da, cb;
+    fieldFromBytes(x1, point);
+    memcpy(x3, x1, sizeof(x3));
+
+    int64_t swap = 0;
+    for(int bit = 254; bit >= 0; bit--){
+        int64_t scalar_bit = (clamped[bit >> 3] >> (bit & 7)) & 1;
+        swap ^= scalar_bit;
+        fieldConditionalSwap(x2, x3, swap);
+        fieldConditionalSwap(z2, z3, swap);
+        swap = scalar_bit;
+
+        fieldAdd(a, x2, z2);
+        fieldSquare(aa, a);
+        fieldSubtract(b, x2, z2);
+        fieldSquare(bb, b);
+        fieldSubtract(e, aa, bb);
+        fieldAdd(c, x3, z3);
+        fieldSubtract(d, x3, z3);
+        fieldMultiply(da, d, a);
+        fieldMultiply(cb, c, b);
+
+        fieldAdd(x3, da, cb);
+        fieldSquare(x3, x3);
+        fieldSubtract(z3, da, cb);
+        fieldSquare(z3, z3);
+        fieldMultiply(z3, z3, x1);
+
+        fieldMultiply(x2, aa, bb);
+        fieldMultiplySmall(z2, e, 121665); // (A - 2) / 4
+        fieldAdd(z2, z2, aa);
+        fieldMultiply(z2, z2, e);
+    }
+    fieldConditionalSwap(x2, x3, swap);
+    fieldConditionalSwap(z2, z3, swap);
+
+    fieldInvert(z2, z2);
+    fieldMultiply(x2, x2, z2);
+    fieldToBytes(shared, x2);
+
+    // The ladder state and temporaries all derive from the secret scalar
+    secureZero(clamped, sizeof(clamped));
+    secureZero(x2, sizeof(x2));
+    secureZero(z2, sizeof(z2));
+    secureZero(x3, sizeof(x3));
+    secureZero(z3, sizeof(z3));
+    secureZero(a, sizeof(a));
+    secureZero(aa, sizeof(aa));
+    secureZero(b, sizeof(b));
+    secureZero(bb, sizeof(bb));
+    secureZero(e, sizeof(e));
+    secureZero(c, sizeof(c));
+    secureZero(d, sizeof(d));
+    secureZero(da, sizeof(da));
+    secureZero(cb, sizeof(cb));
+}
+
+void x25519PublicKey(uint8_t public_key[X25519_KEY_SIZE], const uint8_t secret_key[X25519_KEY_SIZE]){
+
+    static const uint8_t base_point[X25519_KEY_SIZE] = { 9 };
+    x25519(public_key, secret_key, base_point);
+}
@@ -0,0 +1,446 @@
+/*
+ * Adaptive data rate over a simulated channel
+ * -------------------------------------------
+ *
+ * Node 1 sends messages to node 2 through encodeMessage, the fragment
+ * layer (fragment.h) and the link layer (link.h), with the rate offers
+ * and answers travelling in the real packet trailers. Time is virtual:
+ * every frame costs its airtime at the rate it goes at, every missing ACK
+ * the sender's wait (ACK airtime + 250 ms, as in transmiter.c).
+ *
+ * Channel: the SNR of the link follows the scenario, plus 1.5 dB of
+ * Gaussian fading per frame. A frame is heard only at the spreading
+ * factor the other node listens at, and then with a probability that
+ * goes from 50% at the demodulation floor of its spreading factor to
+ * about 98% 2 dB above it; each coding rate step above 4/5 is worth
+ * 0.5 dB. "noisy" adds 10% of frames lost to interference whatever the
+ * SNR.
+ *
+ * Both nodes share the one link table of the process: node 1 keeps its
+ * entry for peer 2, node 2 its entry for peer 1, and the local id is
+ * switched to the node that hears each frame. Each node listens at the
+ * rate of its only peer, which is what linkListenRate gives it.
+ *
+ * Before the scenarios, node 1 overhears offers and answers between other
+ * nodes: they must leave its rates and agreements alone.
+ *
+ * For each scenario it reports delivered messages and airtime (both
+ * directions) per delivered byte of text, with the adaptive rate and with
+ * fixed SF7, SF10 and SF12 at 4/5. SF12 is the base rate the network
+ * would need to reach its farthest peer.
+ *
+ * Interference here hits every frame alike, so in "noisy" the slower rate
+ * that a high loss asks for only costs airtime; it pays off when the loss
+ * comes from a weak link the SNR does not show (the peer hears us worse
+ * than we hear it).
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/adr_sim \
+ *       testplayground/adr_sim.c src/link.c src/fragment.c src/transmiter.c \
+ *       src/packet.c src/compress.c src/aead.c src/session.c src/x25519.c \
+ *       src/sha256.c src/sx1278.c src/sx1278_sim.c src/scheduler.c \
+ *       src/mesh.c src/fec.c -pthread -lm
+ *
+ * Usage:
+ *   ./testplayground/adr_sim [messages] [corpus]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fragment.h"
+#include "link.h"
+#include "sx1278.h"
+#include "transmitter.h"
+
+#define MAX_LINES        2000
+#define ACK_MARGIN_US    (250 * 1000)
+#define BASE_SF          12
+#define FADING_DB        1.5
+#define NOISE_FLOOR_DBM  (-117)
+
+static char corpus[MAX_LINES][MESSAGE_SIZE];
+static int corpus_lines;
+
+typedef enum{
+
+    SCENARIO_NEAR = 0,
+    SCENARIO_MID,
+    SCENARIO_FAR,
+    SCENARIO_WALK,      // walks away to the edge of SF12 and comes back
+    SCENARIO_DROP,      // an obstacle halfway through: the fast rate dies at once
+    SCENARIO_NOISY,     // good SNR, 10% of frames lost to interference
+    SCENARIO_GAPS,      // idle 0-60 s between messages: agreements lapse
+    SCENARIO_COUNT,
+
+} scenario;
+
+static const char *scenario_names[SCENARIO_COUNT] = { "near", "mid", "far", "walk", "drop", "noisy", "gaps" };
+
+typedef struct{
+
+    uint32_t delivered;
+    uint32_t failed;
+    uint32_t corrupted;
+    uint64_t text_bytes;
+    uint64_t airtime_us;
+    uint64_t fragment_sf_sum;   // to report the average spreading factor
+    uint32_t fragments;
+    uint32_t rate_changes;
+    uint32_t fallbacks;
+
+} run_result;
+
+static uint64_t random_state;
+static int64_t now_us;
+
+static double nextRandom(void){
+
+    // xorshift64*: same sequence on every run
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (double)((random_state * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static double gaussian(void){
+
+    double u = nextRandom(), v = nextRandom();
+    return sqrt(-2.0 * log(u + 1e-12)) * cos(2.0 * M_PI * v);
+}
+
+static void loadCorpus(const char *path){
+
+    FILE *file = fopen(path, "r");
+    if(file == NULL){
+        strcpy(corpus[0], "hola, ya estoy en camino\n");
+        corpus_lines = 1;
+        return;
+    }
+    while(corpus_lines < MAX_LINES && fgets(corpus[corpus_lines], MESSAGE_SIZE, file) != NULL){
+        if(corpus[corpus_lines][0] != '\n'){
+            corpus_lines++;
+        }
+    }
+    fclose(file);
+}
+
+static void makeMessage(int index, char *text){
+
+    if(index % 2 == 0){
+        strcpy(text, corpus[(index / 2) % corpus_lines]);
+        return;
+    }
+    for(int position = 0; position < MESSAGE_SIZE - 1; position++){
+        text[position] = (char)(' ' + (int)(nextRandom() * 95));
+    }
+    text[MESSAGE_SIZE - 1] = '\0';
+}
+
+// Mean SNR of the link while message index of count goes
+static double scenarioSnr(scenario which, int index, int count){
+
+    double progress = (double)index / (double)count;
+    switch(which){
+    case SCENARIO_NEAR:  return 6.0;
+    case SCENARIO_MID:   return -6.0;
+    case SCENARIO_FAR:   return -15.0;
+    case SCENARIO_WALK:  return 6.0 - 22.0 * (progress < 0.5 ? progress * 2 : (1.0 - progress) * 2);
+    case SCENARIO_DROP:  return progress < 0.5 ? 6.0 : -14.0;
+    case SCENARIO_NOISY: return 4.0;
+    case SCENARIO_GAPS:  return -3.0;
+    default:             return 0.0;
+    }
+}
+
+static double demodulationFloor(uint8_t spreading_factor){
+
+    return -7.5 - 2.5 * (spreading_factor - 7);
+}
+
+/*
+ * Spreading factor node listens at while talking only to peer. Mirrors
+ * linkListenRate, which looks at the peer heard last and would mix the
+ * two nodes up here.
+ */
+static uint8_t listenSpreadingFactor(uint32_t peer){
+
+    sx1278_rate_t rate;
+    linkPeerRate(peer, &rate);
+    link_peer entry;
+    if(linkGetPeer(peer, &entry) && entry.answering && !entry.answer_sent && entry.previous != 0){
+        return entry.previous;
+    }
+    return rate.spreading_factor;
+}
+
+/*
+ * Puts a finished frame on air: costs its airtime at the rate link.h
+ * picks for it. Returns true (and the SNR it was heard with) if the node
+ * at the other end, listening to peer, hears it.
+ */
+static bool transmit(const uint8_t *frame, size_t length, uint32_t listener_peer, double mean_snr,
+                     bool noisy, run_result *result, float *snr){
+
+    sx1278_rate_t rate;
+    linkFrameRate(frame, length, &rate);
+    uint32_t airtime = sx1278_airtime_rate_us(length, &rate);
+    now_us += airtime;
+    result->airtime_us += airtime;
+
+    double sample = mean_snr + FADING_DB * gaussian();
+    double margin = sample - demodulationFloor(rate.spreading_factor) + 0.5 * (rate.coding_rate - 5);
+    bool heard = rate.spreading_factor == listenSpreadingFactor(listener_peer) &&
+                 nextRandom() < 1.0 / (1.0 + exp(-margin / 0.5)) &&
+                 !(noisy && nextRandom() < 0.10);
+    *snr = (float)sample;
+    return heard;
+}
+
+static run_result runScenario(scenario which, const link_config *config, int messages){
+
+    run_result result = {0};
+    static fragment_sender transfer;
+    static fragment_reassembler reassembly;
+    memset(&transfer, 0, sizeof(transfer));
+    fragmentReassemblerInit(&reassembly, 2);
+    linkInit(config);
+
+    device sender = { .transmitter_id = 1, .receiver_id = 2, .transfer = &transfer };
+    device receiver = { .transmitter_id = 1, .receiver_id = 2, .reassembly = &reassembly };
+
+    random_state = 0x9E3779B97F4A7C15ULL + (uint64_t)which;
+    now_us = 0;
+    bool noisy = which == SCENARIO_NOISY;
+
+    for(int index = 0; index < messages; index++){
+        char text[MESSAGE_SIZE];
+        uint8_t message_frame[PACKET_MAX_MESSAGE_SIZE];
+        size_t message_length = 0;
+        double snr = scenarioSnr(which, index, messages);
+
+        if(which == SCENARIO_GAPS){
+            now_us += (int64_t)(nextRandom() * 60e6);
+        }
+        makeMessage(index, text);
+        if(encodeMessage(text, &sender, message_frame, sizeof(message_frame), &message_length) != 0 ||
+           fragmentSenderStart(&transfer, message_frame, message_length, PACKET_MAX_SIZE, 0) != FRAGMENT_OK){
+            result.failed++;
+            continue;
+        }
+
+        while(transfer.state == FRAGMENT_SENDING || transfer.state == FRAGMENT_WAITING_ACK){
+            uint8_t acks[FRAGMENT_MAX_COUNT][PACKET_MAX_SIZE];
+            size_t ack_lengths[FRAGMENT_MAX_COUNT];
+            float ack_snr[FRAGMENT_MAX_COUNT];
+            int ack_count = 0;
+
+            // One round, as transmiter.c sends it: offers attached where they fit
+            linkService(now_us);
+            uint8_t frame[PACKET_MAX_SIZE];
+            size_t frame_length = 0;
+            while(fragmentSenderNext(&transfer, frame, sizeof(frame), &frame_length)){
+                linkAttachRate(frame, frame_length, sizeof(frame), &frame_length);
+                sx1278_rate_t rate;
+                linkFrameRate(frame, frame_length, &rate);
+                result.fragment_sf_sum += rate.spreading_factor;
+                result.fragments++;
+
+                float heard_snr;
+                if(!transmit(frame, frame_length, 1, snr, noisy, &result, &heard_snr)){
+                    continue;
+                }
+                linkService(now_us);
+                linkSetLocalId(2);
+                linkObserveFrame(frame, frame_length, (int16_t)(NOISE_FLOOR_DBM + heard_snr), heard_snr, now_us);
+
+                uint8_t message[PACKET_MAX_MESSAGE_SIZE];
+                size_t length = 0, ack_length = 0;
+                fragmentReceive(&reassembly, frame, frame_length, now_us, message, sizeof(message), &length,
+                                acks[ack_count], sizeof(acks[0]), &ack_length);
+                if(length > 0){
+                    bool same = receiveMessage(message, length, &receiver) == 0 &&
+                                strcmp(receiver.message, text) == 0;
+                    result.corrupted += !same;
+                    result.text_bytes += same ? strlen(text) : 0;
+                }
+                if(ack_length > 0){
+                    linkAttachRate(acks[ack_count], ack_length, sizeof(acks[0]), &ack_length);
+                    if(transmit(acks[ack_count], ack_length, 2, snr, noisy, &result, &ack_snr[ack_count]) &&
+                       ack_count < FRAGMENT_MAX_COUNT - 1){
+                        ack_lengths[ack_count++] = ack_length;
+                    }
+                }
+            }
+
+            if(ack_count == 0){
+                sx1278_rate_t rate;
+                linkPeerRate(2, &rate);
+                now_us += sx1278_airtime_rate_us(PACKET_HEADER_MAX_SIZE + FRAGMENT_ACK_PAYLOAD_SIZE + 1 +
+                                                 PACKET_CRC_SIZE, &rate) + ACK_MARGIN_US;
+                linkReportTimeout(2, (unsigned)__builtin_popcount(transfer.round_sent), now_us);
+                fragmentSenderTimeout(&transfer);
+                continue;
+            }
+            for(int ack = 0; ack < ack_count && transfer.state != FRAGMENT_DELIVERED; ack++){
+                bool round_out = transfer.state == FRAGMENT_WAITING_ACK;
+                uint16_t round = transfer.round_sent;
+                linkSetLocalId(1);
+                linkObserveFrame(acks[ack], ack_lengths[ack], (int16_t)(NOISE_FLOOR_DBM + ack_snr[ack]),
+                                 ack_snr[ack], now_us);
+                if(fragmentSenderHandleAck(&transfer, acks[ack], ack_lengths[ack]) == FRAGMENT_OK && round_out){
+                    linkReportAck(2, (unsigned)__builtin_popcount(round),
+                                  (unsigned)__builtin_popcount(round & transfer.acknowledged), now_us);
+                }
+            }
+        }
+
+        result.delivered += transfer.state == FRAGMENT_DELIVERED;
+        result.failed += transfer.state == FRAGMENT_FAILED;
+    }
+
+    link_peer peer;
+    if(linkGetPeer(2, &peer)){
+        result.rate_changes = peer.stats.rate_changes;
+        result.fallbacks = peer.stats.fallbacks;
+    }
+    return result;
+}
+
+// Frame of type from one node to another carrying a rate trailer (0 = none)
+static size_t rateFrame(uint8_t type, uint32_t from, uint32_t to, uint8_t spreading_factor, uint8_t *frame){
+
+    packet_header header = { PACKET_VERSION, type, 0, from, to, 1 };
+    const uint8_t payload[4] = { 0 };
+    size_t length = 0;
+    packetEncode(&header, payload, sizeof(payload), frame, PACKET_MAX_SIZE, &length);
+    if(spreading_factor != 0){
+        packetAttachRate(frame, length, PACKET_MAX_SIZE, (uint8_t)((spreading_factor << 4) | 5), &length);
+    }
+    return length;
+}
+
+// Node 1 hears peer 2 talk to node 3 and node 5 to node 9
+static int overheardCheck(void){
+
+    const link_config config = LINK_CONFIG_DEFAULT;
+    uint8_t frame[PACKET_MAX_SIZE];
+    size_t length;
+    sx1278_rate_t rate;
+    link_peer peer;
+    int failures = 0;
+
+    linkInit(&config);
+    linkSetLocalId(1);
+    length = rateFrame(PACKET_TYPE_DATA, 2, 1, 0, frame);
+    linkObserveFrame(frame, length, -100, 5.0f, 0);
+
+    // Offer and answer for node 3: no agreement with 2, signal still counts
+    length = rateFrame(PACKET_TYPE_FRAGMENT, 2, 3, 7, frame);
+    linkObserveFrame(frame, length, -90, 15.0f, 1000);
+    length = rateFrame(PACKET_TYPE_ACK, 2, 3, 7, frame);
+    linkObserveFrame(frame, length, -90, 15.0f, 2000);
+    linkPeerRate(2, &rate);
+    failures += rate.spreading_factor != BASE_SF;
+    linkListenRate(&rate);
+    failures += rate.spreading_factor != BASE_SF;
+    failures += !linkGetPeer(2, &peer) || peer.stats.frames_heard != 3 || peer.stats.rate_changes != 0;
+
+    // A stranger talking to another node takes no entry
+    length = rateFrame(PACKET_TYPE_FRAGMENT, 5, 9, 7, frame);
+    linkObserveFrame(frame, length, -90, 15.0f, 3000);
+    failures += linkGetPeer(5, &peer);
+
+    // Our own agreement with 2 is not kept alive by what 2 says to others
+    length = rateFrame(PACKET_TYPE_FRAGMENT, 2, 1, 7, frame);
+    linkObserveFrame(frame, length, -90, 15.0f, 4000);
+    linkPeerRate(2, &rate);
+    failures += rate.spreading_factor != 7;
+    int64_t lapse_us = 4000 + (int64_t)(config.hold_ms + LINK_ACCEPTOR_GUARD_MS) * 1000;
+    for(int64_t now = 4000 + 1000000; now < lapse_us; now += 1000000){
+        length = rateFrame(PACKET_TYPE_DATA, 2, 3, 0, frame);
+        linkObserveFrame(frame, length, -90, 15.0f, now);
+    }
+    linkService(lapse_us + 1);
+    linkPeerRate(2, &rate);
+    failures += rate.spreading_factor != BASE_SF;
+
+    printf("overheard offers and answers: %s\n", failures == 0 ? "ignored" : "FAILED");
+    return failures;
+}
+
+static double airtimePerByte(const run_result *result){
+
+    return result->text_bytes > 0 ? (double)result->airtime_us / 1000.0 / (double)result->text_bytes : INFINITY;
+}
+
+int main(int argc, char **argv){
+
+    int messages = argc > 1 ? atoi(argv[1]) : 200;
+    loadCorpus(argc > 2 ? argv[2] : "testplayground/chat_corpus.txt");
+
+    // The radio configuration is the base rate of the adaptive runs
+    sx1278_config_t radio = SX1278_CONFIG_DEFAULT;
+    radio.spreading_factor = BASE_SF;
+    if(!sx1278_init(&radio)){
+        return 1;
+    }
+
+    uint8_t key[AEAD_KEY_SIZE];
+    for(size_t index = 0; index < sizeof(key); index++){
+        key[index] = (uint8_t)(index * 7 + 1);
+    }
+    setEncryptionKey(key);
+
+    const link_config adaptive = LINK_CONFIG_DEFAULT;
+    const uint8_t fixed_rates[] = { 7, 10, 12 };
+    int failures = overheardCheck();
+
+    printf("\n%d messages per scenario (half chat lines, half 279 random chars), base SF%d\n\n",
+           messages, BASE_SF);
+    printf("scenario  mode      delivered  failed  avg SF  changes  fallbacks  airtime ms/byte\n");
+
+    for(int which = 0; which < SCENARIO_COUNT; which++){
+        run_result adr = runScenario((scenario)which, &adaptive, messages);
+        printf("%-8s  adaptive  %9u  %6u  %6.2f  %7u  %9u  %15.2f\n", scenario_names[which],
+               adr.delivered, adr.failed, adr.fragments ? (double)adr.fragment_sf_sum / adr.fragments : 0.0,
+               adr.rate_changes, adr.fallbacks, airtimePerByte(&adr));
+        failures += adr.corrupted;
+
+        run_result fixed[sizeof(fixed_rates)];
+        for(size_t rate = 0; rate < sizeof(fixed_rates); rate++){
+            link_config config = LINK_CONFIG_DEFAULT;
+            config.base = (sx1278_rate_t){ fixed_rates[rate], 5 };
+            config.min_spreading_factor = fixed_rates[rate];
+            config.max_spreading_factor = fixed_rates[rate];
+            config.loss_low = 2.0f; // never raises the coding rate
+            fixed[rate] = runScenario((scenario)which, &config, messages);
+            printf("%-8s  SF%-2u      %9u  %6u  %6.2f  %7s  %9s  %15.2f\n", "", fixed_rates[rate],
+                   fixed[rate].delivered, fixed[rate].failed, (double)fixed_rates[rate], "-", "-",
+                   airtimePerByte(&fixed[rate]));
+            failures += fixed[rate].corrupted;
+        }
+        printf("\n");
+
+        // As reliable as the base rate and no costlier (the rate trailer and
+        // a higher coding rate may cost a little where base is all there
+        // is); close to SF7 where SF7 works
+        const run_result *base = &fixed[sizeof(fixed_rates) - 1];
+        failures += adr.delivered + messages / 50 < base->delivered;
+        failures += airtimePerByte(&adr) > 1.05 * airtimePerByte(base);
+        if(which == SCENARIO_NEAR){
+            failures += airtimePerByte(&adr) > 1.5 * airtimePerByte(&fixed[0]);
+        }
+        // The obstacle must have sent it back to base
+        if(which == SCENARIO_DROP){
+            failures += adr.fallbacks == 0;
+        }
+    }
+
+    sx1278_stop();
+    printf("%s\n", failures == 0 ? "OK" : "FAILURES");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/*
+ * Transmitter pipeline benchmark: encryption vs the other stages
+ * --------------------------------------------------------------
+ *
+ * Measures, for a few payload sizes, the CPU cost of each stage a
+ * message goes through in encodeMessage:
+ *
+ *   compress   huffman_codec (compress.h)
+ *   encrypt    aeadSeal in place (aead.h), software backend on the host
+ *   frame      packetEncode, i.e. header + CRC (packet.h)
+ *
+ * plus streaming encryption of a long buffer in small chunks. Output is
+ * bytes/s and cycles/byte (TSC on x86-64; elsewhere only bytes/s), and
+ * the slowest CPU stage for each size is marked.
+ *
+ * Each size also prints the time the frame needs on air at the fastest
+ * LoRa setting we use (SF7, 125 kHz, CR 4/5, ~5.47 kbit/s). That is the
+ * stage encryption has to stay well below: even on the ESP32 (roughly
+ * 10x slower per byte than a desktop core) it is microseconds against
+ * milliseconds.
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/aead_bench \
+ *       testplayground/aead_bench.c src/aead.c src/compress.c src/packet.c
+ *
+ * Usage:
+ *   ./testplayground/aead_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+#endif
+
+#include "aead.h"
+#include "compress.h"
+#include "packet.h"
+
+#define STAGE_COUNT 3
+#define STREAM_SIZE 4096
+#define STREAM_CHUNK 37 // deliberately not a multiple of any block size
+
+// LoRa bit rate: SF * BW / 2^SF * CR = 7 * 125000 / 128 * 4 / 5
+#define LORA_SF7_BITS_PER_SECOND 5468.75
+
+typedef struct{
+
+    double seconds;
+    unsigned long long cycles;
+
+} measurement;
+
+static const char *stage_names[STAGE_COUNT] = { "compress", "encrypt", "frame" };
+
+static uint8_t key[AEAD_KEY_SIZE];
+static uint8_t nonce[AEAD_NONCE_SIZE];
+
+static double nowSeconds(void){
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static unsigned long long nowCycles(void){
+
+#ifdef HAVE_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Chat-like text of the requested size
+static void fillMessage(uint8_t *message, size_t length){
+
+    static const char sample[] = "vale, nos vemos en la plaza a las cinco y media. ok see you there! ";
+    for(size_t index = 0; index < length; index++){
+        message[index] = (uint8_t)sample[index % (sizeof(sample) - 1)];
+    }
+}
+
+static measurement runStage(int stage, const uint8_t *message, size_t length, int iterations){
+
+    uint8_t work[PACKET_MAX_SIZE + AEAD_TAG_SIZE];
+    uint8_t frame[PACKET_MAX_SIZE] = {0};
+    uint8_t tag[AEAD_TAG_SIZE];
+    size_t output_length = 0;
+    packet_header header = { PACKET_VERSION, PACKET_TYPE_DATA, PACKET_FLAG_NONE, 1, 2, 0 };
+    volatile uint8_t sink = 0;
+
+    memcpy(work, message, length);
+
+    double start_seconds = nowSeconds();
+    unsigned long long start_cycles = nowCycles();
+
+    for(int iteration = 0; iteration < iterations; iteration++){
+        switch(stage){
+        case 0:
+            huffmanCompress(message, length, work, sizeof(work), &output_length);
+            break;
+        case 1:
+            // Encrypting the previous ciphertext again is fine for timing
+            aeadSeal(key, nonce, frame, 6, work, length, tag);
+            break;
+        default:
+            packetEncode(&header, message, length, frame, sizeof(frame), &output_length);
+            break;
+        }
+        sink ^= work[0] ^ frame[0];
+    }
+
+    measurement result = { nowSeconds() - start_seconds, nowCycles() - start_cycles };
+    (void)sink;
+    return result;
+}
+
+static void printMeasurement(const char *name, size_t length, int iterations, measurement result, int slowest){
+
+    double bytes = (double)length * iterations;
+
+    printf("  %-10s %10.1f MB/s", name, bytes / result.seconds / 1e6);
+#ifdef HAVE_CYCLE_COUNTER
+    printf(" %8.2f cycles/byte", (double)result.cycles / bytes);
+#endif
+    printf("%s\n", slowest ? "   <- slowest" : "");
+}
+
+int main(int argc, char **argv){
+
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    static const size_t sizes[] = { 16, 64, 128, 200 };
+    uint8_t message[PACKET_MAX_SIZE];
+
+    for(size_t index = 0; index < sizeof(key); index++){
+        key[index] = (uint8_t)(index * 29 + 3);
+    }
+    aeadBuildNonce(nonce, 1, 0, PACKET_TYPE_DATA);
+
+    printf("AEAD backend: %s\n", aeadBackendName());
+#ifndef HAVE_CYCLE_COUNTER
+    printf("(no cycle counter on this host, only bytes/s)\n");
+#endif
+
+    for(size_t size_index = 0; size_index < sizeof(sizes) / sizeof(sizes[0]); size_index++){
+        size_t length = sizes[size_index];
+        measurement results[STAGE_COUNT];
+        int slowest = 0;
+
+        fillMessage(message, length);
+        for(int stage = 0; stage < STAGE_COUNT; stage++){
+            results[stage] = runStage(stage, message, length, iterations);
+            if(results[stage].seconds > results[slowest].seconds){
+                slowest = stage;
+            }
+        }
+
+        printf("\n%zu byte message:\n", length);
+        for(int stage = 0; stage < STAGE_COUNT; stage++){
+            printMeasurement(stage_names[stage], length, iterations, results[stage], stage == slowest);
+        }
+        printf("  encrypt %10.2f us per message, on air %8.1f ms (SF7 125 kHz, payload only)\n",
+               results[1].seconds / iterations * 1e6, length * 8 / LORA_SF7_BITS_PER_SECOND * 1e3);
+    }
+
+    // Long message through the streaming interface, small uneven chunks
+    static uint8_t stream[STREAM_SIZE];
+    uint8_t tag[AEAD_TAG_SIZE];
+    int stream_iterations = iterations / 50 > 0 ? iterations / 50 : 1;
+    fillMessage(stream, sizeof(stream));
+
+    double start_seconds = nowSeconds();
+    unsigned long long start_cycles = nowCycles();
+    for(int iteration = 0; iteration < stream_iterations; iteration++){
+        aead_context context;
+        aeadStart(&context, key, nonce, true);
+        for(size_t offset = 0; offset < sizeof(stream); offset += STREAM_CHUNK){
+            size_t chunk = sizeof(stream) - offset < STREAM_CHUNK ? sizeof(stream) - offset : STREAM_CHUNK;
+            aeadUpdate(&context, &stream[offset], chunk);
+        }
+        aeadFinishEncrypt(&context, tag);
+    }
+    measurement stream_result = { nowSeconds() - start_seconds, nowCycles() - start_cycles };
+
+    printf("\n%d byte stream in %d byte chunks:\n", STREAM_SIZE, STREAM_CHUNK);
+    printMeasurement("encrypt", sizeof(stream), stream_iterations, stream_result, 0);
+    return 0;
+}
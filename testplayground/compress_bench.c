@@ -0,0 +1,142 @@
+/*
+ * Compression stage benchmark
+ * ---------------------------
+ *
+ * Runs every line of a corpus (one chat message per line) through the
+ * compression stage exactly like encodeMessage does: compress, keep the
+ * result only if it is smaller, otherwise send raw text. Every message is
+ * decompressed again and compared with the original.
+ *
+ * Reports the overall ratio (payload bytes on air / raw bytes), how many
+ * messages fell back to raw text and encode/decode throughput.
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/compress_bench \
+ *       testplayground/compress_bench.c src/compress.c src/packet.c
+ *
+ * Usage:
+ *   ./testplayground/compress_bench [corpus.txt] [iterations]
+ *
+ * Note: measuring on the training corpus is optimistic; pass a different
+ * file to see how the model does on unseen text.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "compress.h"
+#include "packet.h"
+
+#define MAX_MESSAGES 4096
+#define LINE_SIZE 512
+
+static char *messages[MAX_MESSAGES];
+static size_t message_lengths[MAX_MESSAGES];
+
+static double nowSeconds(void){
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+
+    const char *path = argc > 1 ? argv[1] : "testplayground/chat_corpus.txt";
+    int iterations = argc > 2 ? atoi(argv[2]) : 2000;
+    const compression_codec *codec = &huffman_codec;
+
+    FILE *corpus = fopen(path, "rb");
+    if(corpus == NULL){
+        perror(path);
+        return 1;
+    }
+
+    int message_count = 0;
+    char line[LINE_SIZE];
+    while(message_count < MAX_MESSAGES && fgets(line, sizeof(line), corpus) != NULL){
+        // '\n' is kept: getMessage keeps it too
+        size_t length = strlen(line);
+        messages[message_count] = malloc(length);
+        memcpy(messages[message_count], line, length);
+        message_lengths[message_count] = length;
+        message_count++;
+    }
+    fclose(corpus);
+
+    // Ratio and correctness (single pass)
+    size_t raw_bytes = 0, sent_bytes = 0;
+    int raw_fallbacks = 0;
+    uint8_t compressed[PACKET_MAX_SIZE];
+    uint8_t restored[LINE_SIZE];
+
+    for(int index = 0; index < message_count; index++){
+        size_t compressed_length = 0, restored_length = 0;
+        raw_bytes += message_lengths[index];
+
+        int error = codec->compress((const uint8_t *)messages[index], message_lengths[index],
+                                    compressed, sizeof(compressed), &compressed_length);
+        if(error != COMPRESS_OK || compressed_length >= message_lengths[index]){
+            raw_fallbacks++;
+            sent_bytes += message_lengths[index];
+            continue;
+        }
+        sent_bytes += compressed_length;
+
+        error = codec->decompress(compressed, compressed_length, restored, sizeof(restored), &restored_length);
+        if(error != COMPRESS_OK || restored_length != message_lengths[index] ||
+           memcmp(restored, messages[index], restored_length) != 0){
+            fprintf(stderr, "round trip failed on line %d (error %d)\n", index + 1, error);
+            return 1;
+        }
+    }
+
+    // Throughput: the whole corpus, 'iterations' times
+    double start = nowSeconds();
+    size_t checksum = 0;
+    for(int iteration = 0; iteration < iterations; iteration++){
+        for(int index = 0; index < message_count; index++){
+            size_t compressed_length = 0;
+            codec->compress((const uint8_t *)messages[index], message_lengths[index],
+                            compressed, sizeof(compressed), &compressed_length);
+            checksum += compressed_length;
+        }
+    }
+    double encode_seconds = nowSeconds() - start;
+
+    // Decode throughput over pre-compressed copies
+    static uint8_t encoded[MAX_MESSAGES][PACKET_MAX_SIZE];
+    static size_t encoded_lengths[MAX_MESSAGES];
+    for(int index = 0; index < message_count; index++){
+        codec->compress((const uint8_t *)messages[index], message_lengths[index],
+                        encoded[index], PACKET_MAX_SIZE, &encoded_lengths[index]);
+    }
+    start = nowSeconds();
+    for(int iteration = 0; iteration < iterations; iteration++){
+        for(int index = 0; index < message_count; index++){
+            size_t restored_length = 0;
+            codec->decompress(encoded[index], encoded_lengths[index], restored, sizeof(restored), &restored_length);
+            checksum += restored[0];
+        }
+    }
+    double decode_seconds = nowSeconds() - start;
+
+    double megabytes = (double)raw_bytes * iterations / 1e6;
+
+    printf("codec            %s\n", codec->name);
+    printf("corpus           %s (%d messages, %zu bytes)\n", path, message_count, raw_bytes);
+    printf("payload on air   %zu bytes (ratio %.3f, %.2f bits/char)\n",
+           sent_bytes, (double)sent_bytes / raw_bytes, 8.0 * sent_bytes / raw_bytes);
+    printf("raw fallbacks    %d\n", raw_fallbacks);
+    printf("encode           %.1f MB/s\n", megabytes / encode_seconds);
+    printf("decode           %.1f MB/s\n", megabytes / decode_seconds);
+    printf("(checksum %zu)\n", checksum);
+
+    for(int index = 0; index < message_count; index++){
+        free(messages[index]);
+    }
+    return 0;
+}
@@ -0,0 +1,264 @@
+/*
+ * Known-answer tests of the crypto primitives
+ * -------------------------------------------
+ *
+ * Runs the published test vectors through the code the transmitter and
+ * the sessions use, so a wrong round, limb or padding fails here instead
+ * of as frames two builds cannot open:
+ *
+ *   AEAD     the compiled backend (aead.h): ChaCha20-Poly1305 against
+ *            RFC 8439 section 2.8.2, or AES-256-GCM against test case 16
+ *            of the GCM specification (McGrew and Viega, 256-bit key,
+ *            96-bit IV). One shot and in odd-sized streaming chunks, and
+ *            the vector with one bit of the tag flipped must not open.
+ *   X25519   RFC 7748 sections 5.2 (two scalar multiplications, 1 and
+ *            1000 iterations) and 6.1 (Alice and Bob).
+ *   SHA-256  FIPS 180-4 "abc".
+ *   HMAC     RFC 4231 test cases 1, 2 and 6 (SHA-256).
+ *   HKDF     RFC 5869 test cases 1, 2 (info longer than a block) and 3.
+ *
+ * The host build runs the software backend. Built with -DESP_PLATFORM
+ * against mbedtls 3 (the API ESP-IDF ships), AEAD_USE_AES_GCM is set and
+ * the AES-256-GCM vector runs instead.
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/crypto_kat \
+ *       testplayground/crypto_kat.c src/aead.c src/x25519.c src/sha256.c
+ *
+ * Usage:
+ *   ./testplayground/crypto_kat
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aead.h"
+#include "sha256.h"
+#include "x25519.h"
+
+#define MAX_VECTOR 128
+
+static int failures = 0;
+
+static size_t fromHex(const char *hex, uint8_t *bytes){
+
+    size_t length = 0;
+    for(; hex[0] != '\0' && hex[1] != '\0'; hex += 2){
+        unsigned value;
+        sscanf(hex, "%2x", &value);
+        bytes[length++] = (uint8_t)value;
+    }
+    return length;
+}
+
+static void check(const char *name, const uint8_t *got, const char *expected_hex){
+
+    uint8_t expected[MAX_VECTOR];
+    size_t length = fromHex(expected_hex, expected);
+    bool same = memcmp(got, expected, length) == 0;
+    printf("%-36s %s\n", name, same ? "ok" : "MISMATCH");
+    failures += !same;
+}
+
+typedef struct{
+
+    const char *name;
+    const char *key;
+    const char *nonce;
+    const char *aad;
+    const char *plaintext;      // hex
+    const char *ciphertext;
+    const char *tag;
+
+} aead_vector;
+
+#ifdef AEAD_USE_AES_GCM
+static const aead_vector aead_kat = {
+    "AES-256-GCM (GCM spec case 16)",
+    "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+    "cafebabefacedbaddecaf888",
+    "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+    "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+    "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+    "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+    "76fc6ece0f4e1768cddf8853bb2d551b",
+};
+#else
+// "Ladies and Gentlemen of the class of '99: If I could offer you only one
+// tip for the future, sunscreen would be it."
+static const aead_vector aead_kat = {
+    "ChaCha20-Poly1305 (RFC 8439 2.8.2)",
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f",
+    "070000004041424344454647",
+    "50515253c0c1c2c3c4c5c6c7",
+    "4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+    "73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+    "6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+    "637265656e20776f756c642062652069742e",
+    "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+    "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+    "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+    "3ff4def08e4b7a9de576d26586cec64b6116",
+    "1ae10b594f09e26a7e902ecbd0600691",
+};
+#endif
+
+static void aeadKat(const aead_vector *vector){
+
+    uint8_t key[AEAD_KEY_SIZE], nonce[AEAD_NONCE_SIZE], aad[MAX_VECTOR];
+    uint8_t plaintext[MAX_VECTOR], data[MAX_VECTOR], tag[AEAD_TAG_SIZE], expected_tag[AEAD_TAG_SIZE];
+    char name[64];
+
+    fromHex(vector->key, key);
+    fromHex(vector->nonce, nonce);
+    size_t aad_length = fromHex(vector->aad, aad);
+    size_t length = fromHex(vector->plaintext, plaintext);
+    fromHex(vector->tag, expected_tag);
+
+    // One shot
+    memcpy(data, plaintext, length);
+    failures += aeadSeal(key, nonce, aad, aad_length, data, length, tag) != AEAD_OK;
+    snprintf(name, sizeof(name), "%s", vector->name);
+    check(name, data, vector->ciphertext);
+    check("  tag", tag, vector->tag);
+
+    bool opened = aeadOpen(key, nonce, aad, aad_length, data, length, expected_tag) == AEAD_OK &&
+                  memcmp(data, plaintext, length) == 0;
+    printf("%-36s %s\n", "  open", opened ? "ok" : "MISMATCH");
+    failures += !opened;
+
+    // Streaming in chunks that straddle the 16 and 64 byte blocks
+    aead_context context;
+    memcpy(data, plaintext, length);
+    failures += aeadStart(&context, key, nonce, true) != AEAD_OK;
+    failures += aeadAddAad(&context, aad, 5) != AEAD_OK;
+    failures += aeadAddAad(&context, &aad[5], aad_length - 5) != AEAD_OK;
+    for(size_t offset = 0, chunk = 1; offset < length; offset += chunk, chunk = chunk * 3 % 37 + 1){
+        size_t step = length - offset < chunk ? length - offset : chunk;
+        failures += aeadUpdate(&context, &data[offset], step) != AEAD_OK;
+    }
+    failures += aeadFinishEncrypt(&context, tag) != AEAD_OK;
+    check("  streaming", data, vector->ciphertext);
+    check("  streaming tag", tag, vector->tag);
+
+    // One bit off in the tag: refused, and no plaintext left behind
+    expected_tag[0] ^= 0x01;
+    bool refused = aeadOpen(key, nonce, aad, aad_length, data, length, expected_tag) == AEAD_ERROR_AUTHENTICATION;
+    for(size_t index = 0; index < length; index++){
+        refused &= data[index] == 0;
+    }
+    printf("%-36s %s\n", "  forged tag", refused ? "refused" : "ACCEPTED");
+    failures += !refused;
+}
+
+static void x25519Kat(void){
+
+    uint8_t scalar[X25519_KEY_SIZE], point[X25519_KEY_SIZE], out[X25519_KEY_SIZE];
+
+    fromHex("a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4", scalar);
+    fromHex("e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c", point);
+    x25519(out, scalar, point);
+    check("X25519 (RFC 7748 5.2, vector 1)", out, "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552");
+
+    // The top bit of u must be ignored
+    fromHex("4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d", scalar);
+    fromHex("e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493", point);
+    x25519(out, scalar, point);
+    check("X25519 (RFC 7748 5.2, vector 2)", out, "95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957");
+
+    // k = u = 9, then k, u = X25519(k, u), k
+    uint8_t k[X25519_KEY_SIZE] = { 9 }, u[X25519_KEY_SIZE] = { 9 };
+    for(int iteration = 1; iteration <= 1000; iteration++){
+        x25519(out, k, u);
+        memcpy(u, k, sizeof(u));
+        memcpy(k, out, sizeof(k));
+        if(iteration == 1){
+            check("X25519 (RFC 7748 5.2, 1 iteration)", k,
+                  "422c8e7a6227d7bca1350b3e2bb7279f7897b87bb6854b783c60e80311ae3079");
+        }
+    }
+    check("X25519 (RFC 7748 5.2, 1000 it.)", k, "684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51");
+
+    uint8_t alice[X25519_KEY_SIZE], bob[X25519_KEY_SIZE], alice_public[X25519_KEY_SIZE], bob_public[X25519_KEY_SIZE];
+    fromHex("77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a", alice);
+    fromHex("5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb", bob);
+    x25519PublicKey(alice_public, alice);
+    x25519PublicKey(bob_public, bob);
+    check("X25519 (RFC 7748 6.1, Alice public)", alice_public,
+          "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a");
+    check("X25519 (RFC 7748 6.1, Bob public)", bob_public,
+          "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f");
+    x25519(out, alice, bob_public);
+    check("X25519 (RFC 7748 6.1, Alice shared)", out, "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742");
+    x25519(out, bob, alice_public);
+    check("X25519 (RFC 7748 6.1, Bob shared)", out, "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742");
+}
+
+static void hashKat(void){
+
+    uint8_t digest[SHA256_DIGEST_SIZE], key[131], output[42];
+    sha256_context context;
+
+    sha256Start(&context);
+    sha256Update(&context, (const uint8_t *)"abc", 3);
+    sha256Finish(&context, digest);
+    check("SHA-256 (FIPS 180-4, \"abc\")", digest, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    memset(key, 0x0b, 20);
+    hmacSha256(key, 20, (const uint8_t *)"Hi There", 8, digest);
+    check("HMAC-SHA256 (RFC 4231 case 1)", digest, "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+
+    const char *question = "what do ya want for nothing?";
+    hmacSha256((const uint8_t *)"Jefe", 4, (const uint8_t *)question, strlen(question), digest);
+    check("HMAC-SHA256 (RFC 4231 case 2)", digest, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+    // Key longer than a block: hashed first
+    const char *long_key_data = "Test Using Larger Than Block-Size Key - Hash Key First";
+    memset(key, 0xaa, sizeof(key));
+    hmacSha256(key, sizeof(key), (const uint8_t *)long_key_data, strlen(long_key_data), digest);
+    check("HMAC-SHA256 (RFC 4231 case 6)", digest, "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+
+    uint8_t input_key[22], salt[13], info[10];
+    memset(input_key, 0x0b, sizeof(input_key));
+    for(size_t index = 0; index < sizeof(salt); index++){
+        salt[index] = (uint8_t)index;
+    }
+    for(size_t index = 0; index < sizeof(info); index++){
+        info[index] = (uint8_t)(0xf0 + index);
+    }
+    hkdfSha256(salt, sizeof(salt), input_key, sizeof(input_key), info, sizeof(info), output, sizeof(output));
+    check("HKDF-SHA256 (RFC 5869 case 1)", output,
+          "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865");
+
+    // 80 byte salt, input and info: info longer than a hash block
+    uint8_t long_input[80], long_salt[80], long_info[80], long_output[82];
+    for(size_t index = 0; index < 80; index++){
+        long_input[index] = (uint8_t)index;
+        long_salt[index] = (uint8_t)(0x60 + index);
+        long_info[index] = (uint8_t)(0xb0 + index);
+    }
+    hkdfSha256(long_salt, sizeof(long_salt), long_input, sizeof(long_input), long_info, sizeof(long_info),
+               long_output, sizeof(long_output));
+    check("HKDF-SHA256 (RFC 5869 case 2)", long_output,
+          "b11e398dc80327a1c8e7f78c596a49344f012eda2d4efad8a050cc4c19afa97c59045a99cac7827271cb41c65e590e09da"
+          "3275600c2f09b8367793a9aca3db71cc30c58179ec3e87c14c01d5c1f3434f1d87");
+
+    // No salt (a block of zeros) and no info
+    hkdfSha256(NULL, 0, input_key, sizeof(input_key), NULL, 0, output, sizeof(output));
+    check("HKDF-SHA256 (RFC 5869 case 3)", output,
+          "8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d9d201395faa4b61a96c8");
+}
+
+int main(void){
+
+    printf("AEAD backend: %s\n\n", aeadBackendName());
+    aeadKat(&aead_kat);
+    x25519Kat();
+    hashKat();
+
+    printf("\n%s\n", failures == 0 ? "OK" : "FAILURES");
+    return failures == 0 ? 0 : 1;
+}
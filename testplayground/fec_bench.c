@@ -0,0 +1,333 @@
+/*
+ * Forward error correction for fragmented messages
+ * ------------------------------------------------
+ *
+ *   1. Round trip: for every data count and parity count that fits in
+ *      FRAGMENT_MAX_COUNT fragments, random sets of exactly data-count
+ *      shards must give the data back (fecEncode, fecRecover).
+ *   2. Kernels: MB/s of fecMulAdd, of encoding every parity shard of a
+ *      message and of rebuilding it with as many shards lost as it has
+ *      parity, at the shard sizes the fragment layer uses.
+ *   3. Channel: 300 byte message frames between two nodes through the
+ *      fragment layer (fragment.h), every frame (fragments and ACKs) lost
+ *      at random. For each loss rate and parity count: messages rebuilt
+ *      from the first round alone, without any retransmission, rounds
+ *      and frames per message, channel time per message and latency (from
+ *      the first fragment until the message is rebuilt) at SF10.
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/fec_bench \
+ *       testplayground/fec_bench.c src/fec.c src/fragment.c src/packet.c src/sha256.c \
+ *       src/sx1278.c src/sx1278_sim.c -pthread -lm
+ *
+ * Usage:
+ *   ./testplayground/fec_bench [messages]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fec.h"
+#include "fragment.h"
+#include "sx1278.h"
+
+#define MESSAGE_PAYLOAD      290     // message frames of about 300 bytes
+#define MAX_FRAME            64
+#define ACK_MARGIN_US        (250 * 1000)
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+static double nextRandom(void){
+
+    // xorshift64*: same sequence on every run
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (double)((random_state * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static double seconds(void){
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Encodes every parity shard, keeps a random data-count of all shards and rebuilds
+static bool roundTrip(size_t data_count, size_t parity_count, size_t shard_size){
+
+    static uint8_t data[FEC_MAX_SHARDS * PACKET_MAX_SIZE];
+    static uint8_t parity[FEC_MAX_SHARDS][PACKET_MAX_SIZE];
+    static uint8_t shards[FEC_MAX_SHARDS * PACKET_MAX_SIZE];
+    size_t data_length = data_count * shard_size - (size_t)(nextRandom() * shard_size); // last shard short
+    for(size_t index = 0; index < data_length; index++){
+        data[index] = (uint8_t)(nextRandom() * 256);
+    }
+    for(size_t index = 0; index < parity_count; index++){
+        fecEncode(data, data_length, shard_size, index, parity[index]);
+    }
+
+    // A random data-count of the shards arrive
+    uint8_t order[FEC_MAX_SHARDS];
+    size_t total = data_count + parity_count;
+    for(size_t index = 0; index < total; index++){
+        order[index] = (uint8_t)index;
+    }
+    for(size_t index = total - 1; index > 0; index--){
+        size_t other = (size_t)(nextRandom() * (index + 1));
+        uint8_t swap = order[index];
+        order[index] = order[other];
+        order[other] = swap;
+    }
+
+    // Same placement as the reassembler: data in its own slot, parity in a free one
+    uint8_t held[FEC_MAX_SHARDS];
+    uint32_t slots = 0;
+    memset(shards, 0, data_count * shard_size);
+    for(size_t index = 0; index < data_count; index++){
+        if(order[index] < data_count){
+            slots |= 1u << order[index];
+        }
+    }
+    for(size_t index = 0; index < data_count; index++){
+        uint8_t shard = order[index];
+        size_t slot = shard;
+        const uint8_t *source = parity[shard >= data_count ? shard - data_count : 0];
+        if(shard < data_count){
+            source = &data[shard * shard_size];
+        } else {
+            for(slot = 0; slots & (1u << slot); slot++){
+            }
+            slots |= 1u << slot;
+        }
+        size_t length = shard_size;
+        if(shard < data_count && (shard + 1) * shard_size > data_length){
+            length = data_length - shard * shard_size;
+        }
+        memcpy(&shards[slot * shard_size], source, length);
+        held[slot] = shard;
+    }
+
+    return fecRecover(shards, shard_size, data_count, held) && memcmp(shards, data, data_length) == 0;
+}
+
+static int checkRoundTrip(void){
+
+    int failures = 0, trials = 0;
+    for(size_t data_count = 1; data_count < FRAGMENT_MAX_COUNT; data_count++){
+        for(size_t parity_count = 1; data_count + parity_count <= FRAGMENT_MAX_COUNT; parity_count++){
+            for(int trial = 0; trial < 50; trial++){
+                size_t shard_size = 1 + (size_t)(nextRandom() * 250);
+                failures += !roundTrip(data_count, parity_count, shard_size);
+                trials++;
+            }
+        }
+    }
+    printf("round trip: %d random erasure patterns, every data count and parity count: %d failed\n\n",
+           trials, failures);
+    return failures;
+}
+
+static void measureKernels(void){
+
+    static uint8_t data[FEC_MAX_SHARDS * PACKET_MAX_SIZE];
+    static uint8_t parity[FEC_MAX_SHARDS][PACKET_MAX_SIZE];
+    static uint8_t shards[FEC_MAX_SHARDS * PACKET_MAX_SIZE];
+    for(size_t index = 0; index < sizeof(data); index++){
+        data[index] = (uint8_t)(nextRandom() * 256);
+    }
+
+    printf("kernel                                  MB/s\n");
+    double start = seconds();
+    size_t bytes = 0;
+    for(int round = 0; bytes < 200u * 1000 * 1000; round++){
+        fecMulAdd(parity[0], data, (uint8_t)(2 + round % 250), 240);
+        bytes += 240;
+    }
+    printf("fecMulAdd, 240 byte shards        %10.1f\n", bytes / (seconds() - start) / 1e6);
+
+    // Shapes the fragment layer produces: a 300 byte message in 64 and in 255 byte frames
+    const size_t shapes[][3] = { { 6, 50, 4 }, { 2, 150, 2 }, { 12, 25, 4 } };
+    for(size_t shape = 0; shape < sizeof(shapes) / sizeof(shapes[0]); shape++){
+        size_t data_count = shapes[shape][0], shard_size = shapes[shape][1], parity_count = shapes[shape][2];
+        size_t data_length = data_count * shard_size;
+
+        start = seconds();
+        bytes = 0;
+        while(bytes < 100u * 1000 * 1000){
+            for(size_t index = 0; index < parity_count; index++){
+                fecEncode(data, data_length, shard_size, index, parity[index]);
+            }
+            bytes += data_length;
+        }
+        double encode = bytes / (seconds() - start) / 1e6;
+
+        // The first parity_count data shards lost, the parity in their place
+        uint8_t held[FEC_MAX_SHARDS];
+        start = seconds();
+        bytes = 0;
+        while(bytes < 100u * 1000 * 1000){
+            memcpy(shards, data, data_length);
+            for(size_t slot = 0; slot < data_count; slot++){
+                held[slot] = (uint8_t)slot;
+            }
+            for(size_t index = 0; index < parity_count; index++){
+                memcpy(&shards[index * shard_size], parity[index], shard_size);
+                held[index] = (uint8_t)(data_count + index);
+            }
+            fecRecover(shards, shard_size, data_count, held);
+            bytes += data_length;
+        }
+        double recover = bytes / (seconds() - start) / 1e6;
+        printf("%2zu+%zu x %3zu bytes: encode            %10.1f\n", data_count, parity_count, shard_size, encode);
+        printf("%2zu+%zu x %3zu bytes: rebuild %zu lost    %10.1f\n", data_count, parity_count, shard_size,
+               parity_count, recover);
+    }
+    printf("\n");
+}
+
+typedef struct{
+
+    uint32_t delivered;
+    uint32_t first_round;       // rebuilt before any retransmission
+    uint32_t corrupted;
+    uint32_t failed;
+    uint32_t rounds;
+    uint32_t frames;            // both directions
+    double channel_us;
+    double latency_us;          // of the messages rebuilt
+    size_t message_length;
+
+} run_result;
+
+static run_result runChannel(double loss, size_t parity_count, int messages){
+
+    run_result result = {0};
+    static fragment_sender transfer;
+    static fragment_reassembler reassembly;
+    memset(&transfer, 0, sizeof(transfer));
+    fragmentReassemblerInit(&reassembly, 2);
+    random_state = 0x9E3779B97F4A7C15ULL;
+    uint32_t ack_airtime = sx1278_airtime_us(PACKET_FIXED_SIZE + 4 + FRAGMENT_ACK_PAYLOAD_SIZE + PACKET_CRC_SIZE);
+
+    for(int index = 0; index < messages; index++){
+        // Random payload: a sealed message does not look any different
+        uint8_t payload[MESSAGE_PAYLOAD];
+        uint8_t message_frame[PACKET_MAX_MESSAGE_SIZE];
+        size_t message_length = 0;
+        packet_header header = { PACKET_VERSION, PACKET_TYPE_DATA, PACKET_FLAG_ENCRYPTED, 1, 2, (uint32_t)index };
+        for(size_t byte = 0; byte < sizeof(payload); byte++){
+            payload[byte] = (uint8_t)(nextRandom() * 256);
+        }
+        packetEncode(&header, payload, sizeof(payload), message_frame, sizeof(message_frame), &message_length);
+        result.message_length = message_length;
+        if(fragmentSenderStart(&transfer, message_frame, message_length, MAX_FRAME, parity_count) != FRAGMENT_OK){
+            result.failed++;
+            continue;
+        }
+
+        bool rebuilt = false;
+        double start_us = result.channel_us;
+        while(transfer.state == FRAGMENT_SENDING || transfer.state == FRAGMENT_WAITING_ACK){
+            uint8_t acks[FRAGMENT_MAX_COUNT][PACKET_MAX_SIZE];
+            size_t ack_lengths[FRAGMENT_MAX_COUNT];
+            int ack_count = 0;
+            bool first_round = transfer.rounds == 0;
+            result.rounds++;
+
+            // One round, then the ACKs it drew (the sender is half duplex)
+            uint8_t frame[PACKET_MAX_SIZE];
+            size_t frame_length = 0;
+            while(fragmentSenderNext(&transfer, frame, sizeof(frame), &frame_length)){
+                result.frames++;
+                result.channel_us += sx1278_airtime_us(frame_length);
+                if(nextRandom() < loss){
+                    continue;
+                }
+
+                uint8_t message[PACKET_MAX_MESSAGE_SIZE];
+                size_t length = 0, ack_length = 0;
+                fragmentReceive(&reassembly, frame, frame_length, (int64_t)result.channel_us,
+                                message, sizeof(message), &length,
+                                acks[ack_count], sizeof(acks[0]), &ack_length);
+                if(length > 0 && !rebuilt){
+                    rebuilt = true;
+                    result.first_round += first_round;
+                    result.latency_us += result.channel_us - start_us;
+                    result.corrupted += length != message_length || memcmp(message, message_frame, length) != 0;
+                }
+                if(ack_length > 0){
+                    result.frames++;
+                    result.channel_us += ack_airtime;
+                    if(nextRandom() >= loss && ack_count < FRAGMENT_MAX_COUNT - 1){
+                        ack_lengths[ack_count++] = ack_length;
+                    }
+                }
+            }
+
+            if(ack_count == 0){
+                result.channel_us += ack_airtime + ACK_MARGIN_US;
+                fragmentSenderTimeout(&transfer);
+                continue;
+            }
+            for(int ack = 0; ack < ack_count && transfer.state != FRAGMENT_DELIVERED; ack++){
+                fragmentSenderHandleAck(&transfer, acks[ack], ack_lengths[ack]);
+            }
+        }
+        result.delivered += transfer.state == FRAGMENT_DELIVERED;
+        result.failed += transfer.state == FRAGMENT_FAILED;
+    }
+    return result;
+}
+
+int main(int argc, char **argv){
+
+    int messages = argc > 1 ? atoi(argv[1]) : 2000;
+
+    sx1278_config_t config = SX1278_CONFIG_DEFAULT;
+    config.spreading_factor = 10;
+    if(!sx1278_init(&config)){
+        return 1;
+    }
+
+    printf("\n");
+    int failures = checkRoundTrip();
+    measureKernels();
+
+    const double losses[] = { 0.0, 0.05, 0.10, 0.20, 0.30 };
+    const size_t parities[] = { 0, 2, 4 };
+    printf("%d messages of %zu bytes in %d byte frames, SF10\n", messages,
+           runChannel(0.0, 0, 1).message_length, MAX_FRAME);
+    printf("loss  parity  delivered  first round  rounds/msg  frames/msg  airtime s/msg  latency s\n");
+    for(size_t loss = 0; loss < sizeof(losses) / sizeof(losses[0]); loss++){
+        double plain_latency = 0;
+        for(size_t parity = 0; parity < sizeof(parities) / sizeof(parities[0]); parity++){
+            run_result result = runChannel(losses[loss], parities[parity], messages);
+            double latency = result.delivered > 0 ? result.latency_us / 1e6 / result.delivered : 0;
+            printf("%3.0f%%  %6zu  %8.1f%%  %10.1f%%  %10.2f  %10.2f  %13.2f  %9.2f\n", losses[loss] * 100,
+                   parities[parity], 100.0 * result.delivered / messages, 100.0 * result.first_round / messages,
+                   (double)result.rounds / messages, (double)result.frames / messages,
+                   result.channel_us / 1e6 / messages, latency);
+            failures += result.corrupted;
+            if(losses[loss] == 0.0){
+                failures += result.failed + (result.first_round != (uint32_t)messages);
+            }
+            // Four parity fragments must cover a 10% loss in nearly every first round,
+            // and from 10% deliver sooner than the retransmissions they replace
+            if(parities[parity] == 0){
+                plain_latency = latency;
+            } else if(parities[parity] == 4){
+                failures += losses[loss] == 0.10 && result.first_round < (uint32_t)messages * 95 / 100;
+                failures += losses[loss] >= 0.10 && latency >= plain_latency;
+            }
+        }
+        printf("\n");
+    }
+
+    sx1278_stop();
+    printf("%s\n", failures == 0 ? "OK" : "FAILURES");
+    return failures == 0 ? 0 : 1;
+}
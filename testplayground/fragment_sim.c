@@ -0,0 +1,342 @@
+/*
+ * Fragmentation over a lossy channel
+ * ----------------------------------
+ *
+ * Node 1 sends messages to node 2 through encodeMessage and the fragment
+ * layer (fragment.h); frames cross an in-memory channel that drops them
+ * at random. Time is virtual: every frame costs its LoRa airtime
+ * (sx1278_airtime_us at the chosen spreading factor) and every missing
+ * ACK costs the sender's wait (ACK airtime + 250 ms, as in transmiter.c).
+ *
+ * Loss is given for a 64 byte frame; a frame of L bytes is lost with
+ * probability 1 - (1 - loss)^(L / 64), so long frames lose more, as with
+ * interference that hits a fixed fraction of the airtime.
+ *
+ * For each maximum frame size and loss rate it reports goodput (text
+ * bits delivered per second of channel time), frames and retransmissions,
+ * with selective ACKs and with a baseline that resends every fragment of
+ * the message whenever one is missing (what a plain per-message ACK does).
+ *
+ * Half the messages are chat lines from chat_corpus.txt, half are
+ * 279 random characters: they do not compress, and with the AEAD tag
+ * their frame no longer fits in 255 bytes.
+ *
+ * Before that it checks that ACKs are authenticated: a forged ACK, alone
+ * or attached to a frame, and a genuine ACK with a widened bitmap must
+ * leave the sender retransmitting.
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/fragment_sim \
+ *       testplayground/fragment_sim.c src/fragment.c src/transmiter.c \
+ *       src/packet.c src/compress.c src/aead.c src/session.c src/x25519.c \
+ *       src/sha256.c src/sx1278.c src/sx1278_sim.c src/scheduler.c \
+ *       src/link.c src/mesh.c src/fec.c -pthread -lm
+ *
+ * Usage:
+ *   ./testplayground/fragment_sim [spreading factor] [messages] [corpus]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fragment.h"
+#include "sx1278.h"
+#include "transmitter.h"
+
+#define MAX_LINES        2000
+#define ACK_MARGIN_US    (250 * 1000)
+#define REFERENCE_LENGTH 64.0
+
+static char corpus[MAX_LINES][MESSAGE_SIZE];
+static int corpus_lines;
+static uint8_t key[AEAD_KEY_SIZE];
+
+typedef struct{
+
+    uint32_t delivered;
+    uint32_t failed;
+    uint32_t corrupted;     // delivered text differs from what was sent
+    uint32_t frames;        // every frame on air, both directions
+    uint32_t retransmissions;
+    uint32_t timeouts;
+    uint64_t text_bytes;
+    double channel_us;
+
+} run_result;
+
+static double lossRate;
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+static double nextRandom(void){
+
+    // xorshift64*: same sequence on every run
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (double)((random_state * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static bool frameLost(size_t length){
+
+    return nextRandom() < 1.0 - pow(1.0 - lossRate, (double)length / REFERENCE_LENGTH);
+}
+
+static void loadCorpus(const char *path){
+
+    FILE *file = fopen(path, "r");
+    if(file == NULL){
+        strcpy(corpus[0], "hola, ya estoy en camino\n");
+        corpus_lines = 1;
+        return;
+    }
+    while(corpus_lines < MAX_LINES && fgets(corpus[corpus_lines], MESSAGE_SIZE, file) != NULL){
+        if(corpus[corpus_lines][0] != '\n'){
+            corpus_lines++;
+        }
+    }
+    fclose(file);
+}
+
+static void makeMessage(int index, char *text){
+
+    if(index % 2 == 0){
+        strcpy(text, corpus[(index / 2) % corpus_lines]);
+        return;
+    }
+    for(int position = 0; position < MESSAGE_SIZE - 1; position++){
+        text[position] = (char)(' ' + (int)(nextRandom() * 95));
+    }
+    text[MESSAGE_SIZE - 1] = '\0';
+}
+
+static run_result runChannel(size_t max_frame, double loss, bool selective, int messages){
+
+    run_result result = {0};
+    static fragment_sender transfer;
+    static fragment_reassembler reassembly;
+    memset(&transfer, 0, sizeof(transfer));
+    fragmentReassemblerInit(&reassembly, 2);
+    transfer.ack_key = key;
+    reassembly.ack_key = key;
+
+    device sender = { .transmitter_id = 1, .receiver_id = 2, .transfer = &transfer };
+    device receiver = { .transmitter_id = 1, .receiver_id = 2, .reassembly = &reassembly };
+
+    lossRate = loss;
+    random_state = 0x9E3779B97F4A7C15ULL;
+    uint32_t ack_airtime = sx1278_airtime_us(PACKET_FIXED_SIZE + 4 + FRAGMENT_ACK_PAYLOAD_SIZE + PACKET_CRC_SIZE);
+
+    for(int index = 0; index < messages; index++){
+        char text[MESSAGE_SIZE];
+        uint8_t message_frame[PACKET_MAX_MESSAGE_SIZE];
+        size_t message_length = 0;
+
+        makeMessage(index, text);
+        if(encodeMessage(text, &sender, message_frame, sizeof(message_frame), &message_length) != 0 ||
+           fragmentSenderStart(&transfer, message_frame, message_length, max_frame, 0) != FRAGMENT_OK){
+            result.failed++;
+            continue;
+        }
+        uint32_t retransmissions_before = transfer.stats.retransmissions;
+        uint32_t timeouts_before = transfer.stats.timeouts;
+
+        while(transfer.state == FRAGMENT_SENDING || transfer.state == FRAGMENT_WAITING_ACK){
+            uint8_t acks[FRAGMENT_MAX_COUNT][PACKET_MAX_SIZE];
+            size_t ack_lengths[FRAGMENT_MAX_COUNT];
+            int ack_count = 0;
+
+            // One round: the sender cannot hear while it transmits, so ACKs
+            // are handled once the round is out
+            uint8_t frame[PACKET_MAX_SIZE];
+            size_t frame_length = 0;
+            while(fragmentSenderNext(&transfer, frame, sizeof(frame), &frame_length)){
+                result.frames++;
+                result.channel_us += sx1278_airtime_us(frame_length);
+                if(frameLost(frame_length)){
+                    continue;
+                }
+
+                uint8_t message[PACKET_MAX_MESSAGE_SIZE];
+                size_t length = 0, ack_length = 0;
+                fragmentReceive(&reassembly, frame, frame_length, (int64_t)result.channel_us,
+                                message, sizeof(message), &length,
+                                acks[ack_count], sizeof(acks[0]), &ack_length);
+                if(length > 0){
+                    bool same = receiveMessage(message, length, &receiver) == 0 &&
+                                strcmp(receiver.message, text) == 0;
+                    result.corrupted += !same;
+                    result.text_bytes += same ? strlen(text) : 0;
+                }
+                if(ack_length > 0){
+                    result.frames++;
+                    result.channel_us += ack_airtime;
+                    if(!frameLost(ack_length) && ack_count < FRAGMENT_MAX_COUNT - 1){
+                        ack_lengths[ack_count++] = ack_length;
+                    }
+                }
+            }
+
+            if(ack_count == 0){
+                result.channel_us += ack_airtime + ACK_MARGIN_US;
+                fragmentSenderTimeout(&transfer);
+                continue;
+            }
+            for(int ack = 0; ack < ack_count && transfer.state != FRAGMENT_DELIVERED; ack++){
+                fragmentSenderHandleAck(&transfer, acks[ack], ack_lengths[ack]);
+
+                // Baseline: anything missing means the whole message again
+                if(!selective && transfer.state == FRAGMENT_SENDING){
+                    transfer.acknowledged = 0;
+                    transfer.round_pending = (uint16_t)((1u << transfer.count) - 1);
+                }
+            }
+        }
+
+        result.delivered += transfer.state == FRAGMENT_DELIVERED;
+        result.failed += transfer.state == FRAGMENT_FAILED;
+        result.retransmissions += transfer.stats.retransmissions - retransmissions_before;
+        result.timeouts += transfer.stats.timeouts - timeouts_before;
+    }
+    return result;
+}
+
+// ACK frame from node 2 for sequence with this payload (bitmap + MAC)
+static size_t ackFrame(uint32_t sequence, const uint8_t *payload, uint8_t *frame, size_t frame_size){
+
+    packet_header header = { PACKET_VERSION, PACKET_TYPE_ACK, PACKET_FLAG_NONE, 2, 1, sequence };
+    size_t length = 0;
+    packetEncode(&header, payload, FRAGMENT_ACK_PAYLOAD_SIZE, frame, frame_size, &length);
+    return length;
+}
+
+static int forgedAckCheck(void){
+
+    static fragment_sender transfer;
+    static fragment_reassembler reassembly;
+    memset(&transfer, 0, sizeof(transfer));
+    fragmentReassemblerInit(&reassembly, 2);
+    transfer.ack_key = key;
+    reassembly.ack_key = key;
+    device sender = { .transmitter_id = 1, .receiver_id = 2, .transfer = &transfer };
+
+    char text[MESSAGE_SIZE];
+    uint8_t message_frame[PACKET_MAX_MESSAGE_SIZE];
+    size_t message_length = 0;
+    makeMessage(1, text);
+    if(encodeMessage(text, &sender, message_frame, sizeof(message_frame), &message_length) != 0 ||
+       fragmentSenderStart(&transfer, message_frame, message_length, 64, 0) != FRAGMENT_OK){
+        printf("forged ACK: could not start the transfer\n");
+        return 1;
+    }
+
+    // Only the last fragment of the round arrives: its ACK lists just that one
+    uint8_t frame[PACKET_MAX_SIZE], ack[PACKET_MAX_SIZE], message[PACKET_MAX_MESSAGE_SIZE];
+    size_t frame_length = 0, ack_length = 0, length = 0;
+    while(fragmentSenderNext(&transfer, frame, sizeof(frame), &frame_length)){
+    }
+    fragmentReceive(&reassembly, frame, frame_length, 0, message, sizeof(message), &length,
+                    ack, sizeof(ack), &ack_length);
+    packet_view genuine;
+    if(ack_length == 0 || packetDecode(ack, ack_length, &genuine) != PACKET_OK){
+        printf("forged ACK: no ACK for the flagged fragment\n");
+        return 1;
+    }
+    uint32_t sequence = transfer.header.sequence;
+    int failures = 0;
+
+    // Every fragment claimed, with no MAC
+    uint8_t payload[FRAGMENT_ACK_PAYLOAD_SIZE] = { 0xFF, 0xFF };
+    uint8_t forged[PACKET_MAX_SIZE];
+    size_t forged_length = ackFrame(sequence, payload, forged, sizeof(forged));
+    failures += fragmentSenderHandleAck(&transfer, forged, forged_length) != FRAGMENT_ERROR_FORGED;
+
+    // The genuine MAC with a widened bitmap
+    memcpy(payload, genuine.payload, FRAGMENT_ACK_PAYLOAD_SIZE);
+    payload[0] = 0xFF;
+    payload[1] = 0xFF;
+    forged_length = ackFrame(sequence, payload, forged, sizeof(forged));
+    failures += fragmentSenderHandleAck(&transfer, forged, forged_length) != FRAGMENT_ERROR_FORGED;
+
+    // Every fragment claimed in an ACK attached to a frame of node 2
+    packet_header carrier = { PACKET_VERSION, PACKET_TYPE_DATA, PACKET_FLAG_NONE, 2, 1, 7 };
+    packet_view attached;
+    forged_length = 0;
+    packetEncode(&carrier, (const uint8_t *)"hi", 2, forged, sizeof(forged), &forged_length);
+    packetAttachAck(forged, forged_length, sizeof(forged), sequence, 0xFFFF, &genuine.payload[PACKET_ACK_BITMAP_SIZE],
+                    &forged_length);
+    packetDecode(forged, forged_length, &attached);
+    failures += fragmentSenderApplyAck(&transfer, &attached.header, attached.ack_sequence, attached.ack_bitmap,
+                                       attached.ack_mac) != FRAGMENT_ERROR_FORGED;
+
+    failures += transfer.acknowledged != 0 || transfer.stats.acks_forged != 3;
+
+    // The genuine ACK still counts, and the rest of the message follows
+    failures += fragmentSenderHandleAck(&transfer, ack, ack_length) != FRAGMENT_OK;
+    while(transfer.state == FRAGMENT_SENDING || transfer.state == FRAGMENT_WAITING_ACK){
+        if(!fragmentSenderNext(&transfer, frame, sizeof(frame), &frame_length)){
+            fragmentSenderTimeout(&transfer);
+            continue;
+        }
+        fragmentReceive(&reassembly, frame, frame_length, 0, message, sizeof(message), &length,
+                        ack, sizeof(ack), &ack_length);
+        if(ack_length > 0){
+            fragmentSenderHandleAck(&transfer, ack, ack_length);
+        }
+    }
+    failures += transfer.state != FRAGMENT_DELIVERED;
+
+    printf("forged ACKs rejected: %u, message %s\n", (unsigned)transfer.stats.acks_forged,
+           transfer.state == FRAGMENT_DELIVERED ? "delivered" : "lost");
+    return failures;
+}
+
+int main(int argc, char **argv){
+
+    int spreading_factor = argc > 1 ? atoi(argv[1]) : 10;
+    int messages = argc > 2 ? atoi(argv[2]) : 400;
+    loadCorpus(argc > 3 ? argv[3] : "testplayground/chat_corpus.txt");
+
+    sx1278_config_t config = SX1278_CONFIG_DEFAULT;
+    config.spreading_factor = (uint8_t)spreading_factor;
+    if(!sx1278_init(&config)){
+        return 1;
+    }
+
+    for(size_t index = 0; index < sizeof(key); index++){
+        key[index] = (uint8_t)(index * 7 + 1);
+    }
+    setEncryptionKey(key);
+
+    const size_t frame_sizes[] = { 255, 128, 64 };
+    const double losses[] = { 0.0, 0.05, 0.10, 0.20, 0.30 };
+    int failures = forgedAckCheck();
+
+    printf("\nSF%d, %d messages (half chat lines, half 279 random chars), %s\n",
+           spreading_factor, messages, aeadBackendName());
+    printf("255 byte frame: %u ms on air\n\n", sx1278_airtime_us(255) / 1000);
+    printf("frame  loss  mode       delivered  failed  frames  resent  timeouts  goodput bit/s\n");
+
+    for(size_t size = 0; size < sizeof(frame_sizes) / sizeof(frame_sizes[0]); size++){
+        for(size_t loss = 0; loss < sizeof(losses) / sizeof(losses[0]); loss++){
+            for(int selective = 1; selective >= 0; selective--){
+                run_result result = runChannel(frame_sizes[size], losses[loss], selective, messages);
+                printf("%5zu  %3.0f%%  %-9s  %9u  %6u  %6u  %6u  %8u  %13.1f\n",
+                       frame_sizes[size], losses[loss] * 100, selective ? "SACK" : "resend all",
+                       result.delivered, result.failed, result.frames, result.retransmissions,
+                       result.timeouts, result.text_bytes * 8 / (result.channel_us / 1e6));
+                failures += result.corrupted;
+                if(losses[loss] == 0.0){
+                    failures += result.failed;
+                }
+            }
+        }
+        printf("\n");
+    }
+
+    sx1278_stop();
+    printf("%s\n", failures == 0 ? "OK" : "FAILURES");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+/*
+ * Static Huffman model trainer for the transmitter compression stage
+ * ------------------------------------------------------------------
+ *
+ * Counts byte frequencies over one or more text files (one message per
+ * line, '\n' included because getMessage keeps it) and prints the
+ * canonical Huffman tables used by src/compress.c.
+ *
+ * Every byte value gets a small base count so that any message can be
+ * encoded, even with characters never seen in the corpus, and capital
+ * letters inherit part of the count of their lower case letter (a chat
+ * corpus rarely has enough of them). Code lengths are limited to
+ * HUFFMAN_MAX_BITS so the decoder tables stay tiny.
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/huffman_train testplayground/huffman_train.c
+ *
+ * Usage:
+ *   ./testplayground/huffman_train testplayground/chat_corpus.txt > tables.txt
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "compress.h"
+
+#define SYMBOLS 256
+
+// Weight of each real occurrence against the +1 every byte gets
+#define CORPUS_WEIGHT 64
+
+// A capital letter is counted as if it appeared 1/CAPITAL_PRIOR_DIVISOR
+// times as often as its lower case letter (on top of its own count)
+#define CAPITAL_PRIOR_DIVISOR 8
+
+static uint64_t corpus_count[SYMBOLS];
+static uint64_t frequency[SYMBOLS];
+static uint8_t code_length[SYMBOLS];
+
+/*
+ * Plain Huffman: repeatedly merge the two lightest nodes (O(n^2), n = 256).
+ * Leaves are 0..255, internal nodes 256..510.
+ */
+static void buildCodeLengths(void){
+
+    uint64_t weight[2 * SYMBOLS];
+    int parent[2 * SYMBOLS];
+    int alive[2 * SYMBOLS];
+    int node_count = SYMBOLS;
+
+    for(int symbol = 0; symbol < SYMBOLS; symbol++){
+        weight[symbol] = frequency[symbol];
+        alive[symbol] = 1;
+        parent[symbol] = -1;
+    }
+
+    for(int merges = 0; merges < SYMBOLS - 1; merges++){
+        int first = -1, second = -1;
+        for(int node = 0; node < node_count; node++){
+            if(!alive[node]) continue;
+            if(first < 0 || weight[node] < weight[first]){
+                second = first;
+                first = node;
+            } else if(second < 0 || weight[node] < weight[second]){
+                second = node;
+            }
+        }
+        weight[node_count] = weight[first] + weight[second];
+        alive[node_count] = 1;
+        parent[node_count] = -1;
+        alive[first] = alive[second] = 0;
+        parent[first] = parent[second] = node_count;
+        node_count++;
+    }
+
+    for(int symbol = 0; symbol < SYMBOLS; symbol++){
+        int depth = 0;
+        for(int node = symbol; parent[node] >= 0; node = parent[node]){
+            depth++;
+        }
+        code_length[symbol] = (uint8_t)depth;
+    }
+}
+
+/*
+ * Clamps lengths to HUFFMAN_MAX_BITS and lengthens the deepest codes
+ * below the limit until the Kraft sum fits again.
+ */
+static void limitCodeLengths(void){
+
+    const uint32_t kraft_limit = 1u << HUFFMAN_MAX_BITS;
+    uint32_t kraft = 0;
+
+    for(int symbol = 0; symbol < SYMBOLS; symbol++){
+        if(code_length[symbol] > HUFFMAN_MAX_BITS){
+            code_length[symbol] = HUFFMAN_MAX_BITS;
+        }
+        kraft += 1u << (HUFFMAN_MAX_BITS - code_length[symbol]);
+    }
+
+    while(kraft > kraft_limit){
+        int deepest = -1;
+        for(int symbol = 0; symbol < SYMBOLS; symbol++){
+            if(code_length[symbol] >= HUFFMAN_MAX_BITS) continue;
+            if(deepest < 0 || code_length[symbol] > code_length[deepest] ||
+               (code_length[symbol] == code_length[deepest] && frequency[symbol] < frequency[deepest])){
+                deepest = symbol;
+            }
+        }
+        kraft -= 1u << (HUFFMAN_MAX_BITS - code_length[deepest] - 1);
+        code_length[deepest]++;
+    }
+}
+
+static void printTable(const char *declaration, const unsigned *values, int count, const char *format){
+
+    printf("%s = {\n", declaration);
+    for(int index = 0; index < count; index++){
+        if(index % 12 == 0) printf("    ");
+        printf(format, values[index]);
+        printf(index % 12 == 11 || index == count - 1 ? ",\n" : ", ");
+    }
+    printf("};\n\n");
+}
+
+int main(int argc, char **argv){
+
+    if(argc < 2){
+        fprintf(stderr, "usage: %s corpus.txt [more.txt ...]\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t total_bytes = 0;
+    for(int file_index = 1; file_index < argc; file_index++){
+        FILE *corpus = fopen(argv[file_index], "rb");
+        if(corpus == NULL){
+            perror(argv[file_index]);
+            return 1;
+        }
+        int character;
+        while((character = fgetc(corpus)) != EOF){
+            corpus_count[character]++;
+            total_bytes++;
+        }
+        fclose(corpus);
+    }
+    for(int symbol = 0; symbol < SYMBOLS; symbol++){
+        frequency[symbol] = corpus_count[symbol] * CORPUS_WEIGHT + 1;
+    }
+    for(int symbol = 'A'; symbol <= 'Z'; symbol++){
+        frequency[symbol] += frequency[symbol - 'A' + 'a'] / CAPITAL_PRIOR_DIVISOR;
+    }
+
+    buildCodeLengths();
+    limitCodeLengths();
+
+    // Canonical codes: sorted by (length, symbol), consecutive values
+    unsigned lengths[SYMBOLS], codes[SYMBOLS], sorted[SYMBOLS];
+    unsigned counts[HUFFMAN_MAX_BITS + 1] = {0};
+    int sorted_count = 0;
+    unsigned code = 0;
+    double expected_bits = 0;
+
+    for(int length = 1; length <= HUFFMAN_MAX_BITS; length++){
+        for(int symbol = 0; symbol < SYMBOLS; symbol++){
+            if(code_length[symbol] != length) continue;
+            codes[symbol] = code++;
+            sorted[sorted_count++] = (unsigned)symbol;
+            counts[length]++;
+        }
+        code <<= 1;
+    }
+    for(int symbol = 0; symbol < SYMBOLS; symbol++){
+        lengths[symbol] = code_length[symbol];
+        expected_bits += (double)corpus_count[symbol] * code_length[symbol];
+    }
+
+    printf("// Generated by testplayground/huffman_train.c from %llu bytes of corpus\n",
+           (unsigned long long)total_bytes);
+    printf("// (%.2f bits per character on the training corpus)\n\n",
+           total_bytes ? expected_bits / total_bytes : 0.0);
+    printTable("static const uint8_t huffman_code_lengths[256]", lengths, SYMBOLS, "%2u");
+    printTable("static const uint16_t huffman_codes[256]", codes, SYMBOLS, "0x%04X");
+    printTable("static const uint8_t huffman_sorted_symbols[256]", sorted, SYMBOLS, "0x%02X");
+    printTable("static const uint16_t huffman_length_counts[HUFFMAN_MAX_BITS + 1]",
+               counts, HUFFMAN_MAX_BITS + 1, "%3u");
+    return 0;
+}
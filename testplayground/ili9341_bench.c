@@ -0,0 +1,398 @@
+/**
+ * Banco de pruebas del driver ILI9341 en el host (sin placa)
+ * ----------------------------------------------------------
+ *
+ * Ejecuta cada primitiva del driver y cada pantalla de Stratagem Hero
+ * contra el emulador de ili9341_sim.c. Para cada caso muestra cuántas
+ * transacciones y bytes cruzan el bus y el tiempo de bus estimado, y
+ * guarda una captura PPM de las pantallas del juego.
+ *
+ * Después dibuja una misma escena (rellenos, líneas, contornos y texto)
+ * por cada camino del driver: en cola con DMA y con cada formato de
+ * framebuffer. La GRAM resultante se compara píxel a píxel, con
+ * ili9341_sim_get_pixel, con la del dibujo directo bloqueante. Cualquier
+ * diferencia, aquí o en los sprites, hace que el programa termine con
+ * código 1.
+ *
+ * Compilación (desde la raíz del repositorio):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/ili9341_bench \
+ *       testplayground/ili9341_bench.c src/ili9341.c src/ili9341_sim.c \
+ *       src/font5x7.c src/game_ui.c src/text_console.c src/text_label.c
+ *
+ * Uso:
+ *   ./testplayground/ili9341_bench [directorio_capturas] [reloj_spi_hz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ili9341.h"
+#include "ili9341_sim.h"
+#include "game_ui.h"
+#include "text_console.h"
+
+static const char *snapshot_dir = ".";
+static int bench_failures;
+
+static void bench_print_header(const char *mode)
+{
+    printf("\n== %s ==\n", mode);
+    printf("%-28s %8s %9s %9s %10s %11s\n",
+           "caso", "trans", "cmd B", "param B", "pixel B", "bus (us)");
+}
+
+static void bench_begin(void)
+{
+    ili9341_flush();
+    ili9341_sim_reset_stats();
+}
+
+static void bench_end(const char *name, const char *snapshot)
+{
+    ili9341_present();   // sin framebuffer no hace nada
+    ili9341_flush();
+
+    ili9341_sim_stats_t stats;
+    ili9341_sim_get_stats(&stats);
+    printf("%-28s %8u %9u %9u %10u %11.1f\n", name,
+           stats.transactions, stats.cmd_bytes, stats.param_bytes,
+           stats.pixel_bytes, stats.bus_time_ns / 1000.0);
+
+    if (snapshot) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s.ppm", snapshot_dir, snapshot);
+        if (ili9341_sim_dump_ppm(path) != 0) {
+            fprintf(stderr, "No se pudo guardar %s\n", path);
+        }
+    }
+}
+
+static void bench_primitives(void)
+{
+    bench_begin();
+    ili9341_fill_screen(COLOR_BG);
+    bench_end("fill_screen", NULL);
+
+    bench_begin();
+    ili9341_fill_rect(20, 20, 100, 100, ILI9341_COLOR_BLUE);
+    bench_end("fill_rect 100x100", NULL);
+
+    bench_begin();
+    for (uint16_t x = 0; x < ILI9341_WIDTH; x++) {
+        ili9341_draw_pixel(x, 200, ILI9341_COLOR_RED);
+    }
+    bench_end("draw_pixel x240 (fila)", NULL);
+
+    bench_begin();
+    for (uint16_t y = 0; y < 100; y++) {
+        ili9341_draw_pixel(120, y, ILI9341_COLOR_GREEN);
+    }
+    bench_end("draw_pixel x100 (columna)", NULL);
+
+    for (uint8_t scale = 1; scale <= 3; scale++) {
+        char name[32];
+        snprintf(name, sizeof(name), "draw_string escala %u", scale);
+        bench_begin();
+        ili9341_draw_string(0, 240, "INTRODUCE LA SECUENCIA", COLOR_INFO, COLOR_BG, scale);
+        bench_end(name, NULL);
+    }
+}
+
+/**
+ * Sprite de prueba 32x32: degradado con un marco de color clave
+ * (magenta) para los casos con transparencia.
+ */
+#define BENCH_SPRITE_SIZE 32
+#define BENCH_SPRITE_KEY  ILI9341_RGB565(31, 0, 31)
+
+static uint16_t bench_sprite[BENCH_SPRITE_SIZE * BENCH_SPRITE_SIZE];
+
+static void bench_build_sprite(void)
+{
+    for (int y = 0; y < BENCH_SPRITE_SIZE; y++) {
+        for (int x = 0; x < BENCH_SPRITE_SIZE; x++) {
+            bool border = x < 4 || y < 4 || x >= BENCH_SPRITE_SIZE - 4 || y >= BENCH_SPRITE_SIZE - 4;
+            bench_sprite[y * BENCH_SPRITE_SIZE + x] = border
+                ? BENCH_SPRITE_KEY
+                : ILI9341_RGB565(x, y * 2, 31 - x);
+        }
+    }
+}
+
+/**
+ * Comprueba que el panel emulado contiene el sprite en (x, y), leyendo
+ * los píxeles visibles de la zona indicada.
+ */
+static void bench_check_sprite(int16_t x, int16_t y, bool skip_key)
+{
+    int errors = 0;
+    for (int sy = 0; sy < BENCH_SPRITE_SIZE; sy++) {
+        for (int sx = 0; sx < BENCH_SPRITE_SIZE; sx++) {
+            int px = x + sx, py = y + sy;
+            if (px < 0 || py < 0 || px >= ILI9341_WIDTH || py >= ILI9341_HEIGHT) continue;
+            uint16_t expected = bench_sprite[sy * BENCH_SPRITE_SIZE + sx];
+            if (skip_key && expected == BENCH_SPRITE_KEY) continue;
+            if (ili9341_sim_get_pixel(px, py) != expected) errors++;
+        }
+    }
+    if (errors) {
+        printf("  !! %d píxeles distintos del sprite en (%d, %d)\n", errors, x, y);
+        bench_failures++;
+    }
+}
+
+static void bench_bitmaps(void)
+{
+    bench_build_sprite();
+
+    bench_begin();
+    ili9341_draw_bitmap(40, 40, BENCH_SPRITE_SIZE, BENCH_SPRITE_SIZE, bench_sprite);
+    bench_end("draw_bitmap 32x32", NULL);
+    bench_check_sprite(40, 40, false);
+
+    bench_begin();
+    ili9341_draw_bitmap(-10, 300, BENCH_SPRITE_SIZE, BENCH_SPRITE_SIZE, bench_sprite);
+    bench_end("draw_bitmap recortado", NULL);
+    bench_check_sprite(-10, 300, false);
+
+    bench_begin();
+    ili9341_draw_bitmap_transparent(100, 40, BENCH_SPRITE_SIZE, BENCH_SPRITE_SIZE,
+                                    bench_sprite, BENCH_SPRITE_KEY);
+    bench_end("draw_bitmap transparente", NULL);
+    bench_check_sprite(100, 40, true);
+}
+
+/**
+ * Conversación en la consola con scroll por hardware: mensajes largos
+ * (del tamaño de MESSAGE_SIZE) hasta llenar la pantalla varias veces.
+ */
+static void bench_console(void)
+{
+    static const char *messages[] = {
+        "Hola! Probando la consola con scroll por hardware del ILI9341.",
+        "Cada linea nueva solo cuesta un VSCRSADD y una linea de pixeles, "
+        "en vez de redibujar los 150 KB de la pantalla. Este mensaje es "
+        "largo a proposito para ver como se parten las palabras al llegar "
+        "al borde derecho, igual que un mensaje de 280 caracteres del "
+        "transmisor con texto normal y palabras de varias longitudes.",
+        "ok",
+    };
+
+    text_console_t con;
+    ili9341_fill_rect(0, 0, ILI9341_WIDTH, 16, ILI9341_COLOR_BLUE);
+    ili9341_draw_string(4, 4, "CONVERSACION", COLOR_TEXT, ILI9341_COLOR_BLUE, 1);
+    text_console_init(&con, 16, 0, 1, COLOR_TEXT, COLOR_BG);
+
+    // Llenamos la consola para que los mensajes siguientes hagan scroll
+    for (int i = 0; i < 12; i++) {
+        text_console_set_color(&con, (i & 1) ? COLOR_INFO : COLOR_TEXT);
+        text_console_write(&con, messages[i % 3]);
+        text_console_newline(&con);
+    }
+
+    bench_begin();
+    text_console_write(&con, "linea nueva");
+    text_console_newline(&con);
+    bench_end("consola: 1 linea con scroll", NULL);
+
+    bench_begin();
+    text_console_set_color(&con, COLOR_GOOD);
+    text_console_write(&con, messages[1]);
+    text_console_newline(&con);
+    bench_end("consola: mensaje de 280", "consola");
+
+    // El resto de pruebas dibuja sin scroll
+    ili9341_scroll_define(0, 0);
+}
+
+static void bench_game_screens(const char *prefix)
+{
+    Direction sequence[] = { DIR_UP, DIR_LEFT, DIR_DOWN, DIR_RIGHT, DIR_UP };
+    int length = sizeof(sequence) / sizeof(sequence[0]);
+    char snapshot[64];
+
+    bench_begin();
+    game_draw_menu_screen();
+    snprintf(snapshot, sizeof(snapshot), "%s_menu", prefix);
+    bench_end("pantalla menu", snapshot);
+
+    bench_begin();
+    game_draw_show_sequence_screen(sequence, length);
+    snprintf(snapshot, sizeof(snapshot), "%s_secuencia", prefix);
+    bench_end("pantalla secuencia", snapshot);
+
+    bench_begin();
+    game_draw_input_screen();
+    bench_end("pantalla input", NULL);
+
+    bench_begin();
+    game_draw_timer(10000);
+    bench_end("temporizador (primero)", NULL);
+
+    // Las siguientes llamadas solo repintan los caracteres que cambian
+    bench_begin();
+    game_draw_timer(9950);
+    bench_end("temporizador (10.0 -> 9.9)", NULL);
+
+    bench_begin();
+    game_draw_timer(9850);
+    bench_end("temporizador (9.9 -> 9.8)", NULL);
+
+    bench_begin();
+    game_draw_input_progress(sequence, length, 1);
+    bench_end("progreso input (primero)", NULL);
+
+    bench_begin();
+    game_draw_input_progress(sequence, length, 2);
+    snprintf(snapshot, sizeof(snapshot), "%s_input", prefix);
+    bench_end("progreso input (+1 paso)", snapshot);
+
+    bench_begin();
+    game_draw_result(1);
+    snprintf(snapshot, sizeof(snapshot), "%s_exito", prefix);
+    bench_end("resultado", snapshot);
+}
+
+static void bench_driver_stats(void)
+{
+    ili9341_stats_t stats;
+    ili9341_get_stats(&stats);
+    printf("\nDriver: %u bytes de comando enviados, %u evitados "
+           "(CASET omitidos %u, RASET omitidos %u, RAMWR reutilizados %u)\n",
+           stats.cmd_bytes, stats.cmd_bytes_saved, stats.caset_skipped,
+           stats.raset_skipped, stats.ramwr_reused);
+}
+
+/**
+ * Escena de comparación: rellenos (uno recortado por el borde), un
+ * contorno de 1 px, líneas píxel a píxel y texto a varias escalas. Usa
+ * menos de 16 colores para que quepan en la paleta de INDEXED4. Con
+ * framebuffer, el present de la mitad obliga a que el segundo present
+ * envíe solo lo que cambia encima de lo ya enviado.
+ */
+static void bench_scene(void)
+{
+    ili9341_fill_screen(ILI9341_COLOR_BLUE);
+    ili9341_fill_rect(10, 10, 220, 120, COLOR_BG);
+    ili9341_fill_rect(200, 290, 100, 100, ILI9341_COLOR_YELLOW);
+    ili9341_present();
+
+    ili9341_fill_rect(20, 20, 200, 1, ILI9341_COLOR_WHITE);
+    ili9341_fill_rect(20, 119, 200, 1, ILI9341_COLOR_WHITE);
+    ili9341_fill_rect(20, 20, 1, 100, ILI9341_COLOR_WHITE);
+    ili9341_fill_rect(219, 20, 1, 100, ILI9341_COLOR_WHITE);
+
+    for (uint16_t x = 0; x < ILI9341_WIDTH; x++) {
+        ili9341_draw_pixel(x, 150, ILI9341_COLOR_RED);
+    }
+    for (uint16_t y = 160; y < 260; y++) {
+        ili9341_draw_pixel(120, y, ILI9341_COLOR_GREEN);
+    }
+    for (uint16_t i = 0; i < 100; i++) {
+        ili9341_draw_pixel(20 + i, 160 + i, ILI9341_COLOR_CYAN);
+    }
+
+    ili9341_draw_string(30, 40, "OK!", COLOR_GOOD, COLOR_BG, 3);
+    ili9341_draw_string(0, 270, "INTRODUCE LA SECUENCIA", COLOR_INFO, COLOR_BG, 1);
+    ili9341_draw_string(0, 280, "ABC 123", ILI9341_COLOR_MAGENTA, ILI9341_COLOR_BLUE, 2);
+    ili9341_present();
+    ili9341_flush();
+}
+
+static uint16_t bench_reference[ILI9341_HEIGHT][ILI9341_WIDTH];
+
+/**
+ * Dibuja la escena por un camino (format < 0: sin framebuffer) y compara
+ * la GRAM con la referencia. Antes se pinta la pantalla de otro color
+ * para que no valga lo que dejó el caso anterior.
+ */
+static void bench_check_path(const char *name, bool async, int format)
+{
+    ili9341_set_async(false);
+    ili9341_fill_screen(ILI9341_COLOR_MAGENTA);
+    ili9341_set_async(async);
+
+    if (format >= 0 && !ili9341_framebuffer_enable((ili9341_fb_format_t)format)) {
+        printf("%-28s sin memoria, no comprobado\n", name);
+        bench_failures++;
+        return;
+    }
+    bench_scene();
+
+    int errors = 0, first_x = 0, first_y = 0;
+    for (uint16_t y = 0; y < ILI9341_HEIGHT; y++) {
+        for (uint16_t x = 0; x < ILI9341_WIDTH; x++) {
+            if (ili9341_sim_get_pixel(x, y) != bench_reference[y][x]) {
+                if (errors++ == 0) {
+                    first_x = x;
+                    first_y = y;
+                }
+            }
+        }
+    }
+    if (errors) {
+        printf("%-28s !! %d píxeles distintos, el primero en (%d, %d)\n", name, errors, first_x, first_y);
+        bench_failures++;
+    } else {
+        printf("%-28s igual\n", name);
+    }
+
+    if (format >= 0) {
+        ili9341_framebuffer_disable();
+    }
+    ili9341_set_async(false);
+}
+
+static void bench_compare_paths(void)
+{
+    printf("\n== Comparación con el dibujo directo bloqueante ==\n");
+
+    ili9341_set_async(false);
+    bench_scene();
+    for (uint16_t y = 0; y < ILI9341_HEIGHT; y++) {
+        for (uint16_t x = 0; x < ILI9341_WIDTH; x++) {
+            bench_reference[y][x] = ili9341_sim_get_pixel(x, y);
+        }
+    }
+
+    bench_check_path("directo en cola (DMA)", true, -1);
+    bench_check_path("framebuffer RGB565", false, ILI9341_FB_RGB565);
+    bench_check_path("framebuffer RGB565 en cola", true, ILI9341_FB_RGB565);
+    bench_check_path("framebuffer INDEXED8 en cola", true, ILI9341_FB_INDEXED8);
+    bench_check_path("framebuffer INDEXED4 en cola", true, ILI9341_FB_INDEXED4);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        snapshot_dir = argv[1];
+    }
+    if (argc > 2) {
+        ili9341_sim_configure((uint32_t)strtoul(argv[2], NULL, 10), 5000);
+    }
+
+    ili9341_init();
+    ili9341_set_async(true);
+    ili9341_reset_stats();
+
+    bench_print_header("Dibujo directo");
+    bench_primitives();
+    bench_bitmaps();
+    bench_console();
+    bench_game_screens("directo");
+
+    if (ili9341_framebuffer_enable(ILI9341_FB_INDEXED4)) {
+        ili9341_present();
+        bench_print_header("Framebuffer INDEXED4 + present");
+        bench_game_screens("fb4");
+        ili9341_framebuffer_disable();
+    }
+
+    bench_driver_stats();
+    bench_compare_paths();
+
+    printf("\n%s (%d fallos)\n", bench_failures == 0 ? "OK" : "FALLOS", bench_failures);
+    return bench_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+/**
+ * Conversor de imágenes para el driver ILI9341 (herramienta de host)
+ * -----------------------------------------------------------------
+ *
+ * Lee un PPM binario (P6, 8 bits por canal) y genera un .h con la imagen
+ * en el formato comprimido de include/ili9341_image.h, listo para
+ * dibujarlo con ili9341_draw_image.
+ *
+ *   - Si la imagen tiene como mucho 256 colores RGB565 distintos se usa
+ *     ILI9341_IMAGE_RLE8 (paleta + índices RLE).
+ *   - Si tiene más, ILI9341_IMAGE_RLE16 (colores RGB565 en RLE).
+ *
+ * Compilación (desde la raíz del repositorio):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/img2ili9341 testplayground/img2ili9341.c
+ *
+ * Uso:
+ *   ./testplayground/img2ili9341 entrada.ppm nombre_array > include/nombre_array.h
+ *
+ * Cualquier editor de imágenes exporta PPM; por ejemplo con ImageMagick:
+ *   convert splash.png -depth 8 splash.ppm
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ili9341_image.h"
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} byte_buffer_t;
+
+static void buffer_put(byte_buffer_t *b, uint8_t byte)
+{
+    if (b->size == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 1024;
+        b->data = realloc(b->data, b->capacity);
+        if (!b->data) {
+            fprintf(stderr, "Sin memoria\n");
+            exit(1);
+        }
+    }
+    b->data[b->size++] = byte;
+}
+
+static void buffer_put16_le(byte_buffer_t *b, uint16_t v)
+{
+    buffer_put(b, v & 0xFF);
+    buffer_put(b, v >> 8);
+}
+
+static void buffer_put_color(byte_buffer_t *b, uint16_t color)
+{
+    buffer_put(b, color >> 8);
+    buffer_put(b, color & 0xFF);
+}
+
+/**
+ * Salta espacios y comentarios de la cabecera PPM y lee un número.
+ */
+static int ppm_read_number(FILE *f, int *value)
+{
+    int ch = fgetc(f);
+    while (ch == '#' || ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+        if (ch == '#') {
+            while (ch != '\n' && ch != EOF) ch = fgetc(f);
+        }
+        ch = fgetc(f);
+    }
+    if (ch < '0' || ch > '9') return -1;
+
+    *value = 0;
+    while (ch >= '0' && ch <= '9') {
+        *value = *value * 10 + (ch - '0');
+        ch = fgetc(f);
+    }
+    return 0;   // el separador que sigue al número ya está consumido
+}
+
+/**
+ * Carga un PPM P6 y lo devuelve convertido a RGB565.
+ */
+static uint16_t *ppm_load(const char *path, int *w, int *h)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+
+    int maxval;
+    if (fgetc(f) != 'P' || fgetc(f) != '6' ||
+        ppm_read_number(f, w) || ppm_read_number(f, h) || ppm_read_number(f, &maxval) ||
+        *w <= 0 || *h <= 0 || *w > 0xFFFF || *h > 0xFFFF || maxval != 255) {
+        fprintf(stderr, "%s: solo se admite PPM P6 con 8 bits por canal\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    size_t count = (size_t)*w * *h;
+    uint16_t *pixels = malloc(count * sizeof(uint16_t));
+    uint8_t rgb[3];
+    for (size_t i = 0; i < count; i++) {
+        if (fread(rgb, 1, 3, f) != 3) {
+            fprintf(stderr, "%s: faltan píxeles\n", path);
+            free(pixels);
+            fclose(f);
+            return NULL;
+        }
+        pixels[i] = (uint16_t)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+    }
+
+    fclose(f);
+    return pixels;
+}
+
+/**
+ * Codifica 'count' valores en paquetes RLE. Una repetición compensa a
+ * partir de 'min_run' valores iguales; lo demás se agrupa en literales.
+ */
+static void rle_encode(byte_buffer_t *out, const uint16_t *values, size_t count,
+                       int value_size, size_t min_run)
+{
+    size_t i = 0;
+    while (i < count) {
+        // ¿Empieza aquí una repetición suficientemente larga?
+        size_t run = 1;
+        while (i + run < count && run < ILI9341_IMAGE_MAX_PACKET && values[i + run] == values[i]) {
+            run++;
+        }
+
+        if (run >= min_run) {
+            buffer_put(out, ILI9341_IMAGE_RUN_FLAG | (uint8_t)(run - 1));
+            if (value_size == 1) buffer_put(out, (uint8_t)values[i]);
+            else buffer_put_color(out, values[i]);
+            i += run;
+            continue;
+        }
+
+        // Literal hasta la próxima repetición que compense
+        size_t start = i;
+        while (i < count && i - start < ILI9341_IMAGE_MAX_PACKET) {
+            size_t next_run = 1;
+            while (i + next_run < count && next_run < min_run && values[i + next_run] == values[i]) {
+                next_run++;
+            }
+            if (next_run >= min_run) break;
+            i++;
+        }
+
+        buffer_put(out, (uint8_t)(i - start - 1));
+        for (size_t k = start; k < i; k++) {
+            if (value_size == 1) buffer_put(out, (uint8_t)values[k]);
+            else buffer_put_color(out, values[k]);
+        }
+    }
+}
+
+/**
+ * Construye la paleta de la imagen. Devuelve el número de colores, o -1
+ * si hay más de 256.
+ */
+static int build_palette(const uint16_t *pixels, size_t count,
+                         uint16_t palette[256], uint16_t *indices)
+{
+    int colors = 0;
+    for (size_t i = 0; i < count; i++) {
+        int index = -1;
+        for (int k = 0; k < colors; k++) {
+            if (palette[k] == pixels[i]) {
+                index = k;
+                break;
+            }
+        }
+        if (index < 0) {
+            if (colors == 256) return -1;
+            index = colors;
+            palette[colors++] = pixels[i];
+        }
+        indices[i] = (uint16_t)index;
+    }
+    return colors;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "Uso: %s entrada.ppm nombre_array > nombre_array.h\n", argv[0]);
+        return 1;
+    }
+
+    int w, h;
+    uint16_t *pixels = ppm_load(argv[1], &w, &h);
+    if (!pixels) return 1;
+
+    size_t count = (size_t)w * h;
+    uint16_t *indices = malloc(count * sizeof(uint16_t));
+    uint16_t palette[256];
+    int colors = build_palette(pixels, count, palette, indices);
+
+    byte_buffer_t out = {0};
+    buffer_put(&out, ILI9341_IMAGE_MAGIC0);
+    buffer_put(&out, ILI9341_IMAGE_MAGIC1);
+    buffer_put(&out, ILI9341_IMAGE_VERSION);
+    buffer_put(&out, colors > 0 ? ILI9341_IMAGE_RLE8 : ILI9341_IMAGE_RLE16);
+    buffer_put16_le(&out, (uint16_t)w);
+    buffer_put16_le(&out, (uint16_t)h);
+
+    if (colors > 0) {
+        buffer_put(&out, (uint8_t)(colors - 1));
+        for (int k = 0; k < colors; k++) buffer_put_color(&out, palette[k]);
+        rle_encode(&out, indices, count, 1, 3);
+    } else {
+        rle_encode(&out, pixels, count, 2, 2);
+    }
+
+    const char *name = argv[2];
+    printf("// Generado por testplayground/img2ili9341.c a partir de %s\n", argv[1]);
+    printf("// %dx%d, %s, %zu bytes (RGB565 sin comprimir: %zu bytes)\n\n",
+           w, h, colors > 0 ? "RLE8" : "RLE16", out.size, count * 2);
+    printf("#pragma once\n\n#include <stdint.h>\n\n");
+    printf("static const uint8_t %s[%zu] = {", name, out.size);
+    for (size_t i = 0; i < out.size; i++) {
+        printf("%s0x%02X,", (i % 12) ? " " : "\n    ", out.data[i]);
+    }
+    printf("\n};\n");
+
+    fprintf(stderr, "%s: %dx%d, %s, %zu -> %zu bytes (%.1f%%)\n",
+            argv[1], w, h, colors > 0 ? "RLE8" : "RLE16", count * 2, out.size,
+            100.0 * out.size / (count * 2));
+
+    free(out.data);
+    free(indices);
+    free(pixels);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * Latencia pulsación -> panel en el host (sin placa)
+ * -------------------------------------------------
+ *
+ * Reproduce el camino de una pulsación del juego con las mismas trazas
+ * que main.c: el hilo principal hace de bucle de eventos (con un retardo
+ * de despertar simulado), encola las pantallas de game_ui en la tarea de
+ * render y cierra cada traza con render_latency. El emulador va en modo
+ * tiempo real, así que cada transacción SPI tarda lo que tardaría a
+ * 40 MHz y la etapa "render -> panel" es comparable con la placa.
+ *
+ * Al final se escribe el mismo informe que en el monitor serie.
+ *
+ * Compilación (desde la raíz del repositorio):
+ *
+ *   gcc -O2 -pthread -Iinclude -o testplayground/latency_sim \
+ *       testplayground/latency_sim.c src/latency.c src/render.c \
+ *       src/ili9341.c src/ili9341_sim.c src/font5x7.c src/game_ui.c \
+ *       src/text_label.c
+ *
+ * Uso:
+ *   ./testplayground/latency_sim [rondas]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "game_ui.h"
+#include "ili9341.h"
+#include "ili9341_sim.h"
+#include "latency.h"
+#include "render.h"
+
+#define SIM_SEQ_LENGTH  5
+
+typedef struct {
+    Direction sequence[SIM_SEQ_LENGTH];
+    int progress;
+} sim_draw_arg_t;
+
+static void sim_sleep_us(uint32_t us)
+{
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void sim_show_sequence_cmd(const void *arg)
+{
+    const sim_draw_arg_t *draw_arg = arg;
+    game_draw_show_sequence_screen((Direction *)draw_arg->sequence, SIM_SEQ_LENGTH);
+}
+
+static void sim_input_screen_cmd(const void *arg)
+{
+    (void)arg;
+    game_draw_input_screen();
+}
+
+static void sim_input_progress_cmd(const void *arg)
+{
+    const sim_draw_arg_t *draw_arg = arg;
+    game_draw_input_progress((Direction *)draw_arg->sequence, SIM_SEQ_LENGTH,
+                             draw_arg->progress);
+}
+
+static void sim_timer_cmd(const void *arg)
+{
+    uint32_t remaining_ms;
+    memcpy(&remaining_ms, arg, sizeof(remaining_ms));
+    game_draw_timer(remaining_ms);
+}
+
+/**
+ * Una pulsación: la interrupción ocurre ahora, el bucle de eventos la
+ * entrega tras 'wake_us' y el juego encola lo que toque dibujar.
+ */
+static void sim_press(void (*draw)(const void *), const sim_draw_arg_t *arg, uint32_t wake_us)
+{
+    int64_t input_us = latency_now_us();
+    sim_sleep_us(wake_us);
+
+    latency_trace_t trace;
+    latency_trace_begin(&trace, input_us);
+
+    render_call(draw, arg, sizeof(*arg));
+    render_present();
+
+    latency_trace_mark(&trace, LATENCY_POINT_ISSUED);
+    render_latency(&trace);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = (argc > 1) ? atoi(argv[1]) : 10;
+
+    ili9341_init();
+    ili9341_set_async(true);
+    ili9341_framebuffer_enable(ILI9341_FB_INDEXED4);
+    ili9341_sim_set_realtime(true);
+    if (!render_start()) {
+        return 1;
+    }
+
+    latency_set_budget(LATENCY_STAGE_DISPATCH, 1000);
+    latency_set_budget(LATENCY_STAGE_TOTAL, 50000);
+
+    srand(1234);
+    for (int round = 0; round < rounds; round++) {
+        sim_draw_arg_t arg = {0};
+        for (int i = 0; i < SIM_SEQ_LENGTH; i++) {
+            arg.sequence[i] = (Direction)(rand() % 4);
+        }
+
+        // Pulsación en el menú: pantalla completa con la secuencia
+        sim_press(sim_show_sequence_cmd, &arg, 50 + rand() % 200);
+        render_sync();
+
+        render_call(sim_input_screen_cmd, NULL, 0);
+        render_present();
+
+        // Pulsaciones correctas, con el reloj corriendo entre medias. Entre
+        // dos pulsaciones pasan al menos ~60 ms (nadie pulsa más rápido).
+        uint32_t remaining_ms = 10000;
+        for (int step = 1; step <= SIM_SEQ_LENGTH; step++) {
+            for (int tick = 0; tick < 3; tick++) {
+                remaining_ms -= 100;
+                render_call(sim_timer_cmd, &remaining_ms, sizeof(remaining_ms));
+                render_present();
+                sim_sleep_us(20000);
+            }
+            arg.progress = step;
+            sim_press(sim_input_progress_cmd, &arg, 50 + rand() % 200);
+        }
+        render_sync();
+    }
+
+    render_stop();
+    latency_report();
+    return 0;
+}
@@ -0,0 +1,442 @@
+/*
+ * Mesh relaying on a simulated grid
+ * ---------------------------------
+ *
+ * GRID x GRID nodes one unit apart; a node hears every node within
+ * RANGE units (its 8 neighbours). Each node runs its own mesh_node
+ * (mesh.h) on real frames (packet.h). Time is virtual, in 1 ms steps;
+ * frames take their airtime at SF9 and a receiver loses a frame if
+ * another one it can hear overlaps it or if it was transmitting itself
+ * (half duplex). Before transmitting a node listens and waits a random
+ * 1-20 ms while the channel is busy (LBT).
+ *
+ *   1. Delivery: floods from random nodes to random nodes, one every
+ *      FLOOD_INTERVAL_MS. Delivered share, transmissions per flood and
+ *      latency for each hop limit, with and without suppression.
+ *   2. Duplicate cache: false positives of the rotating Bloom filter,
+ *      measured against its estimate. The last MESH_CACHE_GENERATION
+ *      floods must always be found.
+ *   3. Storm: one node hears 1000 new floods at once. Relays waiting
+ *      must stay within MESH_RELAY_SLOTS; the rest are dropped (or
+ *      taken for duplicates by the cache).
+ *   4. Reboot: a node floods, restarts and floods again. Its neighbour
+ *      still holds the first floods in its cache and must take the new
+ *      ones for new.
+ *   5. Cost: time per meshReceive (new flood and duplicate) and RAM per
+ *      node.
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/mesh_sim \
+ *       testplayground/mesh_sim.c src/mesh.c src/link.c src/packet.c \
+ *       src/sx1278.c src/sx1278_sim.c -pthread -lm
+ *
+ * Usage:
+ *   ./testplayground/mesh_sim [floods]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "link.h"
+#include "mesh.h"
+#include "packet.h"
+#include "sx1278.h"
+
+#define GRID               5
+#define NODES              (GRID * GRID)
+#define RANGE              1.5
+#define PAYLOAD_SIZE       24
+#define FLOOD_INTERVAL_MS  6000
+#define MAX_FLOODS         2000
+
+typedef struct{
+
+    mesh_node mesh;
+    bool transmitting;
+    int64_t tx_end_us;
+    uint8_t tx_frame[PACKET_MAX_SIZE];
+    size_t tx_length;
+    bool lost[NODES];           // receivers that will not get the frame on air
+    int64_t backoff_until_us;
+    uint8_t outgoing[PACKET_MAX_SIZE]; // flood of its own waiting for the channel
+    size_t outgoing_length;
+
+} sim_node;
+
+typedef struct{
+
+    uint32_t floods;
+    uint32_t delivered;
+    uint64_t transmissions;
+    double latency_ms;
+    uint32_t suppressed;
+    uint32_t expired;
+
+} run_result;
+
+static sim_node nodes[NODES];
+static int64_t flood_start_us[MAX_FLOODS];
+static bool flood_delivered[MAX_FLOODS];
+static uint64_t random_state;
+
+static double nextRandom(void){
+
+    // xorshift64*: same sequence on every run
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (double)((random_state * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static bool inRange(int first, int second){
+
+    double dx = first % GRID - second % GRID;
+    double dy = first / GRID - second / GRID;
+    return first != second && dx * dx + dy * dy <= RANGE * RANGE;
+}
+
+static bool channelBusy(int index){
+
+    for(int other = 0; other < NODES; other++){
+        if(nodes[other].transmitting && inRange(index, other)){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void startTransmission(int index, const uint8_t *frame, size_t length, int64_t now_us, run_result *result){
+
+    sim_node *node = &nodes[index];
+    memcpy(node->tx_frame, frame, length);
+    node->tx_length = length;
+    node->transmitting = true;
+    node->tx_end_us = now_us + linkAirtimeUs(frame, length);
+    memset(node->lost, 0, sizeof(node->lost));
+    result->transmissions++;
+
+    for(int other = 0; other < NODES; other++){
+        if(!nodes[other].transmitting || other == index){
+            continue;
+        }
+        // Both frames are lost wherever both can be heard, and by the two senders
+        for(int receiver = 0; receiver < NODES; receiver++){
+            if(inRange(receiver, index) && inRange(receiver, other)){
+                node->lost[receiver] = true;
+                nodes[other].lost[receiver] = true;
+            }
+        }
+        nodes[other].lost[index] = true;
+        node->lost[other] = true;
+    }
+}
+
+static void finishTransmission(int index, int64_t now_us){
+
+    sim_node *node = &nodes[index];
+    node->transmitting = false;
+    for(int receiver = 0; receiver < NODES; receiver++){
+        if(!inRange(receiver, index) || node->lost[receiver]){
+            continue;
+        }
+        if(meshReceive(&nodes[receiver].mesh, node->tx_frame, node->tx_length, now_us)){
+            packet_view view;
+            packetDecode(node->tx_frame, node->tx_length, &view);
+            uint32_t flood = view.header.sequence;
+            if(flood < MAX_FLOODS && !flood_delivered[flood]){
+                flood_delivered[flood] = true;
+                flood_start_us[flood] = now_us - flood_start_us[flood]; // now the latency
+            }
+        }
+    }
+}
+
+// Sends when the channel is free, after a random backoff otherwise
+static bool tryToSend(int index, int64_t now_us){
+
+    sim_node *node = &nodes[index];
+    if(node->transmitting || now_us < node->backoff_until_us){
+        return false;
+    }
+    if(channelBusy(index)){
+        node->backoff_until_us = now_us + (1 + (int64_t)(nextRandom() * 20)) * 1000;
+        return false;
+    }
+    return true;
+}
+
+static run_result runDelivery(uint8_t hops, uint8_t suppress_count, int floods){
+
+    run_result result = {0};
+    mesh_config config = MESH_CONFIG_DEFAULT;
+    config.hops = hops;
+    config.suppress_count = suppress_count;
+    memset(nodes, 0, sizeof(nodes));
+    for(int index = 0; index < NODES; index++){
+        meshInit(&nodes[index].mesh, (uint32_t)index + 1, &config);
+    }
+    memset(flood_delivered, 0, sizeof(flood_delivered));
+    random_state = 0x9E3779B97F4A7C15ULL;
+
+    int64_t end_us = (int64_t)(floods + 10) * FLOOD_INTERVAL_MS * 1000;
+    int sent = 0;
+    for(int64_t now_us = 0; now_us < end_us; now_us += 1000){
+        for(int index = 0; index < NODES; index++){
+            if(nodes[index].transmitting && nodes[index].tx_end_us <= now_us){
+                finishTransmission(index, now_us);
+            }
+        }
+
+        // A new flood between two random nodes, at least two hops apart
+        if(sent < floods && now_us >= (int64_t)sent * FLOOD_INTERVAL_MS * 1000){
+            int origin, destination;
+            do{
+                origin = (int)(nextRandom() * NODES);
+                destination = (int)(nextRandom() * NODES);
+            } while(origin == destination || inRange(origin, destination));
+
+            packet_header header = { PACKET_VERSION, PACKET_TYPE_DATA, PACKET_FLAG_NONE,
+                                     (uint32_t)origin + 1, (uint32_t)destination + 1, (uint32_t)sent };
+            uint8_t payload[PAYLOAD_SIZE];
+            for(size_t byte = 0; byte < sizeof(payload); byte++){
+                payload[byte] = (uint8_t)(nextRandom() * 256);
+            }
+            sim_node *node = &nodes[origin];
+            packetEncode(&header, payload, sizeof(payload), node->outgoing, sizeof(node->outgoing),
+                         &node->outgoing_length);
+            meshAttach(&node->mesh, node->outgoing, node->outgoing_length, sizeof(node->outgoing),
+                       &node->outgoing_length);
+            flood_start_us[sent] = now_us;
+            sent++;
+        }
+
+        for(int index = 0; index < NODES; index++){
+            sim_node *node = &nodes[index];
+            bool has_own = node->outgoing_length > 0;
+            if(!has_own && meshRelayWaitUs(&node->mesh, now_us) != 0){
+                continue;
+            }
+            if(!tryToSend(index, now_us)){
+                continue;
+            }
+            uint8_t frame[PACKET_MAX_SIZE];
+            size_t length = 0;
+            if(has_own){
+                startTransmission(index, node->outgoing, node->outgoing_length, now_us, &result);
+                node->outgoing_length = 0;
+            } else if(meshNextRelay(&node->mesh, now_us, frame, sizeof(frame), &length)){
+                startTransmission(index, frame, length, now_us, &result);
+            }
+        }
+    }
+
+    result.floods = (uint32_t)sent;
+    for(int flood = 0; flood < sent; flood++){
+        if(flood_delivered[flood]){
+            result.delivered++;
+            result.latency_ms += flood_start_us[flood] / 1000.0;
+        }
+    }
+    result.latency_ms = result.delivered > 0 ? result.latency_ms / result.delivered : 0;
+    for(int index = 0; index < NODES; index++){
+        result.suppressed += nodes[index].mesh.stats.suppressed;
+        result.expired += nodes[index].mesh.stats.expired;
+    }
+    return result;
+}
+
+// A DATA flood from origin as a relay would hear it
+static size_t makeFlood(uint32_t origin, uint32_t flood_id, uint8_t *frame){
+
+    packet_header header = { PACKET_VERSION, PACKET_TYPE_DATA, PACKET_FLAG_NONE, origin, 999, flood_id };
+    uint8_t payload[PAYLOAD_SIZE] = {0};
+    size_t length = 0;
+    packetEncode(&header, payload, sizeof(payload), frame, PACKET_MAX_SIZE, &length);
+    packet_mesh mesh = { flood_id, origin, 3 };
+    packetSetMesh(frame, length, PACKET_MAX_SIZE, &mesh, &length);
+    return length;
+}
+
+static int checkCache(void){
+
+    static mesh_node node;
+    mesh_config config = MESH_CONFIG_DEFAULT;
+    config.relay = false;
+    meshInit(&node, 1, &config);
+    int failures = 0;
+
+    printf("rotating Bloom filter: 2 x %d bits (%zu bytes), %d hashes, %d floods per generation\n",
+           MESH_CACHE_BITS, sizeof(node.cache), MESH_CACHE_HASHES, MESH_CACHE_GENERATION);
+    printf("floods seen  false positives  estimate  recent ones missed\n");
+
+    uint32_t inserted = 0;
+    const uint32_t checkpoints[] = { 128, 256, 512, 4096, 65536 };
+    for(size_t point = 0; point < sizeof(checkpoints) / sizeof(checkpoints[0]); point++){
+        uint8_t frame[PACKET_MAX_SIZE];
+        for(; inserted < checkpoints[point]; inserted++){
+            size_t length = makeFlood(2 + inserted % 50, inserted / 50, frame);
+            meshReceive(&node, frame, length, 0);
+        }
+        // Origins 1000+ never flooded: every hit is a false positive. A probe
+        // goes into the cache too, so each one runs on a copy at this filling
+        static mesh_node filled;
+        filled = node;
+        uint32_t hits = 0, probes = 20000;
+        for(uint32_t probe = 0; probe < probes; probe++){
+            size_t length = makeFlood(1000 + probe % 50, probe, frame);
+            meshReceive(&node, frame, length, 0);
+            hits += node.stats.duplicates != filled.stats.duplicates;
+            node = filled;
+        }
+
+        uint32_t recent = inserted < MESH_CACHE_GENERATION ? inserted : MESH_CACHE_GENERATION;
+        uint32_t missed = 0;
+        for(uint32_t back = 1; back <= recent; back++){
+            uint32_t flood = inserted - back;
+            size_t length = makeFlood(2 + flood % 50, flood / 50, frame);
+            uint32_t duplicates = node.stats.duplicates;
+            meshReceive(&node, frame, length, 0);
+            missed += node.stats.duplicates == duplicates;
+        }
+
+        // Fill of each generation at this point, then k hashes hitting set bits in either
+        uint32_t in_current = node.generation_inserts;
+        uint32_t in_older = inserted > MESH_CACHE_GENERATION ? MESH_CACHE_GENERATION : 0;
+        double fill_current = 1.0 - exp(-(double)MESH_CACHE_HASHES * in_current / MESH_CACHE_BITS);
+        double fill_older = 1.0 - exp(-(double)MESH_CACHE_HASHES * in_older / MESH_CACHE_BITS);
+        double estimate = 1.0 - (1.0 - pow(fill_current, MESH_CACHE_HASHES)) * (1.0 - pow(fill_older, MESH_CACHE_HASHES));
+
+        double rate = (double)hits / probes;
+        printf("%11u  %14.2f%%  %7.2f%%  %18u\n", inserted, rate * 100, estimate * 100, missed);
+        failures += missed > 0;
+        failures += rate > 0.02;
+    }
+    printf("\n");
+    return failures;
+}
+
+static int checkStorm(void){
+
+    static mesh_node node;
+    meshInit(&node, 1, NULL);
+    uint8_t frame[PACKET_MAX_SIZE];
+    for(uint32_t flood = 0; flood < 1000; flood++){
+        size_t length = makeFlood(2 + flood, 0, frame);
+        meshReceive(&node, frame, length, 0);
+    }
+    int waiting = 0;
+    for(int slot = 0; slot < MESH_RELAY_SLOTS; slot++){
+        waiting += node.relays[slot].in_use;
+    }
+    // The few the cache takes for duplicates (false positives) are neither
+    printf("storm: 1000 new floods at once -> %d relays waiting, %u dropped, %u duplicates; %zu bytes per node\n\n",
+           waiting, node.stats.relays_dropped, node.stats.duplicates, sizeof(mesh_node));
+    return waiting != MESH_RELAY_SLOTS || waiting + node.stats.relays_dropped + node.stats.duplicates != 1000;
+}
+
+static int checkReboot(void){
+
+    static mesh_node origin, neighbour;
+    mesh_config config = MESH_CONFIG_DEFAULT;
+    config.relay = false;
+    meshInit(&neighbour, 2, &config);
+    uint32_t heard[2] = { 0, 0 };
+
+    for(int boot = 0; boot < 2; boot++){
+        meshInit(&origin, 1, &config);
+        for(uint32_t index = 0; index < 20; index++){
+            packet_header header = { PACKET_VERSION, PACKET_TYPE_DATA, PACKET_FLAG_NONE, 1, 2, index };
+            uint8_t payload[PAYLOAD_SIZE] = {0};
+            uint8_t frame[PACKET_MAX_SIZE];
+            size_t length = 0;
+            packetEncode(&header, payload, sizeof(payload), frame, PACKET_MAX_SIZE, &length);
+            meshAttach(&origin, frame, length, PACKET_MAX_SIZE, &length);
+            heard[boot] += meshReceive(&neighbour, frame, length, 0);
+        }
+    }
+    printf("reboot: 20 floods before, 20 after -> %u and %u delivered, %u duplicates\n\n",
+           heard[0], heard[1], neighbour.stats.duplicates);
+    return heard[0] != 20 || heard[1] != 20;
+}
+
+static double seconds(void){
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void measureCost(void){
+
+    static mesh_node node;
+    mesh_config config = MESH_CONFIG_DEFAULT;
+    config.relay = false; // the decision only: no frame copies
+    meshInit(&node, 1, &config);
+
+    enum { FRAMES = 1024, ROUNDS = 200 };
+    static uint8_t frames[FRAMES][PACKET_MAX_SIZE];
+    static size_t lengths[FRAMES];
+    for(int index = 0; index < FRAMES; index++){
+        lengths[index] = makeFlood(2 + index % 50, (uint32_t)index, frames[index]);
+    }
+
+    double start = seconds();
+    for(int round = 0; round < ROUNDS; round++){
+        for(int index = 0; index < FRAMES; index++){
+            meshReceive(&node, frames[index], lengths[index], 0);
+        }
+    }
+    double elapsed = seconds() - start;
+    printf("meshReceive: %.0f ns per frame (decode, CRC and cache; %u new, %u duplicates)\n\n",
+           elapsed / (FRAMES * ROUNDS) * 1e9, FRAMES * ROUNDS - node.stats.duplicates, node.stats.duplicates);
+}
+
+int main(int argc, char **argv){
+
+    int floods = argc > 1 ? atoi(argv[1]) : 300;
+    if(floods > MAX_FLOODS){
+        floods = MAX_FLOODS;
+    }
+
+    // Floods go at the base rate: the radio configuration
+    sx1278_config_t radio = SX1278_CONFIG_DEFAULT;
+    radio.spreading_factor = 9;
+    if(!sx1278_init(&radio)){
+        return 1;
+    }
+    linkInit(NULL);
+
+    int failures = 0;
+    uint8_t probe[PACKET_MAX_SIZE];
+    size_t probe_length = makeFlood(2, 0, probe);
+    printf("\n%dx%d grid, range %.1f, %d floods, %u ms per %zu byte frame at SF9\n\n", GRID, GRID, RANGE,
+           floods, (unsigned)(linkAirtimeUs(probe, probe_length) / 1000), probe_length);
+    printf("hops  suppression  delivered  tx per flood  latency ms  suppressed  expired\n");
+
+    for(uint8_t hops = 1; hops <= 5; hops++){
+        for(int suppress = 1; suppress >= 0; suppress--){
+            run_result with = runDelivery(hops, suppress ? 2 : 0, floods);
+            printf("%4u  %-11s  %8.1f%%  %12.1f  %10.0f  %10u  %7u\n", hops, suppress ? "2 copies" : "off",
+                   100.0 * with.delivered / with.floods, (double)with.transmissions / with.floods,
+                   with.latency_ms, with.suppressed, with.expired);
+            // Corner to corner takes 3 relays: from there on nearly everything arrives
+            if(hops >= 4 && with.delivered < with.floods * 95 / 100){
+                failures++;
+            }
+        }
+    }
+    printf("\n");
+
+    failures += checkCache();
+    failures += checkStorm();
+    failures += checkReboot();
+    measureCost();
+
+    sx1278_stop();
+    printf("%s\n", failures == 0 ? "OK" : "FAILURES");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+/**
+ * Radio SX1278 simulada en el host (sin placa)
+ * --------------------------------------------
+ *
+ * Arranca el driver real (src/sx1278.c) sobre el chip simulado
+ * (src/sx1278_sim.c) en modo tiempo real y el nodo 1 habla con un nodo 2
+ * que vive en este programa: lo que el chip transmite llega al nodo 2 por
+ * el callback del simulador y lo que envía el nodo 2 se inyecta como
+ * paquete recibido. Comprueba:
+ *
+ *   - que sendMessage vuelve en cuanto el frame está en la cola, mucho
+ *     antes de su tiempo en el aire, y que el nodo 2 lo decodifica
+ *   - que con la cola de mensajes del planificador (scheduler.h) llena
+ *     sendMessage devuelve 901 sin bloquear
+ *   - que los paquetes recibidos llegan a la cola RX con su RSSI y SNR
+ *     y pasan por receiveMessage
+ *   - paquetes con CRC incorrecto y paquetes que llegan mientras la radio
+ *     transmite
+ *   - listen-before-talk: con el canal ocupado el driver devuelve el frame
+ *     y el planificador lo reintenta cuando se libera
+ *   - que con la radio escuchando y sin tráfico no hay ni un acceso SPI
+ *     (nadie sondea el chip)
+ *
+ * Compilación (desde la raíz del repositorio):
+ *
+ *   gcc -O2 -pthread -Iinclude -o testplayground/radio_sim \
+ *       testplayground/radio_sim.c src/sx1278.c src/sx1278_sim.c \
+ *       src/transmiter.c src/packet.c src/compress.c src/aead.c \
+ *       src/session.c src/x25519.c src/sha256.c src/fragment.c \
+ *       src/scheduler.c src/link.c src/mesh.c src/fec.c -lm
+ *
+ * Uso:
+ *   ./testplayground/radio_sim
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sx1278.h"
+#include "sx1278_sim.h"
+#include "transmitter.h"
+
+#define AIR_CAPACITY  16
+
+// Lo que el nodo 1 ha puesto en el aire (lo escribe el hilo del simulador)
+static pthread_mutex_t air_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t air_frames[AIR_CAPACITY][SX1278_MAX_PAYLOAD];
+static size_t air_lengths[AIR_CAPACITY];
+static int air_count;
+
+static const char *chat_lines[] = {
+    "hola, ya estoy en camino\n",
+    "ok see you at the bridge in 10 min\n",
+    "llevas agua? aqui no hay nada\n",
+    "battery at 40%, switching the screen off\n",
+};
+
+static double now_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+static void on_air(const uint8_t *frame, size_t length, void *context)
+{
+    (void)context;
+    pthread_mutex_lock(&air_lock);
+    if (air_count < AIR_CAPACITY) {
+        memcpy(air_frames[air_count], frame, length);
+        air_lengths[air_count] = length;
+        air_count++;
+    }
+    pthread_mutex_unlock(&air_lock);
+}
+
+static int take_air(uint8_t *frame)
+{
+    int length = -1;
+    pthread_mutex_lock(&air_lock);
+    if (air_count > 0) {
+        length = (int)air_lengths[0];
+        memcpy(frame, air_frames[0], (size_t)length);
+        memmove(air_frames[0], air_frames[1], (size_t)(air_count - 1) * sizeof(air_frames[0]));
+        memmove(air_lengths, air_lengths + 1, (size_t)(air_count - 1) * sizeof(air_lengths[0]));
+        air_count--;
+    }
+    pthread_mutex_unlock(&air_lock);
+    return length;
+}
+
+// Hace de bucle de eventos para el planificador hasta que todo lo
+// encolado haya salido (o se haya descartado)
+static double wait_tx_idle(void)
+{
+    double start = now_us();
+    while (schedulerService((int64_t)now_us()) >= 0 || sx1278_tx_pending() > 0) {
+        usleep(1000);
+    }
+    return now_us() - start;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    // La salida de sendMessage va por stdout; el informe, por stderr
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    sx1278_sim_set_realtime(true);
+    sx1278_sim_set_tx_hook(on_air, NULL);
+    if (!sx1278_init(NULL)) {
+        fprintf(stderr, "sx1278_init falló\n");
+        return 1;
+    }
+    usleep(10000);
+
+    // Cada extremo de los dos enlaces, como los ve transmiter.c
+    device node_one = { .transmitter_id = 1, .receiver_id = 2 };        // 1 -> 2, emisor
+    device node_one_peer = { .transmitter_id = 1, .receiver_id = 2 };   // 1 -> 2, receptor
+    device node_two = { .transmitter_id = 2, .receiver_id = 1 };        // 2 -> 1, emisor
+    device node_two_peer = { .transmitter_id = 2, .receiver_id = 1 };   // 2 -> 1, receptor
+
+    // 1. sendMessage solo encola
+    fprintf(stderr, "\n1. sendMessage con la radio en tiempo real\n");
+    for (int i = 0; i < 3; i++) {
+        char text[MESSAGE_SIZE];
+        strcpy(text, chat_lines[i]);
+        strcpy(node_one.message, text);
+        strcpy(node_one_peer.message, text);
+
+        double start = now_us();
+        int error = sendMessage(2, 1, text, &node_one, &node_one_peer, NULL);
+        double elapsed = now_us() - start;
+        node_one.sequence++;
+        fprintf(stderr, "   mensaje %d: error %d, sendMessage %.0f us\n", i, error, elapsed);
+        failures += error != 0;
+    }
+    double drain_us = wait_tx_idle();
+    fprintf(stderr, "   la cola tardó %.1f ms en salir al aire\n", drain_us / 1000);
+
+    for (int i = 0; i < 3; i++) {
+        uint8_t frame[SX1278_MAX_PAYLOAD];
+        int length = take_air(frame);
+        int error = length > 0 ? receiveMessage(frame, (size_t)length, &node_one_peer) : -1;
+        bool same = error == 0 && strcmp(node_one_peer.message, chat_lines[i]) == 0;
+        fprintf(stderr, "   nodo 2 recibe %d bytes (%u us en el aire): %s\n", length,
+                length > 0 ? sx1278_airtime_us((size_t)length) : 0, same ? "ok" : "DISTINTO");
+        failures += !same;
+    }
+
+    // 2. Cola del planificador llena: 1 en el aire + SCHEDULER_QUEUE_LEN esperando
+    fprintf(stderr, "\n2. Ráfaga de %d mensajes\n", SCHEDULER_QUEUE_LEN + 3);
+    int accepted = 0, rejected = 0;
+    scheduler_ticket last_ticket = 0;
+    double burst_start = now_us();
+    for (int i = 0; i < SCHEDULER_QUEUE_LEN + 3; i++) {
+        char text[MESSAGE_SIZE];
+        strcpy(text, chat_lines[i % 4]);
+        scheduler_ticket ticket = 0;
+        int error = sendMessage(2, 1, text, &node_one, &node_one_peer, &ticket);
+        node_one.sequence++;
+        if (error == 0) { accepted++; last_ticket = ticket; }
+        else if (error == SCHEDULER_ERROR_QUEUE_FULL) rejected++;
+    }
+    double burst_us = now_us() - burst_start;
+    fprintf(stderr, "   %d encolados, %d rechazados con 901, en %.0f us\n", accepted, rejected, burst_us);
+    failures += rejected == 0;
+
+    scheduler_status status;
+    scheduler_ticket_info info;
+    schedulerGetStatus((int64_t)now_us(), &status);
+    schedulerTicketInfo(last_ticket, (int64_t)now_us(), &info);
+    fprintf(stderr, "   cola de mensajes: %u frames, %.1f ms de aire; el último (ticket %u) "
+            "tiene %u delante y espera %.1f ms\n", status.depth[SCHEDULER_PRIORITY_MESSAGE],
+            status.queued_airtime_us / 1000.0, (unsigned)last_ticket, info.position,
+            info.expected_wait_us / 1000.0);
+    double expected_ms = info.expected_wait_us / 1000.0;
+    double drained_ms = wait_tx_idle() / 1000;
+    fprintf(stderr, "   la cola se vació en %.1f ms (estimado %.1f ms + su tiempo en el aire)\n",
+            drained_ms, expected_ms);
+    while (take_air((uint8_t[SX1278_MAX_PAYLOAD]){0}) > 0) {
+    }
+
+    // 3. Recepción con RSSI y SNR
+    fprintf(stderr, "\n3. Paquetes del nodo 2\n");
+    const struct { int16_t rssi; float snr; } links[] = { { -60, 9.5f }, { -118, -7.25f }, { -95, 0.0f } };
+    for (int i = 0; i < 3; i++) {
+        uint8_t frame[PACKET_MAX_SIZE];
+        size_t length = 0;
+        encodeMessage(chat_lines[3 - i], &node_two, frame, sizeof(frame), &length);
+        node_two.sequence++;
+
+        double start = now_us();
+        sx1278_sim_inject(frame, length, links[i].rssi, links[i].snr, false);
+
+        sx1278_packet_t packet;
+        if (!sx1278_receive(&packet, 100)) {
+            fprintf(stderr, "   paquete %d no llegó\n", i);
+            failures++;
+            continue;
+        }
+        double latency = now_us() - start;
+        int error = receiveMessage(packet.data, packet.length, &node_two_peer);
+        bool same = error == 0 && strcmp(node_two_peer.message, chat_lines[3 - i]) == 0 &&
+                    packet.rssi_dbm == links[i].rssi && packet.snr_db == links[i].snr;
+        fprintf(stderr, "   %3u bytes  RSSI %4d dBm  SNR %6.2f dB  RxDone -> cola %5.0f us  %s\n",
+                packet.length, packet.rssi_dbm, packet.snr_db, latency, same ? "ok" : "DISTINTO");
+        failures += !same;
+    }
+
+    // 4. CRC incorrecto y paquete que llega mientras transmitimos
+    fprintf(stderr, "\n4. Casos de error\n");
+    uint8_t junk[32] = { 0x55 };
+    sx1278_sim_inject(junk, sizeof(junk), -100, 2.0f, true);
+    usleep(5000);
+    sx1278_packet_t packet;
+    bool got = sx1278_receive(&packet, 20);
+    fprintf(stderr, "   CRC incorrecto: %s\n", got ? "ENTREGADO" : "descartado");
+    failures += got;
+
+    char text[MESSAGE_SIZE];
+    strcpy(text, chat_lines[0]);
+    sendMessage(2, 1, text, &node_one, &node_one_peer, NULL);
+    node_one.sequence++;
+    usleep(5000);
+    bool heard = sx1278_sim_inject(junk, sizeof(junk), -80, 5.0f, false);
+    fprintf(stderr, "   paquete durante TX: %s\n", heard ? "RECIBIDO" : "perdido (half-duplex)");
+    failures += heard;
+    wait_tx_idle();
+    while (take_air((uint8_t[SX1278_MAX_PAYLOAD]){0}) > 0) {
+    }
+
+    // Otro nodo ocupa el canal 150 ms: el frame espera y sale después
+    scheduler_stats before_busy;
+    schedulerGetStats(&before_busy);
+    sx1278_sim_set_channel(-70, true);
+    scheduler_ticket busy_ticket = 0;
+    sendMessage(2, 1, text, &node_one, &node_one_peer, &busy_ticket);
+    node_one.sequence++;
+    double busy_start = now_us();
+    while (now_us() - busy_start < 150000) {
+        schedulerService((int64_t)now_us());
+        usleep(1000);
+    }
+    sx1278_sim_set_channel(-120, false);
+    wait_tx_idle();
+    scheduler_stats after_busy;
+    schedulerGetStats(&after_busy);
+    schedulerTicketInfo(busy_ticket, (int64_t)now_us(), &info);
+    uint8_t busy_frame[SX1278_MAX_PAYLOAD];
+    int busy_length = take_air(busy_frame);
+    bool after_lbt = info.state == SCHEDULER_TICKET_SENT && busy_length > 0 &&
+                     receiveMessage(busy_frame, (size_t)busy_length, &node_one_peer) == 0;
+    fprintf(stderr, "   canal ocupado 150 ms: %u intentos devueltos por LBT, luego %s en %.0f ms\n",
+            after_busy.channel_busy - before_busy.channel_busy, after_lbt ? "enviado" : "NO ENVIADO",
+            (now_us() - busy_start) / 1000);
+    failures += !after_lbt || after_busy.channel_busy == before_busy.channel_busy;
+
+    // 5. Sin tráfico, la radio no genera ni un acceso SPI
+    sx1278_sim_stats_t before, after;
+    sx1278_sim_get_stats(&before);
+    usleep(200000);
+    sx1278_sim_get_stats(&after);
+    fprintf(stderr, "\n5. 200 ms escuchando sin tráfico: %u transacciones SPI\n",
+            after.spi_transactions - before.spi_transactions);
+    failures += after.spi_transactions != before.spi_transactions;
+
+    sx1278_stats_t stats;
+    sx1278_get_stats(&stats);
+    fprintf(stderr, "\ndriver: %u encolados, %u rechazados, %u TxDone, %u canal ocupado, %u recibidos, "
+            "%u CRC, %u interrupciones, %u accesos SPI\n",
+            stats.tx_queued, stats.tx_rejected, stats.tx_done, stats.tx_busy, stats.rx_packets,
+            stats.rx_crc_errors, stats.interrupts, stats.spi_transactions);
+    fprintf(stderr, "chip:   %u transmitidos (%.1f ms en el aire), %u recibidos, %u perdidos, "
+            "%u bytes de FIFO\n",
+            after.packets_sent, after.airtime_us / 1000.0, after.packets_received,
+            after.packets_missed, after.fifo_bytes);
+
+    sx1278_stop();
+    fprintf(stderr, "\n%s (%d fallos)\n", failures == 0 ? "OK" : "FALLOS", failures);
+    return failures == 0 ? 0 : 1;
+}
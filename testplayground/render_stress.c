@@ -0,0 +1,139 @@
+/**
+ * Prueba de estrés de la cola de render en el host (sin placa)
+ * -----------------------------------------------------------
+ *
+ * El hilo principal hace de productor (como el juego en el núcleo 0) y
+ * encola a toda velocidad una mezcla de comandos; el hilo de render los
+ * ejecuta contra el emulador ili9341_sim. Se comprueba que:
+ *
+ *   - Los comandos llegan todos, una sola vez y en orden (cada
+ *     render_call lleva un número de secuencia y una suma de control de
+ *     sus argumentos).
+ *   - render_sync solo vuelve cuando todo lo encolado se ha ejecutado.
+ *   - Lo último dibujado es lo que se ve en el panel emulado.
+ *
+ * Compilación (desde la raíz del repositorio):
+ *
+ *   gcc -O2 -pthread -Iinclude -o testplayground/render_stress \
+ *       testplayground/render_stress.c src/render.c src/ili9341.c \
+ *       src/ili9341_sim.c src/font5x7.c src/latency.c
+ *
+ * Uso:
+ *   ./testplayground/render_stress [comandos]
+ *
+ * Conviene probarlo también con -fsanitize=thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ili9341.h"
+#include "ili9341_sim.h"
+#include "render.h"
+
+typedef struct {
+    uint32_t sequence;
+    uint32_t payload[5];
+    uint32_t checksum;
+} stress_call_arg_t;
+
+// Solo los toca el hilo de render
+static uint32_t stress_expected_sequence;
+static uint32_t stress_errors;
+
+static uint32_t stress_checksum(const stress_call_arg_t *arg)
+{
+    uint32_t sum = arg->sequence * 2654435761u;
+    for (int i = 0; i < 5; i++) {
+        sum = (sum ^ arg->payload[i]) * 16777619u;
+    }
+    return sum;
+}
+
+static void stress_call(const void *data)
+{
+    const stress_call_arg_t *arg = data;
+    if (arg->sequence != stress_expected_sequence || arg->checksum != stress_checksum(arg)) {
+        stress_errors++;
+    }
+    stress_expected_sequence = arg->sequence + 1;
+}
+
+static double stress_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t total = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : 200000;
+
+    ili9341_init();
+    ili9341_set_async(true);
+    if (!render_start()) {
+        return 1;
+    }
+
+    srand(1234);
+    uint32_t sequence = 0;
+    uint32_t syncs = 0;
+    double start = stress_now_s();
+
+    for (uint32_t i = 0; i < total; i++) {
+        int kind = rand() % 16;
+
+        if (kind < 10) {
+            stress_call_arg_t arg = { .sequence = sequence++ };
+            for (int k = 0; k < 5; k++) arg.payload[k] = (uint32_t)rand();
+            arg.checksum = stress_checksum(&arg);
+            render_call(stress_call, &arg, sizeof(arg));
+        } else if (kind < 13) {
+            render_fill_rect(rand() % ILI9341_WIDTH, rand() % ILI9341_HEIGHT,
+                             1 + rand() % 8, 1 + rand() % 8, (uint16_t)rand());
+        } else if (kind < 15) {
+            char text[8];
+            snprintf(text, sizeof(text), "%u", i % 100000);
+            render_text(rand() % 200, rand() % 300, text, 0xFFFF, 0x0000, 1);
+        } else {
+            // De vez en cuando esperamos a que se vacíe la cola
+            render_sync();
+            syncs++;
+            render_stats_t stats;
+            render_get_stats(&stats);
+            if (stats.executed != stats.submitted) {
+                printf("render_sync volvió con %u comandos pendientes\n",
+                       stats.submitted - stats.executed);
+                stress_errors++;
+            }
+        }
+    }
+
+    // Último dibujo conocido: debe ser lo que quede en el panel
+    render_fill_rect(10, 10, 50, 50, ILI9341_COLOR_RED);
+    render_sync();
+    double elapsed = stress_now_s() - start;
+
+    render_stats_t stats;
+    render_get_stats(&stats);
+    render_stop();
+
+    if (stress_expected_sequence != sequence) {
+        printf("Se ejecutaron %u render_call de %u\n", stress_expected_sequence, sequence);
+        stress_errors++;
+    }
+    if (ili9341_sim_get_pixel(30, 30) != ILI9341_COLOR_RED) {
+        printf("El último rectángulo no está en el panel\n");
+        stress_errors++;
+    }
+
+    printf("%u comandos en %.2f s (%.0f comandos/s), %u syncs\n",
+           stats.submitted, elapsed, stats.submitted / elapsed, syncs);
+    printf("cola llena %u veces, profundidad máxima %u de %u\n",
+           stats.full_waits, stats.max_depth, RENDER_QUEUE_LEN);
+    printf("%s (%u errores)\n", stress_errors ? "FALLO" : "OK", stress_errors);
+    return stress_errors ? 1 : 0;
+}
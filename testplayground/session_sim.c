@@ -0,0 +1,325 @@
+/*
+ * Two-node session simulation
+ * ---------------------------
+ *
+ * Node 1 and node 2 each own a session_cache (session.h) and talk
+ * through encodeMessage/receiveMessage, frames handed over in memory.
+ * Reports:
+ *
+ *   - cost of one full handshake (INIT + REPLY, both ends)
+ *   - steady-state cost per message (compress + seal + open), against
+ *     what it would be with an X25519 exchange per message
+ *   - a long exchange that crosses several rekeys, with a frame sealed
+ *     under the old key arriving after the responder already rekeyed
+ *   - a frame received twice (replayed)
+ *   - a node that reboots (sequence back to 0) and handshakes again:
+ *     its messages must get through at once, not after it passes the
+ *     sequences of its previous session
+ *   - a lost INIT and a lost REPLY: the handshake is retried after
+ *     SESSION_HANDSHAKE_TIMEOUT_MS and messages keep flowing both ways
+ *     meanwhile (virtual clock)
+ *   - one node talking to more peers than the cache holds
+ *   - a handshake from a node without the network key
+ *
+ * Build (from the repository root):
+ *
+ *   gcc -O2 -Iinclude -o testplayground/session_sim \
+ *       testplayground/session_sim.c src/session.c src/x25519.c \
+ *       src/sha256.c src/aead.c src/transmiter.c src/packet.c src/compress.c \
+ *       src/sx1278.c src/sx1278_sim.c src/fragment.c src/scheduler.c \
+ *       src/link.c src/mesh.c src/fec.c -pthread -lm
+ *
+ * Usage:
+ *   ./testplayground/session_sim [handshakes] [messages]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "session.h"
+#include "transmitter.h"
+
+#define EXTRA_PEERS 12
+
+static const char *chat_lines[] = {
+    "hola, ya estoy en camino\n",
+    "ok see you at the bridge in 10 min\n",
+    "llevas agua? aqui no hay nada\n",
+    "battery at 40%, switching the screen off\n",
+};
+
+static double nowSeconds(void){
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static int64_t nowUs(void){
+
+    return (int64_t)(nowSeconds() * 1e6);
+}
+
+// Full exchange: initiator sends INIT, responder answers, initiator finishes
+static int runHandshake(session_cache *initiator, session_cache *responder, uint32_t responder_id){
+
+    uint8_t init_frame[PACKET_MAX_SIZE], reply_frame[PACKET_MAX_SIZE];
+    size_t init_length = 0, reply_length = 0, unused_length = 0;
+
+    int error = sessionStartHandshake(initiator, responder_id, nowUs(), init_frame, sizeof(init_frame), &init_length);
+    if(error != 0) return error;
+    error = sessionHandleHandshake(responder, init_frame, init_length, nowUs(),
+                                   reply_frame, sizeof(reply_frame), &reply_length);
+    if(error != 0) return error;
+    return sessionHandleHandshake(initiator, reply_frame, reply_length, nowUs(),
+                                  init_frame, sizeof(init_frame), &unused_length);
+}
+
+// One message from sender to receiver through the whole pipeline
+static int deliver(device *sender, device *receiver, const char *text){
+
+    uint8_t frame[PACKET_MAX_SIZE];
+    size_t frame_length = 0;
+
+    int error = encodeMessage(text, sender, frame, sizeof(frame), &frame_length);
+    if(error != 0) return error;
+    error = receiveMessage(frame, frame_length, receiver);
+    if(error != 0) return error;
+    return strcmp(text, receiver->message) == 0 ? 0 : -1;
+}
+
+/*
+ * Node 1 and a fresh node 3: the first INIT is lost, then on a rekey the
+ * REPLY is lost. Returns the number of failed checks.
+ */
+static int lostHandshakes(session_cache *node_one, const uint8_t *network_key){
+
+    static session_cache node_three;
+    uint8_t init_frame[PACKET_MAX_SIZE], reply_frame[PACKET_MAX_SIZE];
+    size_t init_length = 0, reply_length = 0, unused_length = 0;
+    const int64_t timeout_us = (int64_t)SESSION_HANDSHAKE_TIMEOUT_MS * 1000;
+    int64_t now = nowUs();
+    int failures = 0;
+
+    sessionCacheInit(&node_three, 3, network_key);
+    device one_to_three_sender = { .transmitter_id = 1, .receiver_id = 3, .sessions = node_one };
+    device one_to_three_receiver = { .transmitter_id = 1, .receiver_id = 3, .sessions = &node_three };
+    device three_to_one_sender = { .transmitter_id = 3, .receiver_id = 1, .sessions = &node_three };
+    device three_to_one_receiver = { .transmitter_id = 3, .receiver_id = 1, .sessions = node_one };
+
+    // INIT lost: no keys, no second INIT until the timeout, then it works
+    sessionStartHandshake(node_one, 3, now, init_frame, sizeof(init_frame), &init_length);
+    failures += sessionRekeyDue(node_one, 3, now + timeout_us - 1);
+    failures += deliver(&one_to_three_sender, &one_to_three_receiver, chat_lines[0]) != SESSION_ERROR_NO_SESSION;
+    now += timeout_us;
+    failures += !sessionRekeyDue(node_one, 3, now);
+    failures += runHandshake(node_one, &node_three, 3) != 0;
+    failures += deliver(&one_to_three_sender, &one_to_three_receiver, chat_lines[1]) != 0;
+    failures += deliver(&three_to_one_sender, &three_to_one_receiver, chat_lines[2]) != 0;
+
+    // REPLY to a rekey lost: node 3 has new keys node 1 does not. Both keep
+    // talking under the old ones
+    now += (int64_t)SESSION_REKEY_SECONDS * 1000000;
+    failures += !sessionRekeyDue(node_one, 3, now);
+    sessionStartHandshake(node_one, 3, now, init_frame, sizeof(init_frame), &init_length);
+    sessionHandleHandshake(&node_three, init_frame, init_length, now, reply_frame, sizeof(reply_frame),
+                           &reply_length);
+    failures += deliver(&three_to_one_sender, &three_to_one_receiver, chat_lines[3]) != 0;
+    failures += deliver(&one_to_three_sender, &one_to_three_receiver, chat_lines[0]) != 0;
+    failures += sessionRekeyDue(node_one, 3, now + timeout_us - 1);
+
+    // Retried: the late REPLY to the lost INIT no longer fits
+    now += timeout_us;
+    failures += !sessionRekeyDue(node_one, 3, now);
+    uint8_t stale_reply[PACKET_MAX_SIZE];
+    memcpy(stale_reply, reply_frame, reply_length);
+    size_t stale_length = reply_length;
+    sessionStartHandshake(node_one, 3, now, init_frame, sizeof(init_frame), &init_length);
+    failures += sessionHandleHandshake(node_one, stale_reply, stale_length, now, init_frame, sizeof(init_frame),
+                                       &unused_length) != SESSION_ERROR_REJECTED;
+    sessionHandleHandshake(&node_three, init_frame, init_length, now, reply_frame, sizeof(reply_frame),
+                           &reply_length);
+    failures += sessionHandleHandshake(node_one, reply_frame, reply_length, now, init_frame, sizeof(init_frame),
+                                       &unused_length) != 0;
+
+    // Node 3 goes on under the old keys until node 1 uses the new ones
+    failures += deliver(&three_to_one_sender, &three_to_one_receiver, chat_lines[1]) != 0;
+    failures += deliver(&one_to_three_sender, &one_to_three_receiver, chat_lines[2]) != 0;
+    failures += deliver(&three_to_one_sender, &three_to_one_receiver, chat_lines[3]) != 0;
+    const session_entry *entry = NULL;
+    for(int index = 0; index < SESSION_CACHE_SIZE; index++){
+        if(node_three.entries[index].in_use && node_three.entries[index].peer_id == 1){
+            entry = &node_three.entries[index];
+        }
+    }
+    failures += entry == NULL || !entry->confirmed;
+
+    printf("lost INIT and lost REPLY: %u retries, %s\n", node_one->stats.handshakes_retried,
+           failures == 0 ? "messages kept flowing" : "FAILED");
+    return failures;
+}
+
+/*
+ * Node 4 sends to node 5, reboots (empty cache, sequence back to 0) and
+ * opens a new session. Returns the number of failed checks.
+ */
+static int rebootedPeer(const uint8_t *network_key){
+
+    static session_cache node_four, node_five;
+    int failures = 0, delivered = 0;
+    const int before_reboot = 200, after_reboot = 20;
+
+    sessionCacheInit(&node_four, 4, network_key);
+    sessionCacheInit(&node_five, 5, network_key);
+    device sender = { .transmitter_id = 4, .receiver_id = 5, .sessions = &node_four };
+    device receiver = { .transmitter_id = 4, .receiver_id = 5, .sessions = &node_five };
+
+    failures += runHandshake(&node_four, &node_five, 5) != 0;
+    for(int index = 0; index < before_reboot; index++){
+        failures += deliver(&sender, &receiver, chat_lines[index % 4]) != 0;
+    }
+
+    sessionCacheInit(&node_four, 4, network_key);
+    sender.sequence = 0;
+    failures += runHandshake(&node_four, &node_five, 5) != 0;
+    for(int index = 0; index < after_reboot; index++){
+        delivered += deliver(&sender, &receiver, chat_lines[index % 4]) == 0;
+    }
+    failures += delivered != after_reboot;
+
+    // The new session still refuses its own replays
+    uint8_t frame[PACKET_MAX_SIZE], replayed[PACKET_MAX_SIZE];
+    size_t frame_length = 0;
+    encodeMessage(chat_lines[0], &sender, frame, sizeof(frame), &frame_length);
+    memcpy(replayed, frame, frame_length);
+    failures += receiveMessage(frame, frame_length, &receiver) != 0;
+    failures += receiveMessage(replayed, frame_length, &receiver) != 306;
+
+    printf("peer rebooted after %d messages: %d of %d delivered, replay %s\n", before_reboot, delivered,
+           after_reboot, failures == 0 ? "refused" : "FAILED");
+    return failures;
+}
+
+int main(int argc, char **argv){
+
+    int handshakes = argc > 1 ? atoi(argv[1]) : 200;
+    int messages = argc > 2 ? atoi(argv[2]) : 20000;
+    uint8_t network_key[AEAD_KEY_SIZE];
+    static session_cache node_one, node_two;
+
+    for(size_t index = 0; index < sizeof(network_key); index++){
+        network_key[index] = (uint8_t)(0xA5 ^ (index * 13));
+    }
+    sessionCacheInit(&node_one, 1, network_key);
+    sessionCacheInit(&node_two, 2, network_key);
+
+    // Each link end as transmiter.c sees it
+    device one_to_two_sender = { .transmitter_id = 1, .receiver_id = 2, .sessions = &node_one };
+    device one_to_two_receiver = { .transmitter_id = 1, .receiver_id = 2, .sessions = &node_two };
+    device two_to_one_sender = { .transmitter_id = 2, .receiver_id = 1, .sessions = &node_two };
+    device two_to_one_receiver = { .transmitter_id = 2, .receiver_id = 1, .sessions = &node_one };
+
+    printf("AEAD backend: %s, cache: %d peers, %zu bytes\n",
+           aeadBackendName(), SESSION_CACHE_SIZE, sizeof(session_cache));
+
+    // No session yet: sending must be refused, not fall back to plaintext
+    int error = deliver(&one_to_two_sender, &one_to_two_receiver, chat_lines[0]);
+    printf("\nsend before handshake: error %d (expected %d)\n", error, SESSION_ERROR_NO_SESSION);
+
+    // 1. Handshake cost
+    double start = nowSeconds();
+    for(int round = 0; round < handshakes; round++){
+        error = runHandshake(&node_one, &node_two, 2);
+        if(error != 0){
+            printf("handshake failed: %d\n", error);
+            return 1;
+        }
+    }
+    double handshake_us = (nowSeconds() - start) / handshakes * 1e6;
+    printf("handshake (both ends, 4 X25519 ops): %8.1f us\n", handshake_us);
+
+    // 2. Steady state, both directions
+    start = nowSeconds();
+    for(int index = 0; index < messages; index++){
+        const char *text = chat_lines[index % 4];
+        error = (index & 1) ? deliver(&two_to_one_sender, &two_to_one_receiver, text)
+                            : deliver(&one_to_two_sender, &one_to_two_receiver, text);
+        if(error != 0){
+            printf("message %d failed: %d\n", index, error);
+            return 1;
+        }
+        // Keep the benchmark in one session: renew before the hard limit
+        if(sessionRekeyDue(&node_one, 2, nowUs())){
+            runHandshake(&node_one, &node_two, 2);
+        }
+    }
+    double message_us = (nowSeconds() - start) / messages * 1e6;
+    printf("message (compress + seal + open):    %8.2f us\n", message_us);
+    printf("per-message X25519 would cost:       %8.1f us (%.0fx)\n",
+           handshake_us + message_us, (handshake_us + message_us) / message_us);
+
+    // 3. Rekeys with a frame in flight across each of them
+    session_stats before = node_two.stats;
+    int failures = 0, late_frames = 0;
+    for(int index = 0; index < 3 * SESSION_REKEY_MESSAGES; index++){
+        if(sessionRekeyDue(&node_one, 2, nowUs())){
+            uint8_t init_frame[PACKET_MAX_SIZE], reply_frame[PACKET_MAX_SIZE], late_frame[PACKET_MAX_SIZE];
+            size_t init_length = 0, reply_length = 0, late_length = 0, unused_length = 0;
+
+            // Node 1 seals one more message, then sends INIT; node 2 sees INIT first
+            encodeMessage(chat_lines[1], &one_to_two_sender, late_frame, sizeof(late_frame), &late_length);
+            sessionStartHandshake(&node_one, 2, nowUs(), init_frame, sizeof(init_frame), &init_length);
+            sessionHandleHandshake(&node_two, init_frame, init_length, nowUs(),
+                                   reply_frame, sizeof(reply_frame), &reply_length);
+            failures += receiveMessage(late_frame, late_length, &one_to_two_receiver) != 0;
+            sessionHandleHandshake(&node_one, reply_frame, reply_length, nowUs(),
+                                   init_frame, sizeof(init_frame), &unused_length);
+            late_frames++;
+        }
+        failures += deliver(&one_to_two_sender, &one_to_two_receiver, chat_lines[index % 4]) != 0;
+    }
+    printf("\n%d messages: %u rekeys, %d late frames across a rekey, %d failures\n",
+           3 * SESSION_REKEY_MESSAGES, node_two.stats.rekeys - before.rekeys, late_frames, failures);
+
+    // 4. A recorded frame sent again is refused
+    uint8_t frame[PACKET_MAX_SIZE], replayed[PACKET_MAX_SIZE];
+    size_t frame_length = 0;
+    encodeMessage(chat_lines[2], &one_to_two_sender, frame, sizeof(frame), &frame_length);
+    memcpy(replayed, frame, frame_length);
+    failures += receiveMessage(frame, frame_length, &one_to_two_receiver) != 0;
+    error = receiveMessage(replayed, frame_length, &one_to_two_receiver);
+    printf("replayed frame: error %d (expected 306)\n", error);
+    failures += error != 306;
+
+    // 5. A peer that reboots
+    failures += rebootedPeer(network_key);
+
+    // 6. Lost handshake frames
+    failures += lostHandshakes(&node_one, network_key);
+
+    // 7. More peers than the cache holds
+    static session_cache peers[EXTRA_PEERS];
+    for(int peer = 0; peer < EXTRA_PEERS; peer++){
+        sessionCacheInit(&peers[peer], 100 + peer, network_key);
+        runHandshake(&node_one, &peers[peer], 100 + peer);
+    }
+    printf("%d extra peers: %u evictions, node 2 %s\n", EXTRA_PEERS, node_one.stats.evictions,
+           sessionRekeyDue(&node_one, 2, nowUs()) ? "evicted (handshake again on next use)" : "still cached");
+
+    // 8. A node without the network key
+    static session_cache intruder;
+    uint8_t wrong_key[AEAD_KEY_SIZE] = {0};
+    sessionCacheInit(&intruder, 66, wrong_key);
+    error = runHandshake(&intruder, &node_two, 2);
+    printf("handshake without the network key: error %d (expected %d)\n", error, SESSION_ERROR_REJECTED);
+    failures += error != SESSION_ERROR_REJECTED;
+
+    printf("\nnode 1: %u started, %u completed, %u rekeys, %u rejected\n",
+           node_one.stats.handshakes_started, node_one.stats.handshakes_completed,
+           node_one.stats.rekeys, node_one.stats.handshakes_rejected);
+    printf("node 2: %u completed, %u rekeys, %u rejected\n",
+           node_two.stats.handshakes_completed, node_two.stats.rekeys, node_two.stats.handshakes_rejected);
+    return failures == 0 ? 0 : 1;
+}